@@ -0,0 +1,628 @@
+/*
+ * HITIComm
+ * Benchmark.cpp (host build)
+ *
+ * Copyright © 2021 Christophe LANDRET
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// *****************************************************************************
+// Include dependencies
+// *****************************************************************************
+
+// HITIComm
+#include <HITIComm.h>
+#include "HC_Toolbox.h"
+#include "sub\HC_MessageType.h"
+
+// HITIComm client (computer side)
+#include "HC_Client.h"
+
+// POSIX
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+
+
+// *****************************************************************************
+// Define
+// *****************************************************************************
+
+// Protocol benchmark of 1 protocol option (PROTOBF_OPTION of the build, see "make benchmark").
+// The board runs on the virtual clock: bytes and rates are deterministic (can be compared
+// between 2 runs to detect a regression), CPU times are measured on the host (ns).
+
+#ifndef HC_PROTOCOL_PROFILE
+	#error "build with -DHC_PROTOCOL_PROFILE (make benchmark)"
+#endif
+
+// virtual time of 1 cycle of loop() (us)
+#define HCB_CYCLE_TIME		100
+
+// cycles without output: end of a burst of X replies
+#define HCB_IDLE_CYCLES		20
+#define HCB_MAX_CYCLES		100000
+
+static const char* const HCB_optionName[] =
+{
+	"FULLY_READABLE",
+	"USE_INT",
+	"USE_SEPARATOR",
+	"HEX",
+	"BINARY"
+};
+
+// board configurations (X sequence): every combination
+static const uint8_t HCB_servoQty[] = { 0, 8, 24 };		// pins 22 ->
+static const uint8_t HCB_pwmQty[]   = { 0, 4, 8 };		// pins 2 ->
+static const uint8_t HCB_adQty[]    = { 0, 8, 20 };		// AD 0 ->
+
+// baudrates (A replies)
+static const unsigned long HCB_baudrate[] = { 9600, 19200, 38400, 57600, 115200, 250000, 500000, 1000000, 2000000 };
+
+// output: CSV (1 value per line) or tables
+static bool g_csv = false;
+
+// output of the board, recorded for the client decoder
+#define HCB_RECORD_SIZE			(4UL * 1024 * 1024)
+#define HCB_DECODE_MIN_BYTES	(64UL * 1024 * 1024)
+#define HCB_DECODE_CHUNK		64
+
+static uint8_t* g_record = NULL_POINTER;
+static size_t g_record_length = 0;
+
+
+
+// *****************************************************************************
+// Board
+// *****************************************************************************
+
+static HC_Protocol& HCB_session() { return *HC_Protocol::getFirstSession(); }
+
+
+// frames in the output (end of frame: LF, or 0x00 if binary)
+static unsigned long HCB_countFrames(const uint8_t* buffer, size_t length)
+{
+	unsigned long qty = 0;
+	for (size_t i = 0; i < length; ++i)
+	{
+		#ifdef PROTOBF_USE_BINARY
+			if (buffer[i] == 0x00)
+		#else
+			if (buffer[i] == '\n')
+		#endif
+				++qty;
+	}
+	return qty;
+}
+
+
+// 1 cycle of loop(). Returns sent bytes (frames: added to frameQty)
+static size_t HCB_cycle(unsigned long* frameQty = NULL_POINTER)
+{
+	HC_communicate();
+	HCS_Host_advance(HCB_CYCLE_TIME);
+
+	uint8_t buffer[1024];
+	size_t total = 0;
+	size_t n;
+	while ((n = HCS_Host_receive(Serial, buffer, sizeof(buffer))) != 0)
+	{
+		total += n;
+		if (frameQty != NULL_POINTER)
+			*frameQty += HCB_countFrames(buffer, n);
+
+		if ((g_record != NULL_POINTER) && (g_record_length + n <= HCB_RECORD_SIZE))
+		{
+			memcpy(&g_record[g_record_length], buffer, n);
+			g_record_length += n;
+		}
+	}
+	return total;
+}
+
+
+static void HCB_run(unsigned long duration)	// us
+{
+	for (unsigned long t = 0; t < duration; t += HCB_CYCLE_TIME)
+		HCB_cycle();
+}
+
+
+// burst of replies: until HCB_IDLE_CYCLES cycles without output
+static size_t HCB_runBurst(unsigned long* frameQty)
+{
+	size_t bytes = 0;
+	unsigned int idle = 0;
+
+	for (unsigned long i = 0; (i < HCB_MAX_CYCLES) && (idle < HCB_IDLE_CYCLES); ++i)
+	{
+		size_t n = HCB_cycle(frameQty);
+		bytes += n;
+		idle = ((n == 0) && (bytes != 0)) ? idle + 1 : 0;
+	}
+	return bytes;
+}
+
+
+// average time of 1 call (ns)
+static double HCB_profile(uint8_t function)
+{
+	unsigned long calls = HCB_session().getProfileCalls(function);
+	return (calls == 0) ? 0 : (double)HCB_session().getProfileTime(function) / calls;
+}
+
+
+
+// *****************************************************************************
+// Queries (computer side)
+// *****************************************************************************
+
+// format of the build
+static HC_ClientFormat HCB_format()
+{
+	HC_ClientFormat format;
+	format.option = PROTOBF_OPTION;
+	#ifdef HC_XQUERY_CHANGEMASK
+		format.changeMask = true;
+	#endif
+	#ifdef HC_QUERY_TIMESTAMP
+		format.timestamp = true;
+	#endif
+	return format;
+}
+
+static HC_ClientQuery g_query(HCB_format());
+
+
+// CRC, end of frame, then sent to the board
+static void HCB_send()
+{
+	size_t length = g_query.end();
+	HCS_Host_send(Serial, g_query.getData(), length);
+}
+
+
+static void HCB_sendCommand(uint8_t type)
+{
+	g_query.begin(type);
+	HCB_send();
+}
+
+
+
+// *****************************************************************************
+// Output
+// *****************************************************************************
+
+static void HCB_printValue(const char* section, const char* config, const char* metric, double value)
+{
+	printf("%s,%s,%s,%s,%.1f\n", HCB_optionName[PROTOBF_OPTION], section, config, metric, value);
+}
+
+
+// each measurement runs in a child process: the board starts from reset
+template <typename F> static void HCB_fork(F measure)
+{
+	fflush(stdout);
+
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		measure();
+		fflush(stdout);
+		_exit(0);
+	}
+
+	int status;
+	waitpid(pid, &status, 0);
+	if (!WIFEXITED(status) || (WEXITSTATUS(status) != 0))
+		fprintf(stderr, "measurement failed (status %d)\n", status);
+}
+
+
+
+// *****************************************************************************
+// X sequence
+// *****************************************************************************
+
+// bytes and frames of a full X sequence (first one after Xs, all groups and config messages),
+// of a steady sequence (next one: config messages only if changed), and CPU time per send()
+static void HCB_measureXSequence(uint8_t servoQty, uint8_t pwmQty, uint8_t adQty)
+{
+	HC_begin();
+	Serial.begin(0); // infinite: a sequence is 1 burst
+
+	for (uint8_t i = 0; i < servoQty; ++i)
+		HC_attachServo(22 + i);
+	for (uint8_t i = 0; i < pwmQty; ++i)
+	{
+		pinMode(2 + i, OUTPUT);
+		HC_outputType(2 + i, 1);
+		HC_writePWM(2 + i, (uint8_t)(20 * (i + 1)));
+	}
+	for (uint8_t i = 0; i < adQty; ++i)
+		HC_writeAD(i, 1.5f * (i + 1));
+
+	HCB_run(10000);
+
+	// active PWM (PWM not available on the timers used by servos)
+	unsigned int pwmActive = 0;
+	for (uint8_t pin = HCS_getDIO_startIndex(); pin <= HCS_getDIO_endIndex(); ++pin)
+		pwmActive += HC_PwmIsActivated(pin);
+
+	char config[32];
+	snprintf(config, sizeof(config), "S%u_P%u_A%u", servoQty, pwmActive, adQty);
+
+	// X query started once: config values which are only read by the X query are up to date
+	HCB_sendCommand(HC_ClientType_Xs);
+	HCB_run(200000);
+	HCB_sendCommand(HC_ClientType_Xu);
+	HCB_run(10000);
+
+	// full sequence
+	unsigned long fullFrames = 0;
+	HCB_sendCommand(HC_ClientType_Xs);
+	size_t fullBytes = HCB_runBurst(&fullFrames);
+
+	// steady sequence
+	unsigned long steadyFrames = 0;
+	size_t steadyBytes = HCB_runBurst(&steadyFrames);
+
+	// send(): 1 s of X replies
+	HCB_session().resetProfile();
+	HCB_run(1000000);
+	double sendTime = HCB_profile(HC_PROFILE_SEND);
+
+	if (g_csv)
+	{
+		HCB_printValue("X", config, "full_bytes", fullBytes);
+		HCB_printValue("X", config, "full_frames", fullFrames);
+		HCB_printValue("X", config, "steady_bytes", steadyBytes);
+		HCB_printValue("X", config, "steady_frames", steadyFrames);
+		HCB_printValue("X", config, "send_ns", sendTime);
+	}
+	else
+		printf("  %-14s %10zu %8lu %12zu %8lu %12.0f %10.1f\n",
+			config, fullBytes, fullFrames, steadyBytes, steadyFrames,
+			115200.0 / 10 / steadyBytes, sendTime);
+}
+
+
+
+// *****************************************************************************
+// A replies
+// *****************************************************************************
+
+// As reply: quantity of subscriptions accepted by the board
+class HCB_SubscriptionHandler : public HC_ClientHandler
+{
+	public:
+		void onMessage(const HC_ClientMessage& message)
+		{
+			if ((message.type == HC_ClientType_As) && (message.event == HC_ClientEvent_Data) && (message.qty == 1))
+				accepted = (int)message.values[0];
+		}
+
+		int accepted = -1;
+};
+
+
+// message type of subscription i
+static uint8_t HCB_subscriptionType(uint8_t i, uint8_t channelQty)
+{
+	if ((channelQty == 4) || (i < 6))
+		return HC_ClientType_AI;
+	return (i < 12) ? HC_ClientType_AD : HC_ClientType_DD;
+}
+
+
+// subscriptions: 4 AI, or 16 channels (6 AI, 6 AD, 4 DD).
+// 4 channels per As message (received message: HC_INPUTMESSAGE_MAX_ARRAY_LENGHT), next ones added in write mode.
+// Only what fits in the output frame is accepted: stops at the first refused subscription (As reply).
+// Accepted ones are added to decoder (if any). Returns the quantity of subscriptions.
+static uint8_t HCB_subscribeA(uint8_t channelQty, HC_ClientDecoder* decoder = NULL_POINTER)
+{
+	uint8_t qty = 0;
+
+	for (uint8_t first = 0; first < channelQty; first += 4)
+	{
+		g_query.begin(HC_ClientType_As, (first == 0) ? 0 : HC_CLIENT_CONFIG_WRITE);
+
+		for (uint8_t i = first; i < first + 4; ++i)
+		{
+			uint8_t type = HCB_subscriptionType(i, channelQty);
+			g_query.addType(type);
+			if (type == HC_ClientType_AI)
+				g_query.addIndex(i);
+			else
+				g_query.addIndex((type == HC_ClientType_AD) ? i - 6 : i - 12);
+		}
+
+		HCB_send();
+
+		// As reply (A replies start in the same cycle)
+		HCB_SubscriptionHandler handler;
+		HC_ClientDecoder replies(handler, HCB_format());
+		for (unsigned long j = 0; (j < HCB_MAX_CYCLES) && (handler.accepted < 0); ++j)
+		{
+			HC_communicate();
+			HCS_Host_advance(HCB_CYCLE_TIME);
+
+			uint8_t buffer[256];
+			size_t n;
+			while ((n = HCS_Host_receive(Serial, buffer, sizeof(buffer))) != 0)
+				replies.feed(buffer, n);
+		}
+		if (handler.accepted < qty)
+			break;
+
+		uint8_t accepted = (uint8_t)handler.accepted;
+		if (decoder != NULL_POINTER)
+			for (uint8_t i = qty; i < accepted; ++i)
+				decoder->addASubscription(HCB_subscriptionType(i, channelQty));
+
+		bool isFull = (accepted < qty + 4);
+		qty = accepted;
+		if (isFull)
+			break;
+	}
+	return qty;
+}
+
+
+// replies per second, bytes per reply, deferred replies (TX buffer full)
+static void HCB_measureAReplies(unsigned long baudrate, uint8_t channelQty)
+{
+	HC_begin();
+	Serial.begin(baudrate);
+	for (uint8_t i = 0; i < 6; ++i)
+		HC_writeAD(i, 0.25f * (i + 1));
+	HCB_run(10000);
+
+	// subscriptions which fit in the output frame
+	uint8_t subscriptionQty = HCB_subscribeA(channelQty);
+	HCB_run(100000);
+
+	// 1 s (virtual clock: includes the time blocked in write() if a reply is longer than the TX buffer)
+	unsigned long frames = 0;
+	size_t bytes = 0;
+	unsigned long deferred = HCB_session().getDeferredReplies();
+	unsigned long long blocked = HCS_Host_getBlockedTime(Serial);
+	unsigned long long start = HCS_Host_getTime();
+	while (HCS_Host_getTime() - start < 1000000)
+		bytes += HCB_cycle(&frames);
+	double duration = (HCS_Host_getTime() - start) / 1000000.0;
+	deferred = HCB_session().getDeferredReplies() - deferred;
+	blocked = HCS_Host_getBlockedTime(Serial) - blocked;
+
+	double rate = frames / duration;
+	double bytesPerReply = (frames == 0) ? 0 : (double)bytes / frames;
+	double load = 100.0 * bytes * 10 / baudrate / duration;
+
+	char config[32];
+	snprintf(config, sizeof(config), "%luBd_%uch", baudrate, channelQty);
+
+	if (g_csv)
+	{
+		HCB_printValue("A", config, "subscriptions", subscriptionQty);
+		HCB_printValue("A", config, "replies_per_s", rate);
+		HCB_printValue("A", config, "bytes_per_reply", bytesPerReply);
+		HCB_printValue("A", config, "deferred", deferred);
+		HCB_printValue("A", config, "blocked_us", blocked);
+	}
+	else
+		printf("  %-10lu %4u %12.0f %10.1f %10lu %10llu %9.0f%%\n",
+			baudrate, subscriptionQty, rate, bytesPerReply, deferred, blocked, load);
+}
+
+
+
+// *****************************************************************************
+// analyzeInput()
+// *****************************************************************************
+
+#define HCB_QUERY_REPEAT	1000
+
+// CPU time per received message (parsing, action and reply), for a few queries
+static void HCB_measureQuery(const char* name)
+{
+	HC_begin();
+	Serial.begin(0);
+	HCB_run(10000);
+
+	HCB_session().resetProfile();
+	for (unsigned int i = 0; i < HCB_QUERY_REPEAT; ++i)
+	{
+		if (strcmp(name, "DD_write") == 0)
+		{
+			g_query.begin(HC_ClientType_DD, HC_CLIENT_CONFIG_WRITE);
+			g_query.addHex(0x12345678 + i, 8);
+		}
+		else if (strcmp(name, "AI_read") == 0)
+			g_query.begin(HC_ClientType_AI, HC_CLIENT_CONFIG_INDEX, i % 16);
+		else if (strcmp(name, "AD_write") == 0)
+		{
+			g_query.begin(HC_ClientType_AD, HC_CLIENT_CONFIG_WRITE | HC_CLIENT_CONFIG_INDEX, i % 20);
+			g_query.addFloat(0.5f * i);
+		}
+		else // DD_read
+			g_query.begin(HC_ClientType_DD);
+
+		HCB_send();
+		HCB_cycle();
+	}
+	double analyzeTime = HCB_profile(HC_PROFILE_ANALYZEINPUT);
+	unsigned long calls = HCB_session().getProfileCalls(HC_PROFILE_ANALYZEINPUT);
+
+	if (g_csv)
+		HCB_printValue("Q", name, "analyzeInput_ns", analyzeTime);
+	else
+		printf("  %-10s %10lu %16.1f\n", name, calls, analyzeTime);
+}
+
+
+
+// *****************************************************************************
+// Client decoder
+// *****************************************************************************
+
+// counts the decoded values, reassembles the X sequences
+class HCB_ClientHandler : public HC_ClientHandler
+{
+	public:
+		void onMessage(const HC_ClientMessage& message)
+		{
+			values += message.qty;
+			sequences += snapshot.update(message);
+		}
+
+		HC_ClientSnapshot snapshot;
+		unsigned long values = 0;
+		unsigned long sequences = 0;
+};
+
+
+// computer side: 1 s of board output (X sequence S8_P4_A8, or A replies with 16 channels),
+// decoded by HC_ClientDecoder in chunks of HCB_DECODE_CHUNK bytes.
+// Rate: MB/s, and multiple of a saturated 1 Mbaud line (100 kB/s)
+static void HCB_measureDecoder(const char* name)
+{
+	HC_begin();
+	Serial.begin(0);
+
+	static uint8_t record[HCB_RECORD_SIZE];
+	g_record = record;
+	g_record_length = 0;
+
+	HCB_ClientHandler handler;
+	HC_ClientDecoder decoder(handler, HCB_format());
+
+	if (strcmp(name, "X") == 0)
+	{
+		for (uint8_t i = 0; i < 8; ++i)
+		{
+			HC_attachServo(22 + i);
+			HC_writeAD(i, 1.5f * (i + 1));
+		}
+		for (uint8_t i = 0; i < 4; ++i)
+		{
+			pinMode(2 + i, OUTPUT);
+			HC_outputType(2 + i, 1);
+			HC_writePWM(2 + i, (uint8_t)(20 * (i + 1)));
+		}
+		HCB_run(10000);
+
+		g_record_length = 0;
+		HCB_sendCommand(HC_ClientType_Xs);
+		HCB_run(1000000);
+	}
+	else // A
+	{
+		for (uint8_t i = 0; i < 6; ++i)
+			HC_writeAD(i, 0.25f * (i + 1));
+		HCB_run(10000);
+
+		HCB_subscribeA(16, &decoder);
+		HCB_run(10000);
+
+		// from the start of a reply
+		g_record_length = 0;
+		HCB_run(1000000);
+		decoder.reset();
+	}
+	g_record = NULL_POINTER;
+
+	// same output, decoded again until HCB_DECODE_MIN_BYTES
+	unsigned long passes = 0;
+	unsigned long long start = HCS_Host_readNanoseconds();
+	do
+	{
+		for (size_t i = 0; i < g_record_length; i += HCB_DECODE_CHUNK)
+			decoder.feed(&record[i], (g_record_length - i < HCB_DECODE_CHUNK) ? g_record_length - i : HCB_DECODE_CHUNK);
+		++passes;
+	} while (passes * g_record_length < HCB_DECODE_MIN_BYTES);
+	double duration = (HCS_Host_readNanoseconds() - start) / 1e9;
+
+	double bytes = (double)passes * g_record_length;
+	double frames = (double)decoder.getFrames() / passes;
+	unsigned long drops = 0;
+	for (uint8_t i = 0; i < HC_CLIENT_DROP_QTY; ++i)
+		drops += decoder.getDrops(i);
+	double rate = bytes / duration / 1e6;
+
+	if (g_csv)
+	{
+		HCB_printValue("D", name, "bytes", g_record_length);
+		HCB_printValue("D", name, "frames", frames);
+		HCB_printValue("D", name, "drops", drops);
+		HCB_printValue("D", name, "MB_per_s", rate);
+		HCB_printValue("D", name, "ns_per_frame", duration * 1e9 / decoder.getFrames());
+	}
+	else
+		printf("  %-4s %10zu %8.0f %8lu %10lu %12.1f %10.1f %12.0f\n",
+			name, g_record_length, frames, drops, handler.sequences / passes, rate,
+			duration * 1e9 / decoder.getFrames(), rate * 1e6 / 100000);
+}
+
+
+
+// *****************************************************************************
+// Main
+// *****************************************************************************
+
+int main(int argc, char** argv)
+{
+	g_csv = (argc > 1) && (strcmp(argv[1], "-c") == 0);
+
+	if (!g_csv)
+		printf("\n##### PROTOBF_OPTIONS_%s\n\n"
+			"X sequence (S: servos, P: active PWM, A: non-null AD)\n"
+			"  %-14s %10s %8s %12s %8s %12s %10s\n",
+			HCB_optionName[PROTOBF_OPTION],
+			"config", "full (B)", "frames", "steady (B)", "frames", "seq/s@115k2", "send (ns)");
+
+	for (uint8_t s = 0; s < sizeof(HCB_servoQty); ++s)
+		for (uint8_t p = 0; p < sizeof(HCB_pwmQty); ++p)
+			for (uint8_t a = 0; a < sizeof(HCB_adQty); ++a)
+				HCB_fork([=] { HCB_measureXSequence(HCB_servoQty[s], HCB_pwmQty[p], HCB_adQty[a]); });
+
+	if (!g_csv)
+		printf("\nA replies (period %u us)\n  %-10s %4s %12s %10s %10s %10s %10s\n",
+			HC_AQUERY_PERIOD, "baudrate", "ch", "replies/s", "B/reply", "deferred", "blocked(us)", "line load");
+
+	for (uint8_t channelQty = 4; channelQty <= 16; channelQty += 12)
+		for (uint8_t i = 0; i < sizeof(HCB_baudrate) / sizeof(HCB_baudrate[0]); ++i)
+			HCB_fork([=] { HCB_measureAReplies(HCB_baudrate[i], channelQty); });
+
+	if (!g_csv)
+		printf("\nanalyzeInput() (1 received message, with its reply)\n  %-10s %10s %16s\n",
+			"query", "messages", "analyze (ns)");
+
+	const char* const queries[] = { "DD_read", "DD_write", "AI_read", "AD_write" };
+	for (uint8_t i = 0; i < 4; ++i)
+		HCB_fork([=] { HCB_measureQuery(queries[i]); });
+
+	if (!g_csv)
+		printf("\nClient decoder (1 s of board output, decoded by HC_ClientDecoder)\n  %-4s %10s %8s %8s %10s %12s %10s %12s\n",
+			"", "bytes", "frames", "drops", "sequences", "MB/s", "ns/frame", "x 1 Mbaud");
+
+	HCB_fork([] { HCB_measureDecoder("X"); });
+	HCB_fork([] { HCB_measureDecoder("A"); });
+
+	return 0;
+}
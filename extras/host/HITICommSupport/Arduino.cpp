@@ -0,0 +1,325 @@
+/*
+ * HITIComm
+ * Arduino.cpp (host build)
+ *
+ * Copyright © 2021 Christophe LANDRET
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "Arduino.h"
+
+
+
+// *****************************************************************************
+// Include dependencies
+// *****************************************************************************
+
+// HITICommSupport
+#include "HITICommSupport.h"
+
+// POSIX
+#include <unistd.h>
+
+
+
+// *****************************************************************************
+// Print
+// *****************************************************************************
+
+	size_t Print::write(const uint8_t* buffer, size_t size)
+	{
+		size_t n = 0;
+		while (size--)
+			n += write(*buffer++);
+		return n;
+	}
+
+	size_t Print::print(const char* str)				{ return write(str); }
+	size_t Print::print(char c)							{ return write((uint8_t)c); }
+	size_t Print::print(unsigned char n, int base)		{ return print((unsigned long)n, base); }
+	size_t Print::print(int n, int base)				{ return print((long)n, base); }
+	size_t Print::print(unsigned int n, int base)		{ return print((unsigned long)n, base); }
+
+	size_t Print::print(long n, int base)
+	{
+		// as Arduino: negative numbers only in base 10, otherwise 32-bit two's complement
+		if ((base == DEC) && (n < 0))
+			return print('-') + printNumber((unsigned long)-n, DEC);
+
+		return printNumber((uint32_t)n, base);
+	}
+
+	size_t Print::print(unsigned long n, int base)
+	{
+		return printNumber(n, base);
+	}
+
+	// as Arduino Print::printFloat()
+	size_t Print::print(double number, int digits)
+	{
+		if (isnan(number))	return print("nan");
+		if (isinf(number))	return print("inf");
+		if ((number > 4294967040.0) || (number < -4294967040.0))
+			return print("ovf");
+
+		size_t n = 0;
+		if (number < 0.0)
+		{
+			n += print('-');
+			number = -number;
+		}
+
+		double rounding = 0.5;
+		for (int i = 0; i < digits; ++i)
+			rounding /= 10.0;
+		number += rounding;
+
+		unsigned long integerPart = (unsigned long)number;
+		double remainder = number - (double)integerPart;
+		n += print(integerPart);
+
+		if (digits > 0)
+			n += print('.');
+
+		while (digits-- > 0)
+		{
+			remainder *= 10.0;
+			unsigned int digit = (unsigned int)remainder;
+			n += print(digit);
+			remainder -= digit;
+		}
+
+		return n;
+	}
+
+	size_t Print::println()									{ return write("\r\n"); }
+	size_t Print::println(const char* str)					{ return print(str) + println(); }
+	size_t Print::println(char c)							{ return print(c) + println(); }
+	size_t Print::println(unsigned char n, int base)		{ return print(n, base) + println(); }
+	size_t Print::println(int n, int base)					{ return print(n, base) + println(); }
+	size_t Print::println(unsigned int n, int base)			{ return print(n, base) + println(); }
+	size_t Print::println(long n, int base)					{ return print(n, base) + println(); }
+	size_t Print::println(unsigned long n, int base)		{ return print(n, base) + println(); }
+	size_t Print::println(double n, int digits)				{ return print(n, digits) + println(); }
+
+	size_t Print::printNumber(unsigned long n, uint8_t base)
+	{
+		char buffer[8 * sizeof(long) + 1];
+		char* str = &buffer[sizeof(buffer) - 1];
+		*str = '\0';
+
+		if (base < 2)
+			base = 10;
+
+		do
+		{
+			char digit = n % base;
+			n /= base;
+			*--str = (digit < 10) ? digit + '0' : digit + 'A' - 10;
+		} while (n);
+
+		return write(str);
+	}
+
+
+
+// *****************************************************************************
+// HardwareSerial
+// *****************************************************************************
+
+	void HardwareSerial::begin(unsigned long baudrate)
+	{
+		drain();
+		mBaudrate = baudrate;
+		mTX_drainTime = HCS_Host_getTime();
+		mTX_drainRemainder = 0;
+	}
+
+
+	// Stream ------------------------------------------------------------------
+
+	int HardwareSerial::available()
+	{
+		pollPty();
+		return (int)mRX_length;
+	}
+
+	int HardwareSerial::read()
+	{
+		pollPty();
+		if (mRX_length == 0)
+			return -1;
+
+		uint8_t b = mRX[mRX_head];
+		mRX_head = (mRX_head + 1) % HCS_HOST_SERIAL_PIPE_SIZE;
+		--mRX_length;
+
+		return b;
+	}
+
+	int HardwareSerial::peek()
+	{
+		pollPty();
+		return (mRX_length == 0) ? -1 : mRX[mRX_head];
+	}
+
+	// wait until all bytes are sent
+	void HardwareSerial::flush()
+	{
+		drain();
+		while (mTX_length != 0)
+		{
+			HCS_Host_advance(10000000ULL / mBaudrate);
+			drain();
+		}
+	}
+
+
+	// Print -------------------------------------------------------------------
+
+	size_t HardwareSerial::write(uint8_t b)
+	{
+		drain();
+
+		// TX buffer full: blocks until 1 byte is sent
+		while (mTX_length >= HCS_HOST_SERIAL_TX_BUFFER_SIZE - 1)
+		{
+			unsigned long long byteTime = 10000000ULL / mBaudrate;
+			HCS_Host_advance(byteTime);
+			mBlockedTime += byteTime;
+			drain();
+		}
+
+		mTX[(mTX_head + mTX_length) % HCS_HOST_SERIAL_TX_BUFFER_SIZE] = b;
+		++mTX_length;
+
+		// infinite baudrate: sent at once
+		if (mBaudrate == 0)
+			drain();
+
+		return 1;
+	}
+
+	size_t HardwareSerial::write(const uint8_t* buffer, size_t size)
+	{
+		for (size_t i = 0; i < size; ++i)
+			write(buffer[i]);
+		return size;
+	}
+
+	int HardwareSerial::availableForWrite()
+	{
+		drain();
+		return (int)(HCS_HOST_SERIAL_TX_BUFFER_SIZE - 1 - mTX_length);
+	}
+
+
+	// host side ---------------------------------------------------------------
+
+	size_t HardwareSerial::host_write(const uint8_t* buffer, size_t size)
+	{
+		size_t n = 0;
+		while ((n < size) && (mRX_length < HCS_HOST_SERIAL_PIPE_SIZE))
+		{
+			mRX[(mRX_head + mRX_length) % HCS_HOST_SERIAL_PIPE_SIZE] = transmit(buffer[n++]);
+			++mRX_length;
+		}
+		return n;
+	}
+
+	size_t HardwareSerial::host_read(uint8_t* buffer, size_t size)
+	{
+		drain();
+
+		size_t n = 0;
+		while ((n < size) && (mSent_length != 0))
+		{
+			buffer[n++] = mSent[mSent_head];
+			mSent_head = (mSent_head + 1) % HCS_HOST_SERIAL_PIPE_SIZE;
+			--mSent_length;
+		}
+		return n;
+	}
+
+	size_t HardwareSerial::host_available()
+	{
+		drain();
+		return mSent_length;
+	}
+
+
+	// private -----------------------------------------------------------------
+
+	// bytes sent on the line since the last call (10 bits per byte)
+	void HardwareSerial::drain()
+	{
+		unsigned long long now = HCS_Host_getTime();
+
+		size_t qty = mTX_length;
+		if (mBaudrate != 0)
+		{
+			double bytes = (double)(now - mTX_drainTime) * mBaudrate / 10000000.0 + mTX_drainRemainder;
+			if (bytes < (double)qty)
+			{
+				qty = (size_t)bytes;
+				mTX_drainRemainder = bytes - qty;
+			}
+			else
+				mTX_drainRemainder = 0;
+		}
+		mTX_drainTime = now;
+
+		while (qty--)
+		{
+			uint8_t b = mTX[mTX_head];
+			mTX_head = (mTX_head + 1) % HCS_HOST_SERIAL_TX_BUFFER_SIZE;
+			--mTX_length;
+
+			// pseudo-terminal (dropped if the application doesn't read), or in-memory pipe
+			if (mPty >= 0)
+			{
+				ssize_t written = ::write(mPty, &b, 1);
+				(void)written;
+			}
+			else if (mSent_length < HCS_HOST_SERIAL_PIPE_SIZE)
+			{
+				mSent[(mSent_head + mSent_length) % HCS_HOST_SERIAL_PIPE_SIZE] = transmit(b);
+				++mSent_length;
+			}
+		}
+	}
+
+	// both ends at different baudrates: bytes are corrupted (framing errors)
+	uint8_t HardwareSerial::transmit(uint8_t b) const
+	{
+		if ((mHostBaudrate != 0) && (mBaudrate != 0) && (mHostBaudrate != mBaudrate))
+			return (uint8_t)~b;
+		return b;
+	}
+
+	// the line is also drained here: nobody else reads the TX buffer of a pseudo-terminal
+	void HardwareSerial::pollPty()
+	{
+		if (mPty < 0)
+			return;
+
+		drain();
+
+		uint8_t buffer[256];
+		size_t room = HCS_HOST_SERIAL_PIPE_SIZE - mRX_length;
+		ssize_t n = ::read(mPty, buffer, (room < sizeof(buffer)) ? room : sizeof(buffer));
+		if (n > 0)
+			host_write(buffer, (size_t)n);
+	}
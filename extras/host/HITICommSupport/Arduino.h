@@ -0,0 +1,224 @@
+/*
+ * HITIComm
+ * Arduino.h (host build)
+ *
+ * Copyright © 2021 Christophe LANDRET
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// *****************************************************************************
+// Include Guard
+// *****************************************************************************
+
+#ifndef Arduino_h
+#define Arduino_h
+
+
+
+// *****************************************************************************
+// Include dependencies
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <avr/pgmspace.h>
+
+
+
+// *****************************************************************************
+// Define
+// *****************************************************************************
+
+// Subset of the Arduino API used by HITIComm and by simple sketches.
+// Time is the virtual clock of the host backend (see HCS_Host.h).
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define LOW				0
+#define HIGH			1
+
+#define INPUT			0
+#define OUTPUT			1
+#define INPUT_PULLUP	2
+
+#define DEC				10
+#define HEX				16
+#define OCT				8
+#define BIN				2
+
+#define F(str)			(str)
+
+// serial port: TX buffer (1 byte is never used, as on AVR boards), in-memory pipes
+#define HCS_HOST_SERIAL_TX_BUFFER_SIZE	64
+#define HCS_HOST_SERIAL_PIPE_SIZE		65536
+
+#define constrain(amt, low, high)	((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+#define noInterrupts()
+#define interrupts()
+
+// pins
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+void analogWrite(uint8_t pin, int value);
+
+// time
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+long map(long x, long in_min, long in_max, long out_min, long out_max);
+
+// port registers, with the pin mapping of the board (Uno or Mega, see HCS_Host.cpp). Ports are
+// numbered as on AVR boards (PA = 1, ... PL = 12)
+#define NOT_A_PORT		0
+
+uint8_t digitalPinToPort(uint8_t pin);
+uint8_t digitalPinToBitMask(uint8_t pin);
+volatile uint8_t* portInputRegister(uint8_t port);
+volatile uint8_t* portOutputRegister(uint8_t port);
+volatile uint8_t* portModeRegister(uint8_t port);
+
+
+
+// *****************************************************************************
+// Class
+// *****************************************************************************
+
+class Print
+{
+	public:
+		virtual ~Print() {}
+
+		virtual size_t write(uint8_t b) = 0;
+		virtual size_t write(const uint8_t* buffer, size_t size);
+		size_t write(const char* buffer, size_t size) { return write((const uint8_t*)buffer, size); }
+		size_t write(const char* str) { return (str == 0) ? 0 : write(str, strlen(str)); }
+
+		// bytes which can be written without blocking (0: unknown)
+		virtual int availableForWrite() { return 0; }
+		virtual void flush() {}
+
+		size_t print(const char* str);
+		size_t print(char c);
+		size_t print(unsigned char n, int base = DEC);
+		size_t print(int n, int base = DEC);
+		size_t print(unsigned int n, int base = DEC);
+		size_t print(long n, int base = DEC);
+		size_t print(unsigned long n, int base = DEC);
+		size_t print(double n, int digits = 2);
+
+		size_t println();
+		size_t println(const char* str);
+		size_t println(char c);
+		size_t println(unsigned char n, int base = DEC);
+		size_t println(int n, int base = DEC);
+		size_t println(unsigned int n, int base = DEC);
+		size_t println(long n, int base = DEC);
+		size_t println(unsigned long n, int base = DEC);
+		size_t println(double n, int digits = 2);
+
+	private:
+		size_t printNumber(unsigned long n, uint8_t base);
+};
+
+
+class Stream : public Print
+{
+	public:
+		virtual int available() = 0;
+		virtual int read() = 0;
+		virtual int peek() = 0;
+};
+
+
+// Serial port of the host backend: an in-memory pipe, or a pseudo-terminal (see HCS_Host.h).
+// TX: buffer of HCS_HOST_SERIAL_TX_BUFFER_SIZE bytes drained at the baudrate on the virtual
+// clock (10 bits per byte). As on a board, write() blocks when the buffer is full: the
+// virtual clock is advanced until there is room (see HCS_Host_getBlockedTime()).
+class HardwareSerial : public Stream
+{
+	public:
+		HardwareSerial() {}
+
+		void begin(unsigned long baudrate);
+		void end() {}
+		unsigned long getBaudrate() const { return mBaudrate; }
+		operator bool() const { return true; }
+
+		// Stream
+		int available();
+		int read();
+		int peek();
+		void flush();
+
+		// Print
+		size_t write(uint8_t b);
+		size_t write(const uint8_t* buffer, size_t size);
+		int availableForWrite();
+		using Print::write;
+
+		// host side (used by HCS_Host.cpp) --------------------------------------
+		size_t host_write(const uint8_t* buffer, size_t size);	// to the board
+		size_t host_read(uint8_t* buffer, size_t size);			// from the board (sent bytes only)
+		size_t host_available();
+		void host_setPty(int fd) { mPty = fd; }
+		void host_setBaudrate(unsigned long baudrate) { mHostBaudrate = baudrate; }
+		int host_getPty() const { return mPty; }
+		unsigned long long host_getBlockedTime() const { return mBlockedTime; }
+
+	private:
+		void drain();			// bytes sent since last call (virtual clock)
+		void pollPty();
+		uint8_t transmit(uint8_t b) const;	// byte as received at the other end of the line
+
+		unsigned long mBaudrate = 0;			// 0: infinite
+		int mPty = -1;							// pseudo-terminal master (-1: in-memory pipe)
+		unsigned long mHostBaudrate = 0;		// computer end of the line (0: same as the board)
+
+		// RX (host -> board)
+		uint8_t mRX[HCS_HOST_SERIAL_PIPE_SIZE];
+		size_t mRX_head = 0;
+		size_t mRX_length = 0;
+
+		// TX buffer (board -> line): ring
+		uint8_t mTX[HCS_HOST_SERIAL_TX_BUFFER_SIZE];
+		size_t mTX_head = 0;
+		size_t mTX_length = 0;
+		unsigned long long mTX_drainTime = 0;	// us
+		double mTX_drainRemainder = 0;			// bytes
+
+		// sent bytes (line -> host), if in-memory pipe
+		uint8_t mSent[HCS_HOST_SERIAL_PIPE_SIZE];
+		size_t mSent_head = 0;
+		size_t mSent_length = 0;
+
+		unsigned long long mBlockedTime = 0;	// us
+};
+
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+
+
+#endif
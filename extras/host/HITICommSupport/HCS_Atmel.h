@@ -0,0 +1,53 @@
+/*
+ * HITIComm
+ * HCS_Atmel.h (host build)
+ *
+ * Copyright © 2021 Christophe LANDRET
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// *****************************************************************************
+// Include Guard
+// *****************************************************************************
+
+#ifndef HCS_Atmel_h
+#define HCS_Atmel_h
+
+
+
+// *****************************************************************************
+// Include dependencies
+// *****************************************************************************
+
+#include <HITICommSupport.h>
+
+
+
+// *****************************************************************************
+// Functions
+// *****************************************************************************
+
+// board description (PROGMEM strings)
+const char* HCS_getBoard_P();
+const char* HCS_getProcessor_P();
+unsigned int HCS_getArduinoLibVersion();
+
+// RAM (host: no memory map)
+unsigned int HCS_getRamStart();
+unsigned int HCS_getRamEnd();
+unsigned int HCS_getMSP();
+
+
+#endif
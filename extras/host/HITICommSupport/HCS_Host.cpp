@@ -0,0 +1,682 @@
+/*
+ * HITIComm
+ * HCS_Host.cpp (host build)
+ *
+ * Copyright © 2021 Christophe LANDRET
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "HITICommSupport.h"
+
+
+
+// *****************************************************************************
+// Include dependencies
+// *****************************************************************************
+
+// HITICommSupport
+#include "HCS_ServoInterface.h"
+#include <avr/eeprom.h>
+
+// POSIX
+#include <fcntl.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+
+
+// *****************************************************************************
+// Define
+// *****************************************************************************
+
+#define HCS_HOST_PIN_QTY	70
+
+#ifdef HCS_HOST_UNO
+	#define HCS_HOST_DIO_END	13
+	#define HCS_HOST_AI_PIN		14
+	#define HCS_HOST_AI_QTY		6
+	#define HCS_HOST_SERVO_QTY	12
+#else
+	#define HCS_HOST_DIO_END	53
+	#define HCS_HOST_AI_PIN		54
+	#define HCS_HOST_AI_QTY		16
+	#define HCS_HOST_SERVO_QTY	48
+#endif
+
+
+
+// *****************************************************************************
+// Variables
+// *****************************************************************************
+
+// clock
+static unsigned long long g_time = 0;
+static unsigned long g_timeStep = 0;
+static bool g_isRealTime = false;
+static unsigned long long g_realTime_origin = 0;
+
+// cycle time
+static unsigned long g_cycleTime = 0;
+static unsigned long long g_cycleTime_last = 0;
+
+// pins
+static uint8_t g_pinMode[HCS_HOST_PIN_QTY] = { 0 };
+static uint8_t g_DO[HCS_HOST_PIN_QTY] = { 0 };
+static uint8_t g_PWM[HCS_HOST_PIN_QTY] = { 0 };
+static int8_t g_DI[HCS_HOST_PIN_QTY];				// -1: not driven
+static bool g_DI_isInitialized = false;
+static int g_AI[HCS_HOST_AI_QTY] = { 0 };
+static int (*g_AI_reader)(uint8_t index) = NULL_POINTER;
+
+// eeprom
+static uint8_t g_eeprom[E2END + 1];
+static bool g_eeprom_isInitialized = false;
+
+// port registers (PINx, PORTx, DDRx), kept up to date with the simulated pins. PORTx can be written
+// by the library: the pins follow at the next access (or clock read)
+#define HCS_HOST_PORT_QTY	13
+static volatile uint8_t g_portInput[HCS_HOST_PORT_QTY] = { 0 };
+static volatile uint8_t g_portOutput[HCS_HOST_PORT_QTY] = { 0 };
+static volatile uint8_t g_portMode[HCS_HOST_PORT_QTY] = { 0 };
+static uint8_t g_portOutput_previous[HCS_HOST_PORT_QTY] = { 0 };	// PORTx as set by the pins
+
+// pin mapping of the board: port (high nibble: PA = 1 ... PL = 12, 0 = no port) and bit (low nibble)
+#define HCS_HOST_PIN(port, bit)		(((port) << 4) | (bit))
+#define PA	1
+#define PB	2
+#define PC	3
+#define PD	4
+#define PE	5
+#define PF	6
+#define PG	7
+#define PH	8
+#define PJ	10
+#define PK	11
+#define PL	12
+
+static const uint8_t g_pinToPort[HCS_HOST_PIN_QTY] PROGMEM =
+{
+#ifdef HCS_HOST_UNO
+	HCS_HOST_PIN(PD, 0), HCS_HOST_PIN(PD, 1), HCS_HOST_PIN(PD, 2), HCS_HOST_PIN(PD, 3),		// 0
+	HCS_HOST_PIN(PD, 4), HCS_HOST_PIN(PD, 5), HCS_HOST_PIN(PD, 6), HCS_HOST_PIN(PD, 7),
+	HCS_HOST_PIN(PB, 0), HCS_HOST_PIN(PB, 1), HCS_HOST_PIN(PB, 2), HCS_HOST_PIN(PB, 3),		// 8
+	HCS_HOST_PIN(PB, 4), HCS_HOST_PIN(PB, 5),
+	HCS_HOST_PIN(PC, 0), HCS_HOST_PIN(PC, 1), HCS_HOST_PIN(PC, 2), HCS_HOST_PIN(PC, 3),		// 14 (A0)
+	HCS_HOST_PIN(PC, 4), HCS_HOST_PIN(PC, 5)
+#else
+	HCS_HOST_PIN(PE, 0), HCS_HOST_PIN(PE, 1), HCS_HOST_PIN(PE, 4), HCS_HOST_PIN(PE, 5),		// 0
+	HCS_HOST_PIN(PG, 5), HCS_HOST_PIN(PE, 3), HCS_HOST_PIN(PH, 3), HCS_HOST_PIN(PH, 4),
+	HCS_HOST_PIN(PH, 5), HCS_HOST_PIN(PH, 6), HCS_HOST_PIN(PB, 4), HCS_HOST_PIN(PB, 5),		// 8
+	HCS_HOST_PIN(PB, 6), HCS_HOST_PIN(PB, 7), HCS_HOST_PIN(PJ, 1), HCS_HOST_PIN(PJ, 0),
+	HCS_HOST_PIN(PH, 1), HCS_HOST_PIN(PH, 0), HCS_HOST_PIN(PD, 3), HCS_HOST_PIN(PD, 2),		// 16
+	HCS_HOST_PIN(PD, 1), HCS_HOST_PIN(PD, 0), HCS_HOST_PIN(PA, 0), HCS_HOST_PIN(PA, 1),
+	HCS_HOST_PIN(PA, 2), HCS_HOST_PIN(PA, 3), HCS_HOST_PIN(PA, 4), HCS_HOST_PIN(PA, 5),		// 24
+	HCS_HOST_PIN(PA, 6), HCS_HOST_PIN(PA, 7), HCS_HOST_PIN(PC, 7), HCS_HOST_PIN(PC, 6),
+	HCS_HOST_PIN(PC, 5), HCS_HOST_PIN(PC, 4), HCS_HOST_PIN(PC, 3), HCS_HOST_PIN(PC, 2),		// 32
+	HCS_HOST_PIN(PC, 1), HCS_HOST_PIN(PC, 0), HCS_HOST_PIN(PD, 7), HCS_HOST_PIN(PG, 2),
+	HCS_HOST_PIN(PG, 1), HCS_HOST_PIN(PG, 0), HCS_HOST_PIN(PL, 7), HCS_HOST_PIN(PL, 6),		// 40
+	HCS_HOST_PIN(PL, 5), HCS_HOST_PIN(PL, 4), HCS_HOST_PIN(PL, 3), HCS_HOST_PIN(PL, 2),
+	HCS_HOST_PIN(PL, 1), HCS_HOST_PIN(PL, 0), HCS_HOST_PIN(PB, 3), HCS_HOST_PIN(PB, 2),		// 48
+	HCS_HOST_PIN(PB, 1), HCS_HOST_PIN(PB, 0), HCS_HOST_PIN(PF, 0), HCS_HOST_PIN(PF, 1),
+	HCS_HOST_PIN(PF, 2), HCS_HOST_PIN(PF, 3), HCS_HOST_PIN(PF, 4), HCS_HOST_PIN(PF, 5),		// 56 (A2)
+	HCS_HOST_PIN(PF, 6), HCS_HOST_PIN(PF, 7), HCS_HOST_PIN(PK, 0), HCS_HOST_PIN(PK, 1),
+	HCS_HOST_PIN(PK, 2), HCS_HOST_PIN(PK, 3), HCS_HOST_PIN(PK, 4), HCS_HOST_PIN(PK, 5),		// 64 (A10)
+	HCS_HOST_PIN(PK, 6), HCS_HOST_PIN(PK, 7)
+#endif
+};
+
+// servos
+servo_struct _servo_map[HCS_HOST_SERVO_QTY];
+
+// board
+static const char g_board[] PROGMEM =
+#ifdef HCS_HOST_UNO
+	"Host Uno";
+#else
+	"Host Mega";
+#endif
+static const char g_processor[] PROGMEM = "Host";
+
+
+
+// *****************************************************************************
+// Virtual clock
+// *****************************************************************************
+
+static unsigned long long HCS_Host_readMonotonic()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (unsigned long long)t.tv_sec * 1000000ULL + t.tv_nsec / 1000;
+}
+
+unsigned long long HCS_Host_readNanoseconds()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (unsigned long long)t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+unsigned long long HCS_Host_getTime()
+{
+	if (g_isRealTime)
+		g_time = HCS_Host_readMonotonic() - g_realTime_origin;
+
+	return g_time;
+}
+
+void HCS_Host_setTime(unsigned long long time)
+{
+	g_time = time;
+}
+
+static void HCS_Host_synchronizePorts();
+
+void HCS_Host_advance(unsigned long long duration)
+{
+	HCS_Host_synchronizePorts();
+
+	if (g_isRealTime)
+	{
+		usleep(duration);
+		return;
+	}
+
+	g_time += duration;
+}
+
+void HCS_Host_setTimeStep(unsigned long step)
+{
+	g_timeStep = step;
+}
+
+void HCS_Host_useRealTime(bool enable)
+{
+	if (enable)
+		g_realTime_origin = HCS_Host_readMonotonic() - g_time;
+	g_isRealTime = enable;
+}
+
+
+// clock read by the library and the sketch
+static unsigned long long HCS_Host_readClock()
+{
+	HCS_Host_synchronizePorts();
+
+	if (g_timeStep != 0)
+		HCS_Host_advance(g_timeStep);
+
+	return HCS_Host_getTime();
+}
+
+unsigned long millis()		{ return (unsigned long)(HCS_Host_readClock() / 1000); }
+unsigned long micros()		{ return (unsigned long)HCS_Host_readClock(); }
+unsigned long HCS_millis()	{ return millis(); }
+unsigned long HCS_micros()	{ return micros(); }
+
+void delay(unsigned long ms)				{ HCS_Host_advance(ms * 1000ULL); }
+void delayMicroseconds(unsigned int us)		{ HCS_Host_advance(us); }
+
+void HCS_calculateCycleTime()
+{
+	unsigned long long now = HCS_Host_getTime();
+	g_cycleTime = (unsigned long)(now - g_cycleTime_last);
+	g_cycleTime_last = now;
+}
+
+unsigned long HCS_getCycleTime()
+{
+	return g_cycleTime;
+}
+
+
+
+// *****************************************************************************
+// Simulated pins
+// *****************************************************************************
+
+static bool HCS_Host_isPin(uint8_t pin) { return pin < HCS_HOST_PIN_QTY; }
+
+static void HCS_Host_initializeDI()
+{
+	if (g_DI_isInitialized)
+		return;
+
+	memset(g_DI, -1, sizeof(g_DI));
+	g_DI_isInitialized = true;
+}
+
+// level of a pin
+static bool HCS_Host_readLevel(uint8_t pin)
+{
+	HCS_Host_initializeDI();
+
+	// output: read back
+	if (g_pinMode[pin] == OUTPUT)
+		return g_DO[pin];
+	if (g_DI[pin] >= 0)
+		return g_DI[pin];
+	return g_pinMode[pin] == INPUT_PULLUP;
+}
+
+// port registers: bits of a pin after a change of its level, mode or output
+static void HCS_Host_updatePort(uint8_t pin)
+{
+	uint8_t port = digitalPinToPort(pin);
+	if (port == NOT_A_PORT)
+		return;
+
+	uint8_t mask = digitalPinToBitMask(pin);
+	g_portInput[port] = HCS_Host_readLevel(pin) ? (g_portInput[port] | mask) : (g_portInput[port] & ~mask);
+	g_portOutput[port] = g_DO[pin] ? (g_portOutput[port] | mask) : (g_portOutput[port] & ~mask);
+	g_portMode[port] = (g_pinMode[pin] == OUTPUT) ? (g_portMode[port] | mask) : (g_portMode[port] & ~mask);
+	g_portOutput_previous[port] = g_portOutput[port];
+}
+
+// PORTx written by the library: DO of the pins of the port (PWM is not stopped, as on AVR boards)
+static void HCS_Host_synchronizePorts()
+{
+	for (uint8_t port = 1; port < HCS_HOST_PORT_QTY; ++port)
+	{
+		if (g_portOutput[port] == g_portOutput_previous[port])
+			continue;
+
+		for (uint8_t pin = 0; pin < HCS_HOST_PIN_QTY; ++pin)
+		{
+			if (digitalPinToPort(pin) == port)
+			{
+				g_DO[pin] = (g_portOutput[port] & digitalPinToBitMask(pin)) ? HIGH : LOW;
+				HCS_Host_updatePort(pin);
+			}
+		}
+	}
+}
+
+void HCS_Host_writeDI(uint8_t pin, bool level)
+{
+	HCS_Host_initializeDI();
+	if (HCS_Host_isPin(pin))
+	{
+		HCS_Host_synchronizePorts();
+		g_DI[pin] = level;
+		HCS_Host_updatePort(pin);
+	}
+}
+
+void HCS_Host_releaseDI(uint8_t pin)
+{
+	HCS_Host_initializeDI();
+	if (HCS_Host_isPin(pin))
+	{
+		HCS_Host_synchronizePorts();
+		g_DI[pin] = -1;
+		HCS_Host_updatePort(pin);
+	}
+}
+
+void HCS_Host_writeAI(uint8_t index, int value)
+{
+	if (index < HCS_HOST_AI_QTY)
+		g_AI[index] = HCS_constrain(value, 0, 1023);
+}
+
+void HCS_Host_setAIReader(int (*reader)(uint8_t index))
+{
+	g_AI_reader = reader;
+}
+
+bool HCS_Host_readDO(uint8_t pin)
+{
+	HCS_Host_synchronizePorts();
+	return HCS_Host_isPin(pin) && g_DO[pin];
+}
+uint8_t HCS_Host_readPWM(uint8_t pin)	{ return HCS_Host_isPin(pin) ? g_PWM[pin] : 0; }
+
+int HCS_Host_readServo(uint8_t pin)
+{
+	for (uint8_t i = 0; i < HCS_HOST_SERVO_QTY; ++i)
+	{
+		HCS_ServoInterface* servo = _servo_map[i].servo;
+		if ((servo != NULL_POINTER) && servo->attached() && (servo->getPin() == pin))
+			return servo->readMicroseconds();
+	}
+
+	return 0;
+}
+
+
+// board pins ------------------------------------------------------------------
+
+uint8_t HCS_getDIO_startIndex()	{ return 2; }
+uint8_t HCS_getDIO_endIndex()	{ return HCS_HOST_DIO_END; }
+uint8_t HCS_getAI_startIndex()	{ return 0; }
+uint8_t HCS_getAI_endIndex()	{ return HCS_HOST_AI_QTY - 1; }
+uint8_t HCS_getAI_qty()			{ return HCS_HOST_AI_QTY; }
+uint8_t HCS_getServo_qty()		{ return HCS_HOST_SERVO_QTY; }
+
+uint8_t HCS_getPinMode(uint8_t pin)
+{
+	return HCS_Host_isPin(pin) ? g_pinMode[pin] : 0;
+}
+
+void HCS_pinMode(uint8_t pin, uint8_t mode)
+{
+	if (HCS_Host_isPin(pin))
+	{
+		HCS_Host_synchronizePorts();
+		g_pinMode[pin] = mode;
+		HCS_Host_updatePort(pin);
+	}
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+	HCS_pinMode(pin, mode);
+}
+
+
+// PWM: pins 2 - 13, 44 - 46 (as on Mega), 3, 5, 6, 9, 10, 11 (as on Uno) -----
+
+bool HCS_hasPWM(uint8_t pin)
+{
+#ifdef HCS_HOST_UNO
+	return (pin == 3) || (pin == 5) || (pin == 6) || (pin == 9) || (pin == 10) || (pin == 11);
+#else
+	return ((pin >= 2) && (pin <= 13)) || ((pin >= 44) && (pin <= 46));
+#endif
+}
+
+// Servo library timers (as on boards): Uno: timer 1 (pins 9, 10).
+// Mega: timer 5 (pins 44 - 46) for servos 1 - 12, then timer 1 (pins 11, 12)
+bool HCS_isPWMEnabled(uint8_t pin, uint8_t attachedServos_qty)
+{
+	if (!HCS_hasPWM(pin))
+		return false;
+
+#ifdef HCS_HOST_UNO
+	return (attachedServos_qty == 0) || ((pin != 9) && (pin != 10));
+#else
+	if ((attachedServos_qty > 0) && (pin >= 44))
+		return false;
+	return (attachedServos_qty <= 12) || ((pin != 11) && (pin != 12));
+#endif
+}
+
+
+// low access read/write -------------------------------------------------------
+
+bool HCS_readDI_LA(uint8_t pin)
+{
+	if (!HCS_Host_isPin(pin))
+		return false;
+
+	HCS_Host_synchronizePorts();
+	return HCS_Host_readLevel(pin);
+}
+
+bool HCS_readDO_LA(uint8_t pin)		{ return HCS_Host_readDO(pin); }
+uint8_t HCS_readPWM_LA(uint8_t pin)	{ return HCS_Host_readPWM(pin); }
+
+void HCS_writeDO_LA(uint8_t pin, uint8_t value)
+{
+	if (!HCS_Host_isPin(pin))
+		return;
+
+	HCS_Host_synchronizePorts();
+	g_DO[pin] = value ? HIGH : LOW;
+	g_PWM[pin] = 0;
+	HCS_Host_updatePort(pin);
+}
+
+void HCS_writePWM_LA(uint8_t pin, uint8_t value)
+{
+	if (!HCS_Host_isPin(pin))
+		return;
+
+	HCS_Host_synchronizePorts();
+	g_PWM[pin] = value;
+	g_DO[pin] = (value != 0);
+	HCS_Host_updatePort(pin);
+}
+
+int HCS_readAI_LA(uint8_t index)
+{
+	if (index >= HCS_HOST_AI_QTY)
+		return 0;
+
+	return (g_AI_reader != NULL_POINTER) ? g_AI_reader(index) : g_AI[index];
+}
+
+
+// port registers --------------------------------------------------------------
+
+uint8_t digitalPinToPort(uint8_t pin)
+{
+	return HCS_Host_isPin(pin) ? pgm_read_byte(&g_pinToPort[pin]) >> 4 : NOT_A_PORT;
+}
+
+uint8_t digitalPinToBitMask(uint8_t pin)
+{
+	return HCS_Host_isPin(pin) ? 1 << (pgm_read_byte(&g_pinToPort[pin]) & 0x0F) : 0;
+}
+
+volatile uint8_t* portInputRegister(uint8_t port)
+{
+	return ((port != NOT_A_PORT) && (port < HCS_HOST_PORT_QTY)) ? &g_portInput[port] : NULL_POINTER;
+}
+
+volatile uint8_t* portOutputRegister(uint8_t port)
+{
+	return ((port != NOT_A_PORT) && (port < HCS_HOST_PORT_QTY)) ? &g_portOutput[port] : NULL_POINTER;
+}
+
+volatile uint8_t* portModeRegister(uint8_t port)
+{
+	return ((port != NOT_A_PORT) && (port < HCS_HOST_PORT_QTY)) ? &g_portMode[port] : NULL_POINTER;
+}
+
+
+// Arduino API -----------------------------------------------------------------
+
+void digitalWrite(uint8_t pin, uint8_t value)	{ HCS_writeDO_LA(pin, value); }
+int digitalRead(uint8_t pin)					{ return HCS_readDI_LA(pin); }
+void analogWrite(uint8_t pin, int value)		{ HCS_writePWM_LA(pin, (uint8_t)HCS_constrain(value, 0, 255)); }
+
+// pin (A0...) or AI index
+int analogRead(uint8_t pin)
+{
+	return HCS_readAI_LA((pin >= HCS_HOST_AI_PIN) ? pin - HCS_HOST_AI_PIN : pin);
+}
+
+long map(long x, long in_min, long in_max, long out_min, long out_max)
+{
+	return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+float HCS_map(float x, float in_min, float in_max, float out_min, float out_max)
+{
+	return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+
+
+// *****************************************************************************
+// Board
+// *****************************************************************************
+
+const char* HCS_getBoard_P()				{ return g_board; }
+const char* HCS_getProcessor_P()			{ return g_processor; }
+unsigned int HCS_getArduinoLibVersion()		{ return 10819; }
+
+unsigned int HCS_getRamStart()	{ return 0; }
+unsigned int HCS_getRamEnd()	{ return 0; }
+unsigned int HCS_getMSP()		{ return 0; }
+
+uint8_t HCS_getSpiMode()	{ return 0; }
+uint8_t HCS_getTwiMode()	{ return 0; }
+uint8_t HCS_getUsartMode()	{ return 1; }
+uint8_t HCS_getI2SMode()	{ return 0; }
+
+
+
+// *****************************************************************************
+// Servos
+// *****************************************************************************
+
+HCS_ServoInterface::HCS_ServoInterface(bool enableServoManagement)
+{
+	(void)enableServoManagement;
+}
+
+uint8_t HCS_ServoInterface::attach(int pin)
+{
+	mPin = pin;
+	return 0;
+}
+
+uint8_t HCS_ServoInterface::attach(int pin, int min, int max)
+{
+	mMin = min;
+	mMax = max;
+	return attach(pin);
+}
+
+bool HCS_ServoInterface::attached() const	{ return mPin >= 0; }
+void HCS_ServoInterface::detach()			{ mPin = -1; }
+
+int HCS_ServoInterface::getMinPulseWidth() const	{ return mMin; }
+int HCS_ServoInterface::getMaxPulseWidth() const	{ return mMax; }
+Servo* HCS_ServoInterface::getServo() const			{ return NULL_POINTER; }
+void HCS_ServoInterface::setServo(Servo* servo)		{ (void)servo; }
+
+void HCS_ServoInterface::write(int value)
+{
+	if (value < mMin)
+	{
+		value = HCS_constrain(value, 0, 180);
+		value = (int)map(value, 0, 180, mMin, mMax);
+	}
+	writeMicroseconds(value);
+}
+
+void HCS_ServoInterface::writeMicroseconds(int value)
+{
+	mPulse = HCS_constrain(value, mMin, mMax);
+}
+
+int HCS_ServoInterface::read()
+{
+	return (int)map(mPulse + 1, mMin, mMax, 0, 180);
+}
+
+int HCS_ServoInterface::readMicroseconds()
+{
+	return mPulse;
+}
+
+
+
+// *****************************************************************************
+// EEPROM
+// *****************************************************************************
+
+static uint8_t* HCS_Host_eeprom(const void* address)
+{
+	if (!g_eeprom_isInitialized)
+	{
+		memset(g_eeprom, 0xFF, sizeof(g_eeprom));
+		g_eeprom_isInitialized = true;
+	}
+
+	return &g_eeprom[(size_t)address % (E2END + 1)];
+}
+
+uint8_t eeprom_read_byte(const uint8_t* address)		{ return *HCS_Host_eeprom(address); }
+void eeprom_write_byte(uint8_t* address, uint8_t value)		{ *HCS_Host_eeprom(address) = value; }
+void eeprom_update_byte(uint8_t* address, uint8_t value)	{ *HCS_Host_eeprom(address) = value; }
+
+void eeprom_read_block(void* destination, const void* address, size_t size)
+{
+	for (size_t i = 0; i < size; ++i)
+		((uint8_t*)destination)[i] = *HCS_Host_eeprom((const uint8_t*)address + i);
+}
+
+void eeprom_update_block(const void* source, void* address, size_t size)
+{
+	for (size_t i = 0; i < size; ++i)
+		*HCS_Host_eeprom((uint8_t*)address + i) = ((const uint8_t*)source)[i];
+}
+
+uint16_t eeprom_read_word(const uint16_t* address)		{ uint16_t v; eeprom_read_block(&v, address, 2); return v; }
+uint32_t eeprom_read_dword(const uint32_t* address)		{ uint32_t v; eeprom_read_block(&v, address, 4); return v; }
+float eeprom_read_float(const float* address)			{ float v; eeprom_read_block(&v, address, 4); return v; }
+void eeprom_update_word(uint16_t* address, uint16_t value)	{ eeprom_update_block(&value, address, 2); }
+void eeprom_update_dword(uint32_t* address, uint32_t value)	{ eeprom_update_block(&value, address, 4); }
+void eeprom_update_float(float* address, float value)		{ eeprom_update_block(&value, address, 4); }
+
+
+
+// *****************************************************************************
+// Serial endpoints
+// *****************************************************************************
+
+HardwareSerial Serial;
+HardwareSerial Serial1;
+
+size_t HCS_Host_send(HardwareSerial& serial, const uint8_t* buffer, size_t size)	{ return serial.host_write(buffer, size); }
+size_t HCS_Host_receive(HardwareSerial& serial, uint8_t* buffer, size_t size)		{ return serial.host_read(buffer, size); }
+size_t HCS_Host_receivable(HardwareSerial& serial)									{ return serial.host_available(); }
+unsigned long long HCS_Host_getBlockedTime(HardwareSerial& serial)					{ return serial.host_getBlockedTime(); }
+void HCS_Host_setBaudrate(HardwareSerial& serial, unsigned long baudrate)			{ serial.host_setBaudrate(baudrate); }
+
+const char* HCS_Host_openPty(HardwareSerial& serial)
+{
+	int fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if ((fd < 0) || (grantpt(fd) != 0) || (unlockpt(fd) != 0))
+	{
+		if (fd >= 0)
+			close(fd);
+		return NULL_POINTER;
+	}
+
+	// raw mode (no echo of the board output back to its input, no line editing)
+	struct termios settings;
+	if (tcgetattr(fd, &settings) == 0)
+	{
+		cfmakeraw(&settings);
+		tcsetattr(fd, TCSANOW, &settings);
+	}
+
+	serial.host_setPty(fd);
+	return ptsname(fd);
+}
+
+
+// main serial port ------------------------------------------------------------
+
+void HCS_Serial_setBaudrate(long baudrate)	{ Serial.begin(baudrate); }
+int HCS_Serial_isAvailable()				{ return Serial.available(); }
+int HCS_Serial_read()						{ return Serial.read(); }
+
+void HCS_Serial_print(const char* str)					{ Serial.print(str); }
+void HCS_Serial_print(char c)							{ Serial.print(c); }
+void HCS_Serial_print(int value, int base)				{ Serial.print(value, base); }
+void HCS_Serial_print(unsigned int value, int base)		{ Serial.print(value, base); }
+void HCS_Serial_print(unsigned long value, int base)	{ Serial.print(value, base); }
+void HCS_Serial_print(double value, int digits)			{ Serial.print(value, digits); }
+void HCS_Serial_print_P(const char* pgm_str)			{ Serial.print(pgm_str); }
+void HCS_Serial_println()								{ Serial.println(); }
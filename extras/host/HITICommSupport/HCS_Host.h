@@ -0,0 +1,104 @@
+/*
+ * HITIComm
+ * HCS_Host.h (host build)
+ *
+ * Copyright © 2021 Christophe LANDRET
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// *****************************************************************************
+// Include Guard
+// *****************************************************************************
+
+#ifndef HCS_Host_h
+#define HCS_Host_h
+
+
+
+// *****************************************************************************
+// Include dependencies
+// *****************************************************************************
+
+#include <HITICommSupport.h>
+
+
+
+// *****************************************************************************
+// Functions
+// *****************************************************************************
+
+// Host backend: simulated board, driven by the host program (benchmarks, tools, tests)
+
+
+// -----------------------------------------------------------------------------
+// Virtual clock ---------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+// Time only changes when the host program advances it: runs are deterministic.
+// Busy-wait loops (delay(), blocking serial writes) advance the clock themselves.
+
+unsigned long long HCS_Host_getTime();				// us
+void HCS_Host_setTime(unsigned long long time);		// us
+void HCS_Host_advance(unsigned long long duration);	// us
+
+// each read of the clock (millis(), micros()) advances it by step (us). Default 0
+void HCS_Host_setTimeStep(unsigned long step);
+
+// clock follows the system monotonic clock (for a pseudo-terminal used by a real application)
+void HCS_Host_useRealTime(bool enable);
+
+// system monotonic clock (ns), not the virtual clock: CPU time measurements (HC_PROFILE_CLOCK)
+unsigned long long HCS_Host_readNanoseconds();
+
+
+// -----------------------------------------------------------------------------
+// Simulated pins --------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+// DI: level of an input pin (not driven: LOW, or HIGH if pull-up)
+void HCS_Host_writeDI(uint8_t pin, bool level);
+void HCS_Host_releaseDI(uint8_t pin);
+
+// AI: ADC value (0 - 1023) of an AI index (not a pin). Or a reader called at each conversion
+void HCS_Host_writeAI(uint8_t index, int value);
+void HCS_Host_setAIReader(int (*reader)(uint8_t index));
+
+// outputs
+bool HCS_Host_readDO(uint8_t pin);
+uint8_t HCS_Host_readPWM(uint8_t pin);
+int HCS_Host_readServo(uint8_t pin);				// pulse width (us), 0 if no servo attached
+
+
+// -----------------------------------------------------------------------------
+// Serial endpoints ------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+// in-memory pipe (default)
+size_t HCS_Host_send(HardwareSerial& serial, const uint8_t* buffer, size_t size);	// to the board
+size_t HCS_Host_receive(HardwareSerial& serial, uint8_t* buffer, size_t size);		// from the board
+size_t HCS_Host_receivable(HardwareSerial& serial);
+
+// baudrate of the computer end of the in-memory pipe (default 0: same as the board). If both
+// differ, bytes are corrupted in both directions (baudrate negotiation tests)
+void HCS_Host_setBaudrate(HardwareSerial& serial, unsigned long baudrate);
+
+// pseudo-terminal: returns the slave device path (ex: /dev/pts/3), or NULL_POINTER
+const char* HCS_Host_openPty(HardwareSerial& serial);
+
+// time spent blocked in write() because the TX buffer was full (us)
+unsigned long long HCS_Host_getBlockedTime(HardwareSerial& serial);
+
+
+#endif
@@ -0,0 +1,67 @@
+/*
+ * HITIComm
+ * HCS_LowAccess_IO.h (host build)
+ *
+ * Copyright © 2021 Christophe LANDRET
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// *****************************************************************************
+// Include Guard
+// *****************************************************************************
+
+#ifndef HCS_LowAccess_IO_h
+#define HCS_LowAccess_IO_h
+
+
+
+// *****************************************************************************
+// Include dependencies
+// *****************************************************************************
+
+#include <HITICommSupport.h>
+
+
+
+// *****************************************************************************
+// Functions
+// *****************************************************************************
+
+// board pins
+uint8_t HCS_getDIO_startIndex();
+uint8_t HCS_getDIO_endIndex();
+uint8_t HCS_getAI_startIndex();
+uint8_t HCS_getAI_endIndex();
+uint8_t HCS_getAI_qty();
+uint8_t HCS_getServo_qty();
+
+// pin mode
+uint8_t HCS_getPinMode(uint8_t pin);
+void HCS_pinMode(uint8_t pin, uint8_t mode);
+
+// PWM
+bool HCS_hasPWM(uint8_t pin);
+bool HCS_isPWMEnabled(uint8_t pin, uint8_t attachedServos_qty);
+
+// low access read/write (simulated pins, see HCS_Host.h)
+bool HCS_readDI_LA(uint8_t pin);
+bool HCS_readDO_LA(uint8_t pin);
+void HCS_writeDO_LA(uint8_t pin, uint8_t value);
+uint8_t HCS_readPWM_LA(uint8_t pin);
+void HCS_writePWM_LA(uint8_t pin, uint8_t value);
+int HCS_readAI_LA(uint8_t index);
+
+
+#endif
@@ -0,0 +1,95 @@
+/*
+ * HITIComm
+ * HCS_ServoInterface.h (host build)
+ *
+ * Copyright © 2021 Christophe LANDRET
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// *****************************************************************************
+// Include Guard
+// *****************************************************************************
+
+#ifndef HCS_ServoInterface_h
+#define HCS_ServoInterface_h
+
+
+
+// *****************************************************************************
+// Include dependencies
+// *****************************************************************************
+
+#include <HITICommSupport.h>
+
+
+
+// *****************************************************************************
+// Define
+// *****************************************************************************
+
+#define HCS_SERVO_MIN_PULSE_WIDTH	544		// us
+#define HCS_SERVO_MAX_PULSE_WIDTH	2400	// us
+#define HCS_SERVO_DEFAULT_PULSE		1500	// us
+
+// Servo library: not available on host (sketches can't provide their own Servo object)
+class Servo;
+
+
+
+// *****************************************************************************
+// Class
+// *****************************************************************************
+
+// Simulated servo: the last pulse width written is readable with HCS_Host_readServo()
+class HCS_ServoInterface
+{
+	public:
+		HCS_ServoInterface(bool enableServoManagement);
+
+		uint8_t attach(int pin);
+		uint8_t attach(int pin, int min, int max);
+		bool attached() const;
+		void detach();
+
+		int getMinPulseWidth() const;
+		int getMaxPulseWidth() const;
+		Servo* getServo() const;
+		void setServo(Servo* servo);
+
+		void write(int value);					// angle (deg), or pulse width (us) if >= min pulse width
+		void writeMicroseconds(int value);
+		int read();								// angle (deg)
+		int readMicroseconds();
+
+		// host side
+		int getPin() const { return mPin; }
+
+	private:
+		int mPin = -1;
+		int mMin = HCS_SERVO_MIN_PULSE_WIDTH;
+		int mMax = HCS_SERVO_MAX_PULSE_WIDTH;
+		int mPulse = HCS_SERVO_DEFAULT_PULSE;
+};
+
+
+// servos managed by HC_ServoManager (HCS_getServo_qty() structures)
+struct servo_struct
+{
+	uint8_t pin;
+	HCS_ServoInterface* servo;
+};
+
+
+#endif
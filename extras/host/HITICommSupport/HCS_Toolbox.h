@@ -0,0 +1,63 @@
+/*
+ * HITIComm
+ * HCS_Toolbox.h (host build)
+ *
+ * Copyright © 2021 Christophe LANDRET
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// *****************************************************************************
+// Include Guard
+// *****************************************************************************
+
+#ifndef HCS_Toolbox_h
+#define HCS_Toolbox_h
+
+
+
+// *****************************************************************************
+// Include dependencies
+// *****************************************************************************
+
+#include <HITICommSupport.h>
+
+
+
+// *****************************************************************************
+// Define
+// *****************************************************************************
+
+#define HCS_readBit(value, bit)				(((value) >> (bit)) & 0x01)
+#define HCS_setBit(value, bit)				((value) |= (1UL << (bit)))
+#define HCS_clearBit(value, bit)			((value) &= ~(1UL << (bit)))
+#define HCS_writeBit(value, bit, bitvalue)	((bitvalue) ? HCS_setBit(value, bit) : HCS_clearBit(value, bit))
+
+#define HCS_getLowByte(w)					((uint8_t) ((w) & 0xff))
+#define HCS_getHighByte(w)					((uint8_t) ((w) >> 8))
+#define HCS_createWord(h, l)				((unsigned int)(((h) << 8) | (l)))
+
+#define HCS_abs(x)							((x) > 0 ? (x) : -(x))
+#define HCS_constrain(amt, low, high)		((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+
+
+// *****************************************************************************
+// Functions
+// *****************************************************************************
+
+float HCS_map(float x, float in_min, float in_max, float out_min, float out_max);
+
+
+#endif
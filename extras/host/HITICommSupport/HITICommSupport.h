@@ -0,0 +1,73 @@
+/*
+ * HITIComm
+ * HITICommSupport.h (host build)
+ *
+ * Copyright © 2021 Christophe LANDRET
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// *****************************************************************************
+// Include Guard
+// *****************************************************************************
+
+#ifndef HITICommSupport_h
+#define HITICommSupport_h
+
+
+
+// *****************************************************************************
+// Include dependencies
+// *****************************************************************************
+
+// Arduino
+#include <Arduino.h>
+
+
+
+// *****************************************************************************
+// Define
+// *****************************************************************************
+
+#define NULL_POINTER 0
+
+// board variants. The host board is a Mega (default) or an Uno (HCS_HOST_UNO)
+#define HC_VARIANT_UNO	0
+#define HC_VARIANT_MEGA	1
+
+#ifdef HCS_HOST_UNO
+	#define HC_VARIANT	HC_VARIANT_UNO
+#else
+	#define HC_VARIANT	HC_VARIANT_MEGA
+#endif
+
+#define HC_EEPROM_ONBOARD
+
+
+
+// *****************************************************************************
+// Include dependencies
+// *****************************************************************************
+
+// HITICommSupport
+#include "HCS_Toolbox.h"
+#include "HCS_Time.h"
+#include "HCS_LowAccess_IO.h"
+#include "HCS_LowAccess_Bus.h"
+#include "HCS_Atmel.h"
+#include "HCS_Serial.h"
+#include "HCS_Host.h"
+
+
+#endif
@@ -0,0 +1,66 @@
+/*
+ * HITIComm
+ * eeprom.h (host build)
+ *
+ * Copyright © 2021 Christophe LANDRET
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// *****************************************************************************
+// Include Guard
+// *****************************************************************************
+
+#ifndef HCS_Host_eeprom_h
+#define HCS_Host_eeprom_h
+
+
+
+// *****************************************************************************
+// Include dependencies
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stddef.h>
+
+
+
+// *****************************************************************************
+// Define
+// *****************************************************************************
+
+// simulated EEPROM (Mega size), initialized to 0xFF. Addresses are offsets
+#define E2END 4095
+
+
+
+// *****************************************************************************
+// Functions
+// *****************************************************************************
+
+uint8_t eeprom_read_byte(const uint8_t* address);
+uint16_t eeprom_read_word(const uint16_t* address);
+uint32_t eeprom_read_dword(const uint32_t* address);
+float eeprom_read_float(const float* address);
+void eeprom_read_block(void* destination, const void* address, size_t size);
+
+void eeprom_write_byte(uint8_t* address, uint8_t value);
+void eeprom_update_byte(uint8_t* address, uint8_t value);
+void eeprom_update_word(uint16_t* address, uint16_t value);
+void eeprom_update_dword(uint32_t* address, uint32_t value);
+void eeprom_update_float(float* address, float value);
+void eeprom_update_block(const void* source, void* address, size_t size);
+
+
+#endif
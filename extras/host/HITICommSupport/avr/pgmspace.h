@@ -0,0 +1,68 @@
+/*
+ * HITIComm
+ * pgmspace.h (host build)
+ *
+ * Copyright © 2021 Christophe LANDRET
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// *****************************************************************************
+// Include Guard
+// *****************************************************************************
+
+#ifndef HCS_Host_pgmspace_h
+#define HCS_Host_pgmspace_h
+
+
+
+// *****************************************************************************
+// Include dependencies
+// *****************************************************************************
+
+#include <stdint.h>
+#include <string.h>
+
+
+
+// *****************************************************************************
+// Define
+// *****************************************************************************
+
+// word read from a wider type (unsigned int is 32 bits on the host): low bytes, as the type is little-endian
+template <typename T> static inline T HCS_pgm_read(const void* address)
+{
+	T value;
+	memcpy(&value, address, sizeof(T));
+	return value;
+}
+
+// single address space: program memory is read as data memory
+#define PROGMEM
+#define PSTR(str)					(str)
+
+#define pgm_read_byte(address)		(*(const uint8_t*)(address))
+#define pgm_read_byte_near(address)	(*(const uint8_t*)(address))
+#define pgm_read_word(address)		HCS_pgm_read<uint16_t>(address)
+#define pgm_read_dword(address)		HCS_pgm_read<uint32_t>(address)
+#define pgm_read_float(address)		HCS_pgm_read<float>(address)
+#define pgm_read_ptr(address)		(*(void* const*)(address))
+
+#define strlen_P	strlen
+#define strcpy_P	strcpy
+#define strcmp_P	strcmp
+#define memcpy_P	memcpy
+
+
+#endif
@@ -0,0 +1,57 @@
+/*
+ * HITIComm
+ * HostMain.cpp (host build)
+ *
+ * Copyright © 2021 Christophe LANDRET
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// *****************************************************************************
+// Include dependencies
+// *****************************************************************************
+
+#include <Arduino.h>
+#include <HITICommSupport.h>
+
+#include <stdio.h>
+
+
+
+// *****************************************************************************
+// Main
+// *****************************************************************************
+
+// Runs a sketch on the host: real time clock, Serial on a pseudo-terminal
+// (HITIPanel, or any serial terminal, can be opened on the printed device).
+
+void setup();
+void loop();
+
+int main()
+{
+	HCS_Host_useRealTime(true);
+
+	const char* device = HCS_Host_openPty(Serial);
+	if (device == NULL_POINTER)
+	{
+		perror("HCS_Host_openPty");
+		return 1;
+	}
+	fprintf(stderr, "Serial: %s\n", device);
+
+	setup();
+	for (;;)
+		loop();
+}
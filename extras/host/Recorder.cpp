@@ -0,0 +1,481 @@
+/*
+ * HITIComm
+ * Recorder.cpp (host build)
+ *
+ * Copyright © 2021 Christophe LANDRET
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// *****************************************************************************
+// Include dependencies
+// *****************************************************************************
+
+// HITIComm client
+#include "HC_Client.h"
+#include "HC_Record.h"
+
+// POSIX
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+
+
+// *****************************************************************************
+// Define
+// *****************************************************************************
+
+// Records a session with a board (serial device, or pseudo-terminal of "make SKETCH=...") into a
+// .hcr file (HC_Record.h). Queries given with -q are sent at start, and recorded.
+// -u: the baudrate is first negotiated (board built with HC_BAUDRATE_NEGOTIATION): highest baudrate
+// supported by both, probed (Bp) then confirmed (Br read) at the new baudrate. The negotiation is recorded.
+// -c: flow control (board built with HC_FLOW_CONTROL): the board may send up to N frames ahead of the
+// frames read. Credits are granted with Fc reads, each time half of them have been read.
+
+#define HCR_QUERY_MAX_QTY	16
+
+// baudrate negotiation: wait for a reply (ms), probes (and confirmations) sent at the new baudrate
+#define HCR_REPLY_TIMEOUT	1000
+#define HCR_PROBE_QTY		3
+
+static volatile bool g_isStopped = false;
+
+static void HCR_stop(int)
+{
+	g_isStopped = true;
+}
+
+
+static uint64_t HCR_getTime()	// us, monotonic
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+
+static speed_t HCR_getSpeed(unsigned long baudrate)
+{
+	switch (baudrate)
+	{
+		case 9600:		return B9600;
+		case 19200:		return B19200;
+		case 38400:		return B38400;
+		case 57600:		return B57600;
+		case 115200:	return B115200;
+		case 230400:	return B230400;
+		case 460800:	return B460800;
+		case 500000:	return B500000;
+		case 921600:	return B921600;
+		case 1000000:	return B1000000;
+		case 2000000:	return B2000000;
+		default:		return B0;
+	}
+}
+
+
+// baudrates of the table which the device can use (standard termios speeds), up to max
+static uint16_t HCR_getBaudrates(unsigned long max)
+{
+	uint16_t mask = 0;
+	for (uint8_t i = 0; i < HC_BAUDRATE_QTY; ++i)
+	{
+		unsigned long baudrate = HC_Client_getBaudrate(i);
+		if ((baudrate <= max) && (HCR_getSpeed(baudrate) != B0))
+			mask |= (1 << i);
+	}
+	return mask;
+}
+
+
+// speed only (the other settings are kept)
+static bool HCR_setSpeed(int fd, unsigned long baudrate)
+{
+	struct termios tio;
+	return (tcgetattr(fd, &tio) == 0) && (cfsetspeed(&tio, HCR_getSpeed(baudrate)) == 0) &&
+		(tcsetattr(fd, TCSADRAIN, &tio) == 0);
+}
+
+
+// raw mode, 8N1
+static bool HCR_configure(int fd, unsigned long baudrate)
+{
+	speed_t speed = HCR_getSpeed(baudrate);
+	if (speed == B0)
+	{
+		fprintf(stderr, "recorder: %lu is not a standard baudrate (set it with stty, then use -b 0)\n", baudrate);
+		return false;
+	}
+
+	struct termios tio;
+	if (tcgetattr(fd, &tio) != 0)
+	{
+		perror("recorder: tcgetattr");
+		return false;
+	}
+	cfmakeraw(&tio);
+	cfsetspeed(&tio, speed);
+	tio.c_cflag |= CLOCAL | CREAD;
+	tio.c_cc[VMIN] = 0;
+	tio.c_cc[VTIME] = 0;
+
+	if (tcsetattr(fd, TCSANOW, &tio) != 0)
+	{
+		perror("recorder: tcsetattr");
+		return false;
+	}
+	return true;
+}
+
+
+static void HCR_usage()
+{
+	fprintf(stderr,
+		"usage: recorder [options] device file.hcr\n"
+		"  -p option     protocol option of the board (PROTOBF_OPTION, default 3)\n"
+		"  -m            HC_XQUERY_CHANGEMASK\n"
+		"  -t            HC_QUERY_TIMESTAMP\n"
+		"  -b baudrate   default 250000 is not standard: 0 keeps the settings of the device (pseudo-terminal)\n"
+		"  -d seconds    duration (default: until Ctrl-C)\n"
+		"  -u baudrate   negotiate the highest baudrate up to this one (HC_BAUDRATE_NEGOTIATION)\n"
+		"  -c frames     flow control: frames the board may send ahead (HC_FLOW_CONTROL)\n"
+		"  -q type       query sent at start, ex: -q Xs (read, no data). Up to %u\n"
+		"  -a            append to the file\n"
+		"  -v            print each received message\n", HCR_QUERY_MAX_QTY);
+}
+
+
+
+// *****************************************************************************
+// Received messages
+// *****************************************************************************
+
+// prints each message (-v), keeps the last reply for the baudrate negotiation
+class HCR_Printer : public HC_ClientHandler
+{
+	public:
+		void onMessage(const HC_ClientMessage& message)
+		{
+			lastType = message.type;
+			lastEvent = message.event;
+			lastQty = message.qty;
+			for (uint8_t i = 0; (i < message.qty) && (i < 2); ++i)
+				lastValues[i] = message.values[i];
+			++replies;
+
+			if (!isVerbose)
+				return;
+
+			char name[3] = "??";
+			if (message.event == HC_ClientEvent_Error)
+				HC_Client_getErrorName(message.type, name);
+			else
+				HC_Client_getName(message.type, name);
+
+			printf("%c%s", (message.event == HC_ClientEvent_Error) ? '!' : '#', name);
+			if (message.control & HC_CLIENT_CONFIG_INDEX)
+				printf(" [%u]", message.index);
+			for (uint8_t i = 0; i < message.qty; ++i)
+			{
+				if (message.isFloat(i))
+					printf(" %g", message.getFloat(i));
+				else
+					printf(" %lu", (unsigned long)message.values[i]);
+			}
+			for (uint8_t i = 0; i < message.stringQty; ++i)
+				printf(" \"%s\"", message.strings[i]);
+			printf("\n");
+		}
+
+		void onDrop(uint8_t reason)
+		{
+			static const char* const reasons[] = { "CRC", "length", "format" };
+			if (isVerbose)
+				printf("dropped (%s)\n", reasons[reason]);
+		}
+
+		bool isVerbose = false;
+		unsigned long replies = 0;
+		uint8_t lastType = 0;
+		uint8_t lastEvent = 0;
+		uint8_t lastQty = 0;
+		uint32_t lastValues[2];
+};
+
+
+
+// *****************************************************************************
+// Baudrate negotiation
+// *****************************************************************************
+
+// sends and records a query
+static void HCR_sendQuery(int fd, HC_Recorder& recorder, HC_ClientQuery& query)
+{
+	size_t length = query.end();
+	if (write(fd, query.getData(), length) != (ssize_t)length)
+		perror("recorder: write");
+	recorder.writeQuery(query, HCR_getTime());
+}
+
+
+// received bytes are recorded until a reply of this type (or an error) is received
+static bool HCR_waitReply(int fd, HC_Recorder& recorder, HCR_Printer& printer, uint8_t type, unsigned int timeout)
+{
+	unsigned long replies = printer.replies;
+	uint64_t start = HCR_getTime();
+	uint8_t buffer[256];
+
+	while (!g_isStopped && (HCR_getTime() - start < timeout * 1000ULL))
+	{
+		struct pollfd pfd = { fd, POLLIN, 0 };
+		if (poll(&pfd, 1, 10) <= 0)
+			continue;
+
+		ssize_t n = read(fd, buffer, sizeof(buffer));
+		if (n <= 0)
+			return false;
+		recorder.feed(buffer, n, HCR_getTime());
+
+		if (printer.replies != replies)
+		{
+			replies = printer.replies;
+			if (printer.lastEvent == HC_ClientEvent_Error)
+				return false;
+			if (printer.lastType == type)
+				return true;
+		}
+	}
+	return false;
+}
+
+
+// Br (read), Br (write) at the current baudrate, then Bp and Br (read) at the new one. Returns true if changed
+static bool HCR_negotiate(int fd, HC_Recorder& recorder, HCR_Printer& printer, const HC_ClientFormat& format,
+	unsigned long max)
+{
+	HC_ClientQuery query(format);
+
+	// settings of the current baudrate (restored if the new one is not confirmed)
+	struct termios current;
+	if (tcgetattr(fd, &current) != 0)
+	{
+		perror("recorder: tcgetattr");
+		return false;
+	}
+
+	// baudrates of the board
+	query.begin(HC_ClientType_Br);
+	HCR_sendQuery(fd, recorder, query);
+	if (!HCR_waitReply(fd, recorder, printer, HC_ClientType_Br, HCR_REPLY_TIMEOUT) || (printer.lastQty != 2))
+	{
+		fprintf(stderr, "recorder: no baudrate negotiation (board built without HC_BAUDRATE_NEGOTIATION?)\n");
+		return false;
+	}
+
+	uint8_t index = HC_Client_selectBaudrate((uint16_t)printer.lastValues[1], HCR_getBaudrates(max));
+	if ((index == HC_BAUDRATE_NONE) || (index == printer.lastValues[0]))
+		return false;
+
+	// change: acknowledged at the current baudrate
+	query.begin(HC_ClientType_Br, HC_CLIENT_CONFIG_WRITE | HC_CLIENT_CONFIG_INDEX, index);
+	HCR_sendQuery(fd, recorder, query);
+	if (!HCR_waitReply(fd, recorder, printer, HC_ClientType_Br, HCR_REPLY_TIMEOUT))
+	{
+		fprintf(stderr, "recorder: baudrate change refused\n");
+		return false;
+	}
+
+	unsigned long baudrate = HC_Client_getBaudrate(index);
+	if (HCR_setSpeed(fd, baudrate))
+	{
+		// probe at the new baudrate, then confirm it (both within HC_BAUDRATE_PROBE_TIMEOUT). Without
+		// confirmation (reply of Bp lost), the board goes back to the current baudrate
+		bool isProbed = false;
+		for (uint8_t i = 0; !isProbed && (i < HCR_PROBE_QTY); ++i)
+		{
+			query.begin(HC_ClientType_Bp);
+			HCR_sendQuery(fd, recorder, query);
+			isProbed = HCR_waitReply(fd, recorder, printer, HC_ClientType_Bp, HC_BAUDRATE_PROBE_TIMEOUT / (4 * HCR_PROBE_QTY));
+		}
+
+		for (uint8_t i = 0; isProbed && (i < HCR_PROBE_QTY); ++i)
+		{
+			query.begin(HC_ClientType_Br);
+			HCR_sendQuery(fd, recorder, query);
+			if (HCR_waitReply(fd, recorder, printer, HC_ClientType_Br, HC_BAUDRATE_PROBE_TIMEOUT / (4 * HCR_PROBE_QTY))
+				&& (printer.lastValues[0] == index))
+			{
+				fprintf(stderr, "recorder: baudrate %lu\n", baudrate);
+				return true;
+			}
+		}
+	}
+
+	// not confirmed: the board goes back to the current baudrate after HC_BAUDRATE_PROBE_TIMEOUT
+	fprintf(stderr, "recorder: baudrate %lu not confirmed, back to the current baudrate\n", baudrate);
+	tcsetattr(fd, TCSANOW, &current);
+	usleep(HC_BAUDRATE_PROBE_TIMEOUT * 1000);
+	tcflush(fd, TCIFLUSH);
+	return false;
+}
+
+
+
+// *****************************************************************************
+// Main
+// *****************************************************************************
+
+int main(int argc, char** argv)
+{
+	HC_ClientFormat format;
+	unsigned long baudrate = 0;
+	unsigned long maxBaudrate = 0;
+	unsigned long credits = 0;
+	double duration = 0;
+	bool append = false;
+	bool verbose = false;
+	uint8_t queries[HCR_QUERY_MAX_QTY];
+	uint8_t queryQty = 0;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "p:mtb:u:c:d:q:av")) != -1)
+	{
+		switch (opt)
+		{
+			case 'p':	format.option = atoi(optarg);			break;
+			case 'm':	format.changeMask = true;				break;
+			case 't':	format.timestamp = true;				break;
+			case 'b':	baudrate = strtoul(optarg, NULL_POINTER, 10);	break;
+			case 'u':	maxBaudrate = strtoul(optarg, NULL_POINTER, 10);	break;
+			case 'c':	credits = strtoul(optarg, NULL_POINTER, 10);	break;
+			case 'd':	duration = atof(optarg);				break;
+			case 'a':	append = true;							break;
+			case 'v':	verbose = true;							break;
+			case 'q':
+				if ((strlen(optarg) != 2) || (queryQty == HCR_QUERY_MAX_QTY) ||
+					((queries[queryQty++] = HC_Client_getType(optarg[0], optarg[1])) == 0))
+				{
+					fprintf(stderr, "recorder: unknown query %s\n", optarg);
+					return 1;
+				}
+				break;
+			default:
+				HCR_usage();
+				return 1;
+		}
+	}
+
+	if ((argc - optind != 2) || (format.option > PROTOBF_OPTIONS_BINARY))
+	{
+		HCR_usage();
+		return 1;
+	}
+
+	int fd = open(argv[optind], O_RDWR | O_NOCTTY);
+	if (fd < 0)
+	{
+		perror(argv[optind]);
+		return 1;
+	}
+	if ((baudrate != 0) && !HCR_configure(fd, baudrate))
+		return 1;
+
+	HC_Recorder recorder;
+	if (!recorder.open(argv[optind + 1], format, append))
+	{
+		perror(argv[optind + 1]);
+		return 1;
+	}
+
+	HCR_Printer printer;
+	printer.isVerbose = verbose;
+	recorder.setHandler(&printer);
+
+	signal(SIGINT, HCR_stop);
+	signal(SIGTERM, HCR_stop);
+
+	// baudrate negotiation
+	if (maxBaudrate != 0)
+		HCR_negotiate(fd, recorder, printer, format, maxBaudrate);
+
+	// flow control: initial credits (frames)
+	HC_ClientQuery query(format);
+	unsigned long firstReply = printer.replies;
+	unsigned long sentQueries = 0;
+	if (credits != 0)
+	{
+		query.begin(HC_ClientType_Fc, HC_CLIENT_CONFIG_WRITE);
+		query.addNumber(HC_FLOW_UNIT_FRAMES, 1);
+		query.addNumber(credits, 8);
+		HCR_sendQuery(fd, recorder, query);
+		++sentQueries;
+	}
+
+	// queries
+	for (uint8_t i = 0; i < queryQty; ++i)
+	{
+		query.begin(queries[i]);
+		HCR_sendQuery(fd, recorder, query);
+		++sentQueries;
+	}
+
+	// received bytes, until Ctrl-C or duration
+	uint64_t start = HCR_getTime();
+	uint8_t buffer[4096];
+	unsigned long readFrames = 0;
+	while (!g_isStopped && ((duration == 0) || (HCR_getTime() - start < duration * 1e6)))
+	{
+		struct pollfd pfd = { fd, POLLIN, 0 };
+		if (poll(&pfd, 1, 100) <= 0)
+			continue;
+
+		ssize_t n = read(fd, buffer, sizeof(buffer));
+		if (n > 0)
+			recorder.feed(buffer, n, HCR_getTime());
+		else if ((n == 0) || (pfd.revents & (POLLHUP | POLLERR)))
+			break;
+
+		// flow control: frames read are granted again (replies to the queries are free)
+		unsigned long replies = printer.replies - firstReply;
+		if ((credits != 0) && (replies >= sentQueries + readFrames + (credits + 1) / 2))
+		{
+			unsigned long grant = replies - sentQueries - readFrames;
+			if (grant > 0xFFFF)
+				grant = 0xFFFF;
+			readFrames += grant;
+
+			query.setCredit(grant);
+			query.begin(HC_ClientType_Fc);
+			HCR_sendQuery(fd, recorder, query);
+			++sentQueries;
+		}
+	}
+
+	const HC_ClientDecoder& decoder = recorder.getDecoder();
+	fprintf(stderr, "%lu records, %llu bytes, %lu frames decoded, dropped: %lu CRC, %lu length, %lu format\n",
+		recorder.getRecords(), recorder.getBytes(), decoder.getFrames(),
+		decoder.getDrops(HC_CLIENT_DROP_CRC), decoder.getDrops(HC_CLIENT_DROP_LENGHT),
+		decoder.getDrops(HC_CLIENT_DROP_FORMAT));
+
+	recorder.close();
+	close(fd);
+	return 0;
+}
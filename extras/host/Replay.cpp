@@ -0,0 +1,276 @@
+/*
+ * HITIComm
+ * Replay.cpp (host build)
+ *
+ * Copyright © 2021 Christophe LANDRET
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// *****************************************************************************
+// Include dependencies
+// *****************************************************************************
+
+// HITIComm
+#include <HITIComm.h>
+
+// HITIComm client
+#include "HC_Client.h"
+#include "HC_Record.h"
+
+// POSIX
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+
+
+// *****************************************************************************
+// Define
+// *****************************************************************************
+
+// Replays a .hcr file (HC_Record.h):
+//   - REPLY records are decoded by HC_ClientDecoder (X sequences rebuilt by HC_ClientSnapshot)
+//   - -b: QUERY records are sent to the simulated board (in-memory Serial): analyzeInput() runs on
+//     the recorded queries, on the virtual clock (its replies are decoded and counted)
+// As fast as possible (default), or at a multiple of real time (-s).
+
+// virtual time of 1 cycle of loop() (us)
+#define HCP_CYCLE_TIME		100
+
+
+static uint64_t HCP_getTime()	// us, monotonic
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+
+static void HCP_usage()
+{
+	fprintf(stderr,
+		"usage: replay [options] file.hcr\n"
+		"  -l            list the records\n"
+		"  -t type       only the records of 1 Message Type (through the index), ex: -t X0\n"
+		"  -a types      A query subscriptions (decoding of Aq), ex: -a AI,AI,AD,DD\n"
+		"  -b            send the queries to the simulated board (protocol option of the build: %u)\n"
+		"  -s speed      multiple of real time (default 0: as fast as possible)\n", PROTOBF_OPTION);
+}
+
+
+
+// *****************************************************************************
+// Decoded messages
+// *****************************************************************************
+
+class HCP_Handler : public HC_ClientHandler
+{
+	public:
+		void onMessage(const HC_ClientMessage& message)
+		{
+			errors += (message.event == HC_ClientEvent_Error);
+			sequences += snapshot.update(message);
+		}
+
+		HC_ClientSnapshot snapshot;
+		unsigned long errors = 0;
+		unsigned long sequences = 0;
+};
+
+
+static void HCP_print(const HC_Record& record)
+{
+	static const char* const kinds[] = { "reply", "query" };
+
+	char name[3] = "--";
+	if (record.header->flags & HC_RECORD_FLAG_ERROR)
+		HC_Client_getErrorName(record.header->type, name);
+	else if (!(record.header->flags & HC_RECORD_FLAG_DROPPED))
+		HC_Client_getName(record.header->type, name);
+
+	printf("%12.6f %s %s%s %4u  ", record.header->time / 1e6, kinds[record.header->kind], name,
+		(record.header->flags & HC_RECORD_FLAG_DROPPED) ? " (dropped)" : "", record.header->size);
+
+	// text frames, or hex
+	for (uint32_t i = 0; i < record.header->size; ++i)
+	{
+		uint8_t c = record.data[i];
+		if ((c >= 0x20) && (c < 0x7F))
+			putchar(c);
+		else if ((c != '\r') && (c != '\n'))
+			printf("\\x%02X", c);
+	}
+	printf("\n");
+}
+
+
+
+// *****************************************************************************
+// Main
+// *****************************************************************************
+
+int main(int argc, char** argv)
+{
+	bool list = false;
+	uint8_t type = 0;
+	const char* subscriptions = NULL_POINTER;
+	bool board = false;
+	double speed = 0;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "lt:a:bs:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'l':	list = true;				break;
+			case 'a':	subscriptions = optarg;		break;
+			case 'b':	board = true;				break;
+			case 's':	speed = atof(optarg);		break;
+			case 't':
+				if ((strlen(optarg) != 2) || ((type = HC_Client_getType(optarg[0], optarg[1])) == 0))
+				{
+					fprintf(stderr, "replay: unknown type %s\n", optarg);
+					return 1;
+				}
+				break;
+			default:
+				HCP_usage();
+				return 1;
+		}
+	}
+
+	if (argc - optind != 1)
+	{
+		HCP_usage();
+		return 1;
+	}
+
+	HC_RecordReader reader;
+	if (!reader.open(argv[optind]))
+	{
+		perror(argv[optind]);
+		return 1;
+	}
+
+	// 1 type: through the index
+	if (type != 0)
+	{
+		HC_RecordCursor cursor;
+		HC_Record record;
+		unsigned long qty = 0;
+		while (reader.readType(cursor, type, record))
+		{
+			if (list)
+				HCP_print(record);
+			++qty;
+		}
+		printf("%lu records (%u index records)\n", qty, reader.getIndexQty());
+		return 0;
+	}
+
+	// recorded replies
+	HC_ClientFormat format = reader.getFormat();
+	HCP_Handler handler;
+	HC_ClientDecoder decoder(handler, format);
+
+	// replies of the simulated board
+	HCP_Handler boardHandler;
+	HC_ClientDecoder boardDecoder(boardHandler, format);
+
+	for (const char* p = subscriptions; (p != NULL_POINTER) && (p[0] != '\0'); p += (p[2] == ',') ? 3 : 2)
+	{
+		uint8_t subscription = HC_Client_getType(p[0], p[1]);
+		if ((subscription == 0) || !decoder.addASubscription(subscription) || !boardDecoder.addASubscription(subscription))
+		{
+			fprintf(stderr, "replay: invalid subscriptions %s\n", subscriptions);
+			return 1;
+		}
+	}
+
+	if (board)
+	{
+		if (format.option != PROTOBF_OPTION)
+		{
+			fprintf(stderr, "replay: recorded with protocol option %u, board built with %u\n", format.option, PROTOBF_OPTION);
+			return 1;
+		}
+		HC_begin();
+		Serial.begin(0);
+	}
+
+	unsigned long records = 0;
+	unsigned long long bytes = 0;
+	uint64_t recordTime = 0;
+	uint64_t boardTime = 0;
+	uint64_t start = HCP_getTime();
+
+	uint64_t offset = 0;
+	HC_Record record;
+	while (reader.read(offset, record))
+	{
+		recordTime = record.header->time;
+
+		// real time multiple
+		if (speed > 0)
+		{
+			uint64_t due = start + (uint64_t)(recordTime / speed);
+			uint64_t now = HCP_getTime();
+			if (due > now)
+				usleep(due - now);
+		}
+
+		// board: runs up to the time of the record
+		if (board)
+		{
+			for (; boardTime < recordTime; boardTime += HCP_CYCLE_TIME)
+			{
+				HC_communicate();
+				HCS_Host_advance(HCP_CYCLE_TIME);
+
+				uint8_t buffer[1024];
+				size_t n;
+				while ((n = HCS_Host_receive(Serial, buffer, sizeof(buffer))) != 0)
+					boardDecoder.feed(buffer, n);
+			}
+
+			if (record.header->kind == HC_RECORD_KIND_QUERY)
+				HCS_Host_send(Serial, record.data, record.header->size);
+		}
+
+		if (record.header->kind == HC_RECORD_KIND_REPLY)
+			decoder.feed(record.data, record.header->size);
+
+		if (list)
+			HCP_print(record);
+
+		++records;
+		bytes += record.header->size;
+	}
+
+	double duration = (HCP_getTime() - start) / 1e6;
+
+	printf("%lu records, %llu bytes, %.3f s recorded, replayed in %.3f s (x %.0f)\n",
+		records, bytes, recordTime / 1e6, duration, (duration > 0) ? recordTime / 1e6 / duration : 0);
+	printf("recorded replies: %lu frames, %lu errors, %lu X sequences, dropped: %lu CRC, %lu length, %lu format\n",
+		decoder.getFrames(), handler.errors, handler.sequences, decoder.getDrops(HC_CLIENT_DROP_CRC),
+		decoder.getDrops(HC_CLIENT_DROP_LENGHT), decoder.getDrops(HC_CLIENT_DROP_FORMAT));
+	if (board)
+		printf("board replies:    %lu frames, %lu errors, %lu X sequences\n",
+			boardDecoder.getFrames(), boardHandler.errors, boardHandler.sequences);
+
+	return 0;
+}
@@ -0,0 +1,1476 @@
+/*
+ * HITIComm
+ * HC_Client.cpp (host client)
+ *
+ * Copyright © 2021 Christophe LANDRET
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "HC_Client.h"
+
+
+
+// *****************************************************************************
+// Include dependencies
+// *****************************************************************************
+
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+
+
+// *****************************************************************************
+// Define
+// *****************************************************************************
+
+// special chars
+#define HCC_CHAR_QUERY			'$'
+#define HCC_CHAR_REPLY			'#'
+#define HCC_CHAR_ERROR			'!'
+#define HCC_CHAR_SEPARATOR		'_'
+#define HCC_CHAR_EMPTYDATA		'&'
+
+// fields of a reply: kind (bits 7-4), width (bits 3-0: hex chars, or HCC_WIDTH_xxx)
+#define HCC_NUMBER(width)		(0x00 | (width))	// decimal if PROTOBF_USE_INT
+#define HCC_HEX(width)			(0x10 | (width))	// always hex (registers, bools)
+#define HCC_FLOAT				0x20
+#define HCC_STRING				0x30
+#define HCC_REPEAT				0x40				// next field is repeated until the end of data
+#define HCC_KIND(field)			((field) & 0xF0)
+
+#define HCC_WIDTH_UINT			0x09				// unsigned int of the board
+#define HCC_WIDTH_PWM			0x0A
+#define HCC_WIDTH_DAC			0x0B
+#define HCC_WIDTH_AI			0x0C
+
+// flags of optional features: all features (every message the board may accept)
+#define HC_MESSAGE_ARDUINOTIME(flags)	(flags)
+#define HC_MESSAGE_STRING(flags)		(flags)
+#define HC_MESSAGE_EEPROM(flags)		(flags)
+#define HC_MESSAGE_DAC(flags)			(flags)
+#define HC_MESSAGE_CAPTURE(flags)		(flags)
+#define HC_MESSAGE_MULTIDROP(flags)		(flags)
+#define HC_MESSAGE_BAUDRATE(flags)		(flags)
+#define HC_MESSAGE_FLOWCONTROL(flags)	(flags)
+#define HC_MESSAGE_SAMPLER(flags)		(flags)
+
+
+
+// *****************************************************************************
+// Shared tables
+// *****************************************************************************
+
+struct HCC_Descriptor
+{
+	uint8_t flags;
+	char name[2];
+};
+
+#define HCC_DESCRIPTOR(name, code, c0, c1, flags)	{ flags, { c0, c1 } },
+#define HCC_DESCRIPTOR_GAP(code)					{ 0, { 0, 0 } },
+
+static const HCC_Descriptor HCC_descriptors[HC_MESSAGETYPE_QTY] =
+{
+	HC_MESSAGETYPE_TABLE(HCC_DESCRIPTOR, HCC_DESCRIPTOR_GAP)
+};
+
+#define HCC_ERROR_NAME(name, code, c0, c1)			{ code, { c0, c1 } },
+
+static const HCC_Descriptor HCC_errors[] =
+{
+	HC_MESSAGEERROR_TABLE(HCC_ERROR_NAME)
+};
+
+#define HCC_ERROR_QTY	(sizeof(HCC_errors) / sizeof(HCC_Descriptor))
+
+
+uint8_t HC_Client_getFlags(uint8_t type)
+{
+	if ((type < HC_MESSAGETYPE_FIRST) || (type > HC_MESSAGETYPE_LAST))
+		return 0;
+
+	return HCC_descriptors[type - HC_MESSAGETYPE_FIRST].flags;
+}
+
+bool HC_Client_getName(uint8_t type, char name[3])
+{
+	if ((type < HC_MESSAGETYPE_FIRST) || (type > HC_MESSAGETYPE_LAST) ||
+		(HCC_descriptors[type - HC_MESSAGETYPE_FIRST].name[0] == 0))
+		return false;
+
+	name[0] = HCC_descriptors[type - HC_MESSAGETYPE_FIRST].name[0];
+	name[1] = HCC_descriptors[type - HC_MESSAGETYPE_FIRST].name[1];
+	name[2] = '\0';
+	return true;
+}
+
+uint8_t HC_Client_getType(char c0, char c1)
+{
+	for (uint8_t i = 0; i < HC_MESSAGETYPE_QTY; ++i)
+		if ((HCC_descriptors[i].name[0] == c0) && (HCC_descriptors[i].name[1] == c1))
+			return HC_MESSAGETYPE_FIRST + i;
+
+	return 0;
+}
+
+bool HC_Client_getErrorName(uint8_t error, char name[3])
+{
+	for (uint8_t i = 0; i < HCC_ERROR_QTY; ++i)
+	{
+		if (HCC_errors[i].flags == error)
+		{
+			name[0] = HCC_errors[i].name[0];
+			name[1] = HCC_errors[i].name[1];
+			name[2] = '\0';
+			return true;
+		}
+	}
+	return false;
+}
+
+static uint8_t HCC_getErrorCode(char c0, char c1)
+{
+	for (uint8_t i = 0; i < HCC_ERROR_QTY; ++i)
+		if ((HCC_errors[i].name[0] == c0) && (HCC_errors[i].name[1] == c1))
+			return HCC_errors[i].flags;
+
+	return 0;
+}
+
+
+#define HCC_BAUDRATE(index, baudrate)	baudrate,
+
+static const uint32_t HCC_baudrates[HC_BAUDRATE_QTY] =
+{
+	HC_BAUDRATE_TABLE(HCC_BAUDRATE)
+};
+
+uint32_t HC_Client_getBaudrate(uint8_t index)
+{
+	return (index < HC_BAUDRATE_QTY) ? HCC_baudrates[index] : 0;
+}
+
+uint8_t HC_Client_getBaudrateIndex(uint32_t baudrate)
+{
+	for (uint8_t i = 0; i < HC_BAUDRATE_QTY; ++i)
+		if (HCC_baudrates[i] == baudrate)
+			return i;
+
+	return HC_BAUDRATE_NONE;
+}
+
+uint8_t HC_Client_selectBaudrate(uint16_t boardMask, uint16_t computerMask)
+{
+	uint16_t mask = boardMask & computerMask;
+
+	for (uint8_t i = HC_BAUDRATE_QTY; i > 0; --i)
+		if ((mask >> (i - 1)) & 1)
+			return i - 1;
+
+	return HC_BAUDRATE_NONE;
+}
+
+
+
+// *****************************************************************************
+// Toolbox
+// *****************************************************************************
+
+// CRC-16/XMODEM (as the board). Table driven (the board computes it bitwise)
+static uint16_t HCC_crc16Table[256];
+
+static bool HCC_initCRC16Table()
+{
+	for (unsigned int i = 0; i < 256; ++i)
+	{
+		uint16_t crc = i << 8;
+		for (uint8_t bit = 0; bit < 8; ++bit)
+			crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+		HCC_crc16Table[i] = crc;
+	}
+	return true;
+}
+
+// whole buffer (table initialized on first use)
+static uint16_t HCC_computeCRC16(const uint8_t* data, size_t length)
+{
+	static const bool isInit = HCC_initCRC16Table();
+
+	uint16_t crc = 0;
+	while (length--)
+		crc = (crc << 8) ^ HCC_crc16Table[(crc >> 8) ^ *data++];
+	return crc;
+}
+
+// 0-15, or 0xFF if not a hex digit (upper case, as sent by the board)
+static inline uint8_t HCC_hexDigit(uint8_t c)
+{
+	if ((c >= '0') && (c <= '9'))	return c - '0';
+	if ((c >= 'A') && (c <= 'F'))	return c - 'A' + 10;
+	if ((c >= 'a') && (c <= 'f'))	return c - 'a' + 10;
+	return 0xFF;
+}
+
+static inline uint32_t HCC_floatToBits(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+float HC_ClientMessage::getFloat(uint8_t i) const
+{
+	float value;
+	memcpy(&value, &values[i], sizeof(value));
+	return value;
+}
+
+
+
+// *****************************************************************************
+// Query encoder
+// *****************************************************************************
+
+
+void HC_ClientQuery::appendByte(uint8_t b)
+{
+	// keep room for CRC, end of frame
+	if (mLength < HC_CLIENT_QUERY_MAX_LENGHT - 4)
+		mData[mLength++] = b;
+	else
+		mOverflow = true;
+}
+
+void HC_ClientQuery::appendSeparator()
+{
+	if (mFormat.usesSeparator())
+		appendByte(HCC_CHAR_SEPARATOR);
+}
+
+// ASCII digits (base 10 or 16, upper case), completed with leading zeros up to minLength
+void HC_ClientQuery::appendDigits(uint32_t value, uint8_t base, uint8_t minLength)
+{
+	char digits[10];
+	uint8_t i = 0;
+
+	do
+	{
+		uint8_t d = value % base;
+		value /= base;
+		digits[i++] = (d < 10) ? d + '0' : d - 10 + 'A';
+	} while (value);
+
+	while ((i < minLength) && (i < sizeof(digits)))
+		digits[i++] = '0';
+
+	while (i)
+		appendByte(digits[--i]);
+}
+
+
+void HC_ClientQuery::begin(uint8_t type, uint8_t config, uint8_t index, uint16_t address)
+{
+	// binary: mData[0] is the first COBS code
+	mLength = mFormat.isBinary() ? 1 : 0;
+	mOverflow = false;
+	mType = type;
+
+	appendByte(HCC_CHAR_QUERY);
+
+	if (mFormat.multidrop)
+		addNumber(mNode, 2);
+
+	addType(type);
+
+	// credits granted (flow control): after the index and address
+	if (mHasCredit)
+		config |= HC_CLIENT_CONFIG_CREDIT;
+
+	// config byte: 1 hex char
+	addHex(config, 1);
+
+	if (config & HC_CLIENT_CONFIG_INDEX)
+		addIndex(index);
+	if (config & HC_CLIENT_CONFIG_ADDRESS)
+		addNumber(address, 4);
+	if (config & HC_CLIENT_CONFIG_CREDIT)
+		addNumber(mCredit, 4);
+
+	mHasCredit = false;
+}
+
+void HC_ClientQuery::addType(uint8_t type)
+{
+	char name[3];
+
+	appendSeparator();
+	if (mFormat.isReadable() && HC_Client_getName(type, name))
+	{
+		appendByte(name[0]);
+		appendByte(name[1]);
+	}
+	else
+		appendByte(type);
+}
+
+void HC_ClientQuery::addIndex(uint8_t index)
+{
+	addNumber(index, 2);
+}
+
+void HC_ClientQuery::addNumber(uint32_t value, uint8_t hexLength)
+{
+	if (mFormat.usesInt())
+	{
+		appendSeparator();
+		appendDigits(value, 10, 1);
+	}
+	else
+		addHex(value, hexLength);
+}
+
+void HC_ClientQuery::addHex(uint32_t value, uint8_t hexLength)
+{
+	if (mFormat.isBinary())
+	{
+		// 1 byte for 2 chars, little-endian
+		for (uint8_t i = 0; i < (hexLength + 1) / 2; ++i)
+			appendByte((uint8_t)(value >> (8 * i)));
+	}
+	else
+	{
+		appendSeparator();
+		appendDigits(value, 16, hexLength);
+	}
+}
+
+void HC_ClientQuery::addFloat(float value)
+{
+	if (mFormat.usesInt())
+	{
+		// decimal (C locale: '.')
+		char str[24];
+		int length = snprintf(str, sizeof(str), "%.7g", value);
+
+		appendSeparator();
+		for (int i = 0; i < length; ++i)
+			appendByte(str[i]);
+	}
+	else
+		addHex(HCC_floatToBits(value), 8);
+}
+
+void HC_ClientQuery::addString(const char* str)
+{
+	appendSeparator();
+	while (*str != '\0')
+		appendByte(*str++);
+
+	// binary: NUL terminator
+	if (mFormat.isBinary())
+		appendByte(0);
+}
+
+
+size_t HC_ClientQuery::end()
+{
+	if (mOverflow)
+	{
+		mLength = 0;
+		return 0;
+	}
+
+	if (mFormat.isBinary())
+	{
+		// CRC-16 (little-endian), COBS encoding (in place: mData[0] is the first code), delimiter
+		uint16_t crc = HCC_computeCRC16(&mData[1], mLength - 1);
+		mData[mLength++] = (uint8_t)crc;
+		mData[mLength++] = (uint8_t)(crc >> 8);
+
+		size_t code_index = 0;
+		for (size_t i = 1; i < mLength; ++i)
+		{
+			if (mData[i] == 0)
+			{
+				mData[code_index] = (uint8_t)(i - code_index);
+				code_index = i;
+			}
+		}
+		mData[code_index] = (uint8_t)(mLength - code_index);
+
+		mData[mLength++] = 0;
+	}
+	else
+	{
+		if (mFormat.usesCRC())
+		{
+			// sum of all chars (separator before the CRC included)
+			appendSeparator();
+
+			uint8_t crc = 0;
+			for (size_t i = 0; i < mLength; ++i)
+				crc += mData[i];
+
+			mData[mLength++] = "0123456789ABCDEF"[crc >> 4];
+			mData[mLength++] = "0123456789ABCDEF"[crc & 0x0F];
+		}
+		mData[mLength++] = '\r';
+		mData[mLength++] = '\n';
+	}
+
+	return mLength;
+}
+
+
+
+// *****************************************************************************
+// Streaming decoder : frames
+// *****************************************************************************
+
+
+void HC_ClientDecoder::setFormat(const HC_ClientFormat& format)
+{
+	mFormat = format;
+	reset();
+}
+
+void HC_ClientDecoder::reset()
+{
+	mFrame_length = 0;
+	mFrame_isStarted = false;
+	mFrame_isOverflow = false;
+	mCobs_code = 0;
+	mCobs_remaining = 0;
+	mTimestamp_isValid = 0;
+}
+
+bool HC_ClientDecoder::addASubscription(uint8_t type)
+{
+	if (mAquery_qty >= HC_CLIENT_AQUERY_MAX_QTY)
+		return false;
+
+	mAquery_types[mAquery_qty++] = type;
+	return true;
+}
+
+void HC_ClientDecoder::drop(uint8_t reason)
+{
+	++mDrops[reason];
+	mHandler->onDrop(reason);
+}
+
+
+void HC_ClientDecoder::feed(const uint8_t* data, size_t length)
+{
+	const uint8_t* end = data + length;
+
+	if (mFormat.isBinary())
+	{
+		// COBS decoding while receiving: each code byte is replaced by 0x00 (except the first one)
+		while (data < end)
+		{
+			uint8_t b = *data++;
+
+			// delimiter: end of frame
+			if (b == 0)
+			{
+				if (mFrame_isOverflow || (mCobs_remaining != 0))
+					drop(HC_CLIENT_DROP_LENGHT);
+				else if (mFrame_length > 0)
+					decodeFrame(mFrame_length);
+
+				mFrame_length = 0;
+				mFrame_isOverflow = false;
+				mCobs_remaining = 0;
+				mCobs_code = 0;
+				continue;
+			}
+
+			if (mCobs_remaining == 0)
+			{
+				// code byte: end of the previous block (0x00, except after a full block)
+				bool hasZero = (mCobs_code != 0) && (mCobs_code != 0xFF);
+
+				mCobs_code = b;
+				mCobs_remaining = b - 1;
+				if (!hasZero)
+					continue;
+				b = 0;
+			}
+			else
+				--mCobs_remaining;
+
+			if (mFrame_length < HC_CLIENT_FRAME_MAX_LENGHT)
+				mFrame[mFrame_length++] = b;
+			else
+				mFrame_isOverflow = true;
+		}
+	}
+	else
+	{
+		// text: from a start char (# or !) to LF. Bytes between frames are ignored
+		while (data < end)
+		{
+			if (!mFrame_isStarted)
+			{
+				// next start char
+				while ((data < end) && (*data != HCC_CHAR_REPLY) && (*data != HCC_CHAR_ERROR))
+					++data;
+				if (data == end)
+					break;
+
+				mFrame_isStarted = true;
+				mFrame_isOverflow = false;
+				mFrame_length = 0;
+			}
+
+			// copy up to LF
+			const uint8_t* lf = (const uint8_t*)memchr(data, '\n', end - data);
+			const uint8_t* chunkEnd = (lf != NULL_POINTER) ? lf : end;
+			size_t chunk = chunkEnd - data;
+
+			if (mFrame_length + chunk <= HC_CLIENT_FRAME_MAX_LENGHT)
+			{
+				memcpy(&mFrame[mFrame_length], data, chunk);
+				mFrame_length += chunk;
+			}
+			else
+				mFrame_isOverflow = true;
+
+			data = chunkEnd;
+
+			if (lf != NULL_POINTER)
+			{
+				++data;
+				mFrame_isStarted = false;
+
+				if (mFrame_isOverflow)
+					drop(HC_CLIENT_DROP_LENGHT);
+				else
+				{
+					// without CR
+					size_t frameLength = mFrame_length;
+					if ((frameLength > 0) && (mFrame[frameLength - 1] == '\r'))
+						--frameLength;
+					decodeFrame(frameLength);
+				}
+			}
+		}
+	}
+}
+
+
+// check CRC, decode, pass to the handler
+void HC_ClientDecoder::decodeFrame(size_t length)
+{
+	size_t dataEnd = length;
+
+	if (mFormat.isBinary())
+	{
+		// start, type, control or error code, CRC-16
+		if (length < 4)
+		{
+			drop(HC_CLIENT_DROP_LENGHT);
+			return;
+		}
+
+		uint16_t crc = HCC_computeCRC16(mFrame, length - 2);
+		if (crc != (uint16_t)(mFrame[length - 2] | (mFrame[length - 1] << 8)))
+		{
+			drop(HC_CLIENT_DROP_CRC);
+			return;
+		}
+		dataEnd = length - 2;
+	}
+	else if (mFormat.option == PROTOBF_OPTIONS_HEX)
+	{
+		// CRC: last 2 hex chars, sum of the previous chars
+		if (length < 4)
+		{
+			drop(HC_CLIENT_DROP_LENGHT);
+			return;
+		}
+
+		uint8_t high = HCC_hexDigit(mFrame[length - 2]);
+		uint8_t low = HCC_hexDigit(mFrame[length - 1]);
+
+		uint8_t crc = 0;
+		for (size_t i = 0; i < length - 2; ++i)
+			crc += mFrame[i];
+
+		if ((high > 0x0F) || (low > 0x0F) || (crc != ((high << 4) | low)))
+		{
+			drop(HC_CLIENT_DROP_CRC);
+			return;
+		}
+		dataEnd = length - 2;
+	}
+	else if (mFormat.option == PROTOBF_OPTIONS_USE_SEPARATOR)
+	{
+		// CRC: hex token after the last separator, sum of the previous chars (separator included)
+		size_t separator = length;
+		while ((separator > 0) && (mFrame[separator - 1] != HCC_CHAR_SEPARATOR))
+			--separator;
+
+		uint8_t crc = 0;
+		for (size_t i = 0; i < separator; ++i)
+			crc += mFrame[i];
+
+		uint8_t received = 0;
+		bool isValid = (separator > 0) && (separator < length) && (length - separator <= 2);
+		for (size_t i = separator; isValid && (i < length); ++i)
+		{
+			uint8_t d = HCC_hexDigit(mFrame[i]);
+			isValid = (d <= 0x0F);
+			received = (received << 4) | d;
+		}
+
+		if (!isValid || (crc != received))
+		{
+			drop(HC_CLIENT_DROP_CRC);
+			return;
+		}
+		dataEnd = separator;
+	}
+
+	// data is terminated (strings)
+	mFrame[dataEnd] = '\0';
+	mRead = &mFrame[1];
+	mRead_end = &mFrame[dataEnd];
+
+	HC_ClientMessage& message = mMessage;
+	message.event = HC_ClientEvent_Reply;
+	message.node = 0;
+	message.control = 0;
+	message.index = 0;
+	message.address = 0;
+	message.hasTimestamp = false;
+	message.timestamp = 0;
+	message.set = 0;
+	message.first = 0;
+	message.mask = 0;
+	message.qty = 0;
+	message.floatMask = 0;
+	message.stringQty = 0;
+
+	bool isError = (mFrame[0] == HCC_CHAR_ERROR);
+
+	// separator after the start char
+	if (mFormat.usesSeparator() && (mRead < mRead_end) && (*mRead == HCC_CHAR_SEPARATOR))
+		++mRead;
+
+	bool isDecoded = true;
+
+	if (mFormat.multidrop)
+	{
+		isDecoded = readField(HCC_NUMBER(2), message);
+		message.node = (uint8_t)message.values[0];
+		message.qty = 0;
+	}
+
+	isDecoded = isDecoded && readType(message.type, isError);
+
+	if (isDecoded && isError)
+	{
+		// received query (if echoed by the board)
+		message.event = HC_ClientEvent_Error;
+		if (mRead < mRead_end)
+		{
+			message.strings[0] = (const char*)mRead;
+			message.stringQty = 1;
+		}
+	}
+	else if (isDecoded)
+	{
+		uint32_t control;
+		isDecoded = readHex(1, control);
+		message.control = (uint8_t)control;
+		isDecoded = isDecoded && readPayload(message);
+	}
+
+	if (!isDecoded)
+	{
+		drop(HC_CLIENT_DROP_FORMAT);
+		return;
+	}
+
+	++mFrames;
+	mHandler->onMessage(message);
+}
+
+
+
+// *****************************************************************************
+// Streaming decoder : fields
+// *****************************************************************************
+
+
+// separator mode: chars up to the next separator (or end of data)
+bool HC_ClientDecoder::readToken(const uint8_t*& token, size_t& length)
+{
+	if (mRead >= mRead_end)
+		return false;
+
+	token = mRead;
+	uint8_t* separator = (uint8_t*)memchr(mRead, HCC_CHAR_SEPARATOR, mRead_end - mRead);
+	if (separator != NULL_POINTER)
+	{
+		length = separator - mRead;
+		mRead = separator + 1;
+	}
+	else
+	{
+		length = mRead_end - mRead;
+		mRead = mRead_end;
+	}
+	return true;
+}
+
+
+// hex value: hexLength chars (any length if separator), (hexLength + 1) / 2 bytes if binary
+bool HC_ClientDecoder::readHex(uint8_t hexLength, uint32_t& value)
+{
+	value = 0;
+
+	if (mFormat.isBinary())
+	{
+		uint8_t qty = (hexLength + 1) / 2;
+		if (mRead_end - mRead < qty)
+			return false;
+
+		for (uint8_t i = 0; i < qty; ++i)
+			value |= (uint32_t)(*mRead++) << (8 * i);
+		return true;
+	}
+
+	const uint8_t* digits;
+	size_t length;
+
+	if (mFormat.usesSeparator())
+	{
+		if (!readToken(digits, length) || (length == 0) || (length > 8))
+			return false;
+	}
+	else
+	{
+		if (mRead_end - mRead < hexLength)
+			return false;
+
+		digits = mRead;
+		length = hexLength;
+		mRead += hexLength;
+	}
+
+	for (size_t i = 0; i < length; ++i)
+	{
+		uint8_t d = HCC_hexDigit(digits[i]);
+		if (d > 0x0F)
+			return false;
+		value = (value << 4) | d;
+	}
+	return true;
+}
+
+
+// 1 field (HCC_NUMBER, HCC_HEX, HCC_FLOAT, HCC_STRING), added to the values (or strings) of the message
+bool HC_ClientDecoder::readField(uint8_t field, HC_ClientMessage& message)
+{
+	uint8_t kind = HCC_KIND(field);
+
+	if (kind == HCC_STRING)
+	{
+		if (message.stringQty >= HC_CLIENT_STRING_MAX_QTY)
+			return false;
+		return readString(message.strings[message.stringQty++]);
+	}
+
+	if (message.qty >= HC_CLIENT_VALUE_MAX_QTY)
+		return false;
+
+	uint32_t& value = message.values[message.qty];
+
+	// width
+	uint8_t hexLength = field & 0x0F;
+	switch (hexLength)
+	{
+		case HCC_WIDTH_UINT:	hexLength = mFormat.uintHexLength;	break;
+		case HCC_WIDTH_PWM:		hexLength = mFormat.pwmHexLength;	break;
+		case HCC_WIDTH_DAC:		hexLength = mFormat.dacHexLength;	break;
+		case HCC_WIDTH_AI:		hexLength = mFormat.aiHexLength;	break;
+	}
+
+	if ((kind == HCC_HEX(0)) || !mFormat.usesInt())
+	{
+		if (!readHex((kind == HCC_FLOAT) ? 8 : hexLength, value))
+			return false;
+	}
+	else
+	{
+		// decimal token
+		const uint8_t* token;
+		size_t length;
+		if (!readToken(token, length) || (length == 0))
+			return false;
+
+		if (kind == HCC_FLOAT)
+		{
+			// [-]int[.decimals], nan, inf, ovf
+			size_t i = 0;
+			bool isNegative = (token[0] == '-');
+			if (isNegative)
+				++i;
+
+			double number = 0;
+			double scale = 0;
+			for (; i < length; ++i)
+			{
+				if (token[i] == '.')
+					scale = 1;
+				else if ((token[i] >= '0') && (token[i] <= '9'))
+				{
+					number = number * 10 + (token[i] - '0');
+					scale *= 10;
+				}
+				else
+					break;
+			}
+
+			float f;
+			if (i < length)
+				f = ((length >= 3) && (memcmp(token, "inf", 3) == 0)) ? INFINITY : NAN;
+			else
+				f = (float)((scale > 0) ? number / scale : number);
+			value = HCC_floatToBits(isNegative ? -f : f);
+		}
+		else
+		{
+			value = 0;
+			for (size_t i = 0; i < length; ++i)
+			{
+				if ((token[i] < '0') || (token[i] > '9'))
+					return false;
+				value = value * 10 + (token[i] - '0');
+			}
+		}
+	}
+
+	if (kind == HCC_FLOAT)
+		message.floatMask |= (uint32_t)1 << message.qty;
+	++message.qty;
+	return true;
+}
+
+
+// fields in order. HCC_REPEAT: next field until the end of data
+bool HC_ClientDecoder::readFields(const uint8_t* fields, uint8_t fieldQty, HC_ClientMessage& message)
+{
+	for (uint8_t i = 0; i < fieldQty; ++i)
+	{
+		if (fields[i] == HCC_REPEAT)
+		{
+			++i;
+			while (mRead < mRead_end)
+				if (!readField(fields[i], message))
+					return false;
+		}
+		else if (!readField(fields[i], message))
+			return false;
+	}
+	return true;
+}
+
+
+// Message Type (or error code): name if readable, else 1 char (1 byte if binary)
+bool HC_ClientDecoder::readType(uint8_t& type, bool isError)
+{
+	if (mFormat.usesSeparator())
+	{
+		const uint8_t* token;
+		size_t length;
+		if (!readToken(token, length))
+			return false;
+
+		if (mFormat.isReadable())
+		{
+			if (length != 2)
+				return false;
+			type = isError ? HCC_getErrorCode(token[0], token[1]) : HC_Client_getType(token[0], token[1]);
+			return (type != 0);
+		}
+
+		if (length != 1)
+			return false;
+		type = token[0];
+		return true;
+	}
+
+	if (mRead >= mRead_end)
+		return false;
+	type = *mRead++;
+	return true;
+}
+
+
+// string: up to the forced separator (NUL if binary), which is replaced by NUL
+bool HC_ClientDecoder::readString(const char*& str)
+{
+	uint8_t terminator = mFormat.isBinary() ? 0 : HCC_CHAR_SEPARATOR;
+
+	str = (const char*)mRead;
+	while ((mRead < mRead_end) && (*mRead != terminator))
+		++mRead;
+
+	// end of data is already terminated
+	if (mRead < mRead_end)
+		*mRead++ = '\0';
+	return true;
+}
+
+
+// empty data (&): message without values
+bool HC_ClientDecoder::readEmptyData()
+{
+	if (mFormat.isBinary())
+	{
+		// only if it is the last byte
+		if ((mRead_end - mRead == 1) && (*mRead == HCC_CHAR_EMPTYDATA))
+		{
+			++mRead;
+			return true;
+		}
+		return false;
+	}
+
+	if ((mRead < mRead_end) && (*mRead == HCC_CHAR_EMPTYDATA))
+	{
+		++mRead;
+		if (mFormat.usesSeparator() && (mRead < mRead_end) && (*mRead == HCC_CHAR_SEPARATOR))
+			++mRead;
+		return true;
+	}
+	return false;
+}
+
+
+// delta from the previous timestamp of the query, or escape + absolute time
+bool HC_ClientDecoder::readTimestamp(uint8_t query, HC_ClientMessage& message)
+{
+	if (!readField(HCC_NUMBER(4), message))
+		return false;
+	uint32_t delta = message.values[--message.qty];
+
+	if (delta == 0xFFFF)
+	{
+		if (!readField(HCC_NUMBER(8), message))
+			return false;
+		mTimestamp[query] = message.values[--message.qty];
+		mTimestamp_isValid |= 1 << query;
+	}
+	else
+		mTimestamp[query] += delta;
+
+	message.hasTimestamp = (mTimestamp_isValid >> query) & 1;
+	message.timestamp = mTimestamp[query];
+	return true;
+}
+
+
+
+// *****************************************************************************
+// Streaming decoder : payloads
+// *****************************************************************************
+
+// fields of the replies (in the order of HC_ProtocolSend.cpp)
+static const uint8_t HCC_fields_registers[]	= { HCC_REPEAT, HCC_HEX(8) };
+static const uint8_t HCC_fields_byte[]		= { HCC_HEX(2) };
+static const uint8_t HCC_fields_bools[]		= { HCC_REPEAT, HCC_HEX(1) };
+static const uint8_t HCC_fields_uints[]		= { HCC_REPEAT, HCC_NUMBER(HCC_WIDTH_UINT) };
+static const uint8_t HCC_fields_cycleTime[]	= { HCC_NUMBER(5) };
+static const uint8_t HCC_fields_ulong[]		= { HCC_NUMBER(8) };
+static const uint8_t HCC_fields_string[]	= { HCC_STRING };
+static const uint8_t HCC_fields_ai[]		= { HCC_NUMBER(HCC_WIDTH_AI) };
+static const uint8_t HCC_fields_pwm[]		= { HCC_NUMBER(HCC_WIDTH_PWM) };
+static const uint8_t HCC_fields_servo[]		= { HCC_NUMBER(5) };
+static const uint8_t HCC_fields_float[]		= { HCC_FLOAT };
+static const uint8_t HCC_fields_dac[]		= { HCC_NUMBER(HCC_WIDTH_DAC) };
+static const uint8_t HCC_fields_Ca[]		= { HCC_NUMBER(2), HCC_NUMBER(2), HCC_NUMBER(4), HCC_NUMBER(4), HCC_NUMBER(8) };
+static const uint8_t HCC_fields_Cd[]		= { HCC_NUMBER(4), HCC_NUMBER(2), HCC_REPEAT, HCC_NUMBER(HCC_WIDTH_AI) };
+static const uint8_t HCC_fields_Bq0[]		= { HCC_NUMBER(3), HCC_STRING, HCC_STRING, HCC_NUMBER(5), HCC_REPEAT, HCC_NUMBER(2) };
+static const uint8_t HCC_fields_Bq1[]		= { HCC_NUMBER(4), HCC_NUMBER(4), HCC_NUMBER(4), HCC_NUMBER(4), HCC_NUMBER(4),
+												HCC_NUMBER(4), HCC_NUMBER(4), HCC_NUMBER(4), HCC_NUMBER(2) };
+static const uint8_t HCC_fields_Bq3[]		= { HCC_REPEAT, HCC_NUMBER(2) };
+static const uint8_t HCC_fields_Bq4[]		= { HCC_STRING, HCC_STRING };
+static const uint8_t HCC_fields_Br[]		= { HCC_NUMBER(2), HCC_NUMBER(4) };
+static const uint8_t HCC_fields_Fc[]		= { HCC_NUMBER(2), HCC_NUMBER(8), HCC_NUMBER(8) };
+static const uint8_t HCC_fields_As[]		= { HCC_NUMBER(2) };
+static const uint8_t HCC_fields_Ar0[]		= { HCC_NUMBER(2) };
+static const uint8_t HCC_fields_Ar1[]		= { HCC_NUMBER(2), HCC_NUMBER(2) };
+
+#define HCC_FIELDS(fields)	fields, sizeof(fields)
+
+// A query: field of a subscribed value
+static uint8_t HCC_getAField(uint8_t type)
+{
+	switch (type)
+	{
+		case HC_ClientType_FR:	return HCC_NUMBER(HCC_WIDTH_UINT);
+		case HC_ClientType_CT:	return HCC_NUMBER(5);
+		case HC_ClientType_AI:	return HCC_NUMBER(HCC_WIDTH_AI);
+		case HC_ClientType_PW:	return HCC_NUMBER(HCC_WIDTH_PWM);
+		case HC_ClientType_SV:	return HCC_NUMBER(5);
+		case HC_ClientType_AD:	return HCC_FLOAT;
+		case HC_ClientType_DA:	return HCC_NUMBER(HCC_WIDTH_DAC);
+		default:				return HCC_NUMBER(1);	// DI, DO, DD: bool
+	}
+}
+
+
+// X1 -> XH: [change mask], values of 1 part of a set
+bool HC_ClientDecoder::readXValues(HC_ClientMessage& message)
+{
+	uint8_t field;
+	uint8_t part;
+
+	if (message.type <= HC_ClientType_X2)
+	{
+		message.set = HC_CLIENT_XSET_AI;
+		part = 8;
+		field = HCC_NUMBER(HCC_WIDTH_AI);
+	}
+	else if (message.type <= HC_ClientType_X4)
+	{
+		message.set = HC_CLIENT_XSET_PWM;
+		part = 8;
+		field = HCC_NUMBER(HCC_WIDTH_PWM);
+	}
+	else if (message.type <= HC_ClientType_XC)
+	{
+		message.set = HC_CLIENT_XSET_SERVO;
+		part = 6;
+		field = HCC_NUMBER(5);
+	}
+	else
+	{
+		message.set = HC_CLIENT_XSET_AD;
+		part = 4;
+		field = HCC_FLOAT;
+	}
+
+	static const uint8_t firstType[] = { HC_ClientType_X1, HC_ClientType_X3, HC_ClientType_X5, HC_ClientType_XD };
+	message.first = (message.type - firstType[message.set]) * part;
+	message.event = HC_ClientEvent_XValues;
+
+	if (readEmptyData())
+		return true;
+
+	if (mFormat.changeMask)
+	{
+		// changed values only: at their position in the part
+		uint32_t mask;
+		if (!readHex(2, mask))
+			return false;
+		message.mask = (uint8_t)mask;
+
+		for (uint8_t i = 0; i < part; ++i)
+		{
+			if ((mask >> i) & 1)
+			{
+				message.qty = i;
+				if (!readField(field, message))
+					return false;
+			}
+		}
+		return true;
+	}
+
+	while ((mRead < mRead_end) && (message.qty < part))
+		if (!readField(field, message))
+			return false;
+
+	message.mask = (uint8_t)((1 << message.qty) - 1);
+	return true;
+}
+
+
+// Aq: [timestamp], values in subscription order (binary: bools packed after the other values)
+bool HC_ClientDecoder::readAValues(HC_ClientMessage& message)
+{
+	message.event = HC_ClientEvent_AValues;
+
+	if (mFormat.timestamp && !readTimestamp(HC_CLIENT_TIMESTAMP_A, message))
+		return false;
+
+	for (uint8_t i = 0; i < mAquery_qty; ++i)
+	{
+		uint8_t field = HCC_getAField(mAquery_types[i]);
+
+		if (mFormat.isBinary() && (field == HCC_NUMBER(1)))
+		{
+			// bit, read below
+			message.values[message.qty++] = 0;
+			continue;
+		}
+
+		if (!readField(field, message))
+			return false;
+	}
+
+	if (mFormat.isBinary())
+	{
+		uint8_t bit = 0;
+		uint8_t bits = 0;
+		for (uint8_t i = 0; i < mAquery_qty; ++i)
+		{
+			if (HCC_getAField(mAquery_types[i]) != HCC_NUMBER(1))
+				continue;
+
+			if ((bit & 0x07) == 0)
+			{
+				if (mRead >= mRead_end)
+					return false;
+				bits = *mRead++;
+			}
+			message.values[i] = (bits >> (bit++ & 0x07)) & 1;
+		}
+	}
+
+	return true;
+}
+
+
+// data of a reply (after the control byte)
+bool HC_ClientDecoder::readPayload(HC_ClientMessage& message)
+{
+	uint8_t type = message.type;
+
+	// X query
+	if ((type >= HC_ClientType_X1) && (type <= HC_ClientType_XH))
+		return readXValues(message);
+
+	if (type == HC_ClientType_X0)
+	{
+		message.event = HC_ClientEvent_XStart;
+		if (mFormat.timestamp && !readTimestamp(HC_CLIENT_TIMESTAMP_X, message))
+			return false;
+		return readFields(HCC_FIELDS(HCC_fields_cycleTime), message);
+	}
+
+	// A query
+	if (type == HC_ClientType_Aq)
+		return readAValues(message);
+
+	// address (EEPROM): [index], address, then bit (index), or consecutive bytes
+	if (message.control & HC_CLIENT_CONFIG_ADDRESS)
+	{
+		uint32_t number;
+		message.event = HC_ClientEvent_Data;
+
+		if (message.control & HC_CLIENT_CONFIG_INDEX)
+		{
+			if (!readField(HCC_NUMBER(2), message) || !readField(HCC_NUMBER(4), message))
+				return false;
+			message.index = (uint8_t)message.values[0];
+			message.address = (uint16_t)message.values[1];
+			message.qty = 0;
+			return readField(HCC_HEX(1), message);
+		}
+
+		while (mRead < mRead_end)
+		{
+			if (!readField(HCC_NUMBER(4), message))
+				return false;
+			number = message.values[--message.qty];
+			if (message.qty == 0)
+				message.address = (uint16_t)number;
+
+			if (!readField(HCC_HEX(2), message))
+				return false;
+		}
+		return true;
+	}
+
+	// index
+	if (message.control & HC_CLIENT_CONFIG_INDEX)
+	{
+		if (!readField(HCC_NUMBER(2), message))
+			return false;
+		message.index = (uint8_t)message.values[--message.qty];
+		message.event = (type == HC_ClientType_Bq) ? HC_ClientEvent_Data : HC_ClientEvent_Value;
+
+		switch (type)
+		{
+			case HC_ClientType_Bq:
+				switch (message.index)
+				{
+					case 0:		return readFields(HCC_FIELDS(HCC_fields_Bq0), message);
+					case 1:		return readEmptyData() || readFields(HCC_FIELDS(HCC_fields_Bq1), message);
+					case 2:		return readFields(HCC_FIELDS(HCC_fields_uints), message);
+					case 3:		return readFields(HCC_FIELDS(HCC_fields_Bq3), message);
+					case 4:		return readFields(HCC_FIELDS(HCC_fields_Bq4), message);
+				}
+				return true;
+
+			case HC_ClientType_FR:	return readFields(HCC_FIELDS(HCC_fields_uints), message);
+			case HC_ClientType_Br:	return readFields(HCC_FIELDS(HCC_fields_ulong), message);
+			case HC_ClientType_AI:	return readFields(HCC_FIELDS(HCC_fields_ai), message);
+			case HC_ClientType_Ar:	return readFields(HCC_FIELDS(HCC_fields_Ar1), message);
+			case HC_ClientType_PW:	return readFields(HCC_FIELDS(HCC_fields_pwm), message);
+			case HC_ClientType_SV:	return readFields(HCC_FIELDS(HCC_fields_servo), message);
+			case HC_ClientType_AD:
+			case HC_ClientType_AM:	return readFields(HCC_FIELDS(HCC_fields_float), message);
+			case HC_ClientType_DA:	return readFields(HCC_FIELDS(HCC_fields_dac), message);
+			default:				return readFields(HCC_FIELDS(HCC_fields_bools), message);	// PM, DI, DO, OT, PA, SM, DD, DM
+		}
+	}
+
+	// no index
+	switch (type)
+	{
+		case HC_ClientType_PM:
+		case HC_ClientType_DI:
+		case HC_ClientType_DO:
+		case HC_ClientType_OT:
+		case HC_ClientType_PA:
+		case HC_ClientType_SM:
+		case HC_ClientType_DD:
+		case HC_ClientType_AM:
+			message.event = HC_ClientEvent_Registers;
+			return readFields(HCC_FIELDS(HCC_fields_registers), message);
+
+		case HC_ClientType_DM:
+			message.event = HC_ClientEvent_Registers;
+			return readFields(HCC_FIELDS(HCC_fields_byte), message);
+
+		case HC_ClientType_M0:
+			message.event = HC_ClientEvent_Data;
+			return readFields(HCC_FIELDS(HCC_fields_uints), message);
+
+		case HC_ClientType_CT:
+			message.event = HC_ClientEvent_Data;
+			return readFields(HCC_FIELDS(HCC_fields_cycleTime), message);
+
+		case HC_ClientType_TM:
+			message.event = HC_ClientEvent_Data;
+			return readFields(HCC_FIELDS(HCC_fields_ulong), message);
+
+		case HC_ClientType_S0:
+			message.event = HC_ClientEvent_Data;
+			return readFields(HCC_FIELDS(HCC_fields_string), message);
+
+		case HC_ClientType_Ca:
+			message.event = HC_ClientEvent_Data;
+			return readFields(HCC_FIELDS(HCC_fields_Ca), message);
+
+		case HC_ClientType_Cd:
+			message.event = HC_ClientEvent_Data;
+			return readFields(HCC_FIELDS(HCC_fields_Cd), message);
+
+		case HC_ClientType_Br:
+			message.event = HC_ClientEvent_Data;
+			return readFields(HCC_FIELDS(HCC_fields_Br), message);
+
+		case HC_ClientType_Fc:
+			message.event = HC_ClientEvent_Data;
+			return readFields(HCC_FIELDS(HCC_fields_Fc), message);
+
+		// quantity of A subscriptions accepted by the board
+		case HC_ClientType_As:
+			message.event = HC_ClientEvent_Data;
+			return readFields(HCC_FIELDS(HCC_fields_As), message);
+
+		// AI hex length: applied to the next AI values
+		case HC_ClientType_Ar:
+			message.event = HC_ClientEvent_Data;
+			if (!readFields(HCC_FIELDS(HCC_fields_Ar0), message))
+				return false;
+			if ((message.values[0] == 3) || (message.values[0] == 4))
+				mFormat.aiHexLength = (uint8_t)message.values[0];
+			return true;
+	}
+
+	// acknowledge: data is ignored
+	return true;
+}
+
+
+
+// *****************************************************************************
+// X sequence reassembly
+// *****************************************************************************
+
+
+static uint8_t HCC_countBits(uint32_t value)
+{
+	uint8_t qty = 0;
+	for (; value != 0; value &= value - 1)
+		++qty;
+	return qty;
+}
+
+static void HCC_copyRegisters(HC_ClientRegisters& registers, const HC_ClientMessage& message)
+{
+	registers.qty = (message.qty < HC_CLIENT_REGISTER_MAX_QTY) ? message.qty : HC_CLIENT_REGISTER_MAX_QTY;
+	memcpy(registers.values, message.values, registers.qty * sizeof(uint32_t));
+}
+
+
+void HC_ClientSnapshot::reset()
+{
+	memset(&mWork, 0, sizeof(mWork));
+	memset(&mPublished, 0, sizeof(mPublished));
+	memset(mHasConfig, 0, sizeof(mHasConfig));
+	mIsStarted = false;
+}
+
+
+// quantities of the config (as the board: X3/X4, X5 -> XC and XD -> XH only contain enabled values)
+void HC_ClientSnapshot::updateQuantities()
+{
+	uint8_t servoQty = 0;
+	for (uint8_t i = 0; i < mWork.servosMode.qty; ++i)
+		servoQty += HCC_countBits(mWork.servosMode.values[i]);
+	mWork.servoQty = servoQty;
+
+	uint8_t adQty = 0;
+	for (uint8_t i = 0; i < mWork.adMask.qty; ++i)
+		adQty += HCC_countBits(mWork.adMask.values[i]);
+	mWork.adQty = adQty;
+
+	// PWM: output, PWM output type, PWM available, no servo (registers of the pins: as many as SM)
+	if (mHasConfig[0] && mHasConfig[1] && mHasConfig[2])
+	{
+		uint8_t pwmQty = 0;
+		for (uint8_t i = 0; i < mWork.servosMode.qty; ++i)
+			pwmQty += HCC_countBits(mWork.pinsMode.values[i] & mWork.outputTypes.values[i] &
+				mWork.pwmAvailability.values[i] & ~mWork.servosMode.values[i]);
+		mWork.pwmQty = pwmQty;
+	}
+}
+
+
+bool HC_ClientSnapshot::update(const HC_ClientMessage& message)
+{
+	// replies of the X query: no index, no address
+	if ((message.event == HC_ClientEvent_Error) || (message.control != 0))
+		return false;
+
+	bool isPublished = false;
+
+	switch (message.type)
+	{
+		// start of a sequence: the previous one is complete
+		case HC_ClientType_X0:
+			if (mIsStarted)
+			{
+				++mWork.sequence;
+				mPublished = mWork;
+				isPublished = true;
+			}
+			mIsStarted = true;
+
+			mWork.hasTimestamp = message.hasTimestamp;
+			mWork.timestamp = message.timestamp;
+			mWork.cycleTime = message.values[0];
+			break;
+
+		// config
+		case HC_ClientType_M0:	HCC_copyRegisters(mWork.sram, message);				break;
+		case HC_ClientType_DM:	HCC_copyRegisters(mWork.dacsMode, message);			break;
+
+		case HC_ClientType_PM:
+			HCC_copyRegisters(mWork.pinsMode, message);
+			mHasConfig[0] = true;
+			updateQuantities();
+			break;
+
+		case HC_ClientType_OT:
+			HCC_copyRegisters(mWork.outputTypes, message);
+			mHasConfig[1] = true;
+			updateQuantities();
+			break;
+
+		case HC_ClientType_PA:
+			HCC_copyRegisters(mWork.pwmAvailability, message);
+			mHasConfig[2] = true;
+			updateQuantities();
+			break;
+
+		case HC_ClientType_SM:
+			HCC_copyRegisters(mWork.servosMode, message);
+			updateQuantities();
+			break;
+
+		case HC_ClientType_AM:
+			HCC_copyRegisters(mWork.adMask, message);
+			updateQuantities();
+			break;
+
+		case HC_ClientType_S0:
+			if (message.stringQty > 0)
+			{
+				strncpy(mWork.string, message.strings[0], HC_CLIENT_STRING_MAX_LENGHT - 1);
+				mWork.string[HC_CLIENT_STRING_MAX_LENGHT - 1] = '\0';
+			}
+			break;
+
+		// digital values
+		case HC_ClientType_DI:	HCC_copyRegisters(mWork.di, message);	break;
+		case HC_ClientType_DO:	HCC_copyRegisters(mWork.do_, message);	break;
+		case HC_ClientType_DD:	HCC_copyRegisters(mWork.dd, message);	break;
+
+		default:
+			if (message.event == HC_ClientEvent_XValues)
+			{
+				for (uint8_t i = 0; i < message.qty; ++i)
+				{
+					if (!((message.mask >> i) & 1))
+						continue;
+
+					uint8_t v = message.first + i;
+					switch (message.set)
+					{
+						case HC_CLIENT_XSET_AI:
+							// AI quantity: from the received values (all AI are sent)
+							if (v < 16)
+							{
+								mWork.ai[v] = (uint16_t)message.values[i];
+								if (v >= mWork.aiQty)
+									mWork.aiQty = v + 1;
+							}
+							break;
+
+						case HC_CLIENT_XSET_PWM:
+							if (v < 16)
+								mWork.pwm[v] = message.values[i];
+							break;
+
+						case HC_CLIENT_XSET_SERVO:
+							if (v < 48)
+								mWork.servo[v] = message.values[i];
+							break;
+
+						case HC_CLIENT_XSET_AD:
+							if (v < 20)
+								mWork.ad[v] = message.getFloat(i);
+							break;
+					}
+				}
+			}
+			break;
+	}
+
+	return isPublished;
+}
@@ -0,0 +1,412 @@
+/*
+ * HITIComm
+ * HC_Client.h (host client)
+ *
+ * Copyright © 2021 Christophe LANDRET
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// *****************************************************************************
+// Include Guard
+// *****************************************************************************
+
+#ifndef HC_Client_h
+#define HC_Client_h
+
+
+
+// *****************************************************************************
+// Include dependencies
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stddef.h>
+
+// HITIComm: message types, errors and flags (shared with the board)
+#include "sub\HC_MessageTable.h"
+
+
+
+// *****************************************************************************
+// Define
+// *****************************************************************************
+
+// Computer side of the protocol: query encoder (HC_ClientQuery), streaming decoder
+// (HC_ClientDecoder: bytes in, decoded messages out) and X sequence reassembly
+// (HC_ClientSnapshot). No allocation: all buffers are members.
+// Does not depend on the board library: can be used by any host application.
+
+// as HITICommSupport.h (the client doesn't depend on it)
+#ifndef NULL_POINTER
+	#define NULL_POINTER 0
+#endif
+
+#define HC_CLIENT_FRAME_MAX_LENGHT		512	// received frame (bytes, decoded if binary)
+#define HC_CLIENT_QUERY_MAX_LENGHT		64	// sent frame (the board accepts 40 bytes)
+#define HC_CLIENT_VALUE_MAX_QTY			32	// values of 1 message
+#define HC_CLIENT_STRING_MAX_QTY		2	// strings of 1 message
+#define HC_CLIENT_AQUERY_MAX_QTY		32	// A query subscriptions (HC_AQUERY_MAX_QTY of the board)
+#define HC_CLIENT_REGISTER_MAX_QTY		6	// registers of 1 message (PM: 4 if Mega, M0: 6)
+#define HC_CLIENT_STRING_MAX_LENGHT		64	// S0 string kept by the snapshot
+
+// config byte of a query, control byte of a reply
+#define HC_CLIENT_CONFIG_WRITE			0x01
+#define HC_CLIENT_CONFIG_INDEX			0x02
+#define HC_CLIENT_CONFIG_ADDRESS		0x04
+#define HC_CLIENT_CONFIG_CREDIT			0x08	// HC_FLOW_CONFIG_CREDIT (set by HC_ClientQuery::setCredit())
+
+// dropped frames
+#define HC_CLIENT_DROP_CRC				0	// CRC mismatch
+#define HC_CLIENT_DROP_LENGHT			1	// frame too long, too short or truncated
+#define HC_CLIENT_DROP_FORMAT			2	// a field can't be decoded
+#define HC_CLIENT_DROP_QTY				3
+
+// sets of values of X1 -> XH
+#define HC_CLIENT_XSET_AI				0	// X1, X2
+#define HC_CLIENT_XSET_PWM				1	// X3, X4
+#define HC_CLIENT_XSET_SERVO			2	// X5 -> XC
+#define HC_CLIENT_XSET_AD				3	// XD -> XH
+
+// timestamps (HC_QUERY_TIMESTAMP)
+#define HC_CLIENT_TIMESTAMP_A			0
+#define HC_CLIENT_TIMESTAMP_X			1
+
+
+// Message Types: HC_ClientType_Bq, HC_ClientType_X0... (codes of HC_MessageTable.h)
+#define HC_CLIENT_TYPE(name, code, c0, c1, flags)	HC_ClientType_##name = code,
+#define HC_CLIENT_TYPE_GAP(code)
+
+enum HC_ClientType
+{
+	HC_MESSAGETYPE_TABLE(HC_CLIENT_TYPE, HC_CLIENT_TYPE_GAP)
+};
+
+// Message Errors: HC_ClientError_MT... (always the 1 char code, also if the board sends names)
+#define HC_CLIENT_ERROR(name, code, c0, c1)			HC_ClientError_##name = code,
+
+enum HC_ClientError
+{
+	HC_MESSAGEERROR_TABLE(HC_CLIENT_ERROR)
+};
+
+
+// Decoded messages
+enum HC_ClientEvent
+{
+	HC_ClientEvent_Reply = 0,	// acknowledge, or reply without data
+	HC_ClientEvent_Error,		// error (!): type is the error code, strings[0]: received query (if echoed)
+	HC_ClientEvent_XStart,		// X0: start of an X sequence. values[0]: cycle time (us)
+	HC_ClientEvent_XValues,		// X1 -> XH: set, first, mask, values
+	HC_ClientEvent_Registers,	// registers (1 bit per pin or value): PM, DI, DO, OT, PA, SM, DD, AM, DM
+	HC_ClientEvent_AValues,		// Aq: 1 value per subscription, in subscription order
+	HC_ClientEvent_Value,		// reply with index (read or write of 1 pin/value): values
+	HC_ClientEvent_Data			// other replies with data: M0, CT, TM, S0, Bq, Br, Fc, Ar, Ca, Cd, EE
+};
+
+
+
+// *****************************************************************************
+// Format
+// *****************************************************************************
+
+// must match the build of the board
+struct HC_ClientFormat
+{
+	uint8_t option = PROTOBF_OPTIONS_HEX;	// PROTOBF_OPTION
+	bool changeMask = false;				// HC_XQUERY_CHANGEMASK
+	bool timestamp = false;					// HC_QUERY_TIMESTAMP
+	bool multidrop = false;					// HC_MULTIDROP
+	uint8_t uintHexLength = 4;				// unsigned int of the board: 4 (AVR), 8 (SAMD)
+	uint8_t pwmHexLength = 2;				// from the PWM resolution (SAMD)
+	uint8_t dacHexLength = 3;				// from the DAC resolution (SAMD)
+	uint8_t aiHexLength = 3;				// 4 if oversampled above 12 bits (HC_sampler). Updated by the Ar replies
+
+	bool isBinary() const		{ return option == PROTOBF_OPTIONS_BINARY; }
+	bool isReadable() const		{ return option == PROTOBF_OPTIONS_FULLY_READABLE; }
+	bool usesSeparator() const	{ return option <= PROTOBF_OPTIONS_USE_SEPARATOR; }
+	bool usesInt() const		{ return option <= PROTOBF_OPTIONS_USE_INT; }
+	bool usesCRC() const		{ return option >= PROTOBF_OPTIONS_USE_SEPARATOR; }
+};
+
+
+// names and flags of the shared tables
+uint8_t HC_Client_getFlags(uint8_t type);						// HC_MESSAGE_xxx, 0 if unknown
+bool HC_Client_getName(uint8_t type, char name[3]);				// ex: "X0". false if unknown
+uint8_t HC_Client_getType(char c0, char c1);					// from a name, 0 if unknown
+bool HC_Client_getErrorName(uint8_t error, char name[3]);		// ex: "MT"
+
+// baudrates of the shared table (Br message, HC_BAUDRATE_NEGOTIATION): 1 bit per index in the masks
+uint32_t HC_Client_getBaudrate(uint8_t index);					// 0 if unknown index
+uint8_t HC_Client_getBaudrateIndex(uint32_t baudrate);			// HC_BAUDRATE_NONE if not in the table
+uint8_t HC_Client_selectBaudrate(uint16_t boardMask, uint16_t computerMask);	// highest of both, HC_BAUDRATE_NONE if none
+
+
+
+// *****************************************************************************
+// Message
+// *****************************************************************************
+
+// decoded message: valid during HC_ClientHandler::onMessage() (strings point into the frame)
+struct HC_ClientMessage
+{
+	uint8_t event;				// HC_ClientEvent_xxx
+	uint8_t type;				// HC_ClientType_xxx (HC_ClientError_xxx if error)
+	uint8_t node;				// multi-drop: address of the board
+	uint8_t control;			// HC_CLIENT_CONFIG_INDEX, HC_CLIENT_CONFIG_ADDRESS
+	uint8_t index;
+	uint16_t address;
+
+	// X0, Aq (HC_QUERY_TIMESTAMP): sampling time (us, board clock), once the absolute time is known
+	bool hasTimestamp;
+	uint32_t timestamp;
+
+	// X1 -> XH: values[i] is value (first + i) of the set, received if bit i of mask is set
+	uint8_t set;				// HC_CLIENT_XSET_xxx
+	uint8_t first;
+	uint8_t mask;
+
+	// values: numbers, registers, or float bits (isFloat())
+	uint8_t qty;
+	uint32_t values[HC_CLIENT_VALUE_MAX_QTY];
+	uint32_t floatMask;
+
+	// strings: Bq (board, processor, code name, code version), S0, received query (error)
+	uint8_t stringQty;
+	const char* strings[HC_CLIENT_STRING_MAX_QTY];
+
+	bool isFloat(uint8_t i) const	{ return (floatMask >> i) & 1; }
+	float getFloat(uint8_t i) const;
+};
+
+
+class HC_ClientHandler
+{
+	public:
+		virtual ~HC_ClientHandler() {}
+
+		virtual void onMessage(const HC_ClientMessage& message) = 0;
+		virtual void onDrop(uint8_t reason) {}	// HC_CLIENT_DROP_xxx
+};
+
+
+
+// *****************************************************************************
+// Query encoder
+// *****************************************************************************
+
+// 1 query: begin(), data fields, end(). Then getData()/getLength() are sent to the board.
+//   query.begin(HC_ClientType_Xs);                                 query.end();
+//   query.begin(HC_ClientType_DD, HC_CLIENT_CONFIG_WRITE);         query.addHex(reg, 8);  query.end();
+//   query.begin(HC_ClientType_AD, HC_CLIENT_CONFIG_WRITE | HC_CLIENT_CONFIG_INDEX, 3);  query.addFloat(1.5f);  query.end();
+// Flow control (HC_FLOW_CONTROL): credits granted to the board are added to the next query (any type).
+class HC_ClientQuery
+{
+	public:
+		HC_ClientQuery() {}
+		HC_ClientQuery(const HC_ClientFormat& format) : mFormat(format) {}
+
+		void setFormat(const HC_ClientFormat& format) { mFormat = format; }
+		void setNode(uint8_t node) { mNode = node; }	// multi-drop: destination
+		void setCredit(uint16_t credit) { mCredit = credit; mHasCredit = true; }	// flow control: next query only
+
+		// header: config (HC_CLIENT_CONFIG_xxx), index and address (if set in config)
+		void begin(uint8_t type, uint8_t config = 0, uint8_t index = 0, uint16_t address = 0);
+
+		// data
+		void addType(uint8_t type);								// ex: As
+		void addIndex(uint8_t index);							// ex: As
+		void addNumber(uint32_t value, uint8_t hexLength);		// decimal if PROTOBF_USE_INT
+		void addHex(uint32_t value, uint8_t hexLength);			// registers, bytes
+		void addFloat(float value);
+		void addString(const char* str);
+
+		// CRC, end of frame. Returns the length (0 if too long)
+		size_t end();
+
+		const uint8_t* getData() const { return mData; }
+		size_t getLength() const { return mLength; }
+		uint8_t getType() const { return mType; }
+
+	private:
+		void appendSeparator();
+		void appendByte(uint8_t b);
+		void appendDigits(uint32_t value, uint8_t base, uint8_t minLength);
+
+		HC_ClientFormat mFormat;
+		uint8_t mNode = 0;
+		uint8_t mType = 0;
+		uint16_t mCredit = 0;
+		bool mHasCredit = false;
+
+		// binary: mData[0] is reserved for COBS encoding
+		uint8_t mData[HC_CLIENT_QUERY_MAX_LENGHT];
+		size_t mLength = 0;
+		bool mOverflow = false;
+};
+
+
+
+// *****************************************************************************
+// Streaming decoder
+// *****************************************************************************
+
+// feed() takes any chunk of received bytes (partial frames are kept for the next call).
+// Each complete frame is checked (CRC), decoded, and passed to the handler.
+// Binary: X3/X4 with 1 PWM value of 0x26 can't be told from empty data ('&'): decoded as
+// a value (HC_ClientSnapshot uses the PWM quantity of the config messages).
+class HC_ClientDecoder
+{
+	public:
+		HC_ClientDecoder(HC_ClientHandler& handler) : mHandler(&handler) {}
+		HC_ClientDecoder(HC_ClientHandler& handler, const HC_ClientFormat& format) : mHandler(&handler), mFormat(format) {}
+
+		void setFormat(const HC_ClientFormat& format);
+		const HC_ClientFormat& getFormat() const { return mFormat; }
+
+		// forget the partial frame and the timestamps
+		void reset();
+
+		void feed(const uint8_t* data, size_t length);
+
+		// A replies: message types of the subscribed values, in the order of the As queries.
+		// The As reply gives the quantity accepted by the board: a refused subscription ends the
+		// As message, so only the first ones of the message are to be added.
+		bool addASubscription(uint8_t type);
+		void clearASubscriptions() { mAquery_qty = 0; }
+
+		// statistics
+		unsigned long getFrames() const { return mFrames; }
+		unsigned long getDrops(uint8_t reason) const { return mDrops[reason]; }
+
+	private:
+		void decodeFrame(size_t length);
+		void drop(uint8_t reason);
+
+		// fields
+		bool readHex(uint8_t hexLength, uint32_t& value);
+		bool readField(uint8_t field, HC_ClientMessage& message);
+		bool readFields(const uint8_t* fields, uint8_t fieldQty, HC_ClientMessage& message);
+		bool readToken(const uint8_t*& token, size_t& length);
+		bool readType(uint8_t& type, bool isError);
+		bool readString(const char*& str);
+		bool readEmptyData();
+		bool readTimestamp(uint8_t query, HC_ClientMessage& message);
+		bool readXValues(HC_ClientMessage& message);
+		bool readAValues(HC_ClientMessage& message);
+		bool readPayload(HC_ClientMessage& message);
+
+		HC_ClientHandler* mHandler;
+		HC_ClientFormat mFormat;
+
+		// frame being received (decoded if binary), +1: string terminator
+		uint8_t mFrame[HC_CLIENT_FRAME_MAX_LENGHT + 1];
+		size_t mFrame_length = 0;
+		bool mFrame_isStarted = false;
+		bool mFrame_isOverflow = false;
+
+		// binary: COBS block being decoded
+		uint8_t mCobs_code = 0;
+		uint8_t mCobs_remaining = 0;
+
+		// frame being decoded
+		uint8_t* mRead;
+		uint8_t* mRead_end;
+		HC_ClientMessage mMessage;
+
+		// A subscriptions, timestamps
+		uint8_t mAquery_types[HC_CLIENT_AQUERY_MAX_QTY];
+		uint8_t mAquery_qty = 0;
+		uint32_t mTimestamp[2] = { 0, 0 };
+		uint8_t mTimestamp_isValid = 0;
+
+		unsigned long mFrames = 0;
+		unsigned long mDrops[HC_CLIENT_DROP_QTY] = { 0 };
+};
+
+
+
+// *****************************************************************************
+// X sequence reassembly
+// *****************************************************************************
+
+struct HC_ClientRegisters
+{
+	uint8_t qty;
+	uint32_t values[HC_CLIENT_REGISTER_MAX_QTY];
+};
+
+// values of 1 complete X sequence (from 1 X0 to the next one)
+struct HC_ClientXData
+{
+	unsigned long sequence;		// complete sequences since reset()
+
+	bool hasTimestamp;
+	uint32_t timestamp;			// X0 (us, board clock)
+	uint32_t cycleTime;			// us
+
+	// config (sent on first pass, then on change)
+	HC_ClientRegisters sram;				// M0
+	HC_ClientRegisters pinsMode;			// PM: pins mode, inputs mode (and options)
+	HC_ClientRegisters servosMode;			// SM
+	HC_ClientRegisters outputTypes;			// OT
+	HC_ClientRegisters pwmAvailability;		// PA
+	HC_ClientRegisters adMask;				// AM
+	HC_ClientRegisters dacsMode;			// DM
+	char string[HC_CLIENT_STRING_MAX_LENGHT];	// S0
+
+	// digital values
+	HC_ClientRegisters di;
+	HC_ClientRegisters do_;
+	HC_ClientRegisters dd;
+
+	// values (servos, PWM, AD: in pin/index order of the enabled ones)
+	uint8_t aiQty;
+	uint16_t ai[16];
+	uint8_t pwmQty;
+	uint32_t pwm[16];
+	uint8_t servoQty;
+	uint32_t servo[48];
+	uint8_t adQty;
+	float ad[20];
+};
+
+// Messages of the X query are applied to a working copy, which is published at the next X0:
+// get() always returns a whole sequence. Values which are not sent (config, unchanged values
+// if HC_XQUERY_CHANGEMASK) are kept from the previous sequences.
+// Quantities of servos, PWM and AD are those of the config messages (SM, PM/OT/PA, AM).
+class HC_ClientSnapshot
+{
+	public:
+		HC_ClientSnapshot() { reset(); }
+
+		// when the X query is (re)started
+		void reset();
+
+		// returns true if a new sequence is published
+		bool update(const HC_ClientMessage& message);
+
+		const HC_ClientXData& get() const { return mPublished; }
+
+	private:
+		void updateQuantities();
+
+		HC_ClientXData mWork;
+		HC_ClientXData mPublished;
+		bool mIsStarted;
+		bool mHasConfig[3];		// PM, OT, PA received (PWM quantity)
+};
+
+
+#endif
@@ -0,0 +1,575 @@
+/*
+ * HITIComm
+ * HC_Record.cpp (host client)
+ *
+ * Copyright © 2021 Christophe LANDRET
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "HC_Record.h"
+
+
+
+// *****************************************************************************
+// Include dependencies
+// *****************************************************************************
+
+// POSIX
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+
+
+// *****************************************************************************
+// Define
+// *****************************************************************************
+
+#define HCR_PADDED(size)		(((size) + HC_RECORD_ALIGN - 1) & ~(uint64_t)(HC_RECORD_ALIGN - 1))
+#define HCR_RECORD_SIZE(size)	(sizeof(HC_RecordHeader) + HCR_PADDED(size))
+
+
+static uint64_t HCR_getWallTime()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL_POINTER);
+	return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static bool HCR_isRecorded(uint8_t kind)
+{
+	return (kind == HC_RECORD_KIND_REPLY) || (kind == HC_RECORD_KIND_QUERY);
+}
+
+
+
+// *****************************************************************************
+// Recorder
+// *****************************************************************************
+
+
+bool HC_Recorder::open(const char* path, const HC_ClientFormat& format, bool append)
+{
+	close();
+
+	mFormat = format;
+	mDecoder.setFormat(format);
+	mFrame_length = 0;
+	mIndex_qty = 0;
+	mIndex_last = 0;
+	mHasStartTime = false;
+	mRecords = 0;
+	mBytes = 0;
+
+	HC_RecordFileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, HC_RECORD_MAGIC, sizeof(header.magic));
+	header.headerSize = sizeof(header);
+	header.option = format.option;
+	header.changeMask = format.changeMask;
+	header.timestamp = format.timestamp;
+	header.multidrop = format.multidrop;
+	header.uintHexLength = format.uintHexLength;
+	header.pwmHexLength = format.pwmHexLength;
+	header.dacHexLength = format.dacHexLength;
+	header.startTime = HCR_getWallTime();
+
+	// append: same format. The FOOTER (or a partial last record) is removed, records after the last INDEX
+	// are indexed again
+	if (append && (access(path, F_OK) == 0))
+	{
+		HC_RecordReader reader;
+		if (!reader.open(path))
+			return false;
+
+		const HC_RecordFileHeader& existing = reader.getHeader();
+		if (memcmp(&existing, &header, offsetof(HC_RecordFileHeader, startTime)) != 0)
+		{
+			errno = EINVAL;
+			return false;
+		}
+		mStartTime = existing.startTime;
+
+		// records after the last INDEX (less than HC_RECORD_INDEX_INTERVAL)
+		uint64_t offset = 0;
+		HC_Record record;
+		while (reader.read(offset, record) && (mIndex_qty < HC_RECORD_INDEX_INTERVAL))
+		{
+			if (record.offset >= reader.getIndexEnd())
+			{
+				mIndex_types[mIndex_qty] = record.header->type;
+				mIndex_offsets[mIndex_qty++] = record.offset;
+			}
+		}
+		mIndex_last = reader.getLastIndex();
+		mOffset = reader.getSize();
+		reader.close();
+
+		if ((truncate(path, mOffset) != 0) || ((mFile = fopen(path, "ab")) == NULL_POINTER))
+			return false;
+
+		// times of the next records: from the start of the file
+		mTimeBase = header.startTime - mStartTime;
+		return true;
+	}
+
+	mFile = fopen(path, "wb");
+	if (mFile == NULL_POINTER)
+		return false;
+
+	fwrite(&header, sizeof(header), 1, mFile);
+	mOffset = sizeof(header);
+	mStartTime = header.startTime;
+	mTimeBase = 0;
+	return true;
+}
+
+
+void HC_Recorder::close()
+{
+	if (mFile == NULL_POINTER)
+		return;
+
+	// partial frame
+	if (mFrame_length > 0)
+		writeFrame(mLastTime);
+
+	// INDEX, FOOTER
+	writeIndex();
+
+	HC_RecordFooter footer;
+	footer.lastIndex = mIndex_last;
+	memcpy(footer.magic, HC_RECORD_FOOTER_MAGIC, sizeof(footer.magic));
+	writeRecord(HC_RECORD_KIND_FOOTER, 0, 0, 0, mLastTime, &footer, sizeof(footer));
+
+	fclose(mFile);
+	mFile = NULL_POINTER;
+}
+
+
+void HC_Recorder::writeRecord(uint8_t kind, uint8_t type, uint8_t flags, uint8_t node,
+	uint64_t time, const void* data, size_t size)
+{
+	static const uint8_t padding[HC_RECORD_ALIGN] = { 0 };
+
+	HC_RecordHeader header;
+	header.size = (uint32_t)size;
+	header.kind = kind;
+	header.type = type;
+	header.flags = flags;
+	header.node = node;
+	header.time = time;
+
+	fwrite(&header, sizeof(header), 1, mFile);
+	fwrite(data, 1, size, mFile);
+	fwrite(padding, 1, HCR_PADDED(size) - size, mFile);
+
+	if (HCR_isRecorded(kind))
+	{
+		mIndex_types[mIndex_qty] = type;
+		mIndex_offsets[mIndex_qty++] = mOffset;
+
+		++mRecords;
+		mBytes += size;
+	}
+	mOffset += HCR_RECORD_SIZE(size);
+
+	if (mIndex_qty == HC_RECORD_INDEX_INTERVAL)
+		writeIndex();
+}
+
+
+// offsets grouped by type (counting sort), then flushed: a crash only loses the records after it
+void HC_Recorder::writeIndex()
+{
+	if (mIndex_qty == 0)
+		return;
+
+	uint32_t counts[256] = { 0 };
+	for (uint32_t i = 0; i < mIndex_qty; ++i)
+		++counts[mIndex_types[i]];
+
+	HC_RecordIndexHeader indexHeader;
+	indexHeader.previous = mIndex_last;
+	indexHeader.recordQty = mIndex_qty;
+	indexHeader.typeQty = 0;
+
+	HC_RecordIndexType types[256];
+	uint32_t first[256];
+	uint32_t position = 0;
+	for (unsigned int type = 0; type < 256; ++type)
+	{
+		if (counts[type] == 0)
+			continue;
+
+		HC_RecordIndexType& entry = types[indexHeader.typeQty++];
+		memset(&entry, 0, sizeof(entry));
+		entry.type = type;
+		entry.first = position;
+		entry.qty = counts[type];
+		first[type] = position;
+		position += counts[type];
+	}
+
+	static uint64_t offsets[HC_RECORD_INDEX_INTERVAL];
+	for (uint32_t i = 0; i < mIndex_qty; ++i)
+		offsets[first[mIndex_types[i]]++] = mIndex_offsets[i];
+
+	// 1 record (data written in parts)
+	size_t size = sizeof(indexHeader) + indexHeader.typeQty * sizeof(HC_RecordIndexType) + mIndex_qty * sizeof(uint64_t);
+
+	HC_RecordHeader header;
+	memset(&header, 0, sizeof(header));
+	header.size = (uint32_t)size;
+	header.kind = HC_RECORD_KIND_INDEX;
+	header.time = mLastTime;
+
+	fwrite(&header, sizeof(header), 1, mFile);
+	fwrite(&indexHeader, sizeof(indexHeader), 1, mFile);
+	fwrite(types, sizeof(HC_RecordIndexType), indexHeader.typeQty, mFile);
+	fwrite(offsets, sizeof(uint64_t), mIndex_qty, mFile);
+
+	mIndex_last = mOffset;
+	mOffset += HCR_RECORD_SIZE(size);
+	mIndex_qty = 0;
+
+	fflush(mFile);
+}
+
+
+// us since the start of the recording
+uint64_t HC_Recorder::getRecordTime(uint64_t time)
+{
+	if (!mHasStartTime)
+	{
+		mFirstTime = time;
+		mHasStartTime = true;
+	}
+	mLastTime = mTimeBase + (time - mFirstTime);
+	return mLastTime;
+}
+
+
+// -----------------------------------------------------------------------------
+// Board -> computer -----------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+void HC_Recorder::feed(const uint8_t* data, size_t length, uint64_t time)
+{
+	if (mFile == NULL_POINTER)
+		return;
+
+	uint8_t delimiter = mFormat.isBinary() ? 0x00 : '\n';
+	uint64_t recordTime = getRecordTime(time);
+
+	while (length > 0)
+	{
+		// up to the end of frame (included)
+		const uint8_t* end = (const uint8_t*)memchr(data, delimiter, length);
+		size_t chunk = (end != NULL_POINTER) ? (end - data) + 1 : length;
+
+		// too long: recorded in parts (not decoded)
+		if (mFrame_length + chunk > HC_RECORD_FRAME_MAX_LENGHT)
+		{
+			chunk = HC_RECORD_FRAME_MAX_LENGHT - mFrame_length;
+			end = NULL_POINTER;
+		}
+
+		memcpy(&mFrame[mFrame_length], data, chunk);
+		mFrame_length += chunk;
+		data += chunk;
+		length -= chunk;
+
+		if ((end != NULL_POINTER) || (mFrame_length == HC_RECORD_FRAME_MAX_LENGHT))
+			writeFrame(recordTime);
+	}
+}
+
+
+// 1 frame: decoded, then recorded
+void HC_Recorder::writeFrame(uint64_t time)
+{
+	mFrame_type = 0;
+	mFrame_flags = HC_RECORD_FLAG_DROPPED;
+	mFrame_node = 0;
+
+	mDecoder.feed(mFrame, mFrame_length);
+
+	writeRecord(HC_RECORD_KIND_REPLY, mFrame_type, mFrame_flags, mFrame_node, time, mFrame, mFrame_length);
+	mFrame_length = 0;
+}
+
+
+void HC_Recorder::onMessage(const HC_ClientMessage& message)
+{
+	mFrame_type = message.type;
+	mFrame_flags = (message.event == HC_ClientEvent_Error) ? HC_RECORD_FLAG_ERROR : 0;
+	mFrame_node = message.node;
+
+	if (mHandler != NULL_POINTER)
+		mHandler->onMessage(message);
+}
+
+
+void HC_Recorder::onDrop(uint8_t reason)
+{
+	if (mHandler != NULL_POINTER)
+		mHandler->onDrop(reason);
+}
+
+
+// -----------------------------------------------------------------------------
+// Computer -> board -----------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+void HC_Recorder::writeQuery(const uint8_t* data, size_t length, uint64_t time, uint8_t type, uint8_t node)
+{
+	if (mFile != NULL_POINTER)
+		writeRecord(HC_RECORD_KIND_QUERY, type, 0, node, getRecordTime(time), data, length);
+}
+
+
+void HC_Recorder::writeQuery(const HC_ClientQuery& query, uint64_t time, uint8_t node)
+{
+	writeQuery(query.getData(), query.getLength(), time, query.getType(), node);
+}
+
+
+
+// *****************************************************************************
+// Reader
+// *****************************************************************************
+
+
+bool HC_RecordReader::open(const char* path)
+{
+	close();
+
+	mFd = ::open(path, O_RDONLY);
+	if (mFd < 0)
+		return false;
+
+	struct stat st;
+	if ((fstat(mFd, &st) != 0) || ((uint64_t)st.st_size < sizeof(HC_RecordFileHeader)))
+	{
+		close();
+		errno = EINVAL;
+		return false;
+	}
+
+	void* map = mmap(NULL_POINTER, st.st_size, PROT_READ, MAP_SHARED, mFd, 0);
+	if (map == MAP_FAILED)
+	{
+		close();
+		return false;
+	}
+	mMap = (const uint8_t*)map;
+	mMapSize = st.st_size;
+	mSize = st.st_size;
+
+	mHeader = (const HC_RecordFileHeader*)mMap;
+	if ((memcmp(mHeader->magic, HC_RECORD_MAGIC, sizeof(mHeader->magic)) != 0) ||
+		(mHeader->headerSize != sizeof(HC_RecordFileHeader)))
+	{
+		close();
+		errno = EINVAL;
+		return false;
+	}
+
+	// closed file: last record is a FOOTER
+	const uint64_t footerSize = HCR_RECORD_SIZE(sizeof(HC_RecordFooter));
+	bool isClosed = false;
+	if (mSize >= sizeof(HC_RecordFileHeader) + footerSize)
+	{
+		const HC_RecordHeader* header = (const HC_RecordHeader*)(mMap + mSize - footerSize);
+		const HC_RecordFooter* footer = (const HC_RecordFooter*)(header + 1);
+		isClosed = (header->kind == HC_RECORD_KIND_FOOTER) && (header->size == sizeof(HC_RecordFooter)) &&
+			(memcmp(footer->magic, HC_RECORD_FOOTER_MAGIC, sizeof(footer->magic)) == 0);
+
+		if (isClosed)
+		{
+			mSize -= footerSize;
+			mIndex_last = footer->lastIndex;
+		}
+	}
+
+	if (isClosed)
+	{
+		// INDEX chain, from the last one
+		for (uint64_t offset = mIndex_last; offset != 0; ++mIndex_qty)
+		{
+			HC_Record record;
+			if (!readAt(offset, record) || (record.header->kind != HC_RECORD_KIND_INDEX))
+				break;
+			offset = ((const HC_RecordIndexHeader*)record.data)->previous;
+		}
+
+		mIndex = (uint64_t*)malloc((mIndex_qty + 1) * sizeof(uint64_t));
+		uint32_t i = mIndex_qty;
+		for (uint64_t offset = mIndex_last; (offset != 0) && (i > 0); )
+		{
+			HC_Record record;
+			if (!readAt(offset, record))
+				break;
+			mIndex[--i] = offset;
+			offset = ((const HC_RecordIndexHeader*)record.data)->previous;
+		}
+	}
+	else
+	{
+		// not closed (crash): complete records, INDEX found by scanning
+		uint64_t offset = sizeof(HC_RecordFileHeader);
+		uint32_t capacity = 0;
+		HC_Record record;
+
+		while (readAt(offset, record))
+		{
+			if (record.header->kind == HC_RECORD_KIND_INDEX)
+			{
+				if (mIndex_qty == capacity)
+				{
+					capacity = (capacity == 0) ? 64 : 2 * capacity;
+					mIndex = (uint64_t*)realloc(mIndex, capacity * sizeof(uint64_t));
+				}
+				mIndex[mIndex_qty++] = offset;
+				mIndex_last = offset;
+			}
+			offset += HCR_RECORD_SIZE(record.header->size);
+		}
+		mSize = offset;
+	}
+
+	// first record after the last INDEX
+	HC_Record record;
+	mIndex_end = ((mIndex_qty > 0) && readAt(mIndex_last, record)) ?
+		mIndex_last + HCR_RECORD_SIZE(record.header->size) : sizeof(HC_RecordFileHeader);
+	if (mIndex_qty == 0)
+		mIndex_last = 0;
+
+	return true;
+}
+
+
+void HC_RecordReader::close()
+{
+	if (mMap != NULL_POINTER)
+		munmap((void*)mMap, mMapSize);
+	if (mFd >= 0)
+		::close(mFd);
+	free(mIndex);
+
+	mFd = -1;
+	mMap = NULL_POINTER;
+	mMapSize = 0;
+	mSize = 0;
+	mHeader = NULL_POINTER;
+	mIndex = NULL_POINTER;
+	mIndex_qty = 0;
+	mIndex_last = 0;
+	mIndex_end = 0;
+}
+
+
+HC_ClientFormat HC_RecordReader::getFormat() const
+{
+	HC_ClientFormat format;
+	format.option = mHeader->option;
+	format.changeMask = mHeader->changeMask;
+	format.timestamp = mHeader->timestamp;
+	format.multidrop = mHeader->multidrop;
+	format.uintHexLength = mHeader->uintHexLength;
+	format.pwmHexLength = mHeader->pwmHexLength;
+	format.dacHexLength = mHeader->dacHexLength;
+	return format;
+}
+
+
+// complete record at offset
+bool HC_RecordReader::readAt(uint64_t offset, HC_Record& record) const
+{
+	if ((offset < sizeof(HC_RecordFileHeader)) || (offset + sizeof(HC_RecordHeader) > mSize))
+		return false;
+
+	const HC_RecordHeader* header = (const HC_RecordHeader*)(mMap + offset);
+	if (offset + HCR_RECORD_SIZE(header->size) > mSize)
+		return false;
+
+	record.offset = offset;
+	record.header = header;
+	record.data = (const uint8_t*)(header + 1);
+	return true;
+}
+
+
+bool HC_RecordReader::read(uint64_t& offset, HC_Record& record) const
+{
+	if (offset == 0)
+		offset = sizeof(HC_RecordFileHeader);
+
+	while (readAt(offset, record))
+	{
+		offset += HCR_RECORD_SIZE(record.header->size);
+		if (HCR_isRecorded(record.header->kind))
+			return true;
+	}
+	return false;
+}
+
+
+bool HC_RecordReader::readType(HC_RecordCursor& cursor, uint8_t type, HC_Record& record) const
+{
+	// indexed records
+	while (cursor.index < mIndex_qty)
+	{
+		HC_Record index;
+		if (readAt(mIndex[cursor.index], index))
+		{
+			const HC_RecordIndexHeader* indexHeader = (const HC_RecordIndexHeader*)index.data;
+			const HC_RecordIndexType* types = (const HC_RecordIndexType*)(indexHeader + 1);
+			const uint64_t* offsets = (const uint64_t*)(types + indexHeader->typeQty);
+
+			for (uint32_t i = 0; i < indexHeader->typeQty; ++i)
+			{
+				if (types[i].type != type)
+					continue;
+
+				if ((cursor.position < types[i].qty) && readAt(offsets[types[i].first + cursor.position], record))
+				{
+					++cursor.position;
+					return true;
+				}
+				break;
+			}
+		}
+
+		++cursor.index;
+		cursor.position = 0;
+	}
+
+	// records after the last INDEX
+	if (cursor.offset < mIndex_end)
+		cursor.offset = mIndex_end;
+
+	while (read(cursor.offset, record))
+		if (record.header->type == type)
+			return true;
+
+	return false;
+}
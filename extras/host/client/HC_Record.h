@@ -0,0 +1,268 @@
+/*
+ * HITIComm
+ * HC_Record.h (host client)
+ *
+ * Copyright © 2021 Christophe LANDRET
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// *****************************************************************************
+// Include Guard
+// *****************************************************************************
+
+#ifndef HC_Record_h
+#define HC_Record_h
+
+
+
+// *****************************************************************************
+// Include dependencies
+// *****************************************************************************
+
+#include "HC_Client.h"
+
+#include <stdio.h>
+
+
+
+// *****************************************************************************
+// Define
+// *****************************************************************************
+
+// Recording of a session (.hcr file): frames as they were on the line, with their time, direction
+// and Message Type. Append-only, memory-mappable (little-endian, every structure aligned on 8 bytes).
+//
+//   file header		HC_RecordFileHeader
+//   records			HC_RecordHeader + data (padded to 8 bytes), in time order:
+//     REPLY			board -> computer: 1 frame (bytes between frames included: the byte stream is kept)
+//     QUERY			computer -> board: 1 frame
+//     INDEX			offsets of the records since the previous INDEX, grouped by Message Type
+//     FOOTER			offset of the last INDEX (last record of a closed file)
+//
+// A file which was not closed (crash) stays readable: records after the last INDEX are scanned.
+// Appending to a file removes its FOOTER.
+
+#define HC_RECORD_MAGIC				"HCREC001"
+#define HC_RECORD_FOOTER_MAGIC		"HCRFOOT1"
+#define HC_RECORD_ALIGN				8
+
+// record kinds
+#define HC_RECORD_KIND_REPLY		0
+#define HC_RECORD_KIND_QUERY		1
+#define HC_RECORD_KIND_INDEX		2
+#define HC_RECORD_KIND_FOOTER		3
+
+// record flags
+#define HC_RECORD_FLAG_ERROR		0x01	// error message (!): type is the error code
+#define HC_RECORD_FLAG_DROPPED		0x02	// not decoded (CRC, format, too long): type is 0
+
+// records per INDEX
+#define HC_RECORD_INDEX_INTERVAL	1024
+
+// frame being recorded (raw bytes: COBS overhead and bytes between frames included)
+#define HC_RECORD_FRAME_MAX_LENGHT	(2 * HC_CLIENT_FRAME_MAX_LENGHT)
+
+
+// file header (32 bytes)
+struct HC_RecordFileHeader
+{
+	char magic[8];					// HC_RECORD_MAGIC
+	uint32_t headerSize;			// sizeof(HC_RecordFileHeader)
+	uint8_t option;					// HC_ClientFormat
+	uint8_t changeMask;
+	uint8_t timestamp;
+	uint8_t multidrop;
+	uint8_t uintHexLength;
+	uint8_t pwmHexLength;
+	uint8_t dacHexLength;
+	uint8_t reserved;
+	uint64_t startTime;				// start of the recording (us since the epoch)
+};
+
+// record header (16 bytes)
+struct HC_RecordHeader
+{
+	uint32_t size;					// data (bytes), without padding
+	uint8_t kind;					// HC_RECORD_KIND_xxx
+	uint8_t type;					// HC_ClientType_xxx (HC_ClientError_xxx if error), 0 if unknown
+	uint8_t flags;					// HC_RECORD_FLAG_xxx
+	uint8_t node;					// multi-drop: address of the board
+	uint64_t time;					// us since startTime
+};
+
+// INDEX data: header, HC_RecordIndexType[typeQty], then the offsets (uint64_t[recordQty]) grouped by type
+struct HC_RecordIndexHeader
+{
+	uint64_t previous;				// offset of the previous INDEX, 0 if none
+	uint32_t recordQty;
+	uint32_t typeQty;
+};
+
+struct HC_RecordIndexType
+{
+	uint8_t type;
+	uint8_t reserved[3];
+	uint32_t first;					// first offset of this type (position in the offsets)
+	uint32_t qty;
+	uint32_t reserved2;
+};
+
+// FOOTER data
+struct HC_RecordFooter
+{
+	uint64_t lastIndex;				// offset of the last INDEX
+	char magic[8];					// HC_RECORD_FOOTER_MAGIC
+};
+
+
+
+// *****************************************************************************
+// Recorder
+// *****************************************************************************
+
+// Received bytes (feed()) are split into frames, each frame is decoded (Message Type, errors,
+// dropped frames) and written as 1 REPLY record. Sent queries are written as QUERY records.
+// Decoded messages are passed to the handler (if any), as with a HC_ClientDecoder.
+// Times are given by the caller (us, any monotonic clock: only differences are used).
+class HC_Recorder : private HC_ClientHandler
+{
+	public:
+		HC_Recorder() : mDecoder(*this) {}
+		~HC_Recorder() { close(); }
+
+		// creates the file (or appends to it, same format required). Returns false on error (errno)
+		bool open(const char* path, const HC_ClientFormat& format, bool append = false);
+		void close();
+		bool isOpen() const { return mFile != NULL_POINTER; }
+
+		void setHandler(HC_ClientHandler* handler) { mHandler = handler; }
+
+		// board -> computer: any chunk of received bytes
+		void feed(const uint8_t* data, size_t length, uint64_t time);
+
+		// computer -> board
+		void writeQuery(const uint8_t* data, size_t length, uint64_t time, uint8_t type = 0, uint8_t node = 0);
+		void writeQuery(const HC_ClientQuery& query, uint64_t time, uint8_t node = 0);
+
+		// statistics
+		unsigned long getRecords() const { return mRecords; }
+		unsigned long long getBytes() const { return mBytes; }
+		const HC_ClientDecoder& getDecoder() const { return mDecoder; }
+
+	private:
+		void onMessage(const HC_ClientMessage& message);
+		void onDrop(uint8_t reason);
+
+		uint64_t getRecordTime(uint64_t time);
+		void writeFrame(uint64_t time);
+		void writeRecord(uint8_t kind, uint8_t type, uint8_t flags, uint8_t node,
+			uint64_t time, const void* data, size_t size);
+		void writeIndex();
+
+		FILE* mFile = NULL_POINTER;
+		HC_ClientFormat mFormat;
+		uint64_t mOffset = 0;
+		uint64_t mStartTime = 0;		// of the file (us since the epoch)
+		uint64_t mTimeBase = 0;			// this recording, from mStartTime
+		uint64_t mFirstTime = 0;		// times of the caller
+		uint64_t mLastTime = 0;
+		bool mHasStartTime = false;
+
+		// frame being received (raw), and its decoding
+		HC_ClientDecoder mDecoder;
+		HC_ClientHandler* mHandler = NULL_POINTER;
+		uint8_t mFrame[HC_RECORD_FRAME_MAX_LENGHT];
+		size_t mFrame_length = 0;
+		uint8_t mFrame_type;
+		uint8_t mFrame_flags;
+		uint8_t mFrame_node;
+
+		// records since the last INDEX
+		uint8_t mIndex_types[HC_RECORD_INDEX_INTERVAL];
+		uint64_t mIndex_offsets[HC_RECORD_INDEX_INTERVAL];
+		uint32_t mIndex_qty = 0;
+		uint64_t mIndex_last = 0;
+
+		unsigned long mRecords = 0;
+		unsigned long long mBytes = 0;
+};
+
+
+
+// *****************************************************************************
+// Reader
+// *****************************************************************************
+
+// 1 record of a mapped file (data points into the mapping)
+struct HC_Record
+{
+	uint64_t offset;
+	const HC_RecordHeader* header;
+	const uint8_t* data;
+};
+
+// position of a reading by Message Type (HC_RecordReader::readType())
+struct HC_RecordCursor
+{
+	uint32_t index = 0;				// INDEX being read
+	uint32_t position = 0;			// next offset in the INDEX
+	uint64_t offset = 0;			// next record (not indexed records)
+};
+
+// The file is mapped (read-only): records are read in place, without copy.
+class HC_RecordReader
+{
+	public:
+		~HC_RecordReader() { close(); }
+
+		// returns false on error (errno), or if it's not a recording
+		bool open(const char* path);
+		void close();
+
+		const HC_RecordFileHeader& getHeader() const { return *mHeader; }
+		HC_ClientFormat getFormat() const;
+
+		// all REPLY and QUERY records, in time order. offset: 0 = first record. false at the end
+		bool read(uint64_t& offset, HC_Record& record) const;
+
+		// records of 1 type (REPLY or QUERY), in time order: through the INDEX records, then scan of
+		// the records which are not indexed yet
+		bool readType(HC_RecordCursor& cursor, uint8_t type, HC_Record& record) const;
+
+		// INDEX records found (0 if none)
+		uint32_t getIndexQty() const { return mIndex_qty; }
+		uint64_t getLastIndex() const { return mIndex_last; }
+		uint64_t getIndexEnd() const { return mIndex_end; }
+		// end of the complete records (FOOTER excluded)
+		uint64_t getSize() const { return mSize; }
+
+	private:
+		bool readAt(uint64_t offset, HC_Record& record) const;
+
+		int mFd = -1;
+		const uint8_t* mMap = NULL_POINTER;
+		uint64_t mMapSize = 0;
+		uint64_t mSize = 0;
+		const HC_RecordFileHeader* mHeader = NULL_POINTER;
+
+		// offsets of the INDEX records, in file order
+		uint64_t* mIndex = NULL_POINTER;
+		uint32_t mIndex_qty = 0;
+		uint64_t mIndex_last = 0;
+		uint64_t mIndex_end = 0;	// first record after the last INDEX
+};
+
+
+#endif
@@ -0,0 +1,222 @@
+/*
+ * HITIComm
+ * FlowControl.cpp (host test)
+ *
+ * Copyright © 2021 Christophe LANDRET
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Flow control (HC_FLOW_CONTROL): the replies of the X query never exceed the granted credits,
+// and credits left (Fc) + credits spent = credits granted, on a fast or a slow (deferred replies) line.
+// B replies are sent without credit.
+
+#include "HCT_Test.h"
+
+#ifndef HC_FLOW_CONTROL
+	#error "build with -DHC_FLOW_CONTROL (make test)"
+#endif
+
+
+
+// *****************************************************************************
+// Computer side
+// *****************************************************************************
+
+// counts the replies, keeps the last Fc reply
+class HCT_FlowHandler : public HC_ClientHandler
+{
+	public:
+		void onMessage(const HC_ClientMessage& message)
+		{
+			if (message.event == HC_ClientEvent_Error)
+				++errors;
+			else if (message.type == HC_ClientType_Bq)
+				++bReplies;
+			else if (message.type == HC_ClientType_Fc)
+			{
+				if (message.qty == 3)
+				{
+					unit = message.values[0];
+					credit = message.values[1];
+					pausedCycles = message.values[2];
+				}
+			}
+			// frames of the X sequence: X0, registers, M0, X values
+			else if ((message.event == HC_ClientEvent_XStart) || (message.event == HC_ClientEvent_XValues) ||
+				(message.event == HC_ClientEvent_Registers) || (message.type == HC_ClientType_M0))
+				++xReplies;
+		}
+
+		void onDrop(uint8_t reason) { ++drops; }
+
+		unsigned long xReplies = 0;
+		unsigned long bReplies = 0;
+		unsigned long errors = 0;
+		unsigned long drops = 0;
+		uint32_t unit = 0xFF;
+		uint32_t credit = 0;
+		uint32_t pausedCycles = 0;
+};
+
+static HC_ClientQuery g_query(HCT_format());
+
+
+// Fc (write): unit and initial credits
+static void HCT_startFlowControl(uint8_t unit, unsigned long credit, HC_ClientDecoder& decoder)
+{
+	g_query.begin(HC_ClientType_Fc, HC_CLIENT_CONFIG_WRITE);
+	g_query.addNumber(unit, 1);
+	g_query.addNumber(credit, 8);
+	HCT_send(g_query);
+	HCT_run(2000, &decoder);
+}
+
+
+// Fc (read): credits left. Credits can be added to the query
+// (2000 cycles: the reply is received at 9600 baud)
+static void HCT_readFlowControl(HC_ClientDecoder& decoder, long credit = -1)
+{
+	if (credit >= 0)
+		g_query.setCredit((uint16_t)credit);
+	g_query.begin(HC_ClientType_Fc);
+	HCT_send(g_query);
+	HCT_run(2000, &decoder);
+}
+
+
+
+// *****************************************************************************
+// Tests
+// *****************************************************************************
+
+// frames: exactly 1 frame of the X sequence per credit, then paused. Piggy-backed credits resume the replies
+static void HCT_testFrames(unsigned long baudrate)
+{
+	HC_begin();
+	Serial.begin(baudrate);
+	HCT_run(10);
+
+	HCT_FlowHandler handler;
+	HC_ClientDecoder decoder(handler, HCT_format());
+
+	HCT_startFlowControl(HC_FLOW_UNIT_FRAMES, 20, decoder);
+
+	// query while the X replies are sent: its reply doesn't use credits
+	g_query.begin(HC_ClientType_Xs);
+	HCT_send(g_query);
+	HCT_run(5, &decoder);
+	HCT_readFlowControl(decoder);
+	HCT_run(40000, &decoder);
+	CHECK(handler.xReplies == 20);
+
+	HCT_readFlowControl(decoder);
+	CHECK(handler.unit == HC_FLOW_UNIT_FRAMES);
+	CHECK(handler.credit == 0);
+	CHECK(handler.pausedCycles > 0);
+
+	// credits added to a query
+	HCT_readFlowControl(decoder, 7);
+	HCT_run(40000, &decoder);
+	CHECK(handler.xReplies == 27);
+
+	HCT_readFlowControl(decoder);
+	CHECK(handler.credit == 0);
+
+	CHECK(handler.errors == 0);
+	CHECK(handler.drops == 0);
+}
+
+
+// bytes: replies stop before the credits are exceeded, credits left + bytes received = credits granted
+static void HCT_testBytes(unsigned long baudrate)
+{
+	HC_begin();
+	Serial.begin(baudrate);
+	HCT_run(10);
+
+	HCT_FlowHandler handler;
+	HC_ClientDecoder decoder(handler, HCT_format());
+
+	HCT_startFlowControl(HC_FLOW_UNIT_BYTES, 0, decoder);
+
+	// no credit: acknowledge of Xs only (not paced)
+	g_query.begin(HC_ClientType_Xs);
+	HCT_send(g_query);
+	size_t ackBytes = HCT_run(2000, &decoder);
+	CHECK(handler.xReplies == 0);
+
+	// credits added to Xs: acknowledge, then X replies
+	const unsigned long granted = 2000;
+	g_query.setCredit(granted);
+	g_query.begin(HC_ClientType_Xs);
+	HCT_send(g_query);
+	size_t bytes = HCT_run(40000, &decoder) - ackBytes;
+	CHECK(handler.xReplies > 0);
+	CHECK(bytes <= granted);
+
+	HCT_readFlowControl(decoder);
+	CHECK(handler.unit == HC_FLOW_UNIT_BYTES);
+	CHECK(handler.credit + bytes == granted);
+	CHECK(handler.credit < HC_OUTPUTFRAME_MAX_ARRAY_LENGHT);
+	CHECK(handler.pausedCycles > 0);
+
+	CHECK(handler.errors == 0);
+	CHECK(handler.drops == 0);
+}
+
+
+// no credit: B replies are still sent, X replies are not
+static void HCT_testBQuery()
+{
+	HC_begin();
+	Serial.begin(115200);
+	HCT_run(10);
+
+	HCT_FlowHandler handler;
+	HC_ClientDecoder decoder(handler, HCT_format());
+
+	HCT_startFlowControl(HC_FLOW_UNIT_FRAMES, 0, decoder);
+
+	g_query.begin(HC_ClientType_Xs);
+	HCT_send(g_query);
+	HCT_run(1000, &decoder);
+	CHECK(handler.xReplies == 0);
+
+	g_query.begin(HC_ClientType_Bf);
+	HCT_send(g_query);
+	HCT_run(1000, &decoder);
+	CHECK(handler.bReplies == 5);
+	CHECK(handler.xReplies == 0);
+
+	HCT_readFlowControl(decoder);
+	CHECK(handler.credit == 0);
+}
+
+
+
+// *****************************************************************************
+// Main
+// *****************************************************************************
+
+int main()
+{
+	// fast line, and slow line (replies deferred: TX buffer full)
+	HCT_fork([] { HCT_testFrames(1000000); });
+	HCT_fork([] { HCT_testFrames(9600); });
+	HCT_fork([] { HCT_testBytes(1000000); });
+	HCT_fork([] { HCT_testBytes(9600); });
+	HCT_fork([] { HCT_testBQuery(); });
+
+	return HCT_result("FlowControl");
+}
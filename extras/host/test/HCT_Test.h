@@ -0,0 +1,182 @@
+/*
+ * HITIComm
+ * HCT_Test.h (host build)
+ *
+ * Copyright © 2021 Christophe LANDRET
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HCT_Test_h
+#define HCT_Test_h
+
+
+
+// *****************************************************************************
+// Include dependencies
+// *****************************************************************************
+
+// HITIComm
+#include <HITIComm.h>
+
+// HITIComm client (computer side)
+#include "HC_Client.h"
+
+// POSIX
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+
+
+// *****************************************************************************
+// Checks
+// *****************************************************************************
+
+// Host tests (see "make test"): 1 program per test file, built for each configuration of the
+// test in the Makefile. The board runs on the virtual clock: results are deterministic.
+// A failed check is printed (file, line, expression), then the test goes on.
+// HCT_fork() runs a test from a board reset.
+// HCT_result() ends main(): prints the test result, returns the exit code (1 if a check failed).
+
+static unsigned long g_hct_checks = 0;
+static unsigned long g_hct_failures = 0;
+
+#define CHECK(condition) \
+	do \
+	{ \
+		++g_hct_checks; \
+		if (!(condition)) \
+		{ \
+			++g_hct_failures; \
+			printf("  %s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+		} \
+	} while (0)
+
+// each test runs in a child process: the board starts from reset. Checks of the child are added
+template <typename F> static void HCT_fork(F test)
+{
+	fflush(stdout);
+
+	int pipeFd[2];
+	if (pipe(pipeFd) != 0)
+		return;
+
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		close(pipeFd[0]);
+		test();
+		fflush(stdout);
+		unsigned long counts[2] = { g_hct_checks, g_hct_failures };
+		ssize_t written = write(pipeFd[1], counts, sizeof(counts));
+		_exit((written == sizeof(counts)) ? 0 : 1);
+	}
+
+	close(pipeFd[1]);
+	unsigned long counts[2] = { 0, 0 };
+	ssize_t length = read(pipeFd[0], counts, sizeof(counts));
+	close(pipeFd[0]);
+
+	int status;
+	waitpid(pid, &status, 0);
+	if ((length != sizeof(counts)) || !WIFEXITED(status) || (WEXITSTATUS(status) != 0))
+	{
+		printf("  test crashed (status %d)\n", status);
+		++g_hct_failures;
+		return;
+	}
+	g_hct_checks = counts[0];
+	g_hct_failures = counts[1];
+}
+
+// simulated board
+#ifdef HCS_HOST_UNO
+	#define HCT_BOARD	"Uno"
+#else
+	#define HCT_BOARD	"Mega"
+#endif
+
+static int HCT_result(const char* name)
+{
+	printf("%-20s %-4s option %d: %lu checks, %s\n", name, HCT_BOARD, PROTOBF_OPTION, g_hct_checks,
+		(g_hct_failures == 0) ? "passed" : "FAILED");
+	return (g_hct_failures == 0) ? 0 : 1;
+}
+
+
+
+// *****************************************************************************
+// Board and computer
+// *****************************************************************************
+
+// virtual time of 1 cycle of loop() (us)
+#define HCT_CYCLE_TIME	100
+
+// format of the build
+static HC_ClientFormat HCT_format()
+{
+	HC_ClientFormat format;
+	format.option = PROTOBF_OPTION;
+	#ifdef HC_XQUERY_CHANGEMASK
+		format.changeMask = true;
+	#endif
+	#ifdef HC_QUERY_TIMESTAMP
+		format.timestamp = true;
+	#endif
+	#ifdef HC_MULTIDROP
+		format.multidrop = true;
+	#endif
+	return format;
+}
+
+
+// CRC, end of frame, then sent to the board
+static void HCT_send(HC_ClientQuery& query)
+{
+	size_t length = query.end();
+	HCS_Host_send(Serial, query.getData(), length);
+}
+
+
+// 1 cycle of loop(). Output of the board is fed to decoder (if any). Returns the received bytes
+static size_t HCT_cycle(HC_ClientDecoder* decoder = NULL_POINTER)
+{
+	HC_communicate();
+	HCS_Host_advance(HCT_CYCLE_TIME);
+
+	uint8_t buffer[1024];
+	size_t total = 0;
+	size_t n;
+	while ((n = HCS_Host_receive(Serial, buffer, sizeof(buffer))) != 0)
+	{
+		total += n;
+		if (decoder != NULL_POINTER)
+			decoder->feed(buffer, n);
+	}
+	return total;
+}
+
+
+// several cycles. Returns the received bytes
+static size_t HCT_run(unsigned long cycles, HC_ClientDecoder* decoder = NULL_POINTER)
+{
+	size_t total = 0;
+	for (unsigned long i = 0; i < cycles; ++i)
+		total += HCT_cycle(decoder);
+	return total;
+}
+
+
+#endif
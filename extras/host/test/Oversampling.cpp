@@ -0,0 +1,251 @@
+/*
+ * HITIComm
+ * Oversampling.cpp (host test)
+ *
+ * Copyright © 2021 Christophe LANDRET
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Oversampling of the background AI sampler (HC_SAMPLER_TRY_COMPILE): results decimated to 10 + n bits
+// (12 and 14 bits), and AI values of the X and A replies decoded by the client after the AI hex length
+// has been changed (Ar).
+
+#include "HCT_Test.h"
+
+#ifndef HC_SAMPLER_COMPILE
+	#error "build with -DHC_SAMPLER_TRY_COMPILE (make test)"
+#endif
+
+
+
+// *****************************************************************************
+// Simulated AI
+// *****************************************************************************
+
+// each AI: base value, + 1 every 4 conversions of the AI. Sum of 4^n conversions (n >= 1): 4^n x base + 4^(n-1)
+#define HCT_AI_QTY	3
+static const int g_base[HCT_AI_QTY] = { 300, 500, 700 };
+static unsigned long g_conversions[HCT_AI_QTY];
+
+static int HCT_readAI(uint8_t index)
+{
+	if (index >= HCT_AI_QTY)
+		return 0;
+	return g_base[index] + (((g_conversions[index]++ & 3) == 3) ? 1 : 0);
+}
+
+// result of n oversampling: (4^n x base + 4^(n-1)) >> n
+static unsigned int HCT_decimated(uint8_t index, uint8_t n)
+{
+	return (unsigned int)(((1UL << (2 * n)) * g_base[index] + (1UL << (2 * (n - 1)))) >> n);
+}
+
+
+static void HCT_startBoard()
+{
+	HCS_Host_setAIReader(HCT_readAI);
+	HC_begin();
+	Serial.begin(1000000);
+	HCT_run(10);
+}
+
+
+
+// *****************************************************************************
+// Computer side
+// *****************************************************************************
+
+// keeps the last Ar reply, AI values of the X and A replies
+class HCT_AIHandler : public HC_ClientHandler
+{
+	public:
+		void onMessage(const HC_ClientMessage& message)
+		{
+			if (message.event == HC_ClientEvent_Error)
+				++errors;
+			else if (message.type == HC_ClientType_Ar)
+			{
+				arQty = message.qty;
+				for (uint8_t i = 0; (i < message.qty) && (i < 2); ++i)
+					ar[i] = message.values[i];
+			}
+			else if ((message.event == HC_ClientEvent_XValues) && (message.set == HC_CLIENT_XSET_AI))
+			{
+				for (uint8_t i = 0; i < message.qty; ++i)
+					if (((message.mask >> i) & 1) && (message.first + i < HCT_AI_QTY))
+						x[message.first + i] = message.values[i];
+			}
+			else if ((message.event == HC_ClientEvent_AValues) && (message.qty == HCT_AI_QTY))
+			{
+				for (uint8_t i = 0; i < HCT_AI_QTY; ++i)
+					a[i] = message.values[i];
+				++aReplies;
+			}
+			else if ((message.type == HC_ClientType_As) && (message.event == HC_ClientEvent_Data) && (message.qty == 1))
+				accepted = message.values[0];
+		}
+
+		void onDrop(uint8_t reason) { ++drops; }
+
+		unsigned long errors = 0;
+		unsigned long drops = 0;
+		uint8_t arQty = 0;
+		uint32_t ar[2] = { 0, 0 };
+		uint32_t x[HCT_AI_QTY] = { 0, 0, 0 };
+		uint32_t a[HCT_AI_QTY] = { 0, 0, 0 };
+		unsigned long aReplies = 0;
+		uint32_t accepted = 0;
+};
+
+static HC_ClientQuery g_query(HCT_format());
+
+
+// Ar (read): AI hex length. Ar (write, index): oversampling of 1 AI
+static void HCT_readAr(HC_ClientDecoder& decoder)
+{
+	g_query.begin(HC_ClientType_Ar);
+	HCT_send(g_query);
+	HCT_run(100, &decoder);
+}
+
+static void HCT_writeAr(uint8_t index, uint8_t n, HC_ClientDecoder& decoder)
+{
+	g_query.begin(HC_ClientType_Ar, HC_CLIENT_CONFIG_WRITE | HC_CLIENT_CONFIG_INDEX, index);
+	g_query.addNumber(n, 1);
+	HCT_send(g_query);
+	HCT_run(100, &decoder);
+}
+
+
+
+// *****************************************************************************
+// Tests
+// *****************************************************************************
+
+// 10 bits (no oversampling), 12 bits (n = 2), 14 bits (n = 4). History: 1 sample per result
+static void HCT_testDecimation()
+{
+	HCT_startBoard();
+
+	for (uint8_t i = 0; i < HCT_AI_QTY; ++i)
+		HC_sampler.enableChannel(i);
+	HC_sampler.setOversampling(1, 2);
+	HC_sampler.setOversampling(2, 4);
+	HC_sampler.begin();
+
+	CHECK(HC_sampler.getResolution(0) == 10);
+	CHECK(HC_sampler.getResolution(1) == 12);
+	CHECK(HC_sampler.getResolution(2) == 14);
+	CHECK(HC_sampler.getResolution(5) == 10);
+	CHECK(HC_sampler.getMaxResolution() == 14);
+
+	// 256 conversions per 14 bits result, 1 channel converted per cycle
+	HCT_run(HCT_AI_QTY * 256 * HC_SAMPLER_HISTORY_SIZE);
+
+	CHECK((HC_readAI(0) == (unsigned int)g_base[0]) || (HC_readAI(0) == (unsigned int)g_base[0] + 1));
+	CHECK(HC_readAI(1) == HCT_decimated(1, 2));
+	CHECK(HC_readAI(2) == HCT_decimated(2, 4));
+	CHECK(HC_readAI(2) > 0xFFF);
+
+	CHECK(HC_sampler.getHistoryQty(2) == HC_SAMPLER_HISTORY_SIZE);
+	for (uint8_t age = 0; age < HC_SAMPLER_HISTORY_SIZE; ++age)
+		CHECK(HC_sampler.readHistory(2, age) == HCT_decimated(2, 4));
+}
+
+
+// AI values of the X and A replies after the AI hex length changes from 3 to 4 chars (Ar)
+static void HCT_testDecode()
+{
+	HCT_startBoard();
+
+	HCT_AIHandler handler;
+	HC_ClientDecoder decoder(handler, HCT_format());
+
+	// 11 and 12 bits: 3 hex chars
+	for (uint8_t i = 0; i < HCT_AI_QTY; ++i)
+	{
+		HC_sampler.enableChannel(i);
+		HC_sampler.setOversampling(i, (i == 0) ? 1 : 2);
+	}
+	HC_sampler.begin();
+
+	HCT_readAr(decoder);
+	CHECK(handler.ar[0] == 3);
+	CHECK(decoder.getFormat().aiHexLength == 3);
+
+	// X and A replies
+	g_query.begin(HC_ClientType_As);
+	for (uint8_t i = 0; i < HCT_AI_QTY; ++i)
+	{
+		g_query.addType(HC_ClientType_AI);
+		g_query.addIndex(i);
+		decoder.addASubscription(HC_ClientType_AI);
+	}
+	HCT_send(g_query);
+	HCT_run(100, &decoder);
+	CHECK(handler.accepted == HCT_AI_QTY);
+
+	g_query.begin(HC_ClientType_Xs);
+	HCT_send(g_query);
+	HCT_run(2000, &decoder);
+
+	CHECK(handler.x[1] == HCT_decimated(1, 2));
+	CHECK(handler.a[1] == HCT_decimated(1, 2));
+
+	// 14 bits on AI 2 (sampler restarted): 4 hex chars
+	HCT_writeAr(2, 4, decoder);
+	CHECK(handler.arQty == 2);
+	CHECK(handler.ar[0] == 4);
+	CHECK(handler.ar[1] == 14);
+	CHECK(HC_sampler.isStarted());
+
+	HCT_readAr(decoder);
+	CHECK(handler.ar[0] == 4);
+	CHECK(decoder.getFormat().aiHexLength == 4);
+
+	unsigned long aReplies = handler.aReplies;
+	HCT_run(HCT_AI_QTY * 256 * 4, &decoder);
+	CHECK(handler.aReplies > aReplies);
+
+	for (uint8_t i = 0; i < HCT_AI_QTY; ++i)
+	{
+		CHECK(handler.x[i] == HC_readAI(i));
+		CHECK(handler.a[i] == HC_readAI(i));
+	}
+	CHECK(handler.x[0] == HCT_decimated(0, 1));
+	CHECK(handler.x[2] == HCT_decimated(2, 4));
+	CHECK(handler.a[2] == HCT_decimated(2, 4));
+
+	// n above the max: 14 bits
+	HCT_writeAr(1, 9, decoder);
+	CHECK(handler.ar[0] == 4);
+	CHECK(handler.ar[1] == 14);
+
+	CHECK(handler.errors == 0);
+	CHECK(handler.drops == 0);
+}
+
+
+
+// *****************************************************************************
+// Main
+// *****************************************************************************
+
+int main()
+{
+	HCT_fork([] { HCT_testDecimation(); });
+	HCT_fork([] { HCT_testDecode(); });
+
+	return HCT_result("Oversampling");
+}
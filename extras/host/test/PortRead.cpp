@@ -0,0 +1,162 @@
+/*
+ * HITIComm
+ * PortRead.cpp (host test)
+ *
+ * Copyright © 2021 Christophe LANDRET
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// DI and DO registers read port by port (port table of HCI_initializeDIOPorts(), bits remapped to the pins
+// by HCI_remapDIOPorts()) are the registers read pin by pin, on the pin mapping of the Mega and of the Uno
+// (HCS_HOST_UNO).
+
+#include "HCT_Test.h"
+
+// POSIX
+#include <stdlib.h>
+
+
+
+// *****************************************************************************
+// Registers
+// *****************************************************************************
+
+// DI register, read port by port (Mega: both halves, and each half alone)
+static unsigned long long HCT_readDIPorts()
+{
+	#if HC_VARIANT == HC_VARIANT_MEGA
+		unsigned long reg_H, reg_L;
+		HC_readDI(reg_H, reg_L);
+		CHECK(HC_readDI_L() == reg_L);
+		CHECK(HC_readDI_H() == reg_H);
+		return ((unsigned long long)reg_H << 32) | reg_L;
+	#else
+		return HC_readDI();
+	#endif
+}
+
+static unsigned long long HCT_readDOPorts()
+{
+	#if HC_VARIANT == HC_VARIANT_MEGA
+		unsigned long reg_H, reg_L;
+		HC_readDO(reg_H, reg_L);
+		CHECK(HC_readDO_L() == reg_L);
+		CHECK(HC_readDO_H() == reg_H);
+		return ((unsigned long long)reg_H << 32) | reg_L;
+	#else
+		return HC_readDO();
+	#endif
+}
+
+
+// same register, read pin by pin
+static unsigned long long HCT_readPins(bool isOutput)
+{
+	unsigned long long reg = 0;
+	for (uint8_t index = 0; index <= HCS_getDIO_endIndex(); ++index)
+	{
+		if (isOutput ? HC_readDO(index) : HC_readDI(index))
+			reg |= 1ULL << index;
+	}
+	return reg;
+}
+
+
+static void HCT_startBoard()
+{
+	HC_begin();
+	Serial.begin(1000000);
+	HCT_run(10);
+	srand(1);
+}
+
+
+
+// *****************************************************************************
+// Tests
+// *****************************************************************************
+
+// inputs driven low or high, or not driven (pull-up or not)
+static void HCT_testDI()
+{
+	HCT_startBoard();
+
+	for (int pattern = 0; pattern < 200; ++pattern)
+	{
+		unsigned long long expected = 0;
+		for (uint8_t pin = HCS_getDIO_startIndex(); pin <= HCS_getDIO_endIndex(); ++pin)
+		{
+			bool isPullUp = (rand() & 1);
+			pinMode(pin, isPullUp ? INPUT_PULLUP : INPUT);
+
+			bool level;
+			if (rand() % 4 == 0)
+			{
+				HCS_Host_releaseDI(pin);
+				level = isPullUp;
+			}
+			else
+			{
+				level = (rand() & 1);
+				HCS_Host_writeDI(pin, level);
+			}
+			if (level)
+				expected |= 1ULL << pin;
+		}
+
+		unsigned long long pins = HCT_readPins(false);
+		CHECK(HCT_readDIPorts() == pins);
+
+		unsigned long long mask = ~((1ULL << HCS_getDIO_startIndex()) - 1);
+		CHECK((pins & mask) == expected);
+	}
+}
+
+
+// outputs written low or high, among inputs
+static void HCT_testDO()
+{
+	HCT_startBoard();
+
+	for (int pattern = 0; pattern < 200; ++pattern)
+	{
+		for (uint8_t pin = HCS_getDIO_startIndex(); pin <= HCS_getDIO_endIndex(); ++pin)
+		{
+			if (rand() % 3 == 0)
+				pinMode(pin, INPUT);
+			else
+			{
+				pinMode(pin, OUTPUT);
+				HC_writeDO(pin, (bool)(rand() & 1));
+			}
+		}
+
+		CHECK(HCT_readDOPorts() == HCT_readPins(true));
+		CHECK(HCT_readDIPorts() == HCT_readPins(false));
+	}
+}
+
+
+
+// *****************************************************************************
+// Main
+// *****************************************************************************
+
+int main()
+{
+	HCT_fork([] { HCT_testDI(); });
+	HCT_fork([] { HCT_testDO(); });
+
+	return HCT_result("PortRead");
+}
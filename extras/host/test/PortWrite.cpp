@@ -0,0 +1,184 @@
+/*
+ * HITIComm
+ * PortWrite.cpp (host test)
+ *
+ * Copyright © 2021 Christophe LANDRET
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// DO register written port by port (masked write of HCI_writeDIOPorts()) leaves the pins as the register
+// written pin by pin (HC_writeDO(index, value)): same levels on the writable outputs, inputs, PWM outputs
+// and servos untouched. Pin modes, output types and servos change between writes (writable mask refreshed).
+// On the pin mapping of the Mega and of the Uno (HCS_HOST_UNO).
+
+#include "HCT_Test.h"
+
+// POSIX
+#include <stdlib.h>
+
+
+
+// *****************************************************************************
+// Pins
+// *****************************************************************************
+
+#define HCT_PIN_MAX_QTY	70
+
+// state of the pins, as seen from outside the board
+struct HCT_PinState
+{
+	bool level[HCT_PIN_MAX_QTY];
+	uint8_t pwm[HCT_PIN_MAX_QTY];
+	int servo[HCT_PIN_MAX_QTY];		// pulse width (us)
+};
+
+static void HCT_readState(HCT_PinState& state)
+{
+	memset(&state, 0, sizeof(state));
+	for (uint8_t pin = 0; (pin <= HCS_getDIO_endIndex()) && (pin < HCT_PIN_MAX_QTY); ++pin)
+	{
+		state.level[pin] = HCS_Host_readDO(pin);
+		state.pwm[pin] = HCS_Host_readPWM(pin);
+		state.servo[pin] = HCS_Host_readServo(pin);
+	}
+}
+
+static bool HCT_isEqual(const HCT_PinState& a, const HCT_PinState& b)
+{
+	return (memcmp(&a, &b, sizeof(HCT_PinState)) == 0);
+}
+
+
+// DO register, written pin by pin
+static void HCT_writePins(unsigned long long reg)
+{
+	for (uint8_t index = HCS_getDIO_startIndex(); index <= HCS_getDIO_endIndex(); ++index)
+		HC_writeDO(index, (bool)((reg >> index) & 1));
+}
+
+// DO register, written port by port
+static void HCT_writePorts(unsigned long long reg)
+{
+	#if HC_VARIANT == HC_VARIANT_MEGA
+		HC_writeDO((unsigned long)(reg >> 32), (unsigned long)reg);
+	#else
+		HC_writeDO((unsigned long)reg);
+	#endif
+}
+
+
+static unsigned long long HCT_random64()
+{
+	return ((unsigned long long)(rand() & 0xFFFF) << 48) | ((unsigned long long)(rand() & 0xFFFF) << 32) |
+		((unsigned long long)(rand() & 0xFFFF) << 16) | (unsigned long long)(rand() & 0xFFFF);
+}
+
+
+// pin modes, output types (digital or PWM), PWM values and servos at random
+static void HCT_configurePins()
+{
+	for (uint8_t pin = HCS_getDIO_startIndex(); pin <= HCS_getDIO_endIndex(); ++pin)
+	{
+		int config = rand() % 6;
+
+		if ((config != 3) && HC_readServoMode(pin))
+			HC_detachServo(pin);
+
+		switch (config)
+		{
+			// input
+			case 0:
+				pinMode(pin, INPUT);
+				break;
+
+			// PWM output (digital if PWM is not available)
+			case 2:
+				pinMode(pin, OUTPUT);
+				HC_outputType(pin, 1);
+				if (HC_PwmIsAvailable(pin))
+					HC_writePWM(pin, (uint8_t)(1 + rand() % 254));
+				break;
+
+			// servo
+			case 3:
+				if (!HC_readServoMode(pin))
+					HC_attachServo(pin);
+				break;
+
+			// digital output
+			default:
+				pinMode(pin, OUTPUT);
+				HC_outputType(pin, 0);
+				break;
+		}
+	}
+}
+
+
+
+// *****************************************************************************
+// Tests
+// *****************************************************************************
+
+static void HCT_testWrite()
+{
+	HC_begin();
+	Serial.begin(1000000);
+	HCT_run(10);
+	srand(1);
+
+	int changed = 0;
+	for (int pattern = 0; pattern < 200; ++pattern)
+	{
+		HCT_configurePins();
+
+		unsigned long long previous = HCT_random64();
+		unsigned long long reg = HCT_random64();
+
+		// pin by pin
+		HCT_PinState initial, pins, restored, ports;
+		HCT_writePins(previous);
+		HCT_readState(initial);
+		HCT_writePins(reg);
+		HCT_readState(pins);
+
+		// back to the initial state, then port by port
+		HCT_writePins(previous);
+		HCT_readState(restored);
+		CHECK(HCT_isEqual(restored, initial));
+
+		HCT_writePorts(reg);
+		HCT_readState(ports);
+		CHECK(HCT_isEqual(ports, pins));
+
+		if (!HCT_isEqual(pins, initial))
+			++changed;
+	}
+
+	// the writes did change outputs
+	CHECK(changed > 0);
+}
+
+
+
+// *****************************************************************************
+// Main
+// *****************************************************************************
+
+int main()
+{
+	HCT_fork([] { HCT_testWrite(); });
+
+	return HCT_result("PortWrite");
+}
@@ -0,0 +1,167 @@
+/*
+ * HITIComm
+ * Sampler.cpp (host test)
+ *
+ * Copyright © 2021 Christophe LANDRET
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Background AI sampler (HC_SAMPLER_TRY_COMPILE), portable engine (1 conversion per HC_communicate()):
+// no other conversion once started (X replies included), history spaced by the period,
+// blocking conversion for the channels which are not enabled.
+
+#include "HCT_Test.h"
+
+#ifndef HC_SAMPLER_COMPILE
+	#error "build with -DHC_SAMPLER_TRY_COMPILE (make test)"
+#endif
+
+
+
+// *****************************************************************************
+// Simulated AI
+// *****************************************************************************
+
+// conversions done by the board (calls of the AI reader)
+static unsigned long g_conversions = 0;
+
+// value of each AI (HCT_TIME_VALUE: time since g_startTime, in cycles)
+#define HCT_TIME_VALUE	0xFFFF
+static int g_value[HC_SAMPLER_MAX_CHANNEL_QTY];
+static unsigned long g_startTime = 0;
+
+static int HCT_readAI(uint8_t index)
+{
+	++g_conversions;
+
+	if (g_value[index] == HCT_TIME_VALUE)
+		return (int)((HCS_micros() - g_startTime) / HCT_CYCLE_TIME);
+	return g_value[index];
+}
+
+
+static void HCT_startBoard()
+{
+	HCS_Host_setAIReader(HCT_readAI);
+	HC_begin();
+	Serial.begin(1000000);
+	HCT_run(10);
+}
+
+
+
+// *****************************************************************************
+// Tests
+// *****************************************************************************
+
+// all channels sampled: 1 conversion per cycle, even with the X replies (AI values) running
+static void HCT_testNoBlocking()
+{
+	HCT_startBoard();
+
+	HC_sampler.enableAllChannels();
+	HC_sampler.begin();
+	CHECK(HC_sampler.isStarted());
+
+	HC_ClientQuery query(HCT_format());
+	query.begin(HC_ClientType_Xs);
+	HCT_send(query);
+
+	unsigned long maxConversions = 0;
+	for (int i = 0; i < 2000; ++i)
+	{
+		g_conversions = 0;
+		HCT_cycle();
+		if (g_conversions > maxConversions)
+			maxConversions = g_conversions;
+	}
+	CHECK(maxConversions == 1);
+
+	// latest conversion
+	g_conversions = 0;
+	for (uint8_t index = 0; index <= HCS_getAI_endIndex(); ++index)
+		HC_readAI(index);
+	CHECK(g_conversions == 0);
+}
+
+
+// history: 1 sample every period at most (channels converted in turn: 1 conversion every 2 cycles)
+static void HCT_testHistory()
+{
+	HCT_startBoard();
+
+	g_value[0] = HCT_TIME_VALUE;
+	g_value[1] = HCT_TIME_VALUE;
+	HC_sampler.enableChannel(0, 10 * HCT_CYCLE_TIME);
+	HC_sampler.enableChannel(1);
+	g_startTime = HCS_micros();
+	HC_sampler.begin();
+	HCT_run(200);
+
+	CHECK(HC_sampler.getHistoryQty(0) == HC_SAMPLER_HISTORY_SIZE);
+	CHECK(HC_sampler.getHistoryQty(1) == HC_SAMPLER_HISTORY_SIZE);
+
+	// spacing (cycles) between 2 samples
+	for (uint8_t age = 0; age + 1 < HC_SAMPLER_HISTORY_SIZE; ++age)
+	{
+		CHECK(HC_sampler.readHistory(0, age) - HC_sampler.readHistory(0, age + 1) == 10);
+		CHECK(HC_sampler.readHistory(1, age) - HC_sampler.readHistory(1, age + 1) == 2);
+	}
+
+	// latest conversion: last one
+	CHECK(HC_sampler.read(1) == HC_sampler.readHistory(1, 0));
+}
+
+
+// channel not enabled: 1 blocking conversion, the sampler goes on
+static void HCT_testFallback()
+{
+	HCT_startBoard();
+
+	g_value[0] = 100;
+	g_value[5] = 321;
+	HC_sampler.enableChannel(0);
+	HC_sampler.begin();
+	HCT_run(10);
+
+	g_conversions = 0;
+	CHECK(HC_readAI(5) == 321);
+	CHECK(g_conversions == 1);
+	CHECK(HC_sampler.isStarted());
+
+	// enabled channel: latest conversion, updated by the next cycle
+	g_value[0] = 200;
+	g_conversions = 0;
+	CHECK(HC_readAI(0) == 100);
+	CHECK(g_conversions == 0);
+
+	HCT_cycle();
+	CHECK(HC_readAI(0) == 200);
+	CHECK(g_conversions == 1);
+}
+
+
+
+// *****************************************************************************
+// Main
+// *****************************************************************************
+
+int main()
+{
+	HCT_fork([] { HCT_testNoBlocking(); });
+	HCT_fork([] { HCT_testHistory(); });
+	HCT_fork([] { HCT_testFallback(); });
+
+	return HCT_result("Sampler");
+}
@@ -0,0 +1,147 @@
+/*
+ * HITIComm
+ * HC_Capture.h
+ *
+ * Copyright © 2021 Christophe LANDRET
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// *****************************************************************************
+// Include Guard
+// *****************************************************************************
+
+#ifndef HC_Capture_h
+#define HC_Capture_h
+
+
+
+// *****************************************************************************
+// Include dependencies
+// *****************************************************************************
+
+// HITICommSupport
+#include <HITICommSupport.h>
+
+// HITIComm
+#include "sub\HC_CompilationTriggers.h"
+#include "HC_Enum.h"
+
+
+
+// *****************************************************************************
+// Define
+// *****************************************************************************
+
+// Capture buffer: samples (2 bytes each), shared by all channels
+#define HC_CAPTURE_BUFFER_SIZE			512
+
+// max captured AI channels
+#define HC_CAPTURE_MAX_CHANNEL_QTY		4
+
+// min sampling period (us)
+#define HC_CAPTURE_MIN_PERIOD			100
+
+
+#ifdef HC_CAPTURE_COMPILE
+// *****************************************************************************
+// Class
+// *****************************************************************************
+
+// Burst capture of AI channels (oscilloscope):
+//   - once armed, AI channels are sampled every period into a ring buffer
+//   - when the trigger occurs (level crossing on an AI, or edge on a DI), the
+//     buffer keeps the pre-trigger frames and is filled with the post-trigger frames
+//   - then the capture is done and the frames can be read (in time order)
+//
+// Sampling is done in run() (called by HC_communicate()), 1 frame per call at
+// most, when its time has come (never waits). The period must be longer than
+// the cycle time of the loop: arm() refuses a shorter period, and the capture
+// stops if a sample is missed (a frame late by 1 period or more). In both cases
+// the state is HC_CAPTURE_OVERRUN, as frames would not be spaced by the period.
+class HC_Capture
+{
+	public:
+		// constructor ---------------------------------------------------------
+		HC_Capture() {}
+
+		// setters (capture is stopped) ----------------------------------------
+		void setPeriod(unsigned long period);		// us
+		void setPreTrigger(unsigned int frameQty);	// frames captured before the trigger
+		void setTrigger(
+			HC_CaptureTrigger source,
+			uint8_t index = 0,						// AI or DI index
+			unsigned int level = 512,				// AI level
+			HC_CaptureEdge edge = HC_CAPTURE_RISING);
+		void clearChannels();
+		bool addChannel(uint8_t index);				// AI index. false if table is full
+
+		// control -------------------------------------------------------------
+		void arm();
+		void stop();
+		void run();
+
+		// getters -------------------------------------------------------------
+		HC_CaptureState getState() const;
+		unsigned long getPeriod() const;
+		unsigned int getPreTrigger() const;			// index of the trigger frame
+		uint8_t getChannelQty() const;
+		uint8_t getChannel(uint8_t channel) const;
+		unsigned int getFrameQty() const;			// frames in buffer (when done)
+
+		// sample of a channel, frames in time order (0: oldest)
+		unsigned int readSample(unsigned int frame, uint8_t channel) const;
+
+
+	protected:
+	private:
+		// sample all channels, check trigger
+		void sample();
+
+		// settings
+		unsigned long mPeriod = 1000;
+		unsigned int mPreTrigger = 0;
+		uint8_t mTrigger_source = HC_CAPTURE_TRIGGER_NONE;
+		uint8_t mTrigger_index = 0;
+		unsigned int mTrigger_level = 512;
+		uint8_t mTrigger_edge = HC_CAPTURE_RISING;
+		uint8_t mChannel[HC_CAPTURE_MAX_CHANNEL_QTY];
+		uint8_t mChannelQty = 0;
+
+		// state
+		uint8_t mState = HC_CAPTURE_IDLE;
+		unsigned int mFrameCapacity = 0;		// frames in buffer
+		unsigned int mFrame_write = 0;			// next frame to write (ring)
+		unsigned int mFrame_count = 0;			// frames captured since armed (if armed), or left to capture (if triggered)
+		unsigned int mFrame_trigger = 0;		// trigger frame (ring)
+		bool mTrigger_previous;					// trigger input state at previous frame
+		unsigned long mNextSampleTime = 0;		// us
+
+		// buffer
+		uint16_t mBuffer[HC_CAPTURE_BUFFER_SIZE];
+};
+
+
+
+// *****************************************************************************
+// Forward declare a class object
+// *****************************************************************************
+
+extern HC_Capture HC_capture;
+
+
+#endif	// HC_CAPTURE_COMPILE
+
+
+#endif
@@ -198,6 +198,17 @@ bool HC_PwmIsAvailable(uint8_t index);
 bool HCI_PWMavailability_hasChanged();
 
 
+// -----------------------------------------------------------------------------
+// DIO ports -------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+// port table (DI and DO registers read and written port by port), built by HC_begin()
+void HCI_initializeDIOPorts();
+
+// writable DO mask: to invalidate on changes of output type or servo mode
+void HCI_invalidateWritableDO();
+
+
 // -----------------------------------------------------------------------------
 // DI --------------------------------------------------------------------------
 // -----------------------------------------------------------------------------
@@ -207,6 +218,9 @@ bool HCI_PWMavailability_hasChanged();
     long unsigned HC_readDI_L();
 
     long unsigned HC_readDI_H();
+
+    // both registers, all pins sampled at the same time
+    void HC_readDI(long unsigned& reg_H, long unsigned& reg_L);
 #else
     long unsigned HC_readDI();
 #endif
@@ -236,6 +250,9 @@ void HC_writeDO(uint8_t index, bool value);
     long unsigned HC_readDO_L();
 
     long unsigned HC_readDO_H();
+
+    // both registers, all pins sampled at the same time
+    void HC_readDO(long unsigned& reg_H, long unsigned& reg_L);
 #else
     long unsigned HC_readDO();
 #endif
@@ -67,4 +67,34 @@ typedef enum
 }HC_UserSpace;
 
 
+
+
+// *****************************************************************************
+// Capture
+// *****************************************************************************
+
+typedef enum
+{
+	HC_CAPTURE_IDLE			= 0,	// not armed
+	HC_CAPTURE_ARMED		= 1,	// sampling, waiting for trigger
+	HC_CAPTURE_TRIGGERED	= 2,	// sampling after trigger
+	HC_CAPTURE_DONE			= 3,	// buffer is full and can be read
+	HC_CAPTURE_OVERRUN		= 4		// stopped: period shorter than the cycle time (sample missed)
+}HC_CaptureState;
+
+typedef enum
+{
+	HC_CAPTURE_TRIGGER_NONE	= 0,	// triggered as soon as pre-trigger samples are captured
+	HC_CAPTURE_TRIGGER_AI	= 1,	// AI crosses level
+	HC_CAPTURE_TRIGGER_DI	= 2		// DI edge
+}HC_CaptureTrigger;
+
+typedef enum
+{
+	HC_CAPTURE_RISING		= 0,
+	HC_CAPTURE_FALLING		= 1,
+	HC_CAPTURE_BOTHEDGES	= 2
+}HC_CaptureEdge;
+
+
 #endif
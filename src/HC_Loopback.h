@@ -0,0 +1,94 @@
+/*
+ * HITIComm
+ * HC_Loopback.h
+ *
+ * Copyright © 2021 Christophe LANDRET
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// *****************************************************************************
+// Include Guard
+// *****************************************************************************
+
+#ifndef HC_Loopback_h
+#define HC_Loopback_h
+
+
+
+// *****************************************************************************
+// Include dependencies
+// *****************************************************************************
+
+// Arduino
+#include <Arduino.h>
+
+// HITIComm
+#include "sub\HC_Protocol.h"
+
+
+
+// *****************************************************************************
+// Define
+// *****************************************************************************
+
+// received bytes (ring buffer), max 255. Takes a whole output frame of a session (up to
+// HC_AQUERY_MAX_FRAME_LENGHT if binary): a frame is never cut by a full buffer
+#define HC_LOOPBACK_BUFFER_SIZE (HC_OUTPUTFRAME_MAX_ARRAY_LENGHT + 1)
+
+
+
+// *****************************************************************************
+// Class
+// *****************************************************************************
+
+// In-memory Stream: bytes written to a loopback are received by its peer (or by
+// itself if not connected). Ex: run a session without serial port, connect 2 sessions,
+// or feed a session from the sketch.
+// A byte written when the peer buffer is full is dropped (write() returns 0).
+class HC_Loopback : public Stream
+{
+	public:
+		// constructor ---------------------------------------------------------
+		HC_Loopback() {}
+
+		// both directions
+		void connect(HC_Loopback& peer);
+
+		// Stream --------------------------------------------------------------
+		int available();
+		int read();
+		int peek();
+		void flush() {}
+
+		// Print ---------------------------------------------------------------
+		size_t write(uint8_t b);
+		int availableForWrite();
+		using Print::write;
+
+
+	protected:
+	private:
+		// write into this buffer
+		bool receive(uint8_t b);
+
+		HC_Loopback* mPeer = this;
+
+		uint8_t mBuffer[HC_LOOPBACK_BUFFER_SIZE];
+		uint8_t mBuffer_start = 0;		// next byte to read
+		uint8_t mBuffer_length = 0;		// bytes to read
+};
+
+
+#endif
@@ -0,0 +1,146 @@
+/*
+ * HITIComm
+ * HC_Mirror.h
+ *
+ * Copyright © 2021 Christophe LANDRET
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// *****************************************************************************
+// Include Guard
+// *****************************************************************************
+
+#ifndef HC_Mirror_h
+#define HC_Mirror_h
+
+
+
+// *****************************************************************************
+// Include dependencies
+// *****************************************************************************
+
+// Arduino
+#include <Arduino.h>
+
+// HITIComm
+#include "sub\HC_CompilationTriggers.h"
+#include "HC_Data.h"
+
+
+
+// *****************************************************************************
+// Define
+// *****************************************************************************
+
+// min time between 2 frames (us)
+#define HC_MIRROR_PERIOD				20000
+
+// all published values are sent at least every HC_MIRROR_KEYFRAME_PERIOD (us)
+#define HC_MIRROR_KEYFRAME_PERIOD		1000000
+
+// frame: COBS code, type, sequence, DD mask, DD values, AD mask (3 bytes), AD values, CRC-16
+#define HC_MIRROR_FRAME_TYPE			'M'
+#define HC_MIRROR_FRAME_MIN_LENGHT		11		// no DD, no AD (without COBS code)
+#define HC_MIRROR_FRAME_MAX_LENGHT		(HC_MIRROR_FRAME_MIN_LENGHT + 4 + 4 * HC_AD_QTY)
+
+
+#ifdef HC_MIRROR_COMPILE
+// *****************************************************************************
+// Class
+// *****************************************************************************
+
+// Board-to-board mirroring of DD bits and AD values over a Stream (Serial1, HC_Loopback...)
+// dedicated to the mirror (no HC_Protocol session on it).
+//   - published values are sent when they change (not faster than the period), and all
+//     of them every HC_MIRROR_KEYFRAME_PERIOD (a frame lost only delays a change)
+//   - received values are applied if subscribed, all together once the frame is checked
+//   - each frame has a sequence number: lost frames are counted by the receiver
+// Frames are binary (COBS framing, 0x00 delimiter, CRC-16), whatever the protocol option.
+// run() (called by HC_communicate()) never blocks: a frame is sent when it fits in the TX buffer.
+class HC_Mirror
+{
+	public:
+		// constructor ---------------------------------------------------------
+		HC_Mirror(Stream& stream) : mStream(&stream) {}
+
+		// setters -------------------------------------------------------------
+		void publishDD(unsigned long mask);		// bit i: DD i is sent
+		void publishAD(unsigned long mask);		// bit i: AD i is sent
+		void subscribeDD(unsigned long mask);	// bit i: DD i is applied when received
+		void subscribeAD(unsigned long mask);	// bit i: AD i is applied when received
+		void setPeriod(unsigned long period);	// us
+
+		// receive and apply, send changes
+		void run();
+
+		// getters -------------------------------------------------------------
+		unsigned long getReceivedFrames() const;
+		unsigned long getLostFrames() const;	// sequence gaps
+		unsigned long getInvalidFrames() const;	// bad length, type or CRC
+
+		// mirrors run by HC_communicate() ------------------------------------
+		static void addMirror(HC_Mirror& mirror);
+		static HC_Mirror* getFirstMirror();
+		HC_Mirror* getNextMirror() const;
+
+
+	protected:
+	private:
+		void receive();
+		void applyInput();
+		void send();
+
+		// list of mirrors
+		static HC_Mirror* mMirror_first;
+		HC_Mirror* mMirror_next = NULL_POINTER;
+
+		Stream* mStream;
+
+		// settings
+		unsigned long mPublished_DD = 0;
+		unsigned long mPublished_AD = 0;
+		unsigned long mSubscribed_DD = 0;
+		unsigned long mSubscribed_AD = 0;
+		unsigned long mPeriod = HC_MIRROR_PERIOD;
+
+		// sent values
+		unsigned long mOutput_DD = 0;
+		float mOutput_AD[HC_AD_QTY];
+		uint8_t mOutput_sequence = 0;
+		unsigned long mOutput_time = 0;
+		unsigned long mOutput_keyframeTime = 0;
+		bool mOutput_isStarted = false;			// first frame is a keyframe
+		int mOutput_txRoomMax = 0;
+
+		// received frame (COBS decoded while receiving)
+		uint8_t mInput[HC_MIRROR_FRAME_MAX_LENGHT];
+		uint8_t mInput_length = 0;
+		bool mInput_isValid = true;				// false if too long or badly encoded
+		uint8_t mInput_cobsCode = 0xFF;
+		uint8_t mInput_cobsCount = 0;
+		uint8_t mInput_sequence = 0;			// next expected sequence
+		bool mInput_isStarted = false;
+
+		// statistics
+		unsigned long mReceivedFrames = 0;
+		unsigned long mLostFrames = 0;
+		unsigned long mInvalidFrames = 0;
+};
+
+
+#endif	// HC_MIRROR_COMPILE
+
+
+#endif
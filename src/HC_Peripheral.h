@@ -0,0 +1,188 @@
+/*
+ * HITIComm
+ * HC_Peripheral.h
+ *
+ * Copyright © 2021 Christophe LANDRET
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// *****************************************************************************
+// Include Guard
+// *****************************************************************************
+
+#ifndef HC_Peripheral_h
+#define HC_Peripheral_h
+
+
+
+// *****************************************************************************
+// Include dependencies
+// *****************************************************************************
+
+// Arduino
+#include <Arduino.h>
+
+// HITICommSupport
+#include <HITICommSupport.h>
+
+// HITIComm
+#include "sub\HC_CompilationTriggers.h"
+
+
+
+// *****************************************************************************
+// Define
+// *****************************************************************************
+
+// Register map (byte addresses, multi-byte values in little-endian) -----------
+
+#define HC_PERIPHERAL_REG_SEQUENCE		0x00	// uint8:  incremented at each snapshot
+#define HC_PERIPHERAL_REG_STREAMQTY		0x01	// uint8:  bytes to read at HC_PERIPHERAL_REG_STREAM
+#define HC_PERIPHERAL_REG_DIQTY			0x02	// uint8:  DIO qty
+#define HC_PERIPHERAL_REG_AIQTY			0x03	// uint8:  AI qty
+#define HC_PERIPHERAL_REG_DD			0x04	// uint32: DD (bit field)
+#define HC_PERIPHERAL_REG_DI			0x08	// uint32 x 2: DI 0-31, DI 32-63 (bit fields)
+#define HC_PERIPHERAL_REG_AI			0x10	// uint16 x 16: AI 0-15
+#define HC_PERIPHERAL_AI_QTY			16
+#define HC_PERIPHERAL_REG_AD			0x30	// float x 20: AD 0-19
+#define HC_PERIPHERAL_SNAPSHOT_SIZE		0x80
+
+#define HC_PERIPHERAL_REG_STREAM		0x80	// HC_Protocol messages (write: to the board, read: from the board)
+
+// snapshot refresh period (us)
+#define HC_PERIPHERAL_PERIOD			10000
+
+// stream ring buffers (capacity: size - 1), max 255
+#define HC_PERIPHERAL_RX_BUFFER_SIZE	64
+#define HC_PERIPHERAL_TX_BUFFER_SIZE	64
+
+// max bytes sent in 1 I2C read (Wire TX buffer)
+#if defined(ARDUINO_ARCH_SAMD)
+	#define HC_PERIPHERAL_I2C_READ_LENGHT	HC_PERIPHERAL_SNAPSHOT_SIZE
+#else
+	#define HC_PERIPHERAL_I2C_READ_LENGHT	32
+#endif
+
+// SPI peripheral (AVR boards with SPCR only). Uses the SPI interrupt (SPI_STC_vect)
+//#define HC_PERIPHERAL_SPI
+
+#if defined(HC_PERIPHERAL_SPI) && defined(SPCR)
+	#define HC_PERIPHERAL_SPI_COMPILE
+#endif
+
+
+#ifdef HC_PERIPHERAL_COMPILE
+// *****************************************************************************
+// Class
+// *****************************************************************************
+
+// Peripheral transport: the board is polled by a master MCU (I2C, optionally SPI).
+//
+// Register-mapped, read-only snapshot of DD, DI, AI and AD values (refreshed by
+// HC_communicate() every period). Values are raw binary: no message formatting.
+// AI: channels sampled by HC_sampler are refreshed at each snapshot, the other
+// ones 1 per snapshot, in turn (1 conversion: the update does not wait longer).
+// The master writes the register address, then reads (address auto-incremented).
+// Ex: all AD in 1 read of 80 bytes at HC_PERIPHERAL_REG_AD (I2C reads are limited
+// to HC_PERIPHERAL_I2C_READ_LENGHT bytes: 32 on AVR boards. Compare the sequence
+// before and after several reads to check they belong to the same snapshot).
+//
+// I2C, register HC_PERIPHERAL_REG_STREAM: HC_Protocol messages. The peripheral is
+// a Stream, so a session can run on it (HC_Protocol session(HC_peripheral)).
+// The master reads HC_PERIPHERAL_REG_STREAMQTY first, then reads this qty of bytes
+// (bytes not read by the master are lost).
+//
+// SPI (HC_PERIPHERAL_SPI): snapshot only. Command byte: 0x80 | register, then the
+// master sends 0x00 to read each byte. The byte is loaded by the SPI interrupt:
+// leave about 10us between bytes.
+class HC_Peripheral : public Stream
+{
+	public:
+		// constructor ---------------------------------------------------------
+		HC_Peripheral() {}
+
+		// start ---------------------------------------------------------------
+		void beginI2C(uint8_t address);
+#ifdef HC_PERIPHERAL_SPI_COMPILE
+		void beginSPI();
+#endif
+
+		// snapshot ------------------------------------------------------------
+		void setPeriod(unsigned long period);	// us
+		void update();							// called by HC_communicate()
+
+		// Stream --------------------------------------------------------------
+		int available();
+		int read();
+		int peek();
+		void flush() {}
+
+		// Print ---------------------------------------------------------------
+		size_t write(uint8_t b);
+		int availableForWrite();
+		using Print::write;
+
+		// called from interrupts ----------------------------------------------
+		void onI2CReceive(int byteQty);
+		void onI2CRequest();
+#ifdef HC_PERIPHERAL_SPI_COMPILE
+		void onSPITransfer();
+#endif
+
+
+	protected:
+	private:
+		// snapshot: the master reads the front buffer, update() writes the other one
+		void writeSnapshot(uint8_t reg, unsigned long value, uint8_t size);
+		void updateAI();
+
+		bool mIsStarted = false;
+		unsigned long mPeriod = HC_PERIPHERAL_PERIOD;
+		unsigned long mLastUpdateTime = 0;
+
+		uint8_t mSnapshot[2][HC_PERIPHERAL_SNAPSHOT_SIZE];
+		volatile uint8_t mSnapshot_front = 0;
+		uint8_t mSnapshot_sequence = 0;
+		uint8_t mAI_next = 0;					// next AI converted (not sampled)
+
+		// register selected by the master
+		volatile uint8_t mRegister = 0;
+#ifdef HC_PERIPHERAL_SPI_COMPILE
+		volatile uint8_t mSPI_buffer = 0;		// front buffer when the command was received
+#endif
+
+		// ring buffers (1 writer, 1 reader): head is read, tail is written
+		uint8_t mRX_buffer[HC_PERIPHERAL_RX_BUFFER_SIZE];
+		volatile uint8_t mRX_head = 0;
+		volatile uint8_t mRX_tail = 0;
+
+		uint8_t mTX_buffer[HC_PERIPHERAL_TX_BUFFER_SIZE];
+		volatile uint8_t mTX_head = 0;
+		volatile uint8_t mTX_tail = 0;
+};
+
+
+
+// *****************************************************************************
+// Forward declare a class object
+// *****************************************************************************
+
+extern HC_Peripheral HC_peripheral;
+
+
+#endif	// HC_PERIPHERAL_COMPILE
+
+
+#endif
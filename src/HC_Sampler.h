@@ -0,0 +1,226 @@
+/*
+ * HITIComm
+ * HC_Sampler.h
+ *
+ * Copyright © 2021 Christophe LANDRET
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// *****************************************************************************
+// Include Guard
+// *****************************************************************************
+
+#ifndef HC_Sampler_h
+#define HC_Sampler_h
+
+
+
+// *****************************************************************************
+// Include dependencies
+// *****************************************************************************
+
+// Arduino
+#include <Arduino.h>
+
+// HITICommSupport
+#include <HITICommSupport.h>
+
+// HITIComm
+#include "sub\HC_CompilationTriggers.h"
+
+
+
+// *****************************************************************************
+// Define
+// *****************************************************************************
+
+// max sampled AI channels (AI 0 to qty - 1)
+#if HC_VARIANT == HC_VARIANT_MEGA
+	#define HC_SAMPLER_MAX_CHANNEL_QTY	16
+#else
+	#define HC_SAMPLER_MAX_CHANNEL_QTY	12
+#endif
+
+// history of each channel (samples), power of 2, max 128
+#define HC_SAMPLER_HISTORY_SIZE			8
+
+// AVR boards with ADCSRA: conversions chained by the ADC interrupt (ADC_vect).
+// Experimental (not validated on a board yet): off by default, conversions are then done by run()
+//#define HC_SAMPLER_INTERRUPT_EXPERIMENTAL
+
+#if defined(HC_SAMPLER_INTERRUPT_EXPERIMENTAL) && defined(ADCSRA) && defined(ADC_vect)
+	#define HC_SAMPLER_INTERRUPT
+#endif
+
+// SAMD21 boards: ADC inputs scanned in free-running mode, results written by DMA.
+// Experimental (not validated on a board yet): off by default, conversions are then done by run()
+//#define HC_SAMPLER_DMA_EXPERIMENTAL
+
+#if defined(HC_SAMPLER_DMA_EXPERIMENTAL) && defined(ARDUINO_ARCH_SAMD) && defined(DMAC) && defined(ADC_DMAC_ID_RESRDY)
+	#define HC_SAMPLER_DMA
+#endif
+
+// DMA: scanned ADC inputs (max), sweeps of all inputs in each of the 2 buffers
+#define HC_SAMPLER_DMA_MAX_INPUT_QTY	20
+#define HC_SAMPLER_DMA_SWEEP_QTY		4
+#define HC_SAMPLER_DMA_BUFFER_SIZE		(HC_SAMPLER_DMA_MAX_INPUT_QTY * HC_SAMPLER_DMA_SWEEP_QTY)
+
+// DMA: hardware averaging (2^n samples per result), max n
+#define HC_SAMPLER_DMA_MAX_AVERAGING	10
+
+// oversampling (4^n samples per result, decimated to 10 + n bits), max n
+#define HC_SAMPLER_MAX_OVERSAMPLING		4
+
+
+#ifdef HC_SAMPLER_COMPILE
+// *****************************************************************************
+// Class
+// *****************************************************************************
+
+// Background AI sampler:
+//   - the enabled channels are converted one after the other, continuously
+//   - the latest conversion of each channel is kept: once started, HC_readAI()
+//     (and the X and A replies) returns it, without waiting for a conversion
+//   - each channel also keeps its last HC_SAMPLER_HISTORY_SIZE samples, taken
+//     every period at most (period 0: every conversion of the channel)
+//
+// Conversions:
+//   - HC_SAMPLER_INTERRUPT (experimental: HC_SAMPLER_INTERRUPT_EXPERIMENTAL):
+//     the ADC interrupt stores the result and starts the next conversion (about
+//     110us each). Do not call analogRead() meanwhile: HC_readAI() of a channel
+//     which is not enabled pauses the sampler
+//   - HC_SAMPLER_DMA (experimental: HC_SAMPLER_DMA_EXPERIMENTAL): the ADC scans
+//     the inputs from the lowest to the highest enabled one, again and again
+//     (free-running). DMA (channel 0) writes the results into 2 buffers
+//     alternately, without CPU. The latest conversions are read in the last
+//     completed buffer, the history is updated by run() once per completed
+//     buffer. Optional hardware averaging (setAveraging()). Results are scaled
+//     to 10 bits, as analogRead(). If the DMA controller is already used
+//     (another library), conversions are done as below
+//   - other boards: 1 conversion in run() (called by HC_communicate())
+//
+// Oversampling (setOversampling()): 4^n conversions of a channel are summed as
+// they come, then decimated (sum >> n) to 1 result of 10 + n bits. The latest
+// conversion and the history of the channel are updated once per result.
+//
+// History period: time between 2 conversions of a channel at least (enabled
+// channel qty x conversion time, or x cycle time). Oversampled: x 4^n.
+class HC_Sampler
+{
+	public:
+		// constructor ---------------------------------------------------------
+		HC_Sampler() {}
+
+		// setters (sampler is stopped) ----------------------------------------
+		void enableChannel(uint8_t index, unsigned long period = 0);	// AI index, history period (us)
+		void disableChannel(uint8_t index);
+		void enableAllChannels(unsigned long period = 0);
+		void setOversampling(uint8_t index, uint8_t n);	// 4^n samples per result (0: no oversampling)
+#ifdef HC_SAMPLER_DMA
+		void setAveraging(uint8_t n);				// 2^n samples per result (0: no averaging)
+#endif
+
+		// control -------------------------------------------------------------
+		void begin();
+		void stop();
+		void run();		// called by HC_communicate()
+
+		// getters -------------------------------------------------------------
+		bool isStarted() const;
+		bool isEnabled(uint8_t index) const;
+		unsigned long getPeriod(uint8_t index) const;
+		uint8_t getOversampling(uint8_t index) const;
+		uint8_t getResolution(uint8_t index) const;		// bits of the results (10 if not enabled)
+		uint8_t getMaxResolution() const;				// of the enabled channels
+#ifdef HC_SAMPLER_DMA
+		uint8_t getAveraging() const;
+#endif
+
+		// latest conversion (channel not enabled: blocking conversion)
+		unsigned int read(uint8_t index);
+
+		// history: samples in buffer, sample (0: latest)
+		uint8_t getHistoryQty(uint8_t index) const;
+		unsigned int readHistory(uint8_t index, uint8_t age) const;
+
+		// called from interrupts ----------------------------------------------
+		void onConversion(unsigned int value);
+
+
+	protected:
+	private:
+		// conversion of the current channel (DMA: conversions of all channels)
+		void startConversion();
+		void waitConversion();
+
+		// latest conversion and history of a channel
+		void record(uint8_t channel, unsigned int value);
+
+		// next enabled channel (current channel if no other)
+		uint8_t getNextChannel() const;
+
+		// settings
+		unsigned int mChannels = 0;							// enabled channels (bit field)
+		unsigned long mPeriod[HC_SAMPLER_MAX_CHANNEL_QTY];	// us
+		uint8_t mOversampling[HC_SAMPLER_MAX_CHANNEL_QTY];
+
+		// state
+		bool mIsStarted = false;
+		volatile uint8_t mChannel_current = 0;
+
+		// samples
+		volatile unsigned int mLatest[HC_SAMPLER_MAX_CHANNEL_QTY];
+		volatile unsigned int mHistory[HC_SAMPLER_MAX_CHANNEL_QTY][HC_SAMPLER_HISTORY_SIZE];
+		volatile uint8_t mHistory_write[HC_SAMPLER_MAX_CHANNEL_QTY];	// next sample to write (ring)
+		volatile uint8_t mHistory_qty[HC_SAMPLER_MAX_CHANNEL_QTY];
+		volatile unsigned long mHistory_time[HC_SAMPLER_MAX_CHANNEL_QTY];	// us, latest sample
+
+		// oversampling: sum of the conversions of the result in progress
+		volatile unsigned long mSum[HC_SAMPLER_MAX_CHANNEL_QTY];
+		volatile unsigned int mSum_qty[HC_SAMPLER_MAX_CHANNEL_QTY];
+
+#ifdef HC_SAMPLER_DMA
+		// DMA: last sweep of the last completed buffer (NULL_POINTER: none yet)
+		const volatile uint16_t* getCompletedSweep();
+		unsigned int readSweep(const volatile uint16_t* sweep, uint8_t channel) const;
+
+		// settings
+		uint8_t mAveraging = 0;
+		uint8_t mInput[HC_SAMPLER_MAX_CHANNEL_QTY];		// ADC input of each channel
+
+		// state
+		bool mDma_isStarted = false;		// false: conversions done by run()
+		bool mDma_isFilled = false;			// a buffer has been completed
+		uint8_t mScan_first = 0;			// lowest scanned ADC input
+		uint8_t mScan_qty = 0;
+
+		// buffers
+		volatile uint16_t mDma_buffer[2][HC_SAMPLER_DMA_BUFFER_SIZE];
+#endif
+};
+
+
+
+// *****************************************************************************
+// Forward declare a class object
+// *****************************************************************************
+
+extern HC_Sampler HC_sampler;
+
+
+#endif	// HC_SAMPLER_COMPILE
+
+
+#endif
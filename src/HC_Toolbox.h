@@ -78,6 +78,23 @@ unsigned long HCI_convertFloatToHex(float f);
 unsigned int HCI_stringToConcByte(char* inputString);
 unsigned long HCI_concByteToString(unsigned int inputValue, char* destinationString, uint8_t stringLength);
 
+// ASCII hex digit ('0'-'9', 'A'-'F', 'a'-'f') to value (0xFF if not a hex digit)
+uint8_t HCI_hexCharToValue(char c);
+
+
+
+// --------------------------------------------------------------------------
+// Binary framing (CRC-16, COBS) --------------------------------------------
+// --------------------------------------------------------------------------
+
+// CRC-16/XMODEM (poly 0x1021, init 0)
+uint16_t HCI_updateCRC16(uint16_t crc, uint8_t data);
+
+// COBS (Consistent Overhead Byte Stuffing) encoding, in place, frames shorter than 254 bytes
+//   => buffer[0] is reserved, data is in buffer[1..length]. Returns encoded length (length + 1)
+//   => decoding is done byte per byte while receiving (see HC_Protocol::receive())
+uint8_t HCI_encodeCOBS(uint8_t* buffer, uint8_t length);
+
 
 
 // --------------------------------------------------------------------------
@@ -36,6 +36,10 @@
 #include "HC_ServoManager.h"
 #include "sub\HC_Protocol.h"
 #include "HC_Toolbox.h"
+#include "HC_Loopback.h"
+#include "HC_Peripheral.h"
+#include "HC_Mirror.h"
+#include "HC_Sampler.h"
 
 
 
@@ -45,8 +49,40 @@
 
 void HC_begin(long baudrate);
 void HC_begin();
+void HC_begin(Stream& stream);		// main session on another Stream (already started)
+
+// additional session on another Stream, with its own queries and subscriptions.
+// Ex: HC_Protocol logger(Serial1); ... HC_addSession(logger);
+void HC_addSession(HC_Protocol& session);
+
+#ifdef HC_MIRROR_COMPILE
+// board-to-board mirroring of DD/AD on another Stream, run by HC_communicate().
+// Ex: HC_Mirror mirror(Serial1); ... mirror.publishAD(0x0F); HC_addMirror(mirror);
+void HC_addMirror(HC_Mirror& mirror);
+#endif
+
+#ifdef HC_MULTIDROP
+// multi-drop bus (main session): node address, driver enable pin and turn-around delay (us, at least
+// 1 character time: the pin is set low once the last character is sent, without blocking)
+void HC_multidropNode(uint8_t node);
+void HC_multidropDriverEnable(uint8_t pin, unsigned int turnaroundDelay);
+#endif
+
+#ifdef HC_BAUDRATE_NEGOTIATION
+// baudrate of the main serial port (negotiated by the computer)
+long HC_readBaudrate();
+#endif
 
 void HC_communicate();
 
+// bytes queued on the serial port during the last HC_communicate() (main session)
+unsigned int HC_readQueuedBytes();
+
+// replies deferred because the serial TX buffer was full (HC_communicate() never blocks)
+unsigned long HC_readDeferredReplies();
+
+// replies dropped: longer than the output frame, or built while a deferred reply was still waiting
+unsigned long HC_readDroppedReplies();
+
 
 #endif
@@ -0,0 +1,265 @@
+/*
+ * HITIComm
+ * HC_Capture.cpp
+ *
+ * Copyright © 2021 Christophe LANDRET
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "HC_Capture.h"
+
+
+
+// *****************************************************************************
+// Compilation trigger
+// *****************************************************************************
+
+#ifdef HC_CAPTURE_COMPILE
+
+
+
+// *****************************************************************************
+// Include dependencies
+// *****************************************************************************
+
+// HITICommSupport
+#include "HITICommSupport.h"
+
+// HITIComm
+#include "HC_Data.h"
+
+
+
+// *****************************************************************************
+// Instanciates an object so that it can be reused in other files (forward declared in .h)
+// *****************************************************************************
+
+HC_Capture HC_capture;
+
+
+
+// *****************************************************************************
+// Class Methods
+// *****************************************************************************
+
+	// setters -----------------------------------------------------------------
+
+	void HC_Capture::setPeriod(unsigned long period)
+	{
+		mState = HC_CAPTURE_IDLE;
+		mPeriod = (period < HC_CAPTURE_MIN_PERIOD) ? HC_CAPTURE_MIN_PERIOD : period;
+	}
+
+	void HC_Capture::setPreTrigger(unsigned int frameQty)
+	{
+		mState = HC_CAPTURE_IDLE;
+		mPreTrigger = frameQty;
+	}
+
+	void HC_Capture::setTrigger(HC_CaptureTrigger source, uint8_t index, unsigned int level, HC_CaptureEdge edge)
+	{
+		mState = HC_CAPTURE_IDLE;
+		mTrigger_source = source;
+		mTrigger_index = index;
+		mTrigger_level = level;
+		mTrigger_edge = edge;
+	}
+
+	void HC_Capture::clearChannels()
+	{
+		mState = HC_CAPTURE_IDLE;
+		mChannelQty = 0;
+	}
+
+	bool HC_Capture::addChannel(uint8_t index)
+	{
+		mState = HC_CAPTURE_IDLE;
+
+		if ((mChannelQty >= HC_CAPTURE_MAX_CHANNEL_QTY) || (index > HCS_getAI_endIndex()))
+			return false;
+
+		mChannel[mChannelQty++] = index;
+		return true;
+	}
+
+
+	// control -----------------------------------------------------------------
+
+	void HC_Capture::arm()
+	{
+		if (mChannelQty == 0)
+			return;
+
+		// buffer is shared by all channels
+		mFrameCapacity = HC_CAPTURE_BUFFER_SIZE / mChannelQty;
+		if (mPreTrigger >= mFrameCapacity)
+			mPreTrigger = mFrameCapacity - 1;
+
+		// loop can't keep up with the period
+		if (mPeriod < HCS_getCycleTime())
+		{
+			mState = HC_CAPTURE_OVERRUN;
+			return;
+		}
+
+		mFrame_write = 0;
+		mFrame_count = 0;
+		mNextSampleTime = HCS_micros();
+		mState = HC_CAPTURE_ARMED;
+	}
+
+	void HC_Capture::stop()
+	{
+		mState = HC_CAPTURE_IDLE;
+	}
+
+	void HC_Capture::run()
+	{
+		if ((mState != HC_CAPTURE_ARMED) && (mState != HC_CAPTURE_TRIGGERED))
+			return;
+
+		// 1 frame at most, when its time has come
+		unsigned long now = HCS_micros();
+		if ((long)(now - mNextSampleTime) < 0)
+			return;
+
+		// sample missed since last call (cycle time > period): frames would not be spaced by the period
+		if ((long)(now - mNextSampleTime) >= (long)mPeriod)
+		{
+			mState = HC_CAPTURE_OVERRUN;
+			return;
+		}
+
+		mNextSampleTime += mPeriod;
+		sample();
+	}
+
+	void HC_Capture::sample()
+	{
+		// sample all channels
+		uint16_t* frame = &mBuffer[mFrame_write * mChannelQty];
+		unsigned int triggerValue = 0;
+		bool triggerValueIsRead = false;
+
+		for (uint8_t c = 0; c < mChannelQty; ++c)
+		{
+			frame[c] = HC_readAI(mChannel[c]);
+
+			// AI trigger on a captured channel: reuse the sample
+			if (mChannel[c] == mTrigger_index)
+			{
+				triggerValue = frame[c];
+				triggerValueIsRead = true;
+			}
+		}
+
+		unsigned int current = mFrame_write;
+		if (++mFrame_write >= mFrameCapacity)
+			mFrame_write = 0;
+
+		// triggered: count post-trigger frames
+		if (mState == HC_CAPTURE_TRIGGERED)
+		{
+			if (--mFrame_count == 0)
+				mState = HC_CAPTURE_DONE;
+			return;
+		}
+
+		// armed: check trigger
+		bool triggered = true;
+		if (mTrigger_source != HC_CAPTURE_TRIGGER_NONE)
+		{
+			bool input;
+			if (mTrigger_source == HC_CAPTURE_TRIGGER_AI)
+			{
+				if (!triggerValueIsRead)
+					triggerValue = HC_readAI(mTrigger_index);
+				input = (triggerValue >= mTrigger_level);
+			}
+			else
+				input = HC_readDI(mTrigger_index);
+
+			// edge (previous state is known after the first frame)
+			switch (mTrigger_edge)
+			{
+				case HC_CAPTURE_RISING:		triggered = !mTrigger_previous && input;	break;
+				case HC_CAPTURE_FALLING:	triggered = mTrigger_previous && !input;	break;
+				default:					triggered = mTrigger_previous != input;		break;
+			}
+			triggered = triggered && (mFrame_count > 0);
+			mTrigger_previous = input;
+		}
+
+		// trigger is accepted once the pre-trigger frames are captured
+		if (triggered && (mFrame_count >= mPreTrigger))
+		{
+			mFrame_trigger = current;
+			mFrame_count = mFrameCapacity - mPreTrigger - 1;
+			mState = (mFrame_count == 0) ? HC_CAPTURE_DONE : HC_CAPTURE_TRIGGERED;
+		}
+		else if (mFrame_count <= mPreTrigger)
+			++mFrame_count;
+	}
+
+
+	// getters -----------------------------------------------------------------
+
+	HC_CaptureState HC_Capture::getState() const
+	{
+		return (HC_CaptureState)mState;
+	}
+
+	unsigned long HC_Capture::getPeriod() const
+	{
+		return mPeriod;
+	}
+
+	unsigned int HC_Capture::getPreTrigger() const
+	{
+		return mPreTrigger;
+	}
+
+	uint8_t HC_Capture::getChannelQty() const
+	{
+		return mChannelQty;
+	}
+
+	uint8_t HC_Capture::getChannel(uint8_t channel) const
+	{
+		return (channel < mChannelQty) ? mChannel[channel] : 0;
+	}
+
+	unsigned int HC_Capture::getFrameQty() const
+	{
+		return (mState == HC_CAPTURE_DONE) ? mFrameCapacity : 0;
+	}
+
+	unsigned int HC_Capture::readSample(unsigned int frame, uint8_t channel) const
+	{
+		if ((frame >= mFrameCapacity) || (channel >= mChannelQty))
+			return 0;
+
+		// oldest frame: first pre-trigger frame
+		unsigned int i = mFrame_trigger + mFrameCapacity - mPreTrigger + frame;
+		if (i >= mFrameCapacity)
+			i -= mFrameCapacity;
+		if (i >= mFrameCapacity)
+			i -= mFrameCapacity;
+
+		return mBuffer[i * mChannelQty + channel];
+	}
+
+
+#endif // HC_CAPTURE_COMPILE
@@ -44,6 +44,10 @@
 // to comment to prevent compiling
 //#define HC_MAIN_TRY_COMPILE
 #define HC_EEPROM_TRY_COMPILE
+//#define HC_CAPTURE_TRY_COMPILE	// capture buffer: 1KB of RAM
+//#define HC_PERIPHERAL_TRY_COMPILE	// uses Wire (I2C)
+//#define HC_MIRROR_TRY_COMPILE
+//#define HC_SAMPLER_TRY_COMPILE	// uses the ADC interrupt (ADC_vect) on AVR boards if HC_SAMPLER_INTERRUPT_EXPERIMENTAL (HC_Sampler.h)
 
 #ifdef HC_MAIN_TRY_COMPILE
 	#define HC_STRINGMESSAGE_COMPILE
@@ -55,4 +59,24 @@
 	#define HC_EEPROM_COMPILE
 #endif
 
+// capture buffer uses RAM: not on boards with 2.5KB of RAM or less
+#if defined(HC_CAPTURE_TRY_COMPILE) && ((HC_VARIANT == HC_VARIANT_MEGA) || defined(ARDUINO_ARCH_SAMD))
+	#define HC_CAPTURE_COMPILE
+#endif
+
+// peripheral transport (polled by a master MCU)
+#ifdef HC_PERIPHERAL_TRY_COMPILE
+	#define HC_PERIPHERAL_COMPILE
+#endif
+
+// board-to-board mirroring of DD/AD
+#ifdef HC_MIRROR_TRY_COMPILE
+	#define HC_MIRROR_COMPILE
+#endif
+
+// background AI sampler (HC_readAI() without waiting for a conversion)
+#ifdef HC_SAMPLER_TRY_COMPILE
+	#define HC_SAMPLER_COMPILE
+#endif
+
 #endif
\ No newline at end of file
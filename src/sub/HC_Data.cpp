@@ -34,6 +34,7 @@
 // HITIComm
 #include "HC_Toolbox.h"
 #include "HC_ServoManager.h"
+#include "HC_Sampler.h"
 
 
 
@@ -49,6 +50,24 @@
 #define HC_IN_PU 2
 #define HC_IN_PD 3
 
+// DIO ports: max DIO pins and ports in the port table
+#if HC_VARIANT == HC_VARIANT_MEGA
+    #define HCI_DIO_MAX_QTY         64
+    #define HCI_DIO_PORT_MAX_QTY    12
+#else
+    #define HCI_DIO_MAX_QTY         32
+    #define HCI_DIO_PORT_MAX_QTY    4
+#endif
+
+#define HCI_DIO_NO_PORT         0xFF    // pin read pin by pin
+
+// port register (PINx/PORTx on AVR boards, IN/OUT on SAMD boards)
+#if defined(ARDUINO_ARCH_SAMD)
+    typedef uint32_t HCI_PortRegister;
+#else
+    typedef uint8_t HCI_PortRegister;
+#endif
+
 
 
 // *****************************************************************************
@@ -107,6 +126,22 @@ static const char* g_pgm_projectVersion = NULL_POINTER;
 #endif  
 
 
+// DIO ports: input and output registers of each port, port and bit of each DIO pin
+// (built by HCI_initializeDIOPorts() from the pin mapping of the board)
+static volatile HCI_PortRegister* g_DIO_portInput[HCI_DIO_PORT_MAX_QTY];
+static volatile HCI_PortRegister* g_DIO_portOutput[HCI_DIO_PORT_MAX_QTY];
+static volatile HCI_PortRegister* g_DIO_portMode[HCI_DIO_PORT_MAX_QTY];
+static uint8_t g_DIO_portQty = 0;
+static uint8_t g_DIO_pinPort[HCI_DIO_MAX_QTY];              // HCI_DIO_NO_PORT: no port
+static HCI_PortRegister g_DIO_pinMask[HCI_DIO_MAX_QTY];
+static uint8_t g_DIO_pinQty = 0;                            // 0: table not built
+
+// DO writable by port (output type digital or PWM not available, no servo)
+// => refreshed at the next register write after a change of output type or servo mode
+static HCI_PortRegister g_DIO_portWritable[HCI_DIO_PORT_MAX_QTY];
+static bool g_DIO_portWritable_isValid = false;
+
+
 // HITI Digital Data register
 // => binary mode (0: LOW, 1: HIGH)       
 static long unsigned g_DD = 0; // unsigned int (32 bit)
@@ -630,6 +665,7 @@ bool HCI_InputsMode_hasChanged()
             g_OutputTypes_hasChanged = true;
             g_outputType_L = Output_type_L;
             g_outputType_H = Output_type_H;
+            HCI_invalidateWritableDO();
 
             // update Outputs
             HCI_updateOutputs();
@@ -643,6 +679,7 @@ bool HCI_InputsMode_hasChanged()
         {
             g_OutputTypes_hasChanged = true;
             g_outputType = Output_type;
+            HCI_invalidateWritableDO();
 
             // update Outputs
             HCI_updateOutputs();
@@ -690,8 +727,12 @@ void HC_outputType(uint8_t index, bool value)
     #endif
 
     if(g_OutputTypes_hasChanged)
+    {
+        HCI_invalidateWritableDO();
+
         // update Output
         HCI_updateOutput(index);
+    }
 }
 
 
@@ -867,53 +908,193 @@ bool HCI_PWMavailability_hasChanged()
 
 
 // -----------------------------------------------------------------------------
-// DI --------------------------------------------------------------------------
+// DIO ports -------------------------------------------------------------------
 // -----------------------------------------------------------------------------
 
+// DI and DO registers are read port by port: each port register is read once (all pins are
+// sampled at the same time), then its bits are remapped to the pins through the port table.
+// Pins without port (or if the table is not built yet) are read pin by pin.
+// DO registers are written the same way, with a masked read-modify-write of each port.
+
+// build the port table *********************************************************
+void HCI_initializeDIOPorts()
+{
+    g_DIO_portQty = 0;
+    g_DIO_pinQty = (HCS_getDIO_endIndex() < HCI_DIO_MAX_QTY) ? HCS_getDIO_endIndex() + 1 : HCI_DIO_MAX_QTY;
+
+    for (uint8_t index = 0; index < g_DIO_pinQty; ++index)
+    {
+        g_DIO_pinPort[index] = HCI_DIO_NO_PORT;
+
+        #if !defined(ARDUINO_ARCH_SAMD)
+            if (digitalPinToPort(index) == NOT_A_PORT)
+                continue;
+        #endif
+
+        volatile HCI_PortRegister* input = portInputRegister(digitalPinToPort(index));
+        if (input == NULL_POINTER)
+            continue;
+
+        // port already in the table, or new port
+        uint8_t port = 0;
+        while ((port < g_DIO_portQty) && (g_DIO_portInput[port] != input))
+            ++port;
+
+        if (port == g_DIO_portQty)
+        {
+            if (port == HCI_DIO_PORT_MAX_QTY)
+                continue;
+
+            g_DIO_portInput[port] = input;
+            g_DIO_portOutput[port] = portOutputRegister(digitalPinToPort(index));
+            g_DIO_portMode[port] = portModeRegister(digitalPinToPort(index));
+            ++g_DIO_portQty;
+        }
+
+        g_DIO_pinPort[index] = port;
+        g_DIO_pinMask[index] = (HCI_PortRegister) digitalPinToBitMask(index);
+    }
+
+    HCI_invalidateWritableDO();
+}
+
+
+// read all ports at once *******************************************************
+static void HCI_sampleDIOPorts(bool isOutput, HCI_PortRegister* sample)
+{
+    volatile HCI_PortRegister** registers = isOutput ? g_DIO_portOutput : g_DIO_portInput;
+
+    for (uint8_t port = 0; port < g_DIO_portQty; ++port)
+        sample[port] = *registers[port];
+}
+
+
+// pins first -> last of a sample, in a register (bit 0: first) ****************
+static long unsigned HCI_remapDIOPorts(bool isOutput, const HCI_PortRegister* sample, uint8_t first, uint8_t last)
+{
+    long unsigned reg = 0;
+
+    uint8_t index = last + 1;
+    while (index > first)
+    {
+        --index;
+
+        bool value;
+        if ((index < g_DIO_pinQty) && (g_DIO_pinPort[index] != HCI_DIO_NO_PORT))
+            value = (sample[g_DIO_pinPort[index]] & g_DIO_pinMask[index]) != 0;
+        else
+            value = isOutput ? HCS_readDO_LA(index) : HCS_readDI_LA(index);
+
+        reg = (reg << 1) | value;
+    }
+
+    return reg;
+}
+
+static long unsigned HCI_readDIOPorts(bool isOutput, uint8_t first, uint8_t last)
+{
+    HCI_PortRegister sample[HCI_DIO_PORT_MAX_QTY];
+    HCI_sampleDIOPorts(isOutput, sample);
+
+    return HCI_remapDIOPorts(isOutput, sample, first, last);
+}
 
-// read register ***************************************************************
 #if HC_VARIANT == HC_VARIANT_MEGA
-    long unsigned HC_readDI_L()
+    static void HCI_readDIOPorts(bool isOutput, long unsigned& reg_H, long unsigned& reg_L)
     {
-        long unsigned reg = 0;
-        
-		// if input, read digital input
-        //for (uint8_t index = 0; index <= 31; ++index)
-        uint8_t index = 32;
-        while (index)
+        HCI_PortRegister sample[HCI_DIO_PORT_MAX_QTY];
+        HCI_sampleDIOPorts(isOutput, sample);
+
+        reg_L = HCI_remapDIOPorts(isOutput, sample, 0, 31);
+        reg_H = HCI_remapDIOPorts(isOutput, sample, 32, HCS_getDIO_endIndex());
+    }
+#endif
+
+
+// writable DO mask ************************************************************
+void HCI_invalidateWritableDO()
+{
+    g_DIO_portWritable_isValid = false;
+}
+
+static void HCI_refreshWritableDO()
+{
+    for (uint8_t port = 0; port < g_DIO_portQty; ++port)
+        g_DIO_portWritable[port] = 0;
+
+    for (uint8_t index = HCS_getDIO_startIndex(); index < g_DIO_pinQty; ++index)
+    {
+        if ((g_DIO_pinPort[index] != HCI_DIO_NO_PORT) &&
+            (!HC_readOutputType(index) || !HC_PwmIsAvailable(index)) &&
+            !HC_readServoMode(index))
+            g_DIO_portWritable[g_DIO_pinPort[index]] |= g_DIO_pinMask[index];
+    }
+
+    g_DIO_portWritable_isValid = true;
+}
+
+
+// write all ports at once ******************************************************
+// Pin mode is read from the port mode register (pinMode() may be called by the sketch).
+// Pins without port are written pin by pin.
+static void HCI_writeDIOPorts(long unsigned reg_H, long unsigned reg_L)
+{
+    if (!g_DIO_portWritable_isValid)
+        HCI_refreshWritableDO();
+
+    HCI_PortRegister value[HCI_DIO_PORT_MAX_QTY] = { 0 };
+
+    for (uint8_t index = HCS_getDIO_startIndex(); index <= HCS_getDIO_endIndex(); ++index)
+    {
+        bool bit = (index < 32) ? HCS_readBit(reg_L, index) : HCS_readBit(reg_H, index - 32);
+
+        if ((index < g_DIO_pinQty) && (g_DIO_pinPort[index] != HCI_DIO_NO_PORT))
         {
-            --index;
-            HCS_writeBit(reg, index, HCS_readDI_LA(index));
+            if (bit)
+                value[g_DIO_pinPort[index]] |= g_DIO_pinMask[index];
         }
+        else
+            HC_writeDO(index, bit);
+    }
 
-        return reg;
+    // all outputs switch at the same time
+    noInterrupts();
+    for (uint8_t port = 0; port < g_DIO_portQty; ++port)
+    {
+        HCI_PortRegister mask = g_DIO_portWritable[port] & *g_DIO_portMode[port];
+        *g_DIO_portOutput[port] = (*g_DIO_portOutput[port] & ~mask) | (value[port] & mask);
+    }
+    interrupts();
+}
+
+
+
+// -----------------------------------------------------------------------------
+// DI --------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+
+// read register ***************************************************************
+#if HC_VARIANT == HC_VARIANT_MEGA
+    long unsigned HC_readDI_L()
+    {
+        return HCI_readDIOPorts(false, 0, 31);
     }
 
     long unsigned HC_readDI_H()
     {
-        long unsigned reg = 0;
-		
-        // if input, read digital input
-        for(uint8_t index = 32; index <= HCS_getDIO_endIndex(); ++index)
-			HCS_writeBit(reg, index - 32, HCS_readDI_LA(index));
+        return HCI_readDIOPorts(false, 32, HCS_getDIO_endIndex());
+    }
 
-        return reg;
+    // all pins sampled at the same time
+    void HC_readDI(long unsigned& reg_H, long unsigned& reg_L)
+    {
+        HCI_readDIOPorts(false, reg_H, reg_L);
     }
 #else
     long unsigned HC_readDI()
     {
-        long unsigned reg = 0;
-        
-        // if input, read digital input
-        //for(uint8_t index = 0; index <= HCS_getDIO_endIndex(); ++index)
-        uint8_t index = HCS_getDIO_endIndex() + 1;
-        while (index)
-        {
-            --index;
-            HCS_writeBit(reg, index, HCS_readDI_LA(index));
-        }
-
-        return reg;
+        return HCI_readDIOPorts(false, 0, HCS_getDIO_endIndex());
     }
 #endif
 
@@ -936,26 +1117,16 @@ bool HC_readDI(uint8_t index)
 
 
 // write register **************************************************************
-// internal call to HCS_digitalWrite()
+// masked write of the port registers (writable DO only)
 #if HC_VARIANT == HC_VARIANT_MEGA
     void HC_writeDO(unsigned long reg_H, unsigned long reg_L)
     {
-        // call HCS_digitalWrite() on every DIO pins, based on registers
-        // call to HCS_digitalWrite() reset PWM
-        for(uint8_t index = HCS_getDIO_startIndex(); index <= HCS_getDIO_endIndex(); ++index)
-        {
-            if(index < 32)
-                HC_writeDO(index, (bool) HCS_readBit(reg_L, index));
-            else
-                HC_writeDO(index, (bool) HCS_readBit(reg_H, index - 32));
-        }
+        HCI_writeDIOPorts(reg_H, reg_L);
     }
 #else
     void HC_writeDO(unsigned long reg)
     {
-        // call HCS_digitalWrite() on every DIO pins, based on registers
-        for(uint8_t index = HCS_getDIO_startIndex(); index <= HCS_getDIO_endIndex(); ++index)
-            HC_writeDO(index, (bool) HCS_readBit(reg, index));
+        HCI_writeDIOPorts(0, reg);
     }
 #endif
 
@@ -982,45 +1153,23 @@ void HC_writeDO(uint8_t index, bool value)
 #if HC_VARIANT == HC_VARIANT_MEGA
     long unsigned HC_readDO_L()
     {
-        long unsigned reg = 0;
-        
-		// if output, read digital output
-        //for (uint8_t index = 0; index <= 31; ++index)
-        uint8_t index = 32;
-        while (index)
-        {
-            --index;
-                HCS_writeBit(reg, index, HC_readDO(index));
-        }
-
-        return reg;
+        return HCI_readDIOPorts(true, 0, 31);
     }
 
     long unsigned HC_readDO_H()
     {
-        long unsigned reg = 0;
-        
-		// if output, read digital output
-        for(uint8_t index = 32; index <= HCS_getDIO_endIndex(); ++index)
-		    HCS_writeBit(reg, index - 32, HC_readDO(index));
-        
-        return reg;
+        return HCI_readDIOPorts(true, 32, HCS_getDIO_endIndex());
+    }
+
+    // all pins sampled at the same time
+    void HC_readDO(long unsigned& reg_H, long unsigned& reg_L)
+    {
+        HCI_readDIOPorts(true, reg_H, reg_L);
     }
 #else
     long unsigned HC_readDO()
     {
-        long unsigned reg = 0;
-        
-		// if output, read digital output
-        //for(uint8_t index = 0; index <= HCS_getDIO_endIndex(); ++index)
-        uint8_t index = HCS_getDIO_endIndex() + 1;
-        while (index)
-        {
-            --index;
-            HCS_writeBit(reg, index, HC_readDO(index));
-        }
-
-        return reg;
+        return HCI_readDIOPorts(true, 0, HCS_getDIO_endIndex());
     }
 #endif
 
@@ -1037,15 +1186,26 @@ bool HC_readDO(uint8_t index)
 
 
 // update DO *******************************************************************
+// pin by pin: call to HCS_writeDO_LA() resets PWM (pins switched to digital)
 #if HC_VARIANT == HC_VARIANT_MEGA
     void HCI_updateDO()
     {
-        HC_writeDO(HC_readDO_H(), HC_readDO_L());
+        unsigned long reg_H = HC_readDO_H();
+        unsigned long reg_L = HC_readDO_L();
+
+        for(uint8_t index = HCS_getDIO_startIndex(); index <= HCS_getDIO_endIndex(); ++index)
+        {
+            if(index < 32)
+                HC_writeDO(index, (bool) HCS_readBit(reg_L, index));
+            else
+                HC_writeDO(index, (bool) HCS_readBit(reg_H, index - 32));
+        }
     }
 #else
     void HCI_updateDO()
     {
-        HC_writeDO(0);
+        for(uint8_t index = HCS_getDIO_startIndex(); index <= HCS_getDIO_endIndex(); ++index)
+            HC_writeDO(index, HC_LOW);
     }
 #endif
 
@@ -1126,7 +1286,7 @@ bool HC_PwmIsActivated(uint8_t index)
 
 uint8_t HCI_getPWM_qty()
 {
-    uint8_t counter;
+    uint8_t counter = 0;
 
     //for (uint8_t index = 0; index <= HCS_getDIO_endIndex(); ++index)
     uint8_t index = HCS_getDIO_endIndex() + 1;
@@ -1230,8 +1390,16 @@ unsigned int HC_readDAC(uint8_t index)
 unsigned int HC_readAI(uint8_t index)
 {        
     if (index <= HCS_getAI_endIndex())
+    {
+        #ifdef HC_SAMPLER_COMPILE
+            // latest conversion of the background sampler
+            if (HC_sampler.isStarted())
+                return HC_sampler.read(index);
+        #endif
+
         // read analog input and return
         return (unsigned int)HCS_readAI_LA(index);
+    }
 
     return 0;
 }
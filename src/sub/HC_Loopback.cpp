@@ -0,0 +1,88 @@
+/*
+ * HITIComm
+ * HC_Loopback.cpp
+ *
+ * Copyright © 2021 Christophe LANDRET
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "HC_Loopback.h"
+
+
+
+// *****************************************************************************
+// Class Methods
+// *****************************************************************************
+
+	void HC_Loopback::connect(HC_Loopback& peer)
+	{
+		mPeer = &peer;
+		peer.mPeer = this;
+	}
+
+
+	// Stream ------------------------------------------------------------------
+
+	int HC_Loopback::available()
+	{
+		return mBuffer_length;
+	}
+
+	int HC_Loopback::read()
+	{
+		if (mBuffer_length == 0)
+			return -1;
+
+		uint8_t b = mBuffer[mBuffer_start];
+		if (++mBuffer_start >= HC_LOOPBACK_BUFFER_SIZE)
+			mBuffer_start = 0;
+		--mBuffer_length;
+
+		return b;
+	}
+
+	int HC_Loopback::peek()
+	{
+		return (mBuffer_length == 0) ? -1 : mBuffer[mBuffer_start];
+	}
+
+
+	// Print -------------------------------------------------------------------
+
+	size_t HC_Loopback::write(uint8_t b)
+	{
+		return mPeer->receive(b) ? 1 : 0;
+	}
+
+	int HC_Loopback::availableForWrite()
+	{
+		return HC_LOOPBACK_BUFFER_SIZE - mPeer->mBuffer_length;
+	}
+
+
+	// private -----------------------------------------------------------------
+
+	bool HC_Loopback::receive(uint8_t b)
+	{
+		if (mBuffer_length >= HC_LOOPBACK_BUFFER_SIZE)
+			return false;
+
+		unsigned int i = mBuffer_start + mBuffer_length++;
+		if (i >= HC_LOOPBACK_BUFFER_SIZE)
+			i -= HC_LOOPBACK_BUFFER_SIZE;
+		mBuffer[i] = b;
+
+		return true;
+	}
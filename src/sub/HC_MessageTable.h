@@ -0,0 +1,219 @@
+/*
+ * HITIComm
+ * HC_MessageTable.h
+ *
+ * Copyright © 2021 Christophe LANDRET
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// *****************************************************************************
+// Include Guard
+// *****************************************************************************
+
+#ifndef HC_MessageTable_h
+#define HC_MessageTable_h
+
+
+
+// *****************************************************************************
+// Protocol definitions
+// *****************************************************************************
+
+// Shared by the board (HC_Protocol) and the computer (host client, extras/host/client):
+// no dependency, only defines.
+
+
+// Protocol options (PROTOBF_OPTION) -------------------------------------------
+
+#define PROTOBF_OPTIONS_FULLY_READABLE	0 // int, separator, readable
+#define PROTOBF_OPTIONS_USE_INT			1 // int, separator
+#define PROTOBF_OPTIONS_USE_SEPARATOR	2 // hex, separator,          CRC
+#define PROTOBF_OPTIONS_HEX				3 // hex,                     CRC
+#define PROTOBF_OPTIONS_BINARY			4 // binary (little-endian),  CRC-16, COBS framing
+
+
+// Message descriptor flags ----------------------------------------------------
+
+// flags: what the computer can send. 0: message is only sent by the board (or not compiled)
+#define HC_MESSAGE_QUERY		0x01	// accepted
+#define HC_MESSAGE_WRITE		0x02	// write mode accepted (else error RW)
+#define HC_MESSAGE_INDEX		0x04	// target index accepted (else error IA)
+#define HC_MESSAGE_NOINDEX		0x08	// accepted without target index (else error IR)
+#define HC_MESSAGE_ADDRESS		0x10	// target address accepted (else error AD)
+
+// flags: target index range (else error IN)
+#define HC_MESSAGE_RANGE_MASK	0x60
+#define HC_MESSAGE_RANGE_ANY	0x00	// checked by the handler
+#define HC_MESSAGE_RANGE_PIN	0x20	// pin (DIO or AI)
+#define HC_MESSAGE_RANGE_DD		0x40	// Digital Data
+#define HC_MESSAGE_RANGE_AD		0x60	// Analog Data
+
+// shortcuts
+#define HC_MESSAGE_READ_NOINDEX		(HC_MESSAGE_QUERY | HC_MESSAGE_NOINDEX)
+#define HC_MESSAGE_COMMAND			(HC_MESSAGE_QUERY | HC_MESSAGE_WRITE | HC_MESSAGE_NOINDEX)
+#define HC_MESSAGE_READ_PIN			(HC_MESSAGE_QUERY | HC_MESSAGE_INDEX | HC_MESSAGE_NOINDEX | HC_MESSAGE_RANGE_PIN)
+#define HC_MESSAGE_WRITE_PIN		(HC_MESSAGE_READ_PIN | HC_MESSAGE_WRITE)
+
+
+// Message Types ---------------------------------------------------------------
+
+// range of codes
+#define HC_MESSAGETYPE_FIRST	0x30
+#define HC_MESSAGETYPE_LAST		0x7D
+#define HC_MESSAGETYPE_QTY		(HC_MESSAGETYPE_LAST - HC_MESSAGETYPE_FIRST + 1)
+
+// 1 row per code, from HC_MESSAGETYPE_FIRST to HC_MESSAGETYPE_LAST (dense: unused codes are GAP rows)
+//   ENTRY(name, code, name char 0, name char 1, flags)
+//   GAP(code)
+// The name (2 chars) is sent instead of the code if PROTOBF_USE_READABLE_MESSAGETYPE.
+// Flags of optional features are wrapped by the includer: HC_MESSAGE_ARDUINOTIME(flags),
+// HC_MESSAGE_STRING, HC_MESSAGE_EEPROM, HC_MESSAGE_DAC, HC_MESSAGE_CAPTURE, HC_MESSAGE_MULTIDROP,
+// HC_MESSAGE_BAUDRATE, HC_MESSAGE_FLOWCONTROL, HC_MESSAGE_SAMPLER (0 if the feature is not compiled).
+#define HC_MESSAGETYPE_TABLE(ENTRY, GAP) \
+	ENTRY(Bq, 0x30, 'B', 'q', 0)																				\
+	ENTRY(Bf, 0x31, 'B', 'f', HC_MESSAGE_COMMAND | HC_MESSAGE_INDEX)											\
+	ENTRY(BS, 0x32, 'B', 'S', 0)																				\
+	ENTRY(Br, 0x33, 'B', 'r', HC_MESSAGE_BAUDRATE(HC_MESSAGE_COMMAND | HC_MESSAGE_INDEX))						\
+	ENTRY(Bp, 0x34, 'B', 'p', HC_MESSAGE_BAUDRATE(HC_MESSAGE_READ_NOINDEX))										\
+	ENTRY(Fc, 0x35, 'F', 'c', HC_MESSAGE_FLOWCONTROL(HC_MESSAGE_COMMAND))										\
+	ENTRY(Ar, 0x36, 'A', 'r', HC_MESSAGE_SAMPLER(HC_MESSAGE_WRITE_PIN))											\
+	GAP(0x37)																									\
+	GAP(0x38)																									\
+	GAP(0x39)																									\
+	ENTRY(M0, 0x3A, 'M', '0', HC_MESSAGE_READ_NOINDEX)															\
+	GAP(0x3B)																									\
+	GAP(0x3C)																									\
+	ENTRY(FR, 0x3D, 'F', 'R', HC_MESSAGE_READ_NOINDEX)															\
+	GAP(0x3E)																									\
+	GAP(0x3F)																									\
+	ENTRY(X0, 0x40, 'X', '0', 0)																				\
+	ENTRY(X1, 0x41, 'X', '1', 0)																				\
+	ENTRY(X2, 0x42, 'X', '2', 0)																				\
+	ENTRY(X3, 0x43, 'X', '3', 0)																				\
+	ENTRY(X4, 0x44, 'X', '4', 0)																				\
+	ENTRY(X5, 0x45, 'X', '5', 0)																				\
+	ENTRY(X6, 0x46, 'X', '6', 0)																				\
+	ENTRY(X7, 0x47, 'X', '7', 0)																				\
+	ENTRY(X8, 0x48, 'X', '8', 0)																				\
+	ENTRY(X9, 0x49, 'X', '9', 0)																				\
+	ENTRY(XA, 0x4A, 'X', 'A', 0)																				\
+	ENTRY(XB, 0x4B, 'X', 'B', 0)																				\
+	ENTRY(XC, 0x4C, 'X', 'C', 0)																				\
+	ENTRY(XD, 0x4D, 'X', 'D', 0)																				\
+	ENTRY(XE, 0x4E, 'X', 'E', 0)																				\
+	ENTRY(XF, 0x4F, 'X', 'F', 0)																				\
+	ENTRY(XG, 0x50, 'X', 'G', 0)																				\
+	ENTRY(XH, 0x51, 'X', 'H', 0)																				\
+	GAP(0x52)																									\
+	GAP(0x53)																									\
+	GAP(0x54)																									\
+	GAP(0x55)																									\
+	GAP(0x56)																									\
+	GAP(0x57)																									\
+	GAP(0x58)																									\
+	GAP(0x59)																									\
+	ENTRY(CT, 0x5A, 'C', 'T', HC_MESSAGE_READ_NOINDEX)															\
+	ENTRY(Xs, 0x5B, 'X', 's', HC_MESSAGE_COMMAND)																\
+	ENTRY(TM, 0x5C, 'T', 'M', HC_MESSAGE_ARDUINOTIME(HC_MESSAGE_READ_NOINDEX))									\
+	ENTRY(Xu, 0x5D, 'X', 'u', HC_MESSAGE_COMMAND)																\
+	GAP(0x5E)																									\
+	GAP(0x5F)																									\
+	ENTRY(PM, 0x60, 'P', 'M', HC_MESSAGE_WRITE_PIN)																\
+	ENTRY(DI, 0x61, 'D', 'I', HC_MESSAGE_READ_PIN)																\
+	ENTRY(DO, 0x62, 'D', 'O', HC_MESSAGE_WRITE_PIN)																\
+	ENTRY(AI, 0x63, 'A', 'I', HC_MESSAGE_QUERY | HC_MESSAGE_INDEX | HC_MESSAGE_RANGE_PIN)						\
+	ENTRY(OT, 0x64, 'O', 'T', HC_MESSAGE_WRITE_PIN)																\
+	ENTRY(PA, 0x65, 'P', 'A', HC_MESSAGE_READ_PIN)																\
+	ENTRY(PW, 0x66, 'P', 'W', HC_MESSAGE_QUERY | HC_MESSAGE_WRITE | HC_MESSAGE_INDEX | HC_MESSAGE_RANGE_PIN)	\
+	ENTRY(SM, 0x67, 'S', 'M', HC_MESSAGE_WRITE_PIN)																\
+	ENTRY(SV, 0x68, 'S', 'V', HC_MESSAGE_QUERY | HC_MESSAGE_WRITE | HC_MESSAGE_INDEX)							\
+	ENTRY(DD, 0x69, 'D', 'D', HC_MESSAGE_COMMAND | HC_MESSAGE_INDEX | HC_MESSAGE_RANGE_DD)						\
+	ENTRY(AM, 0x6A, 'A', 'M', HC_MESSAGE_READ_NOINDEX | HC_MESSAGE_INDEX | HC_MESSAGE_RANGE_AD)					\
+	ENTRY(AD, 0x6B, 'A', 'D', HC_MESSAGE_QUERY | HC_MESSAGE_WRITE | HC_MESSAGE_INDEX | HC_MESSAGE_RANGE_AD)		\
+	ENTRY(DM, 0x6C, 'D', 'M', HC_MESSAGE_DAC(HC_MESSAGE_COMMAND | HC_MESSAGE_INDEX))							\
+	ENTRY(DA, 0x6D, 'D', 'A', HC_MESSAGE_DAC(HC_MESSAGE_QUERY | HC_MESSAGE_WRITE | HC_MESSAGE_INDEX))			\
+	GAP(0x6E)																									\
+	GAP(0x6F)																									\
+	ENTRY(EE, 0x70, 'E', 'E', HC_MESSAGE_EEPROM(HC_MESSAGE_COMMAND | HC_MESSAGE_INDEX | HC_MESSAGE_ADDRESS))	\
+	ENTRY(Es, 0x71, 'E', 's', 0)																				\
+	ENTRY(Ee, 0x72, 'E', 'e', 0)																				\
+	ENTRY(Ec, 0x73, 'E', 'c', HC_MESSAGE_EEPROM(HC_MESSAGE_COMMAND))											\
+	ENTRY(Ep, 0x74, 'E', 'p', HC_MESSAGE_EEPROM(HC_MESSAGE_COMMAND | HC_MESSAGE_INDEX))							\
+	ENTRY(Ca, 0x75, 'C', 'a', HC_MESSAGE_CAPTURE(HC_MESSAGE_COMMAND))											\
+	ENTRY(Cr, 0x76, 'C', 'r', HC_MESSAGE_CAPTURE(HC_MESSAGE_COMMAND))											\
+	ENTRY(Cd, 0x77, 'C', 'd', 0)																				\
+	ENTRY(NP, 0x78, 'N', 'P', HC_MESSAGE_MULTIDROP(HC_MESSAGE_READ_NOINDEX))									\
+	ENTRY(S0, 0x79, 'S', '0', HC_MESSAGE_STRING(HC_MESSAGE_COMMAND))											\
+	ENTRY(Aq, 0x7A, 'A', 'q', 0)																				\
+	ENTRY(As, 0x7B, 'A', 's', HC_MESSAGE_COMMAND)																\
+	GAP(0x7C)																									\
+	ENTRY(Au, 0x7D, 'A', 'u', HC_MESSAGE_COMMAND)																\
+
+
+// Flow control ----------------------------------------------------------------
+
+// credits (Fc message): unit
+#define HC_FLOW_UNIT_NONE			0	// no flow control (default)
+#define HC_FLOW_UNIT_FRAMES			1
+#define HC_FLOW_UNIT_BYTES			2
+
+// credits granted by any query: bit 3 of the config byte, then the credit (4 hex chars, 2 bytes if binary,
+// decimal if PROTOBF_USE_INT) after the index and address
+#define HC_FLOW_CONFIG_CREDIT		0x08
+
+
+// Baudrates -------------------------------------------------------------------
+
+// baudrates which can be negotiated (Br message): the index is sent, not the baudrate.
+// Supported baudrates are sent as a mask (1 bit per index)
+//   ENTRY(index, baudrate)
+#define HC_BAUDRATE_TABLE(ENTRY) \
+	ENTRY(0, 9600)		\
+	ENTRY(1, 19200)		\
+	ENTRY(2, 38400)		\
+	ENTRY(3, 57600)		\
+	ENTRY(4, 115200)	\
+	ENTRY(5, 230400)	\
+	ENTRY(6, 250000)	\
+	ENTRY(7, 500000)	\
+	ENTRY(8, 1000000)	\
+	ENTRY(9, 2000000)
+
+#define HC_BAUDRATE_QTY				10
+#define HC_BAUDRATE_NONE			0xFF	// baudrate which is not in the table
+
+// after a change (Br), the board goes back to the previous baudrate if not confirmed (Bp, then another frame)
+#define HC_BAUDRATE_PROBE_TIMEOUT	500		// ms
+
+
+// Message Errors --------------------------------------------------------------
+
+// error replies (!): code (1 char), or name (2 chars) if PROTOBF_USE_READABLE_MESSAGETYPE
+//   ENTRY(name, code, name char 0, name char 1)
+#define HC_MESSAGEERROR_TABLE(ENTRY) \
+	ENTRY(AM, 0x30, 'A', 'M')	/* Address Missing */			\
+	ENTRY(IA, 0x31, 'I', 'A')	/* Index not Allowed */			\
+	ENTRY(MT, 0x32, 'M', 'T')	/* invalid Message Type */		\
+	ENTRY(RW, 0x33, 'R', 'W')	/* invalid Read Write mode */	\
+	ENTRY(IN, 0x34, 'I', 'N')	/* invalid INdex */				\
+	ENTRY(AD, 0x35, 'A', 'D')	/* invalid ADdress */			\
+	ENTRY(US, 0x36, 'U', 'S')	/* Unknown Sender */			\
+	ENTRY(TS, 0x37, 'T', 'S')	/* message is Too Short */		\
+	ENTRY(CS, 0x38, 'C', 'S')	/* Invalid Checksum */			\
+	ENTRY(CM, 0x39, 'C', 'M')	/* Checksum mismatch */			\
+	ENTRY(IR, 0x3A, 'I', 'R')	/* Index Required */
+
+
+#endif
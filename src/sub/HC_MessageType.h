@@ -0,0 +1,216 @@
+/*
+ * HITIComm
+ * HC_MessageType.h
+ *
+ * Copyright © 2021 Christophe LANDRET
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// *****************************************************************************
+// Include Guard
+// *****************************************************************************
+
+#ifndef HC_MessageType_h
+#define HC_MessageType_h
+
+
+
+// *****************************************************************************
+// Include dependencies
+// *****************************************************************************
+
+// AVR
+#include <avr\pgmspace.h>
+
+// HITIComm
+#include "sub\HC_Protocol.h"
+#include "sub\HC_MessageTable.h"
+
+
+
+// *****************************************************************************
+// Message Type
+// *****************************************************************************
+
+// Message Type code (1 char). If PROTOBF_USE_READABLE_MESSAGETYPE, the 2 chars
+// name of the descriptor (see below) is sent instead.
+enum MessageType
+{
+	HC_MessageType_Bq = 0x30,  // B query replies (Board features 0-3)
+	HC_MessageType_Bf = 0x31,  // B query request (Board features)
+	HC_MessageType_BS = 0x32,  // Board has started (or has reset)
+#ifdef HC_BAUDRATE_NEGOTIATION
+	HC_MessageType_Br = 0x33,  // Baudrate: supported baudrates (read), change (write)
+	HC_MessageType_Bp = 0x34,  // Baudrate probe: confirms the new baudrate
+#endif
+#ifdef HC_FLOW_CONTROL
+	HC_MessageType_Fc = 0x35,  // Flow control: credit unit and credits (write), state (read)
+#endif
+#ifdef HC_SAMPLER_COMPILE
+	HC_MessageType_Ar = 0x36,  // AI resolution: AI hex length (read), oversampling of 1 AI (write)
+#endif
+
+	HC_MessageType_M0 = 0x3A,  // SRAM (Break value 0, Stack Pointer 0)
+	HC_MessageType_FR = 0x3D,  // Free RAM (measurement 0-2)
+
+	HC_MessageType_X0 = 0x40,  // XQuery period, Cycle Time
+	HC_MessageType_X1 = 0x41,  // AI values (part 1 : 0 - 7)
+	HC_MessageType_X2 = 0x42,  // AI values (part 2 : 8 - 15)
+	HC_MessageType_X3 = 0x43,  // PWM values (part 1 : 0 - 7)
+	HC_MessageType_X4 = 0x44,  // PWM values (part 1 : 8 - 15)
+	HC_MessageType_X5 = 0x45,  // Servo values (part 1 :  0 - 5)
+	HC_MessageType_X6 = 0x46,  // Servo values (part 2 :  6 - 11)
+	HC_MessageType_X7 = 0x47,  // Servo values (part 3 : 12 - 17)
+	HC_MessageType_X8 = 0x48,  // Servo values (part 4 : 18 - 23)
+	HC_MessageType_X9 = 0x49,  // Servo values (part 5 : 24 - 29)
+	HC_MessageType_XA = 0x4A,  // Servo values (part 6 : 30 - 35)
+	HC_MessageType_XB = 0x4B,  // Servo values (part 7 : 36 - 41)
+	HC_MessageType_XC = 0x4C,  // Servo values (part 8 : 42 - 47)
+	HC_MessageType_XD = 0x4D,  // AD values (part 1 :  0 - 3)
+	HC_MessageType_XE = 0x4E,  // AD values (part 2 :  4 - 7)
+	HC_MessageType_XF = 0x4F,  // AD values (part 3 :  8 - 11)
+	HC_MessageType_XG = 0x50,  // AD values (part 4 : 12 - 15)
+	HC_MessageType_XH = 0x51,  // AD values (part 5 : 16 - 19)
+
+	HC_MessageType_CT = 0x5A,  // Cycle Time (in us)
+	HC_MessageType_Xs = 0x5B,  // Subscribe to X query
+#ifdef HC_ARDUINOTIME_COMPILE
+	HC_MessageType_TM = 0x5C,  // Arduino Time (in ms)
+#endif
+	HC_MessageType_Xu = 0x5D,  // Unsubscribe from X query
+
+	HC_MessageType_PM = 0x60,  // Pin mode / Input mode
+	HC_MessageType_DI = 0x61,  // DI values
+	HC_MessageType_DO = 0x62,  // DO values
+	HC_MessageType_AI = 0x63,  // AI values
+	HC_MessageType_OT = 0x64,  // Output type
+	HC_MessageType_PA = 0x65,  // PWM availability
+	HC_MessageType_PW = 0x66,  // PWM values
+	HC_MessageType_SM = 0x67,  // Servo mode
+	HC_MessageType_SV = 0x68,  // Servo values
+	HC_MessageType_DD = 0x69,  // DD values
+	HC_MessageType_AM = 0x6A,  // AD mask
+	HC_MessageType_AD = 0x6B,  // AD values
+#ifdef ARDUINO_ARCH_SAMD
+	HC_MessageType_DM = 0x6C,  // DAC mode (enable mask)
+	HC_MessageType_DA = 0x6D,  // DAC values
+#endif
+
+#ifdef HC_EEPROM_COMPILE
+	HC_MessageType_EE = 0x70,  // EEPROM access
+	HC_MessageType_Es = 0x71,  // EEPROM (notify start of a reply sequence)
+	HC_MessageType_Ee = 0x72,  // EEPROM (notify end of a reply sequence)
+	HC_MessageType_Ec = 0x73,  // EEPROM (IO Config access)
+	HC_MessageType_Ep = 0x74,  // EEPROM (Config Param)
+#endif
+
+#ifdef HC_CAPTURE_COMPILE
+	HC_MessageType_Ca = 0x75,  // Capture: arm (write) or state (read)
+	HC_MessageType_Cr = 0x76,  // Capture: read captured data
+	HC_MessageType_Cd = 0x77,  // Capture: captured data (1 chunk)
+#endif
+
+#ifdef HC_MULTIDROP
+	HC_MessageType_NP = 0x78,  // Node poll (multi-drop): turn of the node (query), end of turn (reply)
+#endif
+
+#ifdef HC_STRINGMESSAGE_COMPILE
+	HC_MessageType_S0 = 0x79,  // HITI string
+#endif
+
+	HC_MessageType_Aq = 0x7A,  // A query reply
+	HC_MessageType_As = 0x7B,  // Subscribe to A query
+	HC_MessageType_Au = 0x7D,  // Unsubscribe from A query
+};
+
+// range of codes, flags and names: see HC_MessageTable.h
+
+
+
+// *****************************************************************************
+// Message descriptor
+// *****************************************************************************
+
+// flags of a feature which is not compiled: 0
+#ifdef HC_ARDUINOTIME_COMPILE
+	#define HC_MESSAGE_ARDUINOTIME(flags)	(flags)
+#else
+	#define HC_MESSAGE_ARDUINOTIME(flags)	0
+#endif
+#ifdef HC_STRINGMESSAGE_COMPILE
+	#define HC_MESSAGE_STRING(flags)		(flags)
+#else
+	#define HC_MESSAGE_STRING(flags)		0
+#endif
+#ifdef HC_EEPROM_COMPILE
+	#define HC_MESSAGE_EEPROM(flags)		(flags)
+#else
+	#define HC_MESSAGE_EEPROM(flags)		0
+#endif
+#ifdef ARDUINO_ARCH_SAMD
+	#define HC_MESSAGE_DAC(flags)			(flags)
+#else
+	#define HC_MESSAGE_DAC(flags)			0
+#endif
+#ifdef HC_CAPTURE_COMPILE
+	#define HC_MESSAGE_CAPTURE(flags)		(flags)
+#else
+	#define HC_MESSAGE_CAPTURE(flags)		0
+#endif
+#ifdef HC_MULTIDROP
+	#define HC_MESSAGE_MULTIDROP(flags)		(flags)
+#else
+	#define HC_MESSAGE_MULTIDROP(flags)		0
+#endif
+#ifdef HC_BAUDRATE_NEGOTIATION
+	#define HC_MESSAGE_BAUDRATE(flags)		(flags)
+#else
+	#define HC_MESSAGE_BAUDRATE(flags)		0
+#endif
+#ifdef HC_FLOW_CONTROL
+	#define HC_MESSAGE_FLOWCONTROL(flags)	(flags)
+#else
+	#define HC_MESSAGE_FLOWCONTROL(flags)	0
+#endif
+#ifdef HC_SAMPLER_COMPILE
+	#define HC_MESSAGE_SAMPLER(flags)		(flags)
+#else
+	#define HC_MESSAGE_SAMPLER(flags)		0
+#endif
+
+// 1 descriptor per code (table in HC_ProtocolReceive.cpp, PROGMEM)
+struct MessageDescriptor
+{
+	uint8_t flags;
+	#ifdef PROTOBF_USE_READABLE_MESSAGETYPE
+		char name[2];
+	#endif
+};
+
+#ifdef PROTOBF_USE_READABLE_MESSAGETYPE
+	#define HC_MESSAGE(flags, c0, c1)	{ flags, { c0, c1 } }
+#else
+	#define HC_MESSAGE(flags, c0, c1)	{ flags }
+#endif
+#define HC_MESSAGE_NONE				HC_MESSAGE(0, 0, 0)
+
+// rows of HC_MESSAGETYPE_TABLE
+#define HC_MESSAGE_DESCRIPTOR(name, code, c0, c1, flags)	HC_MESSAGE(flags, c0, c1),
+#define HC_MESSAGE_DESCRIPTOR_GAP(code)						HC_MESSAGE_NONE,
+
+extern const MessageDescriptor HC_messageDescriptors[HC_MESSAGETYPE_QTY] PROGMEM;
+
+
+#endif
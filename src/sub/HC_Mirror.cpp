@@ -0,0 +1,371 @@
+/*
+ * HITIComm
+ * HC_Mirror.cpp
+ *
+ * Copyright © 2021 Christophe LANDRET
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "HC_Mirror.h"
+
+
+
+// *****************************************************************************
+// Compilation trigger
+// *****************************************************************************
+
+#ifdef HC_MIRROR_COMPILE
+
+
+
+// *****************************************************************************
+// Include dependencies
+// *****************************************************************************
+
+// HITICommSupport
+#include "HITICommSupport.h"
+
+// HITIComm
+#include "HC_Toolbox.h"
+
+
+
+// *****************************************************************************
+// Functions
+// *****************************************************************************
+
+// little-endian
+static unsigned long HCI_readMirrorBytes(const uint8_t* data, uint8_t qty)
+{
+	unsigned long value = 0;
+	while (qty)
+	{
+		--qty;
+		value = (value << 8) | data[qty];
+	}
+	return value;
+}
+
+static void HCI_writeMirrorBytes(uint8_t* data, unsigned long value, uint8_t qty)
+{
+	for (uint8_t i = 0; i < qty; ++i)
+	{
+		data[i] = (uint8_t)value;
+		value >>= 8;
+	}
+}
+
+
+
+// *****************************************************************************
+// Class Methods
+// *****************************************************************************
+
+	// setters -----------------------------------------------------------------
+
+	void HC_Mirror::publishDD(unsigned long mask)
+	{
+		mPublished_DD = mask;
+		mOutput_isStarted = false;
+	}
+
+	void HC_Mirror::publishAD(unsigned long mask)
+	{
+		mPublished_AD = mask;
+		mOutput_isStarted = false;
+	}
+
+	void HC_Mirror::subscribeDD(unsigned long mask)
+	{
+		mSubscribed_DD = mask;
+	}
+
+	void HC_Mirror::subscribeAD(unsigned long mask)
+	{
+		mSubscribed_AD = mask;
+	}
+
+	void HC_Mirror::setPeriod(unsigned long period)
+	{
+		mPeriod = period;
+	}
+
+
+	void HC_Mirror::run()
+	{
+		receive();
+		send();
+	}
+
+
+	// getters -----------------------------------------------------------------
+
+	unsigned long HC_Mirror::getReceivedFrames() const
+	{
+		return mReceivedFrames;
+	}
+
+	unsigned long HC_Mirror::getLostFrames() const
+	{
+		return mLostFrames;
+	}
+
+	unsigned long HC_Mirror::getInvalidFrames() const
+	{
+		return mInvalidFrames;
+	}
+
+
+	// mirrors -----------------------------------------------------------------
+
+	HC_Mirror* HC_Mirror::mMirror_first = NULL_POINTER;
+
+	// add at the end of the list (if not already added)
+	void HC_Mirror::addMirror(HC_Mirror& mirror)
+	{
+		HC_Mirror** last = &mMirror_first;
+		while (*last != NULL_POINTER)
+		{
+			if (*last == &mirror)
+				return;
+			last = &(*last)->mMirror_next;
+		}
+
+		*last = &mirror;
+	}
+
+	HC_Mirror* HC_Mirror::getFirstMirror()
+	{
+		return mMirror_first;
+	}
+
+	HC_Mirror* HC_Mirror::getNextMirror() const
+	{
+		return mMirror_next;
+	}
+
+
+	// receive -----------------------------------------------------------------
+
+	// COBS decoding byte per byte (as HC_Protocol::receive())
+	void HC_Mirror::receive()
+	{
+		while (mStream->available() > 0)
+		{
+			uint8_t b = mStream->read();
+
+			// 0x00 delimiter: frame is complete
+			if (b == 0)
+			{
+				if ((mInput_cobsCount == 0) && mInput_isValid && (mInput_length != 0))
+					applyInput();
+				else if (mInput_length != 0)
+					++mInvalidFrames;
+
+				mInput_length = 0;
+				mInput_isValid = true;
+				mInput_cobsCode = 0xFF;
+				mInput_cobsCount = 0;
+				continue;
+			}
+
+			// COBS code byte: a 0x00 precedes each block (except the first one)
+			if (mInput_cobsCount == 0)
+			{
+				bool isFirst = (mInput_cobsCode == 0xFF);
+				mInput_cobsCode = b;
+				mInput_cobsCount = b - 1;
+
+				if (isFirst)
+					continue;
+				b = 0;
+			}
+			else
+				--mInput_cobsCount;
+
+			if (mInput_length < HC_MIRROR_FRAME_MAX_LENGHT)
+				mInput[mInput_length++] = b;
+			else
+				mInput_isValid = false;
+		}
+	}
+
+	// check the whole frame, then apply all values
+	void HC_Mirror::applyInput()
+	{
+		// type, CRC
+		bool isValid = (mInput_length >= HC_MIRROR_FRAME_MIN_LENGHT) && (mInput[0] == HC_MIRROR_FRAME_TYPE);
+
+		if (isValid)
+		{
+			uint16_t crc = 0;
+			for (uint8_t i = 0; i < mInput_length - 2; ++i)
+				crc = HCI_updateCRC16(crc, mInput[i]);
+			isValid = (crc == HCI_readMirrorBytes(&mInput[mInput_length - 2], 2));
+		}
+
+		// content
+		uint8_t sequence = mInput[1];
+		unsigned long ddMask = 0;
+		unsigned long ddValues = 0;
+		unsigned long adMask = 0;
+		uint8_t p = 2;
+
+		if (isValid)
+		{
+			ddMask = HCI_readMirrorBytes(&mInput[p], 4);
+			p += 4;
+			if (ddMask != 0)
+			{
+				ddValues = HCI_readMirrorBytes(&mInput[p], 4);
+				p += 4;
+			}
+			adMask = HCI_readMirrorBytes(&mInput[p], 3);
+			p += 3;
+
+			uint8_t adQty = 0;
+			for (uint8_t i = 0; i < HC_AD_QTY; ++i)
+				if (HCS_readBit(adMask, i))
+					++adQty;
+
+			isValid = (p + 4 * adQty + 2 == mInput_length);
+		}
+
+		if (!isValid)
+		{
+			++mInvalidFrames;
+			return;
+		}
+
+		// sequence gap: frames lost
+		if (mInput_isStarted)
+			mLostFrames += (uint8_t)(sequence - mInput_sequence);
+		mInput_sequence = sequence + 1;
+		mInput_isStarted = true;
+		++mReceivedFrames;
+
+		// apply subscribed values
+		ddMask &= mSubscribed_DD;
+		if (ddMask != 0)
+			HC_writeDD((HC_readDD() & ~ddMask) | (ddValues & ddMask));
+
+		for (uint8_t i = 0; i < HC_AD_QTY; ++i)
+		{
+			if (HCS_readBit(adMask, i))
+			{
+				if (HCS_readBit(mSubscribed_AD, i))
+				{
+					unsigned long bits = HCI_readMirrorBytes(&mInput[p], 4);
+					float value;
+					memcpy(&value, &bits, 4);
+					HC_writeAD(i, value);
+				}
+				p += 4;
+			}
+		}
+	}
+
+
+	// send --------------------------------------------------------------------
+
+	void HC_Mirror::send()
+	{
+		if ((mPublished_DD == 0) && (mPublished_AD == 0))
+			return;
+
+		unsigned long now = HCS_micros();
+		if (mOutput_isStarted && (now - mOutput_time < mPeriod))
+			return;
+
+		bool isKeyframe = !mOutput_isStarted || (now - mOutput_keyframeTime >= HC_MIRROR_KEYFRAME_PERIOD);
+
+		// changed values (all published values if keyframe)
+		unsigned long dd = HC_readDD();
+		unsigned long ddMask = isKeyframe ? mPublished_DD : ((dd ^ mOutput_DD) & mPublished_DD);
+
+		unsigned long adMask = 0;
+		for (uint8_t i = 0; i < HC_AD_QTY; ++i)
+		{
+			if (HCS_readBit(mPublished_AD, i))
+			{
+				float value = HC_readAD(i);
+				if (isKeyframe || (memcmp(&value, &mOutput_AD[i], 4) != 0))
+					HCS_writeBit(adMask, i, true);
+			}
+		}
+
+		if ((ddMask == 0) && (adMask == 0))
+			return;
+
+		// frame (frame[0] is reserved for COBS encoding), + 0x00 delimiter
+		uint8_t frame[HC_MIRROR_FRAME_MAX_LENGHT + 1];
+		uint8_t p = 1;
+
+		frame[p++] = HC_MIRROR_FRAME_TYPE;
+		frame[p++] = mOutput_sequence;
+		HCI_writeMirrorBytes(&frame[p], ddMask, 4);
+		p += 4;
+		if (ddMask != 0)
+		{
+			HCI_writeMirrorBytes(&frame[p], dd, 4);
+			p += 4;
+		}
+		HCI_writeMirrorBytes(&frame[p], adMask, 3);
+		p += 3;
+
+		for (uint8_t i = 0; i < HC_AD_QTY; ++i)
+		{
+			if (HCS_readBit(adMask, i))
+			{
+				float value = HC_readAD(i);
+				unsigned long bits;
+				memcpy(&bits, &value, 4);
+				HCI_writeMirrorBytes(&frame[p], bits, 4);
+				p += 4;
+			}
+		}
+
+		uint16_t crc = 0;
+		for (uint8_t i = 1; i < p; ++i)
+			crc = HCI_updateCRC16(crc, frame[i]);
+		HCI_writeMirrorBytes(&frame[p], crc, 2);
+		p += 2;
+
+		uint8_t length = HCI_encodeCOBS(frame, p - 1);
+
+		// never blocks: frame sent when it fits in the TX buffer (or when TX buffer is empty)
+		int txRoom = mStream->availableForWrite();
+		if (txRoom > mOutput_txRoomMax)
+			mOutput_txRoomMax = txRoom;
+		if ((txRoom < length + 1) && (txRoom < mOutput_txRoomMax))
+			return;
+
+		mStream->write(frame, length);
+		mStream->write((uint8_t)0);
+
+		// sent values
+		mOutput_DD = (mOutput_DD & ~ddMask) | (dd & ddMask);
+		for (uint8_t i = 0; i < HC_AD_QTY; ++i)
+			if (HCS_readBit(adMask, i))
+				mOutput_AD[i] = HC_readAD(i);
+
+		++mOutput_sequence;
+		mOutput_time = now;
+		if (isKeyframe)
+			mOutput_keyframeTime = now;
+		mOutput_isStarted = true;
+	}
+
+#endif	// HC_MIRROR_COMPILE
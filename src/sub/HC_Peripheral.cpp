@@ -0,0 +1,351 @@
+/*
+ * HITIComm
+ * HC_Peripheral.cpp
+ *
+ * Copyright © 2021 Christophe LANDRET
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "HC_Peripheral.h"
+
+
+
+// *****************************************************************************
+// Compilation trigger
+// *****************************************************************************
+
+#ifdef HC_PERIPHERAL_COMPILE
+
+
+
+// *****************************************************************************
+// Include dependencies
+// *****************************************************************************
+
+// Arduino
+#include <Wire.h>
+
+// HITICommSupport
+#include "HITICommSupport.h"
+
+// HITIComm
+#include "HC_Data.h"
+#include "HC_Sampler.h"
+
+
+
+// *****************************************************************************
+// Instanciates an object so that it can be reused in other files (forward declared in .h)
+// *****************************************************************************
+
+HC_Peripheral HC_peripheral;
+
+
+
+// *****************************************************************************
+// Interrupt handlers
+// *****************************************************************************
+
+static void HCI_peripheral_onReceive(int byteQty)	{ HC_peripheral.onI2CReceive(byteQty); }
+static void HCI_peripheral_onRequest()				{ HC_peripheral.onI2CRequest(); }
+
+
+
+// *****************************************************************************
+// Functions
+// *****************************************************************************
+
+// AI read without conversion: latest conversion of the background sampler
+static bool HCI_peripheral_isSampled(uint8_t index)
+{
+	#ifdef HC_SAMPLER_COMPILE
+		return HC_sampler.isStarted() && HC_sampler.isEnabled(index);
+	#else
+		return false;
+	#endif
+}
+
+#ifdef HC_PERIPHERAL_SPI_COMPILE
+ISR(SPI_STC_vect)
+{
+	HC_peripheral.onSPITransfer();
+}
+#endif
+
+
+
+// *****************************************************************************
+// Class Methods
+// *****************************************************************************
+
+	// start -------------------------------------------------------------------
+
+	void HC_Peripheral::beginI2C(uint8_t address)
+	{
+		Wire.begin(address);
+		Wire.onReceive(HCI_peripheral_onReceive);
+		Wire.onRequest(HCI_peripheral_onRequest);
+
+		mIsStarted = true;
+	}
+
+#ifdef HC_PERIPHERAL_SPI_COMPILE
+	void HC_Peripheral::beginSPI()
+	{
+		pinMode(MISO, OUTPUT);
+
+		// SPI enabled (peripheral mode), interrupt enabled
+		SPCR = _BV(SPE) | _BV(SPIE);
+		SPDR = 0;
+
+		mIsStarted = true;
+	}
+#endif
+
+
+	// snapshot ----------------------------------------------------------------
+
+	void HC_Peripheral::setPeriod(unsigned long period)
+	{
+		mPeriod = period;
+	}
+
+	void HC_Peripheral::update()
+	{
+		if (!mIsStarted)
+			return;
+
+		unsigned long now = HCS_micros();
+		if (now - mLastUpdateTime < mPeriod)
+			return;
+		mLastUpdateTime = now;
+
+		// write the back buffer
+		uint8_t back = mSnapshot_front ^ 1;
+
+		writeSnapshot(HC_PERIPHERAL_REG_SEQUENCE, ++mSnapshot_sequence, 1);
+		writeSnapshot(HC_PERIPHERAL_REG_STREAMQTY, 0, 1);		// set when read
+		writeSnapshot(HC_PERIPHERAL_REG_DIQTY, HCS_getDIO_endIndex() + 1, 1);
+		writeSnapshot(HC_PERIPHERAL_REG_AIQTY, HCS_getAI_qty(), 1);
+
+		writeSnapshot(HC_PERIPHERAL_REG_DD, HC_readDD(), 4);
+
+		#if HC_VARIANT == HC_VARIANT_MEGA
+			unsigned long DI_H, DI_L;
+			HC_readDI(DI_H, DI_L);
+			writeSnapshot(HC_PERIPHERAL_REG_DI, DI_L, 4);
+			writeSnapshot(HC_PERIPHERAL_REG_DI + 4, DI_H, 4);
+		#else
+			writeSnapshot(HC_PERIPHERAL_REG_DI, HC_readDI(), 4);
+			writeSnapshot(HC_PERIPHERAL_REG_DI + 4, 0, 4);
+		#endif
+
+		updateAI();
+
+		for (uint8_t i = 0; i < HC_AD_QTY; ++i)
+		{
+			float value = HC_readAD(i);
+			unsigned long bits;
+			memcpy(&bits, &value, 4);
+			writeSnapshot(HC_PERIPHERAL_REG_AD + 4 * i, bits, 4);
+		}
+
+		// the master now reads the new snapshot (1 byte write: atomic)
+		mSnapshot_front = back;
+	}
+
+	// AI: 1 blocking conversion per update at most. Sampled channels are all refreshed (latest
+	// conversion of HC_sampler), the other ones 1 per update, in turn (previous value kept meanwhile)
+	void HC_Peripheral::updateAI()
+	{
+		uint8_t qty = HCS_getAI_qty();
+		if (qty > HC_PERIPHERAL_AI_QTY)
+			qty = HC_PERIPHERAL_AI_QTY;
+
+		// previous values
+		memcpy(&mSnapshot[mSnapshot_front ^ 1][HC_PERIPHERAL_REG_AI], &mSnapshot[mSnapshot_front][HC_PERIPHERAL_REG_AI],
+			2 * HC_PERIPHERAL_AI_QTY);
+
+		for (uint8_t i = 0; i < qty; ++i)
+		{
+			if (HCI_peripheral_isSampled(i))
+				writeSnapshot(HC_PERIPHERAL_REG_AI + 2 * i, HC_readAI(i), 2);
+		}
+
+		// next channel not sampled
+		for (uint8_t n = 0; n < qty; ++n)
+		{
+			uint8_t i = (mAI_next < qty) ? mAI_next : 0;
+			mAI_next = i + 1;
+
+			if (!HCI_peripheral_isSampled(i))
+			{
+				writeSnapshot(HC_PERIPHERAL_REG_AI + 2 * i, HC_readAI(i), 2);
+				break;
+			}
+		}
+	}
+
+	void HC_Peripheral::writeSnapshot(uint8_t reg, unsigned long value, uint8_t size)
+	{
+		uint8_t* data = &mSnapshot[mSnapshot_front ^ 1][reg];
+
+		for (uint8_t i = 0; i < size; ++i)
+		{
+			data[i] = (uint8_t)value;
+			value >>= 8;
+		}
+	}
+
+
+	// Stream ------------------------------------------------------------------
+
+	int HC_Peripheral::available()
+	{
+		int qty = mRX_tail - mRX_head;
+		return (qty < 0) ? qty + HC_PERIPHERAL_RX_BUFFER_SIZE : qty;
+	}
+
+	int HC_Peripheral::read()
+	{
+		if (mRX_head == mRX_tail)
+			return -1;
+
+		uint8_t b = mRX_buffer[mRX_head];
+		mRX_head = (mRX_head + 1 < HC_PERIPHERAL_RX_BUFFER_SIZE) ? mRX_head + 1 : 0;
+
+		return b;
+	}
+
+	int HC_Peripheral::peek()
+	{
+		return (mRX_head == mRX_tail) ? -1 : mRX_buffer[mRX_head];
+	}
+
+
+	// Print -------------------------------------------------------------------
+
+	size_t HC_Peripheral::write(uint8_t b)
+	{
+		uint8_t next = (mTX_tail + 1 < HC_PERIPHERAL_TX_BUFFER_SIZE) ? mTX_tail + 1 : 0;
+		if (next == mTX_head)
+			return 0;
+
+		mTX_buffer[mTX_tail] = b;
+		mTX_tail = next;
+
+		return 1;
+	}
+
+	int HC_Peripheral::availableForWrite()
+	{
+		int qty = mTX_head - mTX_tail - 1;
+		return (qty < 0) ? qty + HC_PERIPHERAL_TX_BUFFER_SIZE : qty;
+	}
+
+
+	// interrupts --------------------------------------------------------------
+
+	// master writes: register address, then data (stream register only)
+	void HC_Peripheral::onI2CReceive(int byteQty)
+	{
+		if (byteQty <= 0)
+			return;
+
+		mRegister = Wire.read();
+
+		while (Wire.available())
+		{
+			uint8_t b = Wire.read();
+
+			// snapshot is read-only
+			if (mRegister != HC_PERIPHERAL_REG_STREAM)
+				continue;
+
+			uint8_t next = (mRX_tail + 1 < HC_PERIPHERAL_RX_BUFFER_SIZE) ? mRX_tail + 1 : 0;
+			if (next != mRX_head)
+			{
+				mRX_buffer[mRX_tail] = b;
+				mRX_tail = next;
+			}
+		}
+	}
+
+	// master reads from the selected register (1 Wire.write(): 1 buffer)
+	void HC_Peripheral::onI2CRequest()
+	{
+		uint8_t reg = mRegister;
+
+		// stream: queued bytes (not more than the qty read at HC_PERIPHERAL_REG_STREAMQTY)
+		if (reg == HC_PERIPHERAL_REG_STREAM)
+		{
+			uint8_t data[HC_PERIPHERAL_I2C_READ_LENGHT];
+			uint8_t length = 0;
+
+			while ((mTX_head != mTX_tail) && (length < HC_PERIPHERAL_I2C_READ_LENGHT))
+			{
+				data[length++] = mTX_buffer[mTX_head];
+				mTX_head = (mTX_head + 1 < HC_PERIPHERAL_TX_BUFFER_SIZE) ? mTX_head + 1 : 0;
+			}
+
+			if (length == 0)
+				data[length++] = 0;
+			Wire.write(data, length);
+		}
+		// snapshot
+		else if (reg < HC_PERIPHERAL_SNAPSHOT_SIZE)
+		{
+			uint8_t* snapshot = mSnapshot[mSnapshot_front];
+
+			// stream qty when read (at most 1 I2C read)
+			int qty = mTX_tail - mTX_head;
+			if (qty < 0)
+				qty += HC_PERIPHERAL_TX_BUFFER_SIZE;
+			snapshot[HC_PERIPHERAL_REG_STREAMQTY] = (qty < HC_PERIPHERAL_I2C_READ_LENGHT) ? qty : HC_PERIPHERAL_I2C_READ_LENGHT;
+
+			uint8_t length = HC_PERIPHERAL_SNAPSHOT_SIZE - reg;
+			if (length > HC_PERIPHERAL_I2C_READ_LENGHT)
+				length = HC_PERIPHERAL_I2C_READ_LENGHT;
+			Wire.write(snapshot + reg, length);
+		}
+		else
+			Wire.write((uint8_t)0);
+	}
+
+#ifdef HC_PERIPHERAL_SPI_COMPILE
+	// command byte (0x80 | register), then 1 byte per transfer
+	void HC_Peripheral::onSPITransfer()
+	{
+		uint8_t b = SPDR;
+
+		// command: latch the front buffer (not modified until the next snapshot is done)
+		if (b & 0x80)
+		{
+			mRegister = b & 0x7F;
+			mSPI_buffer = mSnapshot_front;
+		}
+
+		uint8_t reg = mRegister;
+		if (reg < HC_PERIPHERAL_SNAPSHOT_SIZE)
+		{
+			SPDR = mSnapshot[mSPI_buffer][reg];
+			mRegister = reg + 1;
+		}
+		else
+			SPDR = 0;
+	}
+#endif
+
+#endif	// HC_PERIPHERAL_COMPILE
@@ -35,9 +35,14 @@
 // HITICommSupport
 #include <HITICommSupport.h>
 
+// Arduino
+#include <Arduino.h>
+
 // HITIComm
 #include "HC_Timer.h"
 #include "HC_Eeprom.h"
+#include "HC_Capture.h"
+#include "sub\HC_MessageTable.h"
 
 
 
@@ -46,15 +51,13 @@
 // *****************************************************************************
 
 
-// Protocol features
-#define PROTOBF_OPTIONS_FULLY_READABLE	0 // int, separator, readable
-#define PROTOBF_OPTIONS_USE_INT			1 // int, separator
-#define PROTOBF_OPTIONS_USE_SEPARATOR	2 // hex, separator,          CRC
-#define PROTOBF_OPTIONS_HEX				3 // hex,                     CRC
+// Protocol features: PROTOBF_OPTIONS_xxx (see HC_MessageTable.h)
 
 
-// select an option
-#define PROTOBF_OPTION	PROTOBF_OPTIONS_HEX
+// select an option (can also be set by the build: -DPROTOBF_OPTION=x)
+#ifndef PROTOBF_OPTION
+	#define PROTOBF_OPTION	PROTOBF_OPTIONS_HEX
+#endif
 
 #if   PROTOBF_OPTION == PROTOBF_OPTIONS_FULLY_READABLE
 	#define PROTOBF_USE_READABLE_MESSAGETYPE
@@ -69,8 +72,155 @@
 #elif PROTOBF_OPTION == PROTOBF_OPTIONS_HEX
 	#define PROTOBF_USE_CRC
 	#define PROTOBF_FILL_HEX
+#elif PROTOBF_OPTION == PROTOBF_OPTIONS_BINARY
+	#define PROTOBF_USE_BINARY
+#endif
+
+// min X query period (ms)
+#ifdef PROTOBF_USE_BINARY
+	#define HC_XQUERY_MIN_PERIOD 25
+#else
+	#define HC_XQUERY_MIN_PERIOD 50
+#endif
+
+// X query: refresh period (ms) and priority (0: highest) of each group of X replies.
+// When several groups are due, the one with the highest priority is sent first
+// (same priority: round robin). A group which has nothing to send is skipped.
+#define HC_XGROUP_PERIOD_CONFIG		HC_XQUERY_MIN_PERIOD	// X0, M0, PM, SM, OT, PA, AM, DM
+#define HC_XGROUP_PERIOD_DIGITAL	HC_XQUERY_MIN_PERIOD	// DI, DO, DD
+#define HC_XGROUP_PERIOD_STRING		HC_XQUERY_MIN_PERIOD	// S0
+#define HC_XGROUP_PERIOD_AI			HC_XQUERY_MIN_PERIOD	// X1, X2
+#define HC_XGROUP_PERIOD_PWM		HC_XQUERY_MIN_PERIOD	// X3, X4
+#define HC_XGROUP_PERIOD_SERVO		HC_XQUERY_MIN_PERIOD	// X5 -> XC
+#define HC_XGROUP_PERIOD_AD			HC_XQUERY_MIN_PERIOD	// XD -> XH
+#define HC_XGROUP_PERIOD_DAC		HC_XQUERY_MIN_PERIOD	// DA
+
+#define HC_XGROUP_PRIORITY_CONFIG	0
+#define HC_XGROUP_PRIORITY_DIGITAL	0
+#define HC_XGROUP_PRIORITY_STRING	0
+#define HC_XGROUP_PRIORITY_AI		0
+#define HC_XGROUP_PRIORITY_PWM		0
+#define HC_XGROUP_PRIORITY_SERVO	0
+#define HC_XGROUP_PRIORITY_AD		0
+#define HC_XGROUP_PRIORITY_DAC		0
+
+#define HC_XGROUP_MAX_QTY 8	// max 8 (1 bit per group)
+
+// X query: change mask. AI, PWM, Servo and AD messages start with a mask (1 bit per value of
+// the message, hex) and only contain the values which have changed since the last message.
+// A message with no changed value is not sent. Every HC_XQUERY_KEYFRAME_PERIOD, all messages and
+// values are sent (keyframe). Not supported by HITIPanel. Uses 440 bytes of RAM (full last sent values).
+//#define HC_XQUERY_CHANGEMASK
+#define HC_XQUERY_KEYFRAME_PERIOD 1000 // ms, max 65535
+
+// A query: subscription table size (channels) and reply period (us)
+#define HC_AQUERY_MAX_QTY	16		// 16 -> 32
+#define HC_AQUERY_PERIOD	2000
+
+// A replies and X0 start with the time (us) at which values are sampled: delta from the previous
+// timestamp of the same query (4 hex, 2 bytes if binary). 0xFFFF: absolute time follows (8 hex,
+// 4 bytes if binary), sent on first reply after subscribing or if delta is too large.
+// Not supported by HITIPanel.
+//#define HC_QUERY_TIMESTAMP
+#define HC_TIMESTAMP_A		0
+#define HC_TIMESTAMP_X		1
+#define HC_TIMESTAMP_QTY	2
+#define HC_TIMESTAMP_ESCAPE	0xFFFF
+
+// C query: samples per Cd message, as many as fit in the output frame (longest sample: 14 bits).
+// Text overhead: start, node, type, control byte, first frame, frame qty (+ separators), CRC, CR LF
+#if defined(PROTOBF_USE_BINARY)
+	#define HC_CQUERY_SAMPLE_QTY	24
+#else
+	#if defined(PROTOBF_USE_INT)
+		#define HC_CQUERY_SAMPLE_LENGHT		6	// 16383 + separator
+		#define HC_CQUERY_FRAME_OVERHEAD	22
+	#elif defined(PROTOBF_USE_SEPARATOR)
+		#define HC_CQUERY_SAMPLE_LENGHT		5
+		#define HC_CQUERY_FRAME_OVERHEAD	22
+	#else
+		#define HC_CQUERY_SAMPLE_LENGHT		4
+		#define HC_CQUERY_FRAME_OVERHEAD	15
+	#endif
+	#define HC_CQUERY_SAMPLE_QTY	((HC_OUTPUTFRAME_MAX_ARRAY_LENGHT - HC_CQUERY_FRAME_OVERHEAD) / HC_CQUERY_SAMPLE_LENGHT)
 #endif
 
+// X query: index of the last sent values (change mask)
+#define HC_XVALUE_AI	0	// 16 AI
+#define HC_XVALUE_PWM	16	// 16 PWM
+#define HC_XVALUE_SERVO	32	// 48 Servos
+#define HC_XVALUE_AD	80	// 20 AD
+#define HC_XVALUE_QTY	100
+
+// Multi-drop bus (RS-485): each frame starts with a node address ($ or #, then node: 2 hex
+// chars, decimal if PROTOBF_USE_INT, 1 byte if binary).
+//   - a node ignores the frames sent to other nodes as soon as the node address is received
+//   - broadcast frames are processed by all nodes, without reply
+//   - a node only talks during its turn: a frame sent to its address starts its turn, the
+//     node replies, sends its due query replies (HC_MULTIDROP_TURN_FRAMES at most), then
+//     ends its turn with an NP message. An NP query only gives the node its turn.
+//   Ex (X data of all nodes): send Xs to each node, then poll each node in turn with NP.
+//   Optional driver enable pin and turn-around delay (HC_multidropDriverEnable()), never blocking:
+//   a reply waits (deferred) for the turn-around delay after the received frame, the pin is high
+//   from the first reply, and low once the TX buffer is empty and the turn-around delay has elapsed
+//   (the last character leaves the shift register: the delay must last 1 character at least).
+//#define HC_MULTIDROP
+#define HC_MULTIDROP_BROADCAST		0xFF	// node address of broadcast frames
+#define HC_MULTIDROP_TURN_FRAMES	8		// max query replies during a turn
+#define HC_MULTIDROP_NO_PIN			0xFF
+
+// Baudrate negotiation (main serial port, started with HC_begin(baudrate)): the board starts at a
+// safe baudrate, then the computer selects the highest baudrate that both support (see
+// HC_BAUDRATE_TABLE in HC_MessageTable.h):
+//   - Br (read): index of the current baudrate, and mask of the baudrates supported by the board
+//   - Br (write, index = baudrate): the board acknowledges at the current baudrate, then switches
+//   - Bp (at the new baudrate): the board replies (probe)
+//   - any other frame (at the new baudrate), once the reply of Bp is received: the new baudrate is confirmed
+//   Until Bp is received, other frames are ignored (sent at the wrong baudrate). Until the new baudrate is
+//   confirmed, no query reply is sent. Without confirmation after HC_BAUDRATE_PROBE_TIMEOUT
+//   (HC_MessageTable.h), the board goes back to the previous baudrate (as does the computer if the reply
+//   of Bp is lost). Not supported by HITIPanel.
+//#define HC_BAUDRATE_NEGOTIATION
+#ifndef HC_BAUDRATE_MAX
+	#define HC_BAUDRATE_MAX			1000000	// highest baudrate of the board (and of its USB-serial converter)
+#endif
+#define HC_BAUDRATE_STATE_IDLE		0
+#define HC_BAUDRATE_STATE_SWITCHING	1		// acknowledge is being sent at the current baudrate
+#define HC_BAUDRATE_STATE_PROBING	2		// new baudrate, waiting for Bp
+#define HC_BAUDRATE_STATE_CONFIRMING	3		// Bp received, waiting for another frame
+
+// Flow control (credits): the computer grants credits to the board (frames or bytes), which are spent
+// by the replies of the E, C, X and A queries. When credits don't cover the next reply, these replies
+// pause until credits are granted again: the computer is never sent more than it can read.
+//   - Fc (write): unit (HC_FLOW_UNIT_xxx) and initial credits. Fc (read): unit, credits, paused cycles
+//   - any query adds credits (piggy-backed): HC_FLOW_CONFIG_CREDIT in the config byte, then the credits
+//   - bytes: a reply is only sent if credits cover a full frame (HC_OUTPUTFRAME_MAX_ARRAY_LENGHT), and
+//     spends its length
+//   The replies to the queries themselves, and the B replies, don't use credits. Not supported by HITIPanel.
+//#define HC_FLOW_CONTROL
+
+// Profiling (benchmarks): calls and time spent in send() (1 message) and in analyzeInput()
+// (1 received message, including its reply), counted by each session.
+// Time is read with HC_PROFILE_CLOCK() (default: us. The host build uses ns).
+//#define HC_PROTOCOL_PROFILE
+#ifndef HC_PROFILE_CLOCK
+	#define HC_PROFILE_CLOCK()	HCS_micros()
+#endif
+#define HC_PROFILE_SEND			0
+#define HC_PROFILE_ANALYZEINPUT	1
+#define HC_PROFILE_QTY			2
+
+// X query: changes of config values (1 bit each). A change is read once from the board, then kept
+// by each session until it is sent
+#define HC_XCHANGE_SRAM				0x01
+#define HC_XCHANGE_PINSMODE			0x02
+#define HC_XCHANGE_SERVOSMODE		0x04
+#define HC_XCHANGE_OUTPUTTYPES		0x08
+#define HC_XCHANGE_PWMAVAILABILITY	0x10
+#define HC_XCHANGE_ADMASK			0x20
+#define HC_XCHANGE_DACSMODE			0x40
+#define HC_XCHANGE_STRING			0x80
+
 #define HC_DISPLAY_INPUT_IN_ERRORMESSAGE // if not defined, decrease memory size (64 bytes)
 //#define HC_DISPLAY_X_QUERY_PERIOD
 
@@ -83,22 +233,55 @@
 class HC_Protocol
 {
     public:
-	    // constructor
-		HC_Protocol():
-				mXquery_timer() // X query
-				#ifndef HC_USE_FTDI
-				, mAquery_timer()   // A query
-				#endif
-		{
-			mXquery_timer.manualReset(); // manual reset
-		}
+	    // constructor: main serial port, or any Stream (Serial1, SerialUSB, HC_Loopback...)
+		HC_Protocol() : mStream(&Serial) {}
+		HC_Protocol(Stream& stream) : mStream(&stream) {}
+
+		void setStream(Stream& stream);
+
+		// Sessions: each session runs on its own Stream, with its own queries and subscriptions.
+		// All sessions are served by HC_communicate()
+		static void addSession(HC_Protocol& session);
+		static HC_Protocol* getFirstSession();
+		HC_Protocol* getNextSession() const;
+
+		#ifdef HC_MULTIDROP
+			// Multi-drop bus: node address of this session (default: 0)
+			void setNode(uint8_t node);
+
+			// pin set high while sending (driver enable), and min delay (us) between a received frame and a reply,
+			// and between the end of the replies and the pin set low (at least 1 character time)
+			void setDriverEnable(uint8_t pin, unsigned int turnaroundDelay);
+		#endif
+
+		#ifdef HC_BAUDRATE_NEGOTIATION
+			// baudrate of the main serial port (set by HC_begin(baudrate)). 0: can't be negotiated
+			void setBaudrate(long baudrate);
+			long getBaudrate() const;
+		#endif
 
         // Send message : Board has started
         void sendMessage_BoardHasStarted();
 
-        // Communicate with computer : receive, process, send message
+        // Communicate with computer : receive, process, send message (this session only)
         void communicate();
 
+		// bytes sent during last communicate() call
+		unsigned int getQueuedBytes() const;
+
+		// replies deferred because the TX buffer was full
+		unsigned long getDeferredReplies() const;
+
+		// replies dropped: longer than the output frame, or deferred reply still waiting
+		unsigned long getDroppedReplies() const;
+
+		#ifdef HC_PROTOCOL_PROFILE
+			// calls and total time (HC_PROFILE_CLOCK() unit) of a profiled function (HC_PROFILE_xxx)
+			unsigned long getProfileCalls(uint8_t function) const;
+			unsigned long getProfileTime(uint8_t function) const;
+			void resetProfile();
+		#endif
+
 
     protected:
     private:
@@ -111,29 +294,175 @@ class HC_Protocol
 		// protocol
 		const char SpecialChar_separator[2] = "_";
 
+		// transport
+		Stream* mStream;
+
+		// sessions (linked list)
+		static HC_Protocol* mSession_first;
+		HC_Protocol* mSession_next = NULL_POINTER;
+
+		#ifdef HC_MULTIDROP
+			// multi-drop bus
+			uint8_t mNode = 0;
+			uint8_t mNode_driverEnablePin = HC_MULTIDROP_NO_PIN;
+			unsigned int mNode_turnaroundDelay = 0;		// us
+			uint8_t mNode_turn = 0;						// frames which can still be sent during the turn (0: node must not talk)
+			bool mNode_isDriving = false;				// driver enable pin is high
+			unsigned long mNode_txBusyTime = 0;			// us, last time the TX buffer was seen not empty
+		#endif
+
+
+		#ifdef HC_FLOW_CONTROL
+			// flow control (credits)
+			uint8_t mFlow_unit = HC_FLOW_UNIT_NONE;
+			unsigned long mFlow_credit = 0;
+			unsigned long mFlow_pausedCycles = 0;		// cycles without credit
+			bool mFlow_isPaced = false;					// reply being built spends credits (E, C, X, A queries)
+		#endif
+
+		#ifdef HC_BAUDRATE_NEGOTIATION
+			// baudrate negotiation
+			long mBaudrate = 0;							// current baudrate (0: can't be negotiated)
+			long mBaudrate_previous = 0;				// restored if the new baudrate is not confirmed
+			uint8_t mBaudrate_state = HC_BAUDRATE_STATE_IDLE;
+			uint8_t mBaudrate_next = HC_BAUDRATE_NONE;	// requested baudrate (index)
+			unsigned long mBaudrate_startTime = 0;		// ms, switch to the new baudrate
+		#endif
+
 
 		// CRC -----------------------------------------------------------------
-		unsigned int mOutput_CRC;
-		uint8_t mInput_CRC_index;
+		unsigned int mOutput_CRC;	// CRC-16 if binary
+		unsigned int mInput_CRC;	// CRC-16 if binary. Calculated while receiving
+
+
+		// Output Frame ---------------------------------------------------------
+		// Message is built in the TX buffer of the session, then sent in 1 write (flushOutput()).
+		// If binary: raw bytes in mOutput[1..], mOutput[0] is reserved for COBS encoding (in place)
+		#ifdef HC_MULTIDROP
+			#define HC_OUTPUTFRAME_NODE_LENGHT 1	// node address (binary)
+		#else
+			#define HC_OUTPUTFRAME_NODE_LENGHT 0
+		#endif
+		#ifdef HC_QUERY_TIMESTAMP
+			#define HC_AQUERY_MAX_FRAME_LENGHT (HC_AQUERY_MAX_QTY * 4 + 14 + HC_OUTPUTFRAME_NODE_LENGHT)
+		#else
+			#define HC_AQUERY_MAX_FRAME_LENGHT (HC_AQUERY_MAX_QTY * 4 + 8 + HC_OUTPUTFRAME_NODE_LENGHT)
+		#endif
+		// A reply which doesn't fit is dropped (HC_readDroppedReplies()): the frame holds the longest reply
+		#if defined(PROTOBF_USE_BINARY) && !defined(HC_USE_FTDI) && (HC_AQUERY_MAX_FRAME_LENGHT > 64)
+			#define HC_OUTPUTFRAME_MAX_ARRAY_LENGHT HC_AQUERY_MAX_FRAME_LENGHT // A reply is sent in 1 frame
+		#elif defined(PROTOBF_USE_INT)
+			#define HC_OUTPUTFRAME_MAX_ARRAY_LENGHT 72 // X reply with 4 AD ("-8388607.500"), change mask and node address
+		#else
+			#define HC_OUTPUTFRAME_MAX_ARRAY_LENGHT 64
+		#endif
+		// A reply: longest frame without the values (header, timestamp, CRC, footer). A value is only
+		// subscribed if the longest reply still fits in the output frame (an A reply is never split)
+		#if defined(PROTOBF_USE_BINARY)
+			#define HC_AQUERY_FRAME_OVERHEAD (HC_AQUERY_MAX_FRAME_LENGHT - HC_AQUERY_MAX_QTY * 4)
+		#else
+			#ifdef HC_MULTIDROP
+				#define HC_AQUERY_HEADER_LENGHT 15	// start, node, type, control byte (+ separators), CRC, CR LF
+			#else
+				#define HC_AQUERY_HEADER_LENGHT 11
+			#endif
+			#ifdef HC_QUERY_TIMESTAMP
+				#define HC_AQUERY_FRAME_OVERHEAD (HC_AQUERY_HEADER_LENGHT + 17)	// escape + absolute time
+			#else
+				#define HC_AQUERY_FRAME_OVERHEAD HC_AQUERY_HEADER_LENGHT
+			#endif
+		#endif
+		#ifdef PROTOBF_USE_BINARY
+			#define HC_OUTPUTFRAME_START 1
+		#else
+			#define HC_OUTPUTFRAME_START 0
+		#endif
+		uint8_t mOutput[HC_OUTPUTFRAME_MAX_ARRAY_LENGHT];
+		uint8_t mOutput_length = HC_OUTPUTFRAME_START;
+		uint8_t mOutput_sentLength = 0;		// deferred frame longer than the TX buffer: part already written
+		bool mOutput_isDeferred = false;	// complete frame waiting for room in the TX buffer
+		bool mOutput_isDropped = false;		// reply being built is dropped (no room in the frame)
+		int mOutput_txRoomMax = 0;			// max room ever seen in the TX buffer (= empty)
+
+		// bytes sent during current communicate() call
+		unsigned int mOutput_queuedBytes = 0;
+
+		// replies deferred because the TX buffer was full
+		unsigned long mOutput_deferredReplies = 0;
+
+		// replies dropped: longer than the output frame, or deferred reply still waiting
+		unsigned long mOutput_droppedReplies = 0;
+
+		#ifdef HC_PROTOCOL_PROFILE
+			// Profiling ---------------------------------------------------------
+			unsigned long mProfile_calls[HC_PROFILE_QTY] = { 0 };
+			unsigned long mProfile_time[HC_PROFILE_QTY] = { 0 };
+
+			// counts 1 call, and the time spent until the end of the scope
+			struct ProfileScope
+			{
+				ProfileScope(unsigned long& calls, unsigned long& time) : mTime(time), mStart(HC_PROFILE_CLOCK()) { ++calls; }
+				~ProfileScope() { mTime += HC_PROFILE_CLOCK() - mStart; }
+
+				unsigned long& mTime;
+				unsigned long mStart;
+			};
+			#define HC_PROFILE(function)	ProfileScope profileScope(mProfile_calls[function], mProfile_time[function])
+		#else
+			#define HC_PROFILE(function)
+		#endif
 
 
         // Received Message: Array Buffer --------------------------------------
 		#define HC_INPUTMESSAGE_MAX_ARRAY_LENGHT 40
 		char mInput[HC_INPUTMESSAGE_MAX_ARRAY_LENGHT];
-		uint8_t mInput_index;	// analyzed input
-		uint8_t mInput_length;	// analyzed input
-
-		#ifdef PROTOBF_USE_SEPARATOR
-			char* mInput_data;	// analyzed input
+		uint8_t mInput_length;	// received bytes (decoded if binary)
+		uint8_t mInput_dataEnd;	// end of data (CRC, or separator before CRC)
+
+		// Received Message: Header, decoded while receiving (parseInput()) ----
+		uint8_t mInput_field;				// field being received ($, Message Type, Config Byte, Index, Address, Data)
+		uint8_t mInput_fieldLength;			// chars (bytes if binary) received in this field
+		unsigned long mInput_fieldValue;	// value of this field
+		#if defined(HC_MULTIDROP) && defined(HC_FLOW_CONTROL)
+			uint8_t mInput_fieldEnd[7];		// end of each header field, 0 if not (validly) received
+		#elif defined(HC_MULTIDROP) || defined(HC_FLOW_CONTROL)
+			uint8_t mInput_fieldEnd[6];
 		#else
-			char mInput_data[HC_EEPROM_STRING_ABSOLUTEMAXSIZE];	// analyzed input
+			uint8_t mInput_fieldEnd[5];
 		#endif
 
-        // Received Message: Ending detection (CR then LF) ---------------------
-        // 0: no ending character detected
-        // 1: CR detected
-        // 2: CR then LF detected
-        uint8_t mInput_EndDetectionFlag = 0;
+		char mInput_type;					// Message Type code (0: unknown)
+		uint8_t mInput_configByte;
+		uint8_t mInput_targetIndex;
+		unsigned int mInput_address;
+		#ifdef HC_FLOW_CONTROL
+			unsigned int mInput_credit;			// credits granted by the query
+		#endif
+		#ifdef HC_MULTIDROP
+			uint8_t mInput_node;
+			bool mInput_isIgnored = false;		// frame sent to another node (not parsed)
+			unsigned long mInput_endTime = 0;	// us, end of the last received frame
+		#endif
+
+		// Received Message: Data, decoded on demand (nextToken()) -------------
+		uint8_t mInput_index;				// next token
+		char* mInput_data;					// last token (in mInput, not NUL-terminated)
+		uint8_t mInput_dataLength;			// last token length
+		unsigned long mInput_value;			// last token value (hex, or little-endian if binary)
+		#ifdef PROTOBF_USE_INT
+			unsigned long mInput_decimalValue;	// last token value (decimal)
+		#endif
+
+		#ifdef PROTOBF_USE_BINARY
+			// Received Message: COBS decoding -------------------------------------
+			uint8_t mInput_cobsCode = 0xFF;		// code of current block
+			uint8_t mInput_cobsCount = 0;		// bytes left in current block
+		#else
+			// Received Message: Ending detection (CR then LF) ---------------------
+			// 0: no ending character detected
+			// 1: CR detected
+			uint8_t mInput_EndDetectionFlag = 0;
+		#endif
 
 
 		// Queries -------------------------------------------------------------
@@ -151,11 +480,14 @@ class HC_Protocol
 		bool mAquery_run = false;
 		#ifdef HC_EEPROM_COMPILE
 			bool mEquery_run = false;
+			bool mEquery_isStarted = false;	// Es sent (in its own cycle)
 			bool mECquery_run = false;
 		#endif
-
-		// flags (= true if Xquery is forced to send all messages)
-		bool mFirstTime = true;
+		#ifdef HC_CAPTURE_COMPILE
+			bool mCquery_run = false;
+			bool mCquery_isArmed = false;	// capture armed by computer: data is sent when capture is done
+			unsigned int mCquery_frame;		// next frame to send
+		#endif
 
 		// Semaphore used to manage A and X query process when both are running
 		// For timing optimization: only one Query is processed per cycle
@@ -166,8 +498,26 @@ class HC_Protocol
 
 		// X query -------------------------------------------------------------
 
-		#define mXquery_qty 30
-		HC_Timer mXquery_timer;	// delay (50ms), manual reset. Used to force X replies period to be higher than 50ms
+		// X replies are sent by groups (see table in HC_ProtocolSend.cpp), each with its own period
+		uint8_t mXquery_group = 0xFF;		// group being sent (none: 0xFF). mXquery_ID is the message index in the group
+		uint8_t mXquery_lastGroup = 0;		// last group sent (round robin between groups of same priority)
+		uint8_t mXquery_firstPass = 0xFF;	// 1 bit per group: = 1 if all messages of the group must be sent
+		unsigned int mXgroup_startTime[HC_XGROUP_MAX_QTY];	// start time of last sending (ms, 16 bits)
+		uint8_t mXchange = 0;				// changes not sent yet (HC_XCHANGE_xxx)
+
+		#ifdef HC_XQUERY_CHANGEMASK
+			unsigned long mXvalue_last[HC_XVALUE_QTY];	// last sent values (float: bits)
+			uint8_t mXvalue_changeMask;					// values of the message which have changed (1 bit per value)
+			unsigned long mXvalue_scanned[8];			// values of the message read when scanning, then printed
+			uint8_t mXvalue_first;						// index in mXvalue_last of the 1st value of the message
+			bool mXvalue_isScanning = false;			// true: values are compared, not printed
+			unsigned int mXquery_keyframeTime = 0;		// ms, 16 bits
+		#endif
+
+		#ifdef HC_QUERY_TIMESTAMP
+			unsigned long mTimestamp_previous[HC_TIMESTAMP_QTY];	// us, last sent timestamp (A reply, X0)
+			uint8_t mTimestamp_isAbsolute = 0xFF;					// 1 bit per query: = 1 if next timestamp is absolute
+		#endif
 
 		#ifdef HC_DISPLAY_X_QUERY_PERIOD
 			long unsigned mXquery_previousTimestamp;	// used to calculate the X replies period (time required to send all X replies)
@@ -176,17 +526,18 @@ class HC_Protocol
 
 		// A query -------------------------------------------------------------
 
-		// arrays of data index and type (max size = 4 data)
-		#define mAquery_ARRAY_SIZE 4
-		uint8_t mAquery_index_array[mAquery_ARRAY_SIZE];
-		#ifdef PROTOBF_USE_READABLE_MESSAGETYPE
-			char mAquery_type_array[mAquery_ARRAY_SIZE][3];
-		#else
-			char mAquery_type_array[mAquery_ARRAY_SIZE];
-		#endif
-
 		#ifndef HC_USE_FTDI
-			HC_Timer mAquery_timer;		// delay (2ms), auto reset. Used to limit A replies period to 2ms.
+			// subscriptions: reader and print format are set when subscribing
+			struct ASubscription
+			{
+				unsigned long (*read)(uint8_t index);	// value (float: bits)
+				uint8_t index;
+				uint8_t hexLength;	// 0: float, 1: bool (packed if binary). AI (sampler): longest
+			};
+			ASubscription mAquery_subscriptions[HC_AQUERY_MAX_QTY];
+			uint8_t mAquery_qty = 0;
+
+			unsigned long mAquery_previousTimestamp = 0;	// us. Used to limit A replies period to HC_AQUERY_PERIOD
 		#endif
 
 
@@ -194,13 +545,15 @@ class HC_Protocol
 		// Output --------------------------------------------------------------
 		// ---------------------------------------------------------------------
 
-		#ifdef PROTOBF_USE_READABLE_MESSAGETYPE
-			void send(unsigned int messageType);
-		#else
-			void send(char messageType);
-		#endif
+		void send(char messageType);
 
 		// X query
+		bool sendX_Values(char messageType);			// X1 -> XH
+		#ifdef HC_XQUERY_CHANGEMASK
+			bool scanX_Values(char messageType);
+			void commitX_Values();
+			bool sendX_valueHasChanged(uint8_t index, uint8_t bit, unsigned long value);
+		#endif
 		bool sendX_AIValues(uint8_t min, uint8_t max);	// AI values	(part i : min - max)  
 		bool sendX_AOValues(uint8_t min, uint8_t max);	// AO values	(part i : min - max)  
 		bool sendX_ServoValues(uint8_t min, uint8_t max);	// Servo values (part i : min - max)  
@@ -209,25 +562,30 @@ class HC_Protocol
 		// B,E,EC,X queries replies
 		void send_BQuery();
 		bool send_XQuery();
+		#ifndef HC_USE_FTDI
+			void sendA_Values();
+			bool subscribeA(char messageType, uint8_t index);
+		#endif
+		#ifdef HC_QUERY_TIMESTAMP
+			void printTimestamp(uint8_t query, unsigned long timestamp);	// HC_TIMESTAMP_A or HC_TIMESTAMP_X
+		#endif
+		bool selectXGroup();	// returns true if an X group is being sent
+		uint8_t readXQuantity(uint8_t (*quantity)(), uint8_t change);
+		void restartXQuery();	// all groups are due
 		#ifdef HC_EEPROM_COMPILE
 			void send_EQuery();
 			//void send_ECQuery();
 		#endif
+		#ifdef HC_CAPTURE_COMPILE
+			void send_CQuery();
+			void sendC_Data();		// Cd: 1 chunk of frames
+		#endif
 
-		#ifdef PROTOBF_USE_READABLE_MESSAGETYPE
-			void send_withIndex(uint8_t index, unsigned int messageType);											// specify 1 index
-			#ifdef HC_EEPROM_COMPILE
-				void send_withAddress(int unsigned address, unsigned int messageType);								// specify 1 address
-				void send_withConsecutiveAddresses(int unsigned start_address, uint8_t qty, unsigned int messageType);	// specify several consecutive addresses
-				void send_withIndex_withAddress(uint8_t index, int unsigned address, unsigned int messageType);		// specify 1 index and 1 address
-			#endif
-		#else
-			void send_withIndex(uint8_t index, char messageType);											// specify 1 index
-			#ifdef HC_EEPROM_COMPILE
-				void send_withAddress(int unsigned address, char messageType);								// specify 1 address
-				void send_withConsecutiveAddresses(int unsigned start_address, uint8_t qty, char messageType);	// specify several consecutive addresses
-				void send_withIndex_withAddress(uint8_t index, int unsigned address, char messageType);		// specify 1 index and 1 address
-			#endif
+		void send_withIndex(uint8_t index, char messageType);											// specify 1 index
+		#ifdef HC_EEPROM_COMPILE
+			void send_withAddress(int unsigned address, char messageType);								// specify 1 address
+			void send_withConsecutiveAddresses(int unsigned start_address, uint8_t qty, char messageType);	// specify several consecutive addresses
+			void send_withIndex_withAddress(uint8_t index, int unsigned address, char messageType);		// specify 1 index and 1 address
 		#endif
 
 
@@ -238,22 +596,69 @@ class HC_Protocol
 		void receive();
 		void analyzeInput();
 
+		// incremental parser (1 call per received byte)
+		void parseInput(uint8_t b);
+		void closeInputField(uint8_t end);
+		void resetInput();
+		bool inputFieldIsReceived(uint8_t field);
+
+		// message descriptor (HC_MessageType.h)
+		uint8_t getMessageFlags(char messageType);				// 0: invalid
 		#ifdef PROTOBF_USE_READABLE_MESSAGETYPE
-			bool messageTypeIsValid(unsigned int messageType);
-		#else
-			bool messageTypeIsValid(char messageType);
+			char getMessageType(unsigned int name);				// 0: unknown name
+		#endif
+		bool indexIsInRange(uint8_t flags, uint8_t index);
+
+		#ifdef HC_FLOW_CONTROL
+			// flow control: false if credits don't cover the next reply (1 frame, or the longest frame)
+			bool hasFlowCredit();
+			void spendFlowCredit(uint8_t length);
+		#endif
+
+		#ifdef HC_MULTIDROP
+			// driver enable pin: low once the replies are sent (never blocks)
+			void releaseDriverEnable();
+		#endif
+
+		#ifdef HC_BAUDRATE_NEGOTIATION
+			// baudrate negotiation
+			void runBaudrateChange();
+			void switchBaudrate(long baudrate);
+			unsigned int getSupportedBaudrates();			// 1 bit per index of HC_BAUDRATE_TABLE
+			bool baudrateIsSupported(uint8_t index);
+			static long getBaudrateValue(uint8_t index);
+			static uint8_t getBaudrateIndex(long baudrate);	// HC_BAUDRATE_NONE if not in the table
 		#endif
 		bool nextToken(uint8_t qty);
 		bool nextToken();
+		#ifdef PROTOBF_USE_BINARY
+			bool nextBytes(uint8_t qty);
+		#else
+			void decodeToken();
+		#endif
 
 
 		// ---------------------------------------------------------------------
 		// Serial print --------------------------------------------------------
 		// ---------------------------------------------------------------------
 
-		// Footer (CR + LF)
+		// Footer (CR + LF, or COBS encoding + 0x00 delimiter if binary)
 		void printFooter();
 
+		// Byte
+		void writeByte(uint8_t b);								// no CRC
+		void printByte(uint8_t b);								// CRC
+		#ifdef PROTOBF_USE_BINARY
+			void printBytes(unsigned long value, uint8_t qty);	// little-endian, CRC
+		#endif
+
+		// Digits (ASCII, base 10 or 16)
+		void printDigits(unsigned long value, uint8_t base, uint8_t minLength, bool addToCRC);
+
+		// Send frame (1 write)
+		void flushOutput();									// frame (or its end) fits in the TX buffer
+		bool sendOutput();									// never blocks (false: frame or its end is deferred)
+
 		// char
 		void printChar(char c);
 
@@ -278,11 +683,10 @@ class HC_Protocol
 		void printStartChar(char StartChar);
 
 		// Message Type/Error
+		void printMessageType(char messageType);
 		#ifdef PROTOBF_USE_READABLE_MESSAGETYPE
-			void printMessageType(unsigned int messageType);
 			void printMessageError(unsigned int errorCode);
 		#else
-			void printMessageType(char messageType);
 			void printMessageError(char errorCode);
 		#endif
 
@@ -291,11 +695,9 @@ class HC_Protocol
 
 		// CRC
 		void printCRC();
-		void addCRC(unsigned long l);
 		
 		// Print number in Hex format
 		void printHex(bool value);
-		void printHex(uint8_t value, bool fillWithZero, bool printedValueIsCRC);
 		void printHex(uint8_t value, bool fillWithZero);
 		void printHex(uint8_t value);
 		void printHex(unsigned int value, uint8_t maxLengthWithZeros);
@@ -317,21 +719,18 @@ class HC_Protocol
 
 
 		// ---------------------------------------------------------------------
-		// String to Number ----------------------------------------------------
+		// Token to Number ----------------------------------------------------
 		// ---------------------------------------------------------------------
 
-		// Hex format string to unsigned Long
-		unsigned long hexStringToULong(char* str);
-
-		// string to Boolean
-		bool stringToBool(char* str);
-
-		// Decimal format string to Unsigned Int/Long
-		unsigned long stringToULong(char* str);
-		unsigned int stringToUInt(char* str);
+		// Last token (mInput_data) to Number (raw little-endian value if binary)
+		unsigned long tokenHexToULong();
+		unsigned long tokenToULong();
+		unsigned int tokenToUInt();
+		bool tokenToBool();
+		float tokenToFloat();
 
-		// Decimal format string to float
-		float stringToFloat(char* str);
+		// Last token to String (NUL-terminated in place: the following char is overwritten)
+		char* tokenToString();
 };
 
 
@@ -35,10 +35,14 @@
 #endif
 
 // HITICommSupport
-#include <HCS_Serial.h>
+#include <HCS_Time.h>
+
+// Arduino
+#include <Arduino.h>
 
 // HITIComm
 #include "HC_Toolbox.h"
+#include "sub\HC_MessageType.h"
 #ifdef PROTOBF_USE_INT
 	#include "HC_Data.h"
 #endif
@@ -73,6 +77,163 @@ enum SpecialChar
 
 
 
+// *****************************************************************************
+// HC_PROTOCOL : Output Frame
+// *****************************************************************************
+
+
+// Byte ------------------------------------------------------------------------
+
+void HC_Protocol::writeByte(uint8_t b)
+{
+	// reply is dropped: the frame may still hold a deferred reply
+	if (mOutput_isDropped)
+		return;
+
+	#ifdef PROTOBF_USE_BINARY
+		// keep 1 byte for the 0x00 delimiter
+		if (mOutput_length < HC_OUTPUTFRAME_MAX_ARRAY_LENGHT - 1)
+	#else
+		if (mOutput_length < HC_OUTPUTFRAME_MAX_ARRAY_LENGHT)
+	#endif
+			mOutput[mOutput_length++] = b;
+		// frame is too long: reply is dropped (never sent in parts)
+		else
+		{
+			mOutput_length = HC_OUTPUTFRAME_START;
+			mOutput_isDropped = true;
+		}
+}
+
+void HC_Protocol::printByte(uint8_t b)
+{
+	#ifdef PROTOBF_USE_BINARY
+		mOutput_CRC = HCI_updateCRC16(mOutput_CRC, b);
+	#else
+		mOutput_CRC += b;
+	#endif
+
+	writeByte(b);
+}
+
+#ifdef PROTOBF_USE_BINARY
+void HC_Protocol::printBytes(unsigned long value, uint8_t qty)
+{
+	// little-endian
+	while (qty--)
+	{
+		printByte((uint8_t) value);
+		value >>= 8;
+	}
+}
+#endif
+
+
+// Digits ----------------------------------------------------------------------
+
+// ASCII digits (base 10 or 16, upper case), completed with leading zeros up to minLength
+void HC_Protocol::printDigits(unsigned long value, uint8_t base, uint8_t minLength, bool addToCRC)
+{
+	char digits[3 * sizeof(unsigned long)];	// enough for DEC (max: 4294967295)
+	uint8_t i = 0;
+
+	do
+	{
+		uint8_t d = value % base;
+		value /= base;
+		digits[i++] = (d < 10) ? d + '0' : d - 10 + 'A';
+	} while (value);
+
+	while ((i < minLength) && (i < sizeof(digits)))
+		digits[i++] = '0';
+
+	while (i)
+	{
+		if (addToCRC)
+			printByte(digits[--i]);
+		else
+			writeByte(digits[--i]);
+	}
+}
+
+
+// Send ------------------------------------------------------------------------
+
+// write the whole frame (or its end) in 1 call. The TX buffer can take it (see sendOutput())
+void HC_Protocol::flushOutput()
+{
+	#ifdef HC_MULTIDROP
+		// multi-drop: the node only talks during its turn (else frame is dropped)
+		if ((mOutput_length > 0) && (mNode_turn > 0))
+		{
+			// driver is enabled until the frames are sent (released in receive())
+			if (mNode_driverEnablePin != HC_MULTIDROP_NO_PIN)
+			{
+				if (!mNode_isDriving)
+				{
+					digitalWrite(mNode_driverEnablePin, HIGH);
+					mNode_isDriving = true;
+				}
+				mNode_txBusyTime = HCS_micros();
+			}
+
+			mStream->write(mOutput, mOutput_length);
+			mOutput_queuedBytes += mOutput_length;
+		}
+	#else
+		if (mOutput_length > mOutput_sentLength)
+		{
+			mStream->write(mOutput + mOutput_sentLength, mOutput_length - mOutput_sentLength);
+			mOutput_queuedBytes += mOutput_length - mOutput_sentLength;
+		}
+	#endif
+
+	mOutput_length = HC_OUTPUTFRAME_START;
+	mOutput_sentLength = 0;
+	mOutput_isDeferred = false;
+}
+
+// write the whole frame only if the TX buffer can take it (else frame is kept for a later cycle)
+bool HC_Protocol::sendOutput()
+{
+	// max room ever seen = empty TX buffer (Stream without TX buffer: always 0)
+	int txRoom = mStream->availableForWrite();
+	if (txRoom > mOutput_txRoomMax)
+		mOutput_txRoomMax = txRoom;
+
+	#ifdef HC_MULTIDROP
+		// turn-around: the host releases the bus before the node talks (frame is kept until then)
+		if (!mNode_isDriving && (mNode_turn > 0) && (HCS_micros() - mInput_endTime < mNode_turnaroundDelay))
+		{
+			mOutput_isDeferred = true;
+			return false;
+		}
+	#endif
+
+	// frame fits, or Stream without TX buffer (room unknown: can't do better)
+	if ((txRoom >= mOutput_length - mOutput_sentLength) || (mOutput_txRoomMax == 0))
+	{
+		flushOutput();
+		return true;
+	}
+
+	#ifndef HC_MULTIDROP
+		// frame longer than the TX buffer, which is empty: the part which fits is written now, the end
+		// in the next cycles (nothing else is sent meanwhile)
+		if ((txRoom > 0) && ((txRoom >= mOutput_txRoomMax) || (mOutput_sentLength > 0)))
+		{
+			mStream->write(mOutput + mOutput_sentLength, txRoom);
+			mOutput_queuedBytes += txRoom;
+			mOutput_sentLength += txRoom;
+		}
+	#endif
+
+	mOutput_isDeferred = true;
+	return false;
+}
+
+
+
 // *****************************************************************************
 // HC_PROTOCOL : Serial Print
 // *****************************************************************************
@@ -82,7 +243,36 @@ enum SpecialChar
 
 void HC_Protocol::printFooter()
 {
-	HCS_Serial_println();
+	// dropped reply (too long, or deferred reply still waiting): counted, nothing is sent
+	if (mOutput_isDropped)
+	{
+		mOutput_isDropped = false;
+		++mOutput_droppedReplies;
+		return;
+	}
+
+	#ifdef PROTOBF_USE_BINARY
+		// COBS encoding (in place): the frame no longer contains any 0x00
+		if (mOutput_length > HC_OUTPUTFRAME_START)
+			mOutput_length = HCI_encodeCOBS(mOutput, mOutput_length - HC_OUTPUTFRAME_START);
+		else
+			mOutput_length = 0;
+
+		// 0x00 delimiter
+		mOutput[mOutput_length++] = 0;
+	#else
+		writeByte('\r');
+		writeByte('\n');
+	#endif
+
+	#ifdef HC_FLOW_CONTROL
+		// reply of a paced query: credits spent by the whole frame, sent now or deferred
+		if (mFlow_isPaced)
+			spendFlowCredit(mOutput_length);
+	#endif
+
+	if (!sendOutput())
+		++mOutput_deferredReplies;
 }
 
 
@@ -90,8 +280,7 @@ void HC_Protocol::printFooter()
 
 void HC_Protocol::printChar(char c)
 {
-	mOutput_CRC += c;
-	HCS_Serial_print(c);
+	printByte(c);
 }
 
 
@@ -102,8 +291,10 @@ void HC_Protocol::printConcBytesToString(unsigned int hex, uint8_t stringLength)
 {
 	// convert hex into string
 	char str[3];
-	mOutput_CRC += HCI_concByteToString(hex, str, stringLength);
-	HCS_Serial_print(str);
+	HCI_concByteToString(hex, str, stringLength);
+
+	for (uint8_t i = 0; i < stringLength; ++i)
+		printChar(str[i]);
 }
 #endif
 
@@ -112,15 +303,15 @@ void HC_Protocol::printConcBytesToString(unsigned int hex, uint8_t stringLength)
 
 void HC_Protocol::printSpecialChar_Separator(bool forcePrinting)
 {
-	#ifdef PROTOBF_USE_SEPARATOR
-		mOutput_CRC += SpecialChar_separator[0];
-		HCS_Serial_print(SpecialChar_separator);
+	#if defined(PROTOBF_USE_BINARY)
+		// a forced separator ends a string: NUL terminator
+		if (forcePrinting)
+			printByte(0);
+	#elif defined(PROTOBF_USE_SEPARATOR)
+		printChar(SpecialChar_separator[0]);
 	#else
 		if (forcePrinting)
-		{
-			mOutput_CRC += SpecialChar_separator[0];
-			HCS_Serial_print(SpecialChar_separator);
-		}
+			printChar(SpecialChar_separator[0]);
 	#endif
 }
 
@@ -131,8 +322,7 @@ void HC_Protocol::printSpecialChar_Separator()
 
 void HC_Protocol::printSpecialChar_EmptyData(bool forcePrintingSeparator)
 {
-	mOutput_CRC += SpecialChar_emptyData;
-	HCS_Serial_print((char) SpecialChar_emptyData);
+	printChar(SpecialChar_emptyData);
 	printSpecialChar_Separator(forcePrintingSeparator);
 }
 
@@ -146,30 +336,17 @@ void HC_Protocol::printSpecialChar_EmptyData()
 
 void HC_Protocol::printString_withSeparator_P(const char* pgm_str)
 {
-	HCS_Serial_print_P(pgm_str);
-
-	// calculate CRC
-	if (strlen_P(pgm_str) > 0)
-	{
-		uint8_t i = strlen_P(pgm_str);
-		while(i)
-			mOutput_CRC += pgm_read_byte_near(pgm_str + (--i));
-	}
+	char c;
+	while ((c = pgm_read_byte_near(pgm_str++)) != '\0')
+		printChar(c);
 
 	printSpecialChar_Separator(true);
 }
 
 void HC_Protocol::printString(const char* str, bool forcePrintSeparator)
 {
-	HCS_Serial_print(str);
-
-	// calculate CRC
-	if (strlen(str) > 0)
-	{
-		uint8_t i = strlen(str);
-		while (i)
-			mOutput_CRC += str[--i];
-	}
+	while (*str != '\0')
+		printChar(*str++);
 
 	printSpecialChar_Separator(forcePrintSeparator);
 }
@@ -189,26 +366,35 @@ void HC_Protocol::printString_withSeparator(const char* str)
 
 void HC_Protocol::printStartChar(char StartChar)
 {
+	// new message: a deferred reply is sent first. Only 1 message is built per cycle once a reply is
+	// deferred (see receive()): if the deferred reply still doesn't fit, the new one is dropped (never blocks)
+	if (mOutput_isDeferred && !sendOutput())
+		mOutput_isDropped = true;
+
 	printChar(StartChar);
 	printSpecialChar_Separator();
+
+	#ifdef HC_MULTIDROP
+		// multi-drop: node address
+		printNumber(mNode);
+	#endif
 }
 
 
 // Message Type/Error ------------------------------------------------------
 
-#ifdef PROTOBF_USE_READABLE_MESSAGETYPE
-	void HC_Protocol::printMessageType(unsigned int messageType)
-	{
-		printConcBytesToString(messageType, 2);
-		printSpecialChar_Separator();
-	}
-#else
-	void HC_Protocol::printMessageType(char messageType)
-	{
+void HC_Protocol::printMessageType(char messageType)
+{
+	#ifdef PROTOBF_USE_READABLE_MESSAGETYPE
+		// name (2 chars) from the descriptor table
+		const MessageDescriptor* descriptor = &HC_messageDescriptors[messageType - HC_MESSAGETYPE_FIRST];
+		printChar(pgm_read_byte(&descriptor->name[0]));
+		printChar(pgm_read_byte(&descriptor->name[1]));
+	#else
 		printChar(messageType);
-		printSpecialChar_Separator();
-	}
-#endif
+	#endif
+	printSpecialChar_Separator();
+}
 
 
 #ifdef PROTOBF_USE_READABLE_MESSAGETYPE
@@ -221,10 +407,19 @@ void HC_Protocol::printMessageError(char errorCode)
 	mOutput_CRC = 0;
 
 	printStartChar(HC_StartChar_exclamation);	// Header 1
-	printMessageType(errorCode);				// Header 2
+
+	#ifdef PROTOBF_USE_READABLE_MESSAGETYPE		// Header 2
+		printConcBytesToString(errorCode, 2);
+		printSpecialChar_Separator();
+	#else
+		printMessageType(errorCode);
+	#endif
 
 	#ifdef HC_DISPLAY_INPUT_IN_ERRORMESSAGE
-		printString(mInput);
+		// received message (may contain 0x00 if binary)
+		for (uint8_t i = 0; i < mInput_length; ++i)
+			printByte(mInput[i]);
+		printSpecialChar_Separator();
 	#endif
 
 	printCRC();									// CRC
@@ -245,93 +440,60 @@ void HC_Protocol::printControlByte(uint8_t b)
 
 void HC_Protocol::printCRC()
 {
-	#ifdef PROTOBF_USE_CRC
-		// fill with 0, printed value is CRC
-		printHex(HCS_getLowByte(mOutput_CRC), true, true);
+	#if defined(PROTOBF_USE_CRC)
+		// fill with 0 (if hex is filled), CRC value is not added to CRC
+		#ifdef PROTOBF_FILL_HEX
+			printDigits(HCS_getLowByte(mOutput_CRC), HEX, 2, false);
+		#else
+			printDigits(HCS_getLowByte(mOutput_CRC), HEX, 1, false);
+		#endif
+	#elif defined(PROTOBF_USE_BINARY)
+		// CRC-16, little-endian
+		writeByte(HCS_getLowByte(mOutput_CRC));
+		writeByte(HCS_getHighByte(mOutput_CRC));
 	#endif
 }
 
-void HC_Protocol::addCRC(unsigned long l)
-{
-	// CRC with HEX only (base 16)
-	do
-	{
-		// convert number into string, add each char to CRC
-		char c = l % 16;
-		l /= 16;
-		mOutput_CRC += (c < 10) ? c + '0' : c-10 + 'A';
-	} while (l);
-}
-
 
 // Print number in Hex format ----------------------------------------------
 
 void HC_Protocol::printHex(bool value)
 {
-	HCS_Serial_print((value == 0) ? '0' : '1');
-	addCRC(value);
-	printSpecialChar_Separator();
-}
-
-void HC_Protocol::printHex(uint8_t value, bool fillWithZero, bool printedValueIsCRC)
-{
-	// 2 chars
-	#ifdef PROTOBF_FILL_HEX
-		// complete with leading 0
-		if (fillWithZero && (value < 16))
-		{
-			HCS_Serial_print('0');
-			mOutput_CRC += '0';
-		}
-	#endif
-
-	if (value == 0)
-		HCS_Serial_print('0');
-	else
-		HCS_Serial_print(value, HEX);
-
-	if (!printedValueIsCRC)
-	{
-		addCRC(value);
+	#ifdef PROTOBF_USE_BINARY
+		printByte(value);
+	#else
+		printByte((value == 0) ? '0' : '1');
 		printSpecialChar_Separator();
-	}
+	#endif
 }
 
 void HC_Protocol::printHex(uint8_t value, bool fillWithZero)
 {
-	printHex(value, fillWithZero, false);
+	#ifdef PROTOBF_USE_BINARY
+		// 1 byte
+		printByte(value);
+	#else
+		// 2 chars
+		#ifdef PROTOBF_FILL_HEX
+			// complete with leading 0
+			printDigits(value, HEX, fillWithZero ? 2 : 1, true);
+		#else
+			printDigits(value, HEX, 1, true);
+		#endif
+
+		printSpecialChar_Separator();
+	#endif
 }
 
 void HC_Protocol::printHex(uint8_t value)
 {
-	printHex(value, true, false);
+	printHex(value, true);
 }
 
 
 void HC_Protocol::printHex(unsigned int value, uint8_t maxLengthWithZeros)
 {
-	// 4 chars
-	#ifdef PROTOBF_FILL_HEX
-		// complete with leading zero
-		while(--maxLengthWithZeros)
-		{
-			if (value < HC_pow(16, maxLengthWithZeros))
-			{
-				HCS_Serial_print('0');
-				mOutput_CRC += '0';
-			}
-			else
-				break;
-		}
-	#endif
-
-	if (value == 0)
-		HCS_Serial_print('0');
-	else
-		HCS_Serial_print(value, HEX);
-
-	addCRC(value);
-	printSpecialChar_Separator();
+	printHex((unsigned long) value, maxLengthWithZeros);
 }
 
 void HC_Protocol::printHex(unsigned int value)
@@ -346,28 +508,20 @@ void HC_Protocol::printHex(unsigned int value)
 
 void HC_Protocol::printHex(unsigned long value, uint8_t maxLengthWithZeros)
 {
-	// 8 chars
-	#ifdef PROTOBF_FILL_HEX
-		// complete with leading zero
-		while (--maxLengthWithZeros)
-		{
-			if (value < HC_pow(16, maxLengthWithZeros))
-			{
-				HCS_Serial_print('0');
-				mOutput_CRC += '0';
-			}
-			else
-				break;
-		}
-	#endif
-
-	if (value == 0)
-		HCS_Serial_print('0');
-	else
-		HCS_Serial_print(value, HEX);
+	#ifdef PROTOBF_USE_BINARY
+		// 1 byte for 2 chars
+		printBytes(value, (maxLengthWithZeros + 1) / 2);
+	#else
+		// 8 chars
+		#ifdef PROTOBF_FILL_HEX
+			// complete with leading zero
+			printDigits(value, HEX, maxLengthWithZeros, true);
+		#else
+			printDigits(value, HEX, 1, true);
+		#endif
 
-	addCRC(value);
-	printSpecialChar_Separator();
+		printSpecialChar_Separator();
+	#endif
 }
 
 void HC_Protocol::printHex(unsigned long value)
@@ -386,7 +540,7 @@ void HC_Protocol::printNumber(bool number)
 void HC_Protocol::printNumber(uint8_t number)
 {
 	#ifdef PROTOBF_USE_INT
-		HCS_Serial_print(number, DEC);
+		printDigits(number, DEC, 1, true);
 		printSpecialChar_Separator();
 	#else
 		printHex(number);
@@ -395,12 +549,7 @@ void HC_Protocol::printNumber(uint8_t number)
 
 void HC_Protocol::printNumber(unsigned int number, uint8_t maxHexLengthWithZeros)
 {
-	#ifdef PROTOBF_USE_INT
-		HCS_Serial_print(number, DEC);
-		printSpecialChar_Separator();
-	#else
-		printHex(number, maxHexLengthWithZeros);
-	#endif
+	printNumber((unsigned long) number, maxHexLengthWithZeros);
 }
 
 void HC_Protocol::printNumber(unsigned int number)
@@ -415,7 +564,7 @@ void HC_Protocol::printNumber(unsigned int number)
 void HC_Protocol::printNumber(unsigned long number, uint8_t maxHexLengthWithZeros)
 {
 	#ifdef PROTOBF_USE_INT
-		HCS_Serial_print(number, DEC);
+		printDigits(number, DEC, 1, true);
 		printSpecialChar_Separator();
 	#else
 		printHex(number, maxHexLengthWithZeros);
@@ -432,13 +581,52 @@ void HC_Protocol::printNumber(unsigned long number)
 void HC_Protocol::printFloat(float number)
 {
 	#ifdef PROTOBF_USE_INT
-		double integer;
-
-		// if fraction is null
-		if (modf(number, &integer) == 0.0)
-			HCS_Serial_print(number, 0);
+		if (isnan(number))
+			printString("nan");
+		else if (isinf(number))
+			printString("inf");
+		// out of unsigned long range
+		else if ((number > 4294967040.0) || (number < -4294967040.0))
+			printString("ovf");
 		else
-			HCS_Serial_print(number, HC_DECIMAL_QTY);
+		{
+			double integer;
+
+			// if fraction is null: no decimal
+			uint8_t decimals = (modf(number, &integer) == 0.0) ? 0 : HC_DECIMAL_QTY;
+
+			// sign
+			if (number < 0.0)
+			{
+				printChar('-');
+				number = -number;
+			}
+
+			// round to the last printed decimal
+			double rounding = 0.5;
+			for (uint8_t i = 0; i < decimals; ++i)
+				rounding /= 10.0;
+			number += rounding;
+
+			// integer part
+			unsigned long int_part = (unsigned long) number;
+			printDigits(int_part, DEC, 1, true);
+
+			// decimal part
+			if (decimals > 0)
+			{
+				printChar('.');
+
+				double remainder = number - (double) int_part;
+				while (decimals--)
+				{
+					remainder *= 10.0;
+					uint8_t digit = (uint8_t) remainder;
+					printChar(digit + '0');
+					remainder -= digit;
+				}
+			}
+		}
 
 		printSpecialChar_Separator();		
 	#else
@@ -449,60 +637,54 @@ void HC_Protocol::printFloat(float number)
 
 
 // *****************************************************************************
-// HC_PROTOCOL : String to Number
+// HC_PROTOCOL : Token to Number
 // *****************************************************************************
 
 
-// Hex format string to unsigned Long
-unsigned long HC_Protocol::hexStringToULong(char* str)
-{
-	// convert string (hex) to a long
-	return strtoul(str, NULL_POINTER, 16);
-}
+// Last token to Number --------------------------------------------------------
+// the token value has already been decoded by nextToken()
 
-
-// string to Boolean
-bool HC_Protocol::stringToBool(char* str)
+unsigned long HC_Protocol::tokenHexToULong()
 {
-	// convert string to bool
-	return (atoi(str) != 0) ? 1 : 0;
+	return mInput_value;
 }
 
-
-// Decimal format string to Unsigned Long (max 4 294 967 295)
-unsigned long HC_Protocol::stringToULong(char* str)
+unsigned long HC_Protocol::tokenToULong()
 {
 	#ifdef PROTOBF_USE_INT
-		// convert string (decimal) to a long
-		return atol(str);
+		return mInput_decimalValue;
 	#else
-		// convert string (hex) to a long
-		return hexStringToULong(str);
+		return mInput_value;
 	#endif
 }
 
+unsigned int HC_Protocol::tokenToUInt()
+{
+	return (unsigned int) tokenToULong();
+}
 
-// Decimal format string to Unsigned Int (max 65535)
-unsigned int HC_Protocol::stringToUInt(char* str)
+bool HC_Protocol::tokenToBool()
+{
+	return (tokenToULong() != 0);
+}
+
+float HC_Protocol::tokenToFloat()
 {
 	#ifdef PROTOBF_USE_INT
-		// convert string (decimal) to a long
-		return atoi(str);
+		// decimal string (ends at next separator)
+		return atof(mInput_data);
 	#else
-		// convert string (hex) to a long
-		return (unsigned int) hexStringToULong(str);
+		// hex value (or raw bytes if binary) to float
+		return HCI_convertHexToFloat(mInput_value);
 	#endif
 }
 
 
-// Decimal format string to float
-float HC_Protocol::stringToFloat(char* str)
+// Last token to String --------------------------------------------------------
+
+char* HC_Protocol::tokenToString()
 {
-	#ifdef PROTOBF_USE_INT
-		// convert the data string (decimal) to a double
-		return atof(str);
-	#else
-		// convert the data string (hex) to a long, then a float
-		return HCI_convertHexToFloat(hexStringToULong(str));
-	#endif
+	// following char (separator, CRC or end of message) is no longer needed
+	mInput_data[mInput_dataLength] = '\0';
+	return mInput_data;
 }
@@ -33,12 +33,17 @@
 // HITICommSupport
 #include <HCS_LowAccess_IO.h>
 #include <HCS_Time.h>
-#include <HCS_Serial.h>
+#ifdef HC_BAUDRATE_NEGOTIATION
+	#include <HCS_Serial.h>
+#endif
 
 // HITIComm
 #include "HC_Data.h"
 #include "HC_Sram.h"
 #include "HC_ServoManager.h"
+#include "HC_Toolbox.h"
+#include "HC_Sampler.h"
+#include "sub\HC_MessageType.h"
 
 
 
@@ -68,174 +73,79 @@ enum StartChar
 	HC_StartChar_dollar			= 0x24, // $, C->A (query)
 };
 
-enum MessageError
-{
+// error codes (see HC_MessageTable.h): 2 chars if PROTOBF_USE_READABLE_MESSAGETYPE
 #ifdef PROTOBF_USE_READABLE_MESSAGETYPE
-	HC_MessageError_AM = 0x414D,  // Address Missing
-	HC_MessageError_IA = 0x4941,  // Index not Allowed
-	HC_MessageError_MT = 0x4D54,  // invalid Message Type
-	HC_MessageError_RW = 0x5257,  // invalid Read Write mode
-	HC_MessageError_IN = 0x494E,  // invalid INdex
-	HC_MessageError_AD = 0x4144,  // invalid ADdress
-	HC_MessageError_US = 0x5553,  // Unknown Sender
-	HC_MessageError_TS = 0x5453,  // message is Too Short
-	HC_MessageError_CS = 0x4353,  // Invalid Checksum
-	HC_MessageError_CM = 0x434D,  // Checksum mismatch
-	HC_MessageError_IR = 0x4952,  // Index Required
+	#define HC_MESSAGEERROR_CODE(name, code, c0, c1)	HC_MessageError_##name = ((c0) << 8) | (c1),
 #else
-	HC_MessageError_AM = 0x30,  // Address Missing
-	HC_MessageError_IA = 0x31,  // Index not Allowed
-	HC_MessageError_MT = 0x32,  // invalid Message Type
-	HC_MessageError_RW = 0x33,  // invalid Read Write mode
-	HC_MessageError_IN = 0x34,  // invalid INdex
-	HC_MessageError_AD = 0x35,  // invalid ADdress
-	HC_MessageError_US = 0x36,  // Unknown Sender
-	HC_MessageError_TS = 0x37,  // message is Too Short
-	HC_MessageError_CS = 0x38,  // Invalid Checksum
-	HC_MessageError_CM = 0x39,  // Checksum mismatch
-	HC_MessageError_IR = 0x3A,  // Index Required
+	#define HC_MESSAGEERROR_CODE(name, code, c0, c1)	HC_MessageError_##name = code,
 #endif
-};
 
-
-// Message Type --------------------------------------------------------
-
-enum MessageType
+enum MessageError
 {
-#ifdef PROTOBF_USE_READABLE_MESSAGETYPE
-	HC_MessageType_Bf = 0x4266,  // B query request (Board features)
-	HC_MessageType_Bq = 0x4271,  // B query replies (Board features 0-3)
-	HC_MessageType_BS = 0x4253,  // Board has started (or has reset)
+	HC_MESSAGEERROR_TABLE(HC_MESSAGEERROR_CODE)
+};
 
-	HC_MessageType_M0 = 0x4D30,  // SRAM (Break value 0, Stack Pointer 0)
-	HC_MessageType_FR = 0x4652,  // Free RAM (measurement 0-2)
 
-	HC_MessageType_CT = 0x4354,  // Cycle Time (in us)
-	HC_MessageType_TM = 0x544D,  // Arduino Time (in ms)
+// Received message fields (in order of reception) -----------------------
 
-#ifdef HC_STRINGMESSAGE_COMPILE
-	HC_MessageType_S0 = 0x5330,  // HITI string
+enum InputField
+{
+	HC_InputField_Start = 0,	// $
+#ifdef HC_MULTIDROP
+	HC_InputField_Node,			// Node address (multi-drop)
+#endif
+	HC_InputField_Type,			// Message Type
+	HC_InputField_Config,		// Config Byte
+	HC_InputField_Index,		// Target Index (optional)
+	HC_InputField_Address,		// Target Address (optional)
+#ifdef HC_FLOW_CONTROL
+	HC_InputField_Credit,		// Credits granted (optional, flow control)
 #endif
+	HC_InputField_Data			// Data (decoded on demand by nextToken()), then CRC
+};
 
-#ifdef HC_EEPROM_COMPILE
-	HC_MessageType_EE = 0x4545,  // EEPROM access
-	HC_MessageType_Es = 0x4573,  // EEPROM (notify start of a reply sequence)	
-	HC_MessageType_Ee = 0x4565,  // EEPROM (notify end of a reply sequence)	
-	HC_MessageType_Ec = 0x4563,  // EEPROM (IO Config access)
-	HC_MessageType_Ep = 0x4570,  // EEPROM (Config Param)
+// fields length if no separator (chars, bytes if binary)
+#ifdef PROTOBF_USE_READABLE_MESSAGETYPE
+	#define HC_INPUTFIELD_TYPE_LENGHT		2
+#else
+	#define HC_INPUTFIELD_TYPE_LENGHT		1
 #endif
 
-	HC_MessageType_PM = 0x504D,  // Pin mode / Input mode
-	HC_MessageType_DI = 0x4449,  // DI values
-	HC_MessageType_DO = 0x444F,  // DO values
-	HC_MessageType_AI = 0x4149,  // AI values
-	HC_MessageType_OT = 0x4F54,  // Output type
-	HC_MessageType_PA = 0x5041,  // PWM availability
-	HC_MessageType_PW = 0x5057,  // PWM values
-	HC_MessageType_SM = 0x534D,  // Servo mode
-	HC_MessageType_SV = 0x5356,  // Servo values
-	HC_MessageType_DD = 0x4444,  // DD values
-	HC_MessageType_AM = 0x414D,  // AD mask
-	HC_MessageType_AD = 0x4144,  // AD values
-#ifdef ARDUINO_ARCH_SAMD
-	HC_MessageType_DM = 0x444D,  // DAC mode (enable mask)
-	HC_MessageType_DA = 0x4441,  // DAC values
+#ifdef PROTOBF_USE_BINARY
+	#define HC_INPUTFIELD_INDEX_LENGHT		1
+	#define HC_INPUTFIELD_ADDRESS_LENGHT	2
+#else
+	#define HC_INPUTFIELD_INDEX_LENGHT		2
+	#define HC_INPUTFIELD_ADDRESS_LENGHT	4
 #endif
 
-	HC_MessageType_Xs = 0x5873,  // Subscribe to X query
-	HC_MessageType_Xu = 0x5875,  // Unsubscribe from X query
-
-	HC_MessageType_X0 = 0x5830,  // XQuery period, Cycle Time
-	HC_MessageType_X1 = 0x5831,  // AI values (part 1 : 0 - 7)
-	HC_MessageType_X2 = 0x5832,  // AI values (part 2 : 8 - 15)
-	HC_MessageType_X3 = 0x5833,  // PWM values (part 1 : 0 - 7)
-	HC_MessageType_X4 = 0x5834,  // PWM values (part 1 : 8 - 15)
-	HC_MessageType_X5 = 0x5835,  // Servo values (part 1 :  0 - 5)
-	HC_MessageType_X6 = 0x5836,  // Servo values (part 2 :  6 - 11)
-	HC_MessageType_X7 = 0x5837,  // Servo values (part 3 : 12 - 17) 
-	HC_MessageType_X8 = 0x5838,  // Servo values (part 4 : 18 - 23) 
-	HC_MessageType_X9 = 0x5839,  // Servo values (part 5 : 24 - 29) 
-	HC_MessageType_XA = 0x5841,  // Servo values (part 6 : 30 - 35)
-	HC_MessageType_XB = 0x5842,  // Servo values (part 7 : 36 - 41) 
-	HC_MessageType_XC = 0x5843,  // Servo values (part 8 : 42 - 47) 
-	HC_MessageType_XD = 0x5844,  // AD values (part 1 :  0 - 3)
-	HC_MessageType_XE = 0x5845,  // AD values (part 2 :  4 - 7)
-	HC_MessageType_XF = 0x5846,  // AD values (part 3 :  8 - 11)
-	HC_MessageType_XG = 0x5847,  // AD values (part 4 : 12 - 15)
-	HC_MessageType_XH = 0x5848,  // AD values (part 5 : 16 - 19)
-
-	HC_MessageType_Aq = 0x4171,  // A query reply
-	HC_MessageType_As = 0x4173,  // Subscribe to A query
-	HC_MessageType_Au = 0x4175,  // Unsubscribe from A query
+// Target Index and Address are decimal if PROTOBF_USE_INT
+#ifdef PROTOBF_USE_INT
+	#define HC_INPUTFIELD_NUMBER_BASE		10
 #else
-	HC_MessageType_Bf = 0x31,  // B query request (Board features)
-	HC_MessageType_Bq = 0x30,  // B query replies (Board features 0-3)
-	HC_MessageType_BS = 0x32,  // Board has started (or has reset)
+	#define HC_INPUTFIELD_NUMBER_BASE		16
+#endif
 
-	HC_MessageType_M0 = 0x3A,  // SRAM (Break value 0, Stack Pointer 0)
-	HC_MessageType_FR = 0x3D,  // Free RAM (measurement 0-2)
 
-	HC_MessageType_CT = 0x5A,  // Cycle Time (in us)
-#ifdef HC_ARDUINOTIME_COMPILE
-	HC_MessageType_TM = 0x5C,  // Arduino Time (in ms)
-#endif
+// Message Type --------------------------------------------------------
 
-#ifdef HC_STRINGMESSAGE_COMPILE
-	HC_MessageType_S0 = 0x79,  // HITI string
-#endif
-	
-#ifdef HC_EEPROM_COMPILE
-	HC_MessageType_EE = 0x70,  // EEPROM access
-	HC_MessageType_Es = 0x71,  // EEPROM (notify start of a reply sequence)	
-	HC_MessageType_Ee = 0x72,  // EEPROM (notify end of a reply sequence)	
-	HC_MessageType_Ec = 0x73,  // EEPROM (IO Config access)
-	HC_MessageType_Ep = 0x74,  // EEPROM (Config Param)
-#endif
+// Message descriptors (1 per code, from HC_MESSAGETYPE_FIRST to HC_MESSAGETYPE_LAST):
+// flags (what the computer can send), name (if PROTOBF_USE_READABLE_MESSAGETYPE)
+const MessageDescriptor HC_messageDescriptors[HC_MESSAGETYPE_QTY] PROGMEM =
+{
+	HC_MESSAGETYPE_TABLE(HC_MESSAGE_DESCRIPTOR, HC_MESSAGE_DESCRIPTOR_GAP)
+};
 
-	HC_MessageType_PM = 0x60,  // Pin mode / Input mode
-	HC_MessageType_DI = 0x61,  // DI values
-	HC_MessageType_DO = 0x62,  // DO values
-	HC_MessageType_AI = 0x63,  // AI values
-	HC_MessageType_OT = 0x64,  // Output type
-	HC_MessageType_PA = 0x65,  // PWM availability
-	HC_MessageType_PW = 0x66,  // PWM values
-	HC_MessageType_SM = 0x67,  // Servo mode
-	HC_MessageType_SV = 0x68,  // Servo values
-	HC_MessageType_DD = 0x69,  // DD values
-	HC_MessageType_AM = 0x6A,  // AD mask
-	HC_MessageType_AD = 0x6B,  // AD values
-#ifdef ARDUINO_ARCH_SAMD
-	HC_MessageType_DM = 0x6C,  // DAC mode (enable mask)
-	HC_MessageType_DA = 0x6D,  // DAC values
-#endif
-		
-	HC_MessageType_Xs = 0x5B,  // Subscribe to X query
-	HC_MessageType_Xu = 0x5D,  // Unsubscribe from X query
-
-	HC_MessageType_X0 = 0x40,  // XQuery period, Cycle Time
-	HC_MessageType_X1 = 0x41,  // AI values (part 1 : 0 - 7)
-	HC_MessageType_X2 = 0x42,  // AI values (part 2 : 8 - 15)
-	HC_MessageType_X3 = 0x43,  // PWM values (part 1 : 0 - 7)
-	HC_MessageType_X4 = 0x44,  // PWM values (part 1 : 8 - 15)
-	HC_MessageType_X5 = 0x45,  // Servo values (part 1 :  0 - 5)
-	HC_MessageType_X6 = 0x46,  // Servo values (part 2 :  6 - 11)
-	HC_MessageType_X7 = 0x47,  // Servo values (part 3 : 12 - 17) 
-	HC_MessageType_X8 = 0x48,  // Servo values (part 4 : 18 - 23) 
-	HC_MessageType_X9 = 0x49,  // Servo values (part 5 : 24 - 29) 
-	HC_MessageType_XA = 0x4A,  // Servo values (part 6 : 30 - 35)
-	HC_MessageType_XB = 0x4B,  // Servo values (part 7 : 36 - 41) 
-	HC_MessageType_XC = 0x4C,  // Servo values (part 8 : 42 - 47) 
-	HC_MessageType_XD = 0x4D,  // AD values (part 1 :  0 - 3)
-	HC_MessageType_XE = 0x4E,  // AD values (part 2 :  4 - 7)
-	HC_MessageType_XF = 0x4F,  // AD values (part 3 :  8 - 11)
-	HC_MessageType_XG = 0x50,  // AD values (part 4 : 12 - 15)
-	HC_MessageType_XH = 0x51,  // AD values (part 5 : 16 - 19)
-
-	HC_MessageType_Aq = 0x7A,  // A query reply
-	HC_MessageType_As = 0x7B,  // Subscribe to A query
-	HC_MessageType_Au = 0x7D,  // Unsubscribe from A query
-#endif
+
+#ifdef HC_BAUDRATE_NEGOTIATION
+// Baudrates (index of HC_BAUDRATE_TABLE)
+#define HC_BAUDRATE_VALUE(index, baudrate)	baudrate,
+
+const uint32_t HC_baudrates[HC_BAUDRATE_QTY] PROGMEM =
+{
+	HC_BAUDRATE_TABLE(HC_BAUDRATE_VALUE)
 };
+#endif
 
 
 #if defined ARDUINO_ARCH_SAMD
@@ -270,64 +180,111 @@ enum MessageType
 
 void HC_Protocol::receive()
 {
-	static uint8_t input_rawIndex = 0;
+#ifdef HC_MULTIDROP
+	// replies sent: back to receive mode
+	releaseDriverEnable();
+#endif
+
+	// if last reply is still waiting for room in the TX buffer, retry it. Nothing else is done
+	// meanwhile (no new reply, received data stays in the RX buffer)
+	if (mOutput_isDeferred && !sendOutput())
+		return;
 
     // if data received, process and reply to computer
-    if(HCS_Serial_isAvailable() > 0)
+    if(mStream->available() > 0)
     {	
-		while(HCS_Serial_isAvailable() > 0)
+		// stop reading if a reply has been deferred (it must be sent before the next one)
+		while((mStream->available() > 0) && !mOutput_isDeferred)
 		{
-			// read a char and record it in the array
-			mInput[input_rawIndex] = HCS_Serial_read();
+		#ifdef HC_BAUDRATE_NEGOTIATION
+			// baudrate change: next bytes are received at the new baudrate
+			if (mBaudrate_state == HC_BAUDRATE_STATE_SWITCHING)
+				break;
+		#endif
+
+			// read a byte
+			uint8_t b = mStream->read();
 
-			// CR detected
-			if (mInput[input_rawIndex] == '\r')
+		#ifdef PROTOBF_USE_BINARY
+			// 0x00 delimiter detected: frame is complete
+			if (b == 0)
 			{
-				mInput_EndDetectionFlag = 1;
-				mInput[input_rawIndex] = '\0';
+				// last COBS block is incomplete: invalid frame
+				if (mInput_cobsCount != 0)
+					mInput_length = 0;
+
+				// analyze message
+				analyzeInput();
+				resetInput();
 			}
-			// CR then LF detected: message is complete
-			else if((mInput_EndDetectionFlag == 1) && (mInput[input_rawIndex] == '\n'))
+			// COBS code byte: a 0x00 precedes each block (except the first one, and after a 254 bytes block)
+			else if (mInput_cobsCount == 0)
 			{
-				mInput_EndDetectionFlag = 2;
-				mInput[input_rawIndex] = '\0';
+				if (mInput_cobsCode != 0xFF)
+					parseInput(0);
 
+				mInput_cobsCode = b;
+				mInput_cobsCount = b - 1;
+			}
+			else
+			{
+				parseInput(b);
+				--mInput_cobsCount;
+			}
+		#else
+			// CR then LF detected: message is complete
+			if ((mInput_EndDetectionFlag == 1) && (b == '\n'))
+			{
 				// analyze message
 				analyzeInput();
-
-				// clear buffer
-				//for (uint8_t i = 0; i < HC_INPUTMESSAGE_MAX_ARRAY_LENGHT; ++i)
-				uint8_t i = HC_INPUTMESSAGE_MAX_ARRAY_LENGHT;
-				while(i)
-					mInput[--i] = 0;
+				resetInput();
 			}
 			else
-				// CR or (CR then LF) not detected
-				mInput_EndDetectionFlag = 0;
-
-			// if message end detected
-			if(mInput_EndDetectionFlag == 2)
 			{
-				// reset flag
-				mInput_EndDetectionFlag = 0;
+				// CR not followed by LF is part of the message
+				if (mInput_EndDetectionFlag == 1)
+					parseInput('\r');
 
-				// reset index
-				input_rawIndex = 0;
+				// CR detected
+				mInput_EndDetectionFlag = (b == '\r');
+
+				if (!mInput_EndDetectionFlag)
+					parseInput(b);
 			}
-			// increment index only if possible. If max is reached, value at index max
-			// will be overwritten every cycle until CR + LF are found
-			else if (input_rawIndex < HC_INPUTMESSAGE_MAX_ARRAY_LENGHT - 1)
-				++input_rawIndex;
+		#endif
 		}
     }
 	// if no data received, process E, EC, A, X Queries
 	else
 	{
+#ifdef HC_BAUDRATE_NEGOTIATION
+		// baudrate change: nothing is sent until the new baudrate is confirmed
+		if (mBaudrate_state != HC_BAUDRATE_STATE_IDLE)
+			return;
+#endif
+
+#ifdef HC_MULTIDROP
+		// multi-drop: queries are only processed during the turn of the node
+		if (mNode_turn == 0)
+			return;
+
+		unsigned int queuedBytes = mOutput_queuedBytes;
+#endif
+
 #ifndef HC_USE_FTDI
 		bool send_Xreply = false;
 		bool send_Areply = false;
 #endif
 
+#ifdef HC_FLOW_CONTROL
+		// flow control: 1 reply per cycle, built only if the credits cover it (else paused until the
+		// computer grants credits). B replies don't use credits
+		mFlow_isPaced = !mBquery_run;
+		if (mFlow_isPaced && !hasFlowCredit())
+			++mFlow_pausedCycles;
+
+		else
+#endif
         // if B Query being processed (B Query has priority on all other Queries)
 		if (mBquery_run)
 			// execute "B" reply at highest rate (every cycle) until all B queries have been sent
@@ -347,25 +304,21 @@ void HC_Protocol::receive()
 #endif
 
 
+#ifdef HC_CAPTURE_COMPILE
+		// if C Query being processed, or capture armed by computer is done or stopped (C Query has priority on A, X Queries)
+		else if (mCquery_run || (mCquery_isArmed && (HC_capture.getState() >= HC_CAPTURE_DONE)))
+			// execute "C" reply at highest rate (every cycle) until all captured data is sent
+			send_CQuery();
+#endif
+
+
 		// if X Query subscription
 		else if (mXquery_run)
 		{
-			// start/run timer (50ms)
-			mXquery_timer.run(50);
-
-			// 50ms is the min X query period. 2 cases can happen:
-			//    1) X reply sequence finishes execution before 50ms => X reply sequence restarts when timer is over (X query ID is reset, timer is reset)
-			//    2) X reply sequence finishes execution after 50ms  => X reply sequence restarts as soon as possible
-			bool XsequenceIsExecuting = (mXquery_ID < mXquery_qty);
-
-			if (mXquery_timer.isOver() && !XsequenceIsExecuting)
-			{
-				// restart reply sequence
-				mXquery_ID = 0;
-
-				// reset timer
-				mXquery_timer.reset();
-			}
+			// Each group of X replies is sent with its own period (HC_XGROUP_PERIOD_xxx). 2 cases can happen:
+			//    1) group is sent before its period is over => group is sent again when period is over
+			//    2) group is sent after its period is over  => group is sent again as soon as possible
+			bool XsequenceIsExecuting = selectXGroup();
 
 #ifdef HC_USE_FTDI
 			// Boards using FTDI chip:
@@ -418,13 +371,31 @@ void HC_Protocol::receive()
 		// if A reply must be sent
 		else if(send_Areply)
 		{
-			// only send reply every 2ms
-			if (mAquery_timer.delay(2))
+			// only send reply every HC_AQUERY_PERIOD (us)
+			unsigned long now = HCS_micros();
+			if (now - mAquery_previousTimestamp >= HC_AQUERY_PERIOD)
+			{
+				mAquery_previousTimestamp = now;
 				send(HC_MessageType_Aq);
+			}
 	
 			mSemaphor = true;
 		}
 #endif
+
+#ifdef HC_FLOW_CONTROL
+		mFlow_isPaced = false;
+#endif
+
+#ifdef HC_MULTIDROP
+		// end of turn: nothing to send anymore, or max frames sent
+		if (!mOutput_isDeferred && ((mOutput_queuedBytes == queuedBytes) || (--mNode_turn == 0)))
+		{
+			mNode_turn = 1;
+			send(HC_MessageType_NP);
+			mNode_turn = 0;
+		}
+#endif
 	}
 }
 
@@ -432,24 +403,49 @@ void HC_Protocol::receive()
 
 void HC_Protocol::analyzeInput()
 {
-	mInput_length = strlen(mInput);
-	mInput_index = 0;
+	HC_PROFILE(HC_PROFILE_ANALYZEINPUT);
+
+	// $, Message Type, Config Byte, Index and Address have been decoded while receiving (parseInput())
+
+	#ifdef HC_MULTIDROP
+		// frame sent to another node
+		if (mInput_isIgnored)
+			return;
+
+		mInput_endTime = HCS_micros();
+
+		// frame sent to this node: turn of the node starts (broadcast: no reply)
+		if ((mInput_fieldEnd[HC_InputField_Node] != 0) && (mInput_node == mNode))
+			mNode_turn = HC_MULTIDROP_TURN_FRAMES;
+	#endif
+
+	#ifdef HC_BAUDRATE_NEGOTIATION
+		// new baudrate not probed yet: only Bp is processed (other frames: no reply)
+		if ((mBaudrate_state == HC_BAUDRATE_STATE_PROBING) && (mInput_type != HC_MessageType_Bp))
+			return;
+	#endif
+
+	#ifdef PROTOBF_USE_SEPARATOR
+		// last field is not followed by a separator
+		if (mInput_fieldLength > 0)
+			closeInputField(mInput_length);
+	#endif
 
 	bool message_isCorrect = true;
 	
 
 	// if no CRC, remove ending separator, if any ------------------------------
-	#ifndef PROTOBF_USE_CRC
+	#if !defined(PROTOBF_USE_CRC) && !defined(PROTOBF_USE_BINARY)
 		if (mInput_length > 0)
 		{
 			if (mInput[mInput_length - 1] == SpecialChar_separator[0])
-			{
-				mInput[mInput_length - 1] = '\0';
 				--mInput_length;
-			}
 		}
 	#endif
 
+	// last token can be used as a string
+	mInput[mInput_length] = '\0';
+
 
 	// Is the message long enough ? --------------------------------------------
 
@@ -464,10 +460,22 @@ void HC_Protocol::analyzeInput()
 		++minLength;
 	#endif
 
+	#ifdef HC_MULTIDROP						// Ex : $05aB or $_5_a_B
+		#ifdef PROTOBF_USE_SEPARATOR
+			minLength += 2;
+		#else
+			minLength += HC_INPUTFIELD_INDEX_LENGHT;
+		#endif
+	#endif
+
 	#ifdef PROTOBF_USE_CRC					// Ex : $_a_B_C or $aBCS
 		minLength += 2;
 	#endif
 
+	#ifdef PROTOBF_USE_BINARY				// Ex : $aB + CRC-16 (2 bytes)
+		minLength += 2;
+	#endif
+
 	message_isCorrect = (mInput_length >= minLength);
 
 
@@ -478,23 +486,7 @@ void HC_Protocol::analyzeInput()
 
 		// Does the message starts with the Start string ? ---------------------
 	
-		#ifdef PROTOBF_USE_SEPARATOR
-			#ifdef HC_DISPLAY_INPUT_IN_ERRORMESSAGE
-				// copy input message before tokenizing
-				char copy[HC_INPUTMESSAGE_MAX_ARRAY_LENGHT];
-				strcpy(copy, mInput);
-
-				// get first token (contains Start Char)
-				mInput_data = strtok(copy, SpecialChar_separator);
-			#else
-				mInput_data = strtok(mInput, SpecialChar_separator);
-			#endif
-
-			message_isCorrect = (HCI_stringToConcByte(mInput_data) == HC_StartChar_dollar);
-		#else
-			if (mInput_length > 0)
-				message_isCorrect = (mInput[mInput_index++] == HC_StartChar_dollar);
-		#endif
+		message_isCorrect = (mInput_fieldEnd[HC_InputField_Start] != 0);
 
 
 		// if the message is still correct
@@ -502,43 +494,37 @@ void HC_Protocol::analyzeInput()
 		{
 			// Is the CRC valid ? ----------------------------------------------
 
-			#ifdef PROTOBF_USE_CRC
+			#if defined(PROTOBF_USE_CRC)
 				uint8_t readCRC = 0;
-				mInput_CRC_index = mInput_length - 2;
-				char CRC_str[3] = { 0 };
-
+				uint8_t i = mInput_length - 2;
 
 				#ifdef PROTOBF_USE_SEPARATOR
-					if (mInput[mInput_CRC_index] == SpecialChar_separator[0])
-						// case: _C
-						CRC_str[0] = mInput[++mInput_CRC_index];
-					else
+					if (mInput[i] == SpecialChar_separator[0])
 					{
-						// case: CS
-						CRC_str[0] = mInput[mInput_CRC_index];
-						CRC_str[1] = mInput[mInput_CRC_index + 1];
+						// case: _C (separator is included in the CRC)
+						mInput_dataEnd = i;
+						mInput_CRC += mInput[i++];
 					}
+					else
+						// case: _CS
+						mInput_dataEnd = i - 1;
 				#else
-					CRC_str[0] = mInput[mInput_CRC_index];
-					CRC_str[1] = mInput[mInput_CRC_index + 1];
+					mInput_dataEnd = i;
 				#endif
 
-
 				// chars must be valid hex values ('0'->'9' : 0x30->0x39 and 'A'->'F' : 0x41->0x46)
-				// else return 0
-				readCRC = hexStringToULong(CRC_str);
-
-				if(!readCRC)
+				while (message_isCorrect && (i < mInput_length))
 				{
-					#ifdef PROTOBF_USE_SEPARATOR
-						if (strlen(CRC_str) == 1)
-							message_isCorrect = (CRC_str[0] == 0x30);
-						else
-							message_isCorrect = (CRC_str[0] == 0x30) || (CRC_str[1] == 0x30);
-					#else
-						message_isCorrect = (CRC_str[0] == 0x30) || (CRC_str[1] == 0x30);
-					#endif
+					uint8_t digit = HCI_hexCharToValue(mInput[i++]);
+
+					message_isCorrect = (digit < 16);
+					readCRC = (readCRC << 4) | digit;
 				}
+			#elif defined(PROTOBF_USE_BINARY)
+				// CRC-16 (2 bytes)
+				mInput_dataEnd = mInput_length - 2;
+			#else
+				mInput_dataEnd = mInput_length;
 			#endif
 
 
@@ -546,17 +532,14 @@ void HC_Protocol::analyzeInput()
 			if (message_isCorrect)
 			{
 				// Does the read and calculated CRC match ? ------------------------
+				// (CRC has been calculated while receiving)
 
-				#ifdef PROTOBF_USE_CRC
-					unsigned int sum = 0;
-
-					// calculate CRC (CRC value not included in calculation)
-					uint8_t i = mInput_CRC_index;
-					while(i)
-						sum += mInput[--i];
-
-					// check matching
-					if(readCRC != HCS_getLowByte(sum))
+				#if defined(PROTOBF_USE_CRC)
+					if(readCRC != HCS_getLowByte(mInput_CRC))
+						message_isCorrect = false;
+				#elif defined(PROTOBF_USE_BINARY)
+					// CRC-16, little-endian, in the last 2 bytes
+					if (mInput_CRC != HCS_createWord((uint8_t) mInput[mInput_dataEnd + 1], (uint8_t) mInput[mInput_dataEnd]))
 						message_isCorrect = false;
 				#endif
 
@@ -564,44 +547,26 @@ void HC_Protocol::analyzeInput()
 				// if the message is still correct
 				if (message_isCorrect)
 				{
-					// Is the Message Type valid ? -------------------------------------
+					#ifdef HC_FLOW_CONTROL
+						// Credits granted by the computer (any valid frame) -----------
 
-					// read Message Type
-					#ifdef PROTOBF_USE_READABLE_MESSAGETYPE
-						unsigned int message_type;
-					#else
-						char message_type;
+						if (inputFieldIsReceived(HC_InputField_Credit) && (mFlow_unit != HC_FLOW_UNIT_NONE))
+							mFlow_credit += mInput_credit;
 					#endif
 
-					#ifdef PROTOBF_USE_SEPARATOR
-						// get next token
-						mInput_data = strtok(NULL_POINTER, SpecialChar_separator);
+					#ifdef HC_BAUDRATE_NEGOTIATION
+						// Bp replied: any other valid frame confirms the new baudrate (reply of Bp received)
+						if ((mBaudrate_state == HC_BAUDRATE_STATE_CONFIRMING) && (mInput_type != HC_MessageType_Bp))
+							mBaudrate_state = HC_BAUDRATE_STATE_IDLE;
+					#endif
 
-						if (mInput_data != 0)
-						{
-							message_type = HCI_stringToConcByte(mInput_data);
 
-							message_isCorrect = messageTypeIsValid(message_type);
-						}
-						else
-							message_isCorrect = false;
-					#else
-						#ifdef PROTOBF_USE_READABLE_MESSAGETYPE
-							// 2 chars
-							char message_type_str[3];
-							message_type_str[0] = mInput[mInput_index++];
-							message_type_str[1] = mInput[mInput_index++];
-							message_type_str[2] = '\0';
-							message_type = HCI_stringToConcByte(message_type_str);
-
-							message_isCorrect = messageTypeIsValid(message_type);
-						#else
-							// 1 char
-							message_type = mInput[mInput_index++];
-
-							message_isCorrect = messageTypeIsValid(message_type);
-						#endif
-					#endif
+					// Is the Message Type valid ? -------------------------------------
+
+					char message_type = mInput_type;
+					uint8_t message_flags = getMessageFlags(message_type);
+
+					message_isCorrect = inputFieldIsReceived(HC_InputField_Type) && (message_flags & HC_MESSAGE_QUERY);
 
 
 					// 	if the message is still correct
@@ -609,26 +574,9 @@ void HC_Protocol::analyzeInput()
 					{
 						// Config Byte ------------------------------------------------------
 			
-						uint8_t configByte;
+						uint8_t configByte = mInput_configByte;
 
-						#ifdef PROTOBF_USE_SEPARATOR
-							// get next token
-							mInput_data = strtok(NULL_POINTER, SpecialChar_separator);
-
-							if (mInput_data != 0)
-							{
-								if (strlen(mInput_data) == 1)
-									configByte = hexStringToULong(mInput_data);
-								else
-									message_isCorrect = false;
-							}
-							else
-								message_isCorrect = false;
-						#else
-							mInput_data[0] = mInput[mInput_index++];
-							mInput_data[1] = '\0';
-							configByte = hexStringToULong(mInput_data);
-						#endif
+						message_isCorrect = inputFieldIsReceived(HC_InputField_Config);
 
 
 						// if the message is still correct
@@ -647,8 +595,8 @@ void HC_Protocol::analyzeInput()
 
 							if (indexSpecified)
 							{
-								if (nextToken(2))
-									index = stringToULong(mInput_data);
+								if (inputFieldIsReceived(HC_InputField_Index))
+									index = mInput_targetIndex;
 								else
 									message_isCorrect = false;
 							}
@@ -665,9 +613,9 @@ void HC_Protocol::analyzeInput()
 
 								if (addressSpecified)
 								{
-									if (nextToken(4))
+									if (inputFieldIsReceived(HC_InputField_Address))
 										#ifdef HC_EEPROM_COMPILE
-											address = stringToULong(mInput_data);
+											address = mInput_address;
 										#else
 											message_isCorrect = true;
 										#endif
@@ -679,9 +627,38 @@ void HC_Protocol::analyzeInput()
 								// if the message is still correct
 								if (message_isCorrect)
 								{		
+									// Are mode, index and address allowed ? (descriptor table)
+
+									if (ReadWriteMode && !(message_flags & HC_MESSAGE_WRITE))
+										// Error message: invalid Read Write mode
+										printMessageError(HC_MessageError_RW);
+
+									else if (indexSpecified && !(message_flags & HC_MESSAGE_INDEX))
+										// Error message: Index not Allowed
+										printMessageError(HC_MessageError_IA);
+
+									else if (!indexSpecified && !(message_flags & HC_MESSAGE_NOINDEX))
+										// Error message: Index Required
+										printMessageError(HC_MessageError_IR);
+
+									else if (addressSpecified && !(message_flags & HC_MESSAGE_ADDRESS))
+										// Error message: invalid ADdress
+										printMessageError(HC_MessageError_AD);
+
+									else if (indexSpecified && !indexIsInRange(message_flags, index))
+										// Error message: invalid INdex
+										printMessageError(HC_MessageError_IN);
+
+									#ifdef HC_BAUDRATE_NEGOTIATION
+									else if (indexSpecified && (message_type == HC_MessageType_Br) && !baudrateIsSupported(index))
+										// Error message: invalid INdex (baudrate not supported)
+										printMessageError(HC_MessageError_IN);
+									#endif
+
+
 									// 	Target index NOT specified --------------------------
 
-									if(!indexSpecified)
+									else if(!indexSpecified)
 									{	
 										// EEPROM access specific variables
 										#ifdef HC_EEPROM_COMPILE
@@ -715,7 +692,7 @@ void HC_Protocol::analyzeInput()
 													case HC_MessageType_S0:
 
 														nextToken();
-														HC_writeString(mInput_data);
+														HC_writeString(tokenToString());
 														break;
 												#endif
 
@@ -727,13 +704,13 @@ void HC_Protocol::analyzeInput()
 														{
 															// get cell value
 															nextToken(2);
-															HC_eeprom.basic_writeByte(address, hexStringToULong(mInput_data));
+															HC_eeprom.basic_writeByte(address, tokenHexToULong());
 														}
 														else
 														{
 															// set or clear all EEPROM values
 															nextToken(1);
-															if (hexStringToULong(mInput_data) == 0)
+															if (tokenHexToULong() == 0)
 																clearAll = true;
 															else
 																setAll = true;
@@ -744,7 +721,7 @@ void HC_Protocol::analyzeInput()
 													case HC_MessageType_Ec:
 
 														/*nextToken(1);
-														switch (hexStringToULong(mInput_data))
+														switch (tokenHexToULong())
 														{
 															case 0:
 																// save current IO Config to EEPROM
@@ -767,7 +744,7 @@ void HC_Protocol::analyzeInput()
 													case HC_MessageType_Ep:
 
 														/*nextToken(2);
-														HC_eeprom.writeConfigRegister((uint8_t)hexStringToULong(mInput_data));*/
+														HC_eeprom.writeConfigRegister((uint8_t)tokenHexToULong());*/
 														break;
 												#endif
 
@@ -777,35 +754,35 @@ void HC_Protocol::analyzeInput()
 													
 													#if HC_VARIANT == HC_VARIANT_MEGA
 														nextToken(8);
-														var1_H = hexStringToULong(mInput_data);
+														var1_H = tokenHexToULong();
 
 														nextToken(8);
-														var1_L = hexStringToULong(mInput_data);
+														var1_L = tokenHexToULong();
 
 														nextToken(8);
-														var2_H = hexStringToULong(mInput_data);
+														var2_H = tokenHexToULong();
 
 														nextToken(8);
-														var2_L = hexStringToULong(mInput_data);
+														var2_L = tokenHexToULong();
 
 														HC_pinsMode(var1_H, var1_L, var2_H, var2_L);
 													#elif defined(ARDUINO_ARCH_SAMD)
 														nextToken(8);
-														var1_L = hexStringToULong(mInput_data);
+														var1_L = tokenHexToULong();
 
 														nextToken(8);
-														var2_L = hexStringToULong(mInput_data);
+														var2_L = tokenHexToULong();
 
 														nextToken(8);
-														var3_L = hexStringToULong(mInput_data);
+														var3_L = tokenHexToULong();
 
 														HC_pinsMode(var1_L, var2_L, var3_L);
 													#else
 														nextToken(8);
-														var1_L = hexStringToULong(mInput_data);
+														var1_L = tokenHexToULong();
 
 														nextToken(8);
-														var2_L = hexStringToULong(mInput_data);
+														var2_L = tokenHexToULong();
 
 														HC_pinsMode(var1_L, var2_L);
 													#endif
@@ -817,15 +794,15 @@ void HC_Protocol::analyzeInput()
 
 													#if HC_VARIANT == HC_VARIANT_MEGA
 														nextToken(8);
-														var1_H = hexStringToULong(mInput_data);
+														var1_H = tokenHexToULong();
 
 														nextToken(8);
-														var1_L = hexStringToULong(mInput_data);
+														var1_L = tokenHexToULong();
 
 														HC_writeDO(var1_H, var1_L);
 													#else
 														nextToken(8);
-														HC_writeDO(hexStringToULong(mInput_data));
+														HC_writeDO(tokenHexToULong());
 													#endif		
 													break;
 
@@ -834,15 +811,15 @@ void HC_Protocol::analyzeInput()
 
 													#if HC_VARIANT == HC_VARIANT_MEGA
 														nextToken(8);
-														var1_H = hexStringToULong(mInput_data);
+														var1_H = tokenHexToULong();
 
 														nextToken(8);
-														var1_L = hexStringToULong(mInput_data);
+														var1_L = tokenHexToULong();
 
 														HC_outputTypes(var1_H, var1_L);
 													#else
 														nextToken(8);
-														HC_outputTypes(hexStringToULong(mInput_data));
+														HC_outputTypes(tokenHexToULong());
 													#endif		
 													break;
 
@@ -851,22 +828,22 @@ void HC_Protocol::analyzeInput()
 
 													#if HC_VARIANT == HC_VARIANT_MEGA
 														nextToken(8);
-														var1_H = hexStringToULong(mInput_data);
+														var1_H = tokenHexToULong();
 
 														nextToken(8);
-														var1_L = hexStringToULong(mInput_data);
+														var1_L = tokenHexToULong();
 
 														HC_servosMode(var1_H, var1_L);
 													#else
 														nextToken(8);
-														HC_servosMode(hexStringToULong(mInput_data));
+														HC_servosMode(tokenHexToULong());
 													#endif  
 													break;
 
 												// DD values
 												case HC_MessageType_DD:
 													nextToken(8);
-													HC_writeDD(hexStringToULong(mInput_data));
+													HC_writeDD(tokenHexToULong());
 													break;
 
 												#ifdef ARDUINO_ARCH_SAMD
@@ -874,7 +851,22 @@ void HC_Protocol::analyzeInput()
 												case HC_MessageType_DM:
 
 													nextToken(2);
-													HC_dacsMode((uint8_t)hexStringToULong(mInput_data));
+													HC_dacsMode((uint8_t)tokenHexToULong());
+													break;
+												#endif
+
+												#ifdef HC_FLOW_CONTROL
+												// Flow control: unit, credits (unknown unit: no flow control)
+												case HC_MessageType_Fc:
+
+													nextToken(1);
+													mFlow_unit = tokenToULong();
+													if (mFlow_unit > HC_FLOW_UNIT_BYTES)
+														mFlow_unit = HC_FLOW_UNIT_NONE;
+
+													nextToken(8);
+													mFlow_credit = (mFlow_unit != HC_FLOW_UNIT_NONE) ? tokenToULong() : 0;
+													mFlow_pausedCycles = 0;
 													break;
 												#endif
 											}
@@ -921,10 +913,6 @@ void HC_Protocol::analyzeInput()
 
 										#endif	// HC_EEPROM_COMPILE
 
-											// A query array index
-											uint8_t Aquery_index = 0;
-											uint8_t j;
-
 											switch (message_type)
 											{
 												// Bf query
@@ -934,6 +922,14 @@ void HC_Protocol::analyzeInput()
 													mBquery_run = true;
 													break;
 
+												#ifdef HC_BAUDRATE_NEGOTIATION
+												// Baudrate probe: new baudrate is confirmed by the next frame
+												case HC_MessageType_Bp:
+													if (mBaudrate_state == HC_BAUDRATE_STATE_PROBING)
+														mBaudrate_state = HC_BAUDRATE_STATE_CONFIRMING;
+													break;
+												#endif
+
 												// Ec query
 												#ifdef HC_EEPROM_COMPILE
 													case HC_MessageType_Ec:
@@ -948,8 +944,8 @@ void HC_Protocol::analyzeInput()
 													// Request start sending X Data continuously
 													mXquery_run = true;
 
-													// reset Xquery ID
-													mXquery_ID = 0;
+													// all groups are sent now
+													restartXQuery();
 													break;
 
 												// X query: stop
@@ -963,42 +959,36 @@ void HC_Protocol::analyzeInput()
 													// Request start sending A Data continuously
 													mAquery_run = true;
 
-													// clear arrays
-													j = mAquery_ARRAY_SIZE;
-													//for (int j = 0; j < mAquery_ARRAY_SIZE; j++)
-													while(j)
+													#ifdef HC_QUERY_TIMESTAMP
+														// first timestamp is absolute
+														HCS_writeBit(mTimestamp_isAbsolute, HC_TIMESTAMP_A, 1);
+													#endif
+
+													#ifndef HC_USE_FTDI
+													// write mode: add to current subscriptions
+													// read mode: replace current subscriptions
+													if (!ReadWriteMode)
+														mAquery_qty = 0;
+
+													while (nextToken(1)) // Message Type: 1 byte if no separator
 													{
 														// Message Type
 														#ifdef PROTOBF_USE_READABLE_MESSAGETYPE
-															strcpy(mAquery_type_array[--j], "");
+															char Aquery_type = getMessageType(HCI_stringToConcByte(tokenToString()));
 														#else
-															mAquery_type_array[--j] = '\0';
+															char Aquery_type = mInput_data[0];
 														#endif
 
 														// Index
-														mAquery_index_array[j] = 0;
-													}
+														if (!nextToken(2))
+															break;
 
-													while (nextToken(1)) // Message Type: 1 byte if no separator
-													{
-														// if too much data, don't retrieve data
-														if (Aquery_index < mAquery_ARRAY_SIZE)
-														{
-															// Message Type
-															#ifdef PROTOBF_USE_READABLE_MESSAGETYPE
-																strcpy(mAquery_type_array[Aquery_index], mInput_data);
-															#else
-																mAquery_type_array[Aquery_index] = mInput_data[0];
-															#endif
-															
-															// Index
-															nextToken(2);
-															mAquery_index_array[Aquery_index] = stringToULong(mInput_data);
-															++Aquery_index;
-														}
-														else
+														// refused (table full, reply too long, unknown type): next ones are refused too,
+														// the accepted ones are the first ones of the message (quantity in the As reply)
+														if (!subscribeA(Aquery_type, tokenToULong()))
 															break;
 													}
+													#endif
 													break;
 
 												// A query: stop
@@ -1006,27 +996,58 @@ void HC_Protocol::analyzeInput()
 													// Request stop sending all A Data
 													mAquery_run = false;
 													break;
-											}
 
-											// send message
-											switch (message_type)
-											{
-												// Error: index required
-												case HC_MessageType_AI:
-												case HC_MessageType_PW:
-												case HC_MessageType_SV:
-												case HC_MessageType_AD:
-												#if defined ARDUINO_ARCH_SAMD
-												case HC_MessageType_DA:
-												#endif
-													// Error message: Index Required
-													printMessageError(HC_MessageError_IR);
+												#ifdef HC_CAPTURE_COMPILE
+												// Capture: arm
+												case HC_MessageType_Ca:
+													// write mode: period (us), pre-trigger frames, trigger (source, index, level, edge),
+													// then AI channels (1 to HC_CAPTURE_MAX_CHANNEL_QTY). No data: stop capture.
+													// read mode: capture state only
+													if (ReadWriteMode)
+													{
+														const uint8_t length[6] = {8, 4, 1, 2, 4, 1};
+														unsigned long setting[6];
+														uint8_t qty = 0;
+
+														while ((qty < 6) && nextToken(length[qty]))
+															setting[qty++] = tokenToULong();
+
+														if (qty == 6)
+														{
+															HC_capture.setPeriod(setting[0]);
+															HC_capture.setPreTrigger(setting[1]);
+															HC_capture.setTrigger((HC_CaptureTrigger)setting[2], setting[3], setting[4], (HC_CaptureEdge)setting[5]);
+
+															HC_capture.clearChannels();
+															while (nextToken(2))
+																HC_capture.addChannel(tokenToULong());
+
+															HC_capture.arm();
+														}
+														else
+															HC_capture.stop();
+
+														// captured data is sent when capture is done
+														mCquery_isArmed = (HC_capture.getState() == HC_CAPTURE_ARMED);
+														mCquery_run = false;
+													}
 													break;
 
-												default:
-													send(message_type);
+												// Capture: read captured data
+												case HC_MessageType_Cr:
+													// Request sending all captured data in several messages (if capture is done)
+													// auto-reset after last message is sent
+													mCquery_run = (HC_capture.getState() == HC_CAPTURE_DONE);
+													mCquery_frame = 0;
 													break;
+												#endif
 											}
+
+											// send message (NP: end of turn is sent after the query replies)
+											#ifdef HC_MULTIDROP
+											if (message_type != HC_MessageType_NP)
+											#endif
+												send(message_type);
 										#ifdef HC_EEPROM_COMPILE
 										}
 										#endif
@@ -1050,30 +1071,30 @@ void HC_Protocol::analyzeInput()
 														if (addressSpecified)
 														{
 															nextToken(1);
-															HC_eeprom.basic_writeBit(address, index, stringToBool(mInput_data));
+															HC_eeprom.basic_writeBit(address, index, tokenToBool());
 														}
 														break;
 					
 													// EEPROM (Config Param)
 													case HC_MessageType_Ep:
 														/*nextToken(1);
-														HC_eeprom.writeConfigRegister(index, stringToBool(mInput_data));*/
+														HC_eeprom.writeConfigRegister(index, tokenToBool());*/
 														break;
 												#endif
 
 												// Pin Mode
 												case HC_MessageType_PM:
 													nextToken(1);
-													if (stringToBool(mInput_data))
+													if (tokenToBool())
 														HCS_pinMode(index, HC_OUT);
 													else
 													{
 														nextToken(1);
-														if (stringToBool(mInput_data))
+														if (tokenToBool())
 														{
 															#if defined(ARDUINO_ARCH_SAMD)
 																nextToken(1);
-																HCS_pinMode(index, stringToBool(mInput_data) ? HC_IN_PU : HC_IN_PD);
+																HCS_pinMode(index, tokenToBool() ? HC_IN_PU : HC_IN_PD);
 															#else
 																HCS_pinMode(index, HC_IN_PU);
 															#endif
@@ -1093,56 +1114,78 @@ void HC_Protocol::analyzeInput()
 												// DO value
 												case HC_MessageType_DO:
 													nextToken(1);
-													HC_writeDO(index, stringToBool(mInput_data));
+													HC_writeDO(index, tokenToBool());
 													break;
 										
 												// Output type
 												case HC_MessageType_OT:
 													nextToken(1);
-													HC_outputType(index, stringToBool(mInput_data));
+													HC_outputType(index, tokenToBool());
 													break;
 
 												// PWM value
 												case HC_MessageType_PW:
 													nextToken(HEX_LENGTH_PWM);
-													HC_writePWM(index, stringToUInt(mInput_data));
+													HC_writePWM(index, tokenToUInt());
 													break;
 
 												// Servo mode
 												case HC_MessageType_SM:
 													nextToken(1);
-													HC_servoMode(index, stringToBool(mInput_data));
+													HC_servoMode(index, tokenToBool());
 													break;
 
 												// Servo value
 												case HC_MessageType_SV:
 													nextToken(HEX_LENGTH_SERVO);
-													HC_servoWrite(index, stringToULong(mInput_data));
+													HC_servoWrite(index, tokenToULong());
 													break;
 
 												// DD value
 												case HC_MessageType_DD:
 													nextToken(1);
-													HC_writeDD(index, stringToBool(mInput_data));
+													HC_writeDD(index, tokenToBool());
+													break;
+
+												#ifdef HC_BAUDRATE_NEGOTIATION
+												// Baudrate change: after the acknowledge is sent (runBaudrateChange())
+												case HC_MessageType_Br:
+													mBaudrate_next = index;
+													mBaudrate_state = HC_BAUDRATE_STATE_SWITCHING;
+													break;
+												#endif
+
+												#ifdef HC_SAMPLER_COMPILE
+												// AI oversampling: the sampler is restarted if it was running
+												case HC_MessageType_Ar:
+													nextToken(1);
+													if (HC_sampler.isStarted())
+													{
+														HC_sampler.setOversampling(index, tokenToULong());
+														HC_sampler.begin();
+													}
+													else
+														HC_sampler.setOversampling(index, tokenToULong());
 													break;
+												#endif
 
 												// AD value
 												case HC_MessageType_AD:
 													nextToken(8);
-													HC_writeAD(index, stringToFloat(mInput_data));
+													HC_writeAD(index, tokenToFloat());
 													break;
 
 												#ifdef ARDUINO_ARCH_SAMD
 												// DAC mode
 												case HC_MessageType_DM:
 													nextToken(1);
-													HC_dacMode(index, stringToBool(mInput_data));
+													HC_dacMode(index, tokenToBool());
 													break;
 
 												// DAC value
 												case HC_MessageType_DA:
 													nextToken(HEX_LENGTH_DAC);
-													HC_writeDAC(index, stringToFloat(mInput_data));
+													HC_writeDAC(index, tokenToFloat());
 													break;
 												#endif
 											}
@@ -1170,36 +1213,7 @@ void HC_Protocol::analyzeInput()
 										{
 										#endif	// HC_EEPROM_COMPILE
 
-											switch (message_type)
-											{
-												case HC_MessageType_Bf:
-												#ifdef HC_EEPROM_COMPILE
-												case HC_MessageType_Ep:
-												#endif
-												case HC_MessageType_PM:
-												case HC_MessageType_DI:
-												case HC_MessageType_DO:
-												case HC_MessageType_AI:
-												case HC_MessageType_OT:
-												case HC_MessageType_PA:
-												case HC_MessageType_PW:
-												case HC_MessageType_SM:
-												case HC_MessageType_SV:
-												case HC_MessageType_DD:
-												case HC_MessageType_AM:
-												case HC_MessageType_AD:
-												#ifdef ARDUINO_ARCH_SAMD
-												case HC_MessageType_DM:
-												case HC_MessageType_DA:
-												#endif					
-													send_withIndex(index, message_type);
-													break;
-
-												default:
-													// Error message: Index not Allowed
-													printMessageError(HC_MessageError_IA);
-													break;
-											}
+											send_withIndex(index, message_type);
 										#ifdef HC_EEPROM_COMPILE
 										}
 										#endif
@@ -1239,118 +1253,631 @@ void HC_Protocol::analyzeInput()
 }
 
 
+// 0: invalid Message Type (or only sent by the board)
+uint8_t HC_Protocol::getMessageFlags(char messageType)
+{
+	if ((messageType < HC_MESSAGETYPE_FIRST) || (messageType > HC_MESSAGETYPE_LAST))
+		return 0;
+
+	return pgm_read_byte(&HC_messageDescriptors[messageType - HC_MESSAGETYPE_FIRST].flags);
+}
+
 #ifdef PROTOBF_USE_READABLE_MESSAGETYPE
-bool HC_Protocol::messageTypeIsValid(unsigned int messageType)
-#else
-bool HC_Protocol::messageTypeIsValid(char messageType)
+// name: 2 chars (concatenated). 0: unknown name
+char HC_Protocol::getMessageType(unsigned int name)
+{
+	for (uint8_t i = 0; i < HC_MESSAGETYPE_QTY; ++i)
+	{
+		if ((pgm_read_byte(&HC_messageDescriptors[i].name[0]) == HCS_getHighByte(name)) &&
+			(pgm_read_byte(&HC_messageDescriptors[i].name[1]) == HCS_getLowByte(name)))
+			return HC_MESSAGETYPE_FIRST + i;
+	}
+
+	return 0;
+}
 #endif
+
+bool HC_Protocol::indexIsInRange(uint8_t flags, uint8_t index)
 {
-	switch (messageType)
+	switch (flags & HC_MESSAGE_RANGE_MASK)
 	{
-		case HC_MessageType_Bf:
+		case HC_MESSAGE_RANGE_PIN:	return (index <= HCS_getAI_endIndex());
+		case HC_MESSAGE_RANGE_DD:	return (index < HC_DD_QTY);
+		case HC_MESSAGE_RANGE_AD:	return (index < HC_AD_QTY);
+		default:					return true;
+	}
+}
 
-		case HC_MessageType_M0:
-		case HC_MessageType_FR:
 
-		case HC_MessageType_CT:
+// qty: considered only if no separator
+bool HC_Protocol::nextToken(uint8_t qty)
+{
+	#if defined(PROTOBF_USE_BINARY)
+		// 1 byte for 2 hex chars
+		return nextBytes((qty + 1) / 2);
+	#else
+		#ifdef PROTOBF_USE_SEPARATOR
+			if (mInput_index >= mInput_dataEnd)
+				return false;
 
-		#ifdef HC_ARDUINOTIME_COMPILE
-			case HC_MessageType_TM:
-		#endif
+			// token ends at next separator
+			mInput_data = &mInput[mInput_index];
+			while ((mInput_index < mInput_dataEnd) && (mInput[mInput_index] != SpecialChar_separator[0]))
+				++mInput_index;
 
-		#ifdef HC_STRINGMESSAGE_COMPILE
-			case HC_MessageType_S0:
-		#endif
+			mInput_dataLength = &mInput[mInput_index] - mInput_data;
 
-		#ifdef HC_EEPROM_COMPILE
-			case HC_MessageType_EE:
-			case HC_MessageType_Ec:
-			case HC_MessageType_Ep:
-		#endif
+			// skip separator
+			++mInput_index;
+		#else
+			if (mInput_dataEnd < mInput_index + qty)
+				return false;
 
-		case HC_MessageType_PM:
-		case HC_MessageType_DI:
-		case HC_MessageType_DO:
-		case HC_MessageType_AI:
-		case HC_MessageType_OT:
-		case HC_MessageType_PA:
-		case HC_MessageType_PW:
-		case HC_MessageType_SM:
-		case HC_MessageType_SV:
-		case HC_MessageType_DD:
-		case HC_MessageType_AM:
-		case HC_MessageType_AD:
-		#ifdef ARDUINO_ARCH_SAMD
-			case HC_MessageType_DM:
-			case HC_MessageType_DA:
+			mInput_data = &mInput[mInput_index];
+			mInput_dataLength = qty;
+			mInput_index += qty;
 		#endif
 
-		case HC_MessageType_Xs:
-		case HC_MessageType_Xu:
+		decodeToken();
+		return true;
+	#endif
+}
+
+bool HC_Protocol::nextToken()
+{
+	#if defined(PROTOBF_USE_BINARY)
+		return nextBytes((mInput_dataEnd - mInput_index));
+	#else
+		return nextToken((mInput_dataEnd - mInput_index));
+	#endif
+}
+
+
+#ifdef PROTOBF_USE_BINARY
+// qty: byte count
+bool HC_Protocol::nextBytes(uint8_t qty)
+{
+	if (mInput_dataEnd >= mInput_index + qty)
+	{
+		// raw bytes (used by strings)
+		mInput_data = &mInput[mInput_index];
+		mInput_dataLength = qty;
+
+		// get value (little-endian, max 4 bytes)
+		mInput_value = 0;
+		uint8_t i = (qty < 4) ? qty : 4;
+		while (i)
+		{
+			--i;
+			mInput_value = (mInput_value << 8) | (uint8_t) mInput[mInput_index + i];
+		}
 
-		case HC_MessageType_As:
-		case HC_MessageType_Au:
-			return true;
+		// update index
+		mInput_index += qty;
+		return true;
 	}
+	else
+		return false;
+}
+#else
+// token chars to value (not a digit: ignored)
+void HC_Protocol::decodeToken()
+{
+	mInput_value = 0;
+	#ifdef PROTOBF_USE_INT
+		mInput_decimalValue = 0;
+	#endif
+
+	for (uint8_t i = 0; i < mInput_dataLength; ++i)
+	{
+		uint8_t digit = HCI_hexCharToValue(mInput_data[i]);
 
-	return false;
+		if (digit < 16)
+			mInput_value = (mInput_value << 4) | digit;
+
+		#ifdef PROTOBF_USE_INT
+			if (digit < 10)
+				mInput_decimalValue = mInput_decimalValue * 10 + digit;
+		#endif
+	}
 }
+#endif
 
 
-// qty: considered only if no separator
-bool HC_Protocol::nextToken(uint8_t qty)
+
+// *****************************************************************************
+// HC_PROTOCOL : Incremental parser
+// *****************************************************************************
+// 1 call per received byte (decoded if binary): CRC and header fields ($, Message
+// Type, Config Byte, Index, Address) are decoded on the fly, at constant cost.
+// The message is analyzed when complete (analyzeInput()). No copy, no clearing.
+
+void HC_Protocol::parseInput(uint8_t b)
 {
-	#ifndef PROTOBF_USE_SEPARATOR
-		#ifdef PROTOBF_USE_CRC
-		if (mInput_CRC_index >= mInput_index + qty)
+	#ifdef HC_MULTIDROP
+		// frame sent to another node: ignored until its end
+		if (mInput_isIgnored)
+			return;
+	#endif
+
+	// buffer is full: byte is ignored (CRC will not match). 1 byte kept for '\0'
+	if (mInput_length >= HC_INPUTMESSAGE_MAX_ARRAY_LENGHT - 1)
+		return;
+
+	// CRC: last bytes are the CRC itself, so bytes are added with a delay of 2 bytes
+	if (mInput_length >= 2)
+	{
+		#ifdef PROTOBF_USE_BINARY
+			mInput_CRC = HCI_updateCRC16(mInput_CRC, mInput[mInput_length - 2]);
 		#else
-		if (mInput_length >= mInput_index + qty)
+			mInput_CRC += (uint8_t) mInput[mInput_length - 2];
 		#endif
-		{
-			// get substring and append '\0'
-			strncpy(mInput_data, &mInput[mInput_index], qty);
-			mInput_data[qty] = '\0';
+	}
 
-			// update index
-			mInput_index += qty;
-			return true;
-		}
-		else
-			return false;
-	#else
-		// get next token
-		mInput_data = strtok(NULL_POINTER, SpecialChar_separator);
-		return (mInput_data != NULL_POINTER);
+	mInput[mInput_length++] = b;
+
+	// header field
+	if (mInput_field < HC_InputField_Data)
+	{
+		#ifdef PROTOBF_USE_SEPARATOR
+			// field ends at next separator
+			if (b == SpecialChar_separator[0])
+			{
+				closeInputField(mInput_length - 1);
+				return;
+			}
+		#endif
+
+		#ifdef PROTOBF_USE_BINARY
+			// raw bytes, little-endian
+			mInput_fieldValue |= (unsigned long) b << (8 * mInput_fieldLength);
+		#else
+			uint8_t digit = HCI_hexCharToValue(b);
+
+			switch (mInput_field)
+			{
+				// concatenated chars
+				case HC_InputField_Start:
+				case HC_InputField_Type:
+					mInput_fieldValue = (mInput_fieldValue << 8) | b;
+					break;
+
+				// hex
+				case HC_InputField_Config:
+					if (digit < 16)
+						mInput_fieldValue = (mInput_fieldValue << 4) | digit;
+					break;
+
+				// hex or decimal
+				default:
+					if (digit < HC_INPUTFIELD_NUMBER_BASE)
+						mInput_fieldValue = mInput_fieldValue * HC_INPUTFIELD_NUMBER_BASE + digit;
+					break;
+			}
+		#endif
+
+		++mInput_fieldLength;
+
+		#ifndef PROTOBF_USE_SEPARATOR
+			// field ends when its length is reached
+			uint8_t length;
+			switch (mInput_field)
+			{
+				case HC_InputField_Type:	length = HC_INPUTFIELD_TYPE_LENGHT;		break;
+				#ifdef HC_MULTIDROP
+				case HC_InputField_Node:	length = HC_INPUTFIELD_INDEX_LENGHT;	break;
+				#endif
+				case HC_InputField_Index:	length = HC_INPUTFIELD_INDEX_LENGHT;	break;
+				case HC_InputField_Address:	length = HC_INPUTFIELD_ADDRESS_LENGHT;	break;
+				#ifdef HC_FLOW_CONTROL
+				case HC_InputField_Credit:	length = HC_INPUTFIELD_ADDRESS_LENGHT;	break;
+				#endif
+				default:					length = 1;								break;
+			}
+
+			if (mInput_fieldLength == length)
+				closeInputField(mInput_length);
+		#endif
+	}
+}
+
+// end: index of the first byte after the field
+void HC_Protocol::closeInputField(uint8_t end)
+{
+	switch (mInput_field)
+	{
+		case HC_InputField_Start:
+			// $ (1 char)
+			if ((mInput_fieldLength == 1) && (mInput_fieldValue == HC_StartChar_dollar))
+				mInput_fieldEnd[HC_InputField_Start] = end;
+			break;
+
+		#ifdef HC_MULTIDROP
+		case HC_InputField_Node:
+			mInput_node = mInput_fieldValue;
+			mInput_fieldEnd[HC_InputField_Node] = end;
+
+			// frame sent to another node: next bytes are not parsed (no CRC, no analysis)
+			mInput_isIgnored = (mInput_node != mNode) && (mInput_node != HC_MULTIDROP_BROADCAST);
+			break;
+		#endif
+
+		case HC_InputField_Type:
+			#ifdef PROTOBF_USE_READABLE_MESSAGETYPE
+				// 2 chars (name)
+				mInput_type = (mInput_fieldLength == 2) ? getMessageType(mInput_fieldValue) : 0;
+			#else
+				// 1 char (code)
+				mInput_type = (mInput_fieldLength == 1) ? mInput_fieldValue : 0;
+			#endif
+			mInput_fieldEnd[HC_InputField_Type] = end;
+			break;
+
+		case HC_InputField_Config:
+			// 1 char (hex)
+			mInput_configByte = mInput_fieldValue;
+			if (mInput_fieldLength == 1)
+				mInput_fieldEnd[HC_InputField_Config] = end;
+			break;
+
+		case HC_InputField_Index:
+			mInput_targetIndex = mInput_fieldValue;
+			mInput_fieldEnd[HC_InputField_Index] = end;
+			break;
+
+		case HC_InputField_Address:
+			mInput_address = mInput_fieldValue;
+			mInput_fieldEnd[HC_InputField_Address] = end;
+			break;
+
+		#ifdef HC_FLOW_CONTROL
+		case HC_InputField_Credit:
+			mInput_credit = mInput_fieldValue;
+			mInput_fieldEnd[HC_InputField_Credit] = end;
+			break;
+		#endif
+	}
+
+	// next field (Index, Address and Credit are optional)
+	++mInput_field;
+
+	if ((mInput_field == HC_InputField_Index) && !HCS_readBit(mInput_configByte, 1))
+		++mInput_field;
+
+	if ((mInput_field == HC_InputField_Address) && !HCS_readBit(mInput_configByte, 2))
+		++mInput_field;
+
+	#ifdef HC_FLOW_CONTROL
+		if ((mInput_field == HC_InputField_Credit) && !HCS_readBit(mInput_configByte, 3))
+			++mInput_field;
 	#endif
+
+	// data starts at next byte
+	if (mInput_field == HC_InputField_Data)
+		mInput_index = mInput_length;
+
+	mInput_fieldLength = 0;
+	mInput_fieldValue = 0;
 }
 
-bool HC_Protocol::nextToken()
+void HC_Protocol::resetInput()
 {
-	#ifdef PROTOBF_USE_CRC
-		return nextToken((mInput_CRC_index - mInput_index));
+	mInput_length = 0;
+	mInput_CRC = 0;
+
+	mInput_field = HC_InputField_Start;
+	mInput_fieldLength = 0;
+	mInput_fieldValue = 0;
+
+	uint8_t i = HC_InputField_Data;
+	while (i)
+		mInput_fieldEnd[--i] = 0;
+
+	mInput_index = 0;
+
+	#ifdef HC_MULTIDROP
+		mInput_isIgnored = false;
+	#endif
+
+	#ifdef PROTOBF_USE_BINARY
+		mInput_cobsCode = 0xFF;
+		mInput_cobsCount = 0;
 	#else
-		return nextToken((mInput_length - mInput_index));
+		mInput_EndDetectionFlag = 0;
 	#endif
 }
 
+// field has been received, before the CRC
+bool HC_Protocol::inputFieldIsReceived(uint8_t field)
+{
+	return (mInput_fieldEnd[field] != 0) && (mInput_fieldEnd[field] <= mInput_dataEnd);
+}
+
 
 
 // --------------------------------------------------------------------------------
 // communicate --------------------------------------------------------------------
 // --------------------------------------------------------------------------------
 
-// Receive and send message to Computer software
+// Receive and send message to Computer software (this session only: tasks done once
+// per cycle are in HC_communicate())
 void HC_Protocol::communicate()
 {
-    // calculate cycle time
-    HCS_calculateCycleTime();
+	// reset counter of sent bytes
+	mOutput_queuedBytes = 0;
 
-    // measure SRAM on probe 0 (measurement used in X query)
-    HC_sram.setProbe(0);
+	#ifdef HC_BAUDRATE_NEGOTIATION
+		// baudrate change: switch after the acknowledge, go back if not confirmed
+		runBaudrateChange();
 
-	// record Digital Data (useful for rising/falling edge detection)
-	HCI_recordDD();
+		if (mBaudrate_state == HC_BAUDRATE_STATE_SWITCHING)
+			return;
+	#endif
 
 	// receive new message
 	receive();
 }
+
+
+// bytes sent during last communicate() call
+unsigned int HC_Protocol::getQueuedBytes() const
+{
+	return mOutput_queuedBytes;
+}
+
+
+// replies deferred because the TX buffer was full
+unsigned long HC_Protocol::getDeferredReplies() const
+{
+	return mOutput_deferredReplies;
+}
+
+
+// replies dropped: longer than the output frame, or deferred reply still waiting
+unsigned long HC_Protocol::getDroppedReplies() const
+{
+	return mOutput_droppedReplies;
+}
+
+
+#ifdef HC_PROTOCOL_PROFILE
+unsigned long HC_Protocol::getProfileCalls(uint8_t function) const
+{
+	return mProfile_calls[function];
+}
+
+
+unsigned long HC_Protocol::getProfileTime(uint8_t function) const
+{
+	return mProfile_time[function];
+}
+
+
+void HC_Protocol::resetProfile()
+{
+	for (uint8_t i = 0; i < HC_PROFILE_QTY; ++i)
+	{
+		mProfile_calls[i] = 0;
+		mProfile_time[i] = 0;
+	}
+}
+#endif
+
+
+
+// --------------------------------------------------------------------------------
+// sessions -----------------------------------------------------------------------
+// --------------------------------------------------------------------------------
+
+HC_Protocol* HC_Protocol::mSession_first = NULL_POINTER;
+
+
+void HC_Protocol::setStream(Stream& stream)
+{
+	mStream = &stream;
+}
+
+
+// add at the end of the list (if not already added)
+void HC_Protocol::addSession(HC_Protocol& session)
+{
+	HC_Protocol** last = &mSession_first;
+	while (*last != NULL_POINTER)
+	{
+		if (*last == &session)
+			return;
+		last = &(*last)->mSession_next;
+	}
+
+	*last = &session;
+}
+
+
+HC_Protocol* HC_Protocol::getFirstSession()
+{
+	return mSession_first;
+}
+
+
+HC_Protocol* HC_Protocol::getNextSession() const
+{
+	return mSession_next;
+}
+
+
+
+// --------------------------------------------------------------------------------
+// flow control -------------------------------------------------------------------
+// --------------------------------------------------------------------------------
+
+#ifdef HC_FLOW_CONTROL
+bool HC_Protocol::hasFlowCredit()
+{
+	switch (mFlow_unit)
+	{
+		case HC_FLOW_UNIT_FRAMES:	return (mFlow_credit > 0);
+		case HC_FLOW_UNIT_BYTES:	return (mFlow_credit >= HC_OUTPUTFRAME_MAX_ARRAY_LENGHT);
+		default:					return true;
+	}
+}
+
+
+// 1 reply (length: bytes of the frame). Covered by the credits (hasFlowCredit() before the reply)
+void HC_Protocol::spendFlowCredit(uint8_t length)
+{
+	switch (mFlow_unit)
+	{
+		case HC_FLOW_UNIT_FRAMES:	--mFlow_credit;				break;
+		case HC_FLOW_UNIT_BYTES:	mFlow_credit -= length;		break;
+	}
+}
+#endif
+
+
+
+// --------------------------------------------------------------------------------
+// baudrate negotiation -----------------------------------------------------------
+// --------------------------------------------------------------------------------
+
+#ifdef HC_BAUDRATE_NEGOTIATION
+void HC_Protocol::setBaudrate(long baudrate)
+{
+	mBaudrate = baudrate;
+}
+
+
+long HC_Protocol::getBaudrate() const
+{
+	return mBaudrate;
+}
+
+
+void HC_Protocol::runBaudrateChange()
+{
+	switch (mBaudrate_state)
+	{
+		// acknowledge of Br: completely sent at the current baudrate, then switch
+		case HC_BAUDRATE_STATE_SWITCHING:
+			if (mOutput_isDeferred && !sendOutput())
+				return;
+
+			mStream->flush();
+
+			mBaudrate_previous = mBaudrate;
+			switchBaudrate(getBaudrateValue(mBaudrate_next));
+			mBaudrate_startTime = millis();
+			mBaudrate_state = HC_BAUDRATE_STATE_PROBING;
+			break;
+
+		// new baudrate not confirmed: go back to the previous one
+		case HC_BAUDRATE_STATE_PROBING:
+		case HC_BAUDRATE_STATE_CONFIRMING:
+			if (millis() - mBaudrate_startTime >= HC_BAUDRATE_PROBE_TIMEOUT)
+			{
+				switchBaudrate(mBaudrate_previous);
+				mBaudrate_state = HC_BAUDRATE_STATE_IDLE;
+
+				// bytes received meanwhile were sent at another baudrate
+				while (mStream->available() > 0)
+					mStream->read();
+			}
+			break;
+	}
+}
+
+
+void HC_Protocol::switchBaudrate(long baudrate)
+{
+	HCS_Serial_setBaudrate(baudrate);
+	mBaudrate = baudrate;
+
+	// frame being received: incomplete
+	resetInput();
+}
+
+
+// baudrates of the table up to HC_BAUDRATE_MAX (none if the baudrate can't be negotiated)
+unsigned int HC_Protocol::getSupportedBaudrates()
+{
+	unsigned int mask = 0;
+
+	if (mBaudrate != 0)
+	{
+		for (uint8_t i = 0; i < HC_BAUDRATE_QTY; ++i)
+		{
+			if (getBaudrateValue(i) <= HC_BAUDRATE_MAX)
+				mask |= (1 << i);
+		}
+	}
+
+	return mask;
+}
+
+
+bool HC_Protocol::baudrateIsSupported(uint8_t index)
+{
+	return (index < HC_BAUDRATE_QTY) && ((getSupportedBaudrates() >> index) & 1);
+}
+
+
+long HC_Protocol::getBaudrateValue(uint8_t index)
+{
+	return pgm_read_dword(&HC_baudrates[index]);
+}
+
+
+uint8_t HC_Protocol::getBaudrateIndex(long baudrate)
+{
+	for (uint8_t i = 0; i < HC_BAUDRATE_QTY; ++i)
+	{
+		if (getBaudrateValue(i) == baudrate)
+			return i;
+	}
+
+	return HC_BAUDRATE_NONE;
+}
+#endif
+
+
+
+// --------------------------------------------------------------------------------
+// multi-drop bus -----------------------------------------------------------------
+// --------------------------------------------------------------------------------
+
+#ifdef HC_MULTIDROP
+void HC_Protocol::setNode(uint8_t node)
+{
+	mNode = node;
+}
+
+
+void HC_Protocol::setDriverEnable(uint8_t pin, unsigned int turnaroundDelay)
+{
+	mNode_driverEnablePin = pin;
+	mNode_turnaroundDelay = turnaroundDelay;
+
+	// receive mode
+	if (pin != HC_MULTIDROP_NO_PIN)
+	{
+		pinMode(pin, OUTPUT);
+		digitalWrite(pin, LOW);
+	}
+}
+
+
+// driver enable pin is set low once the TX buffer is empty and the turn-around delay has elapsed
+// since (last character sent from the shift register). Checked every cycle: never blocks
+void HC_Protocol::releaseDriverEnable()
+{
+	if (!mNode_isDriving)
+		return;
+
+	if (mOutput_isDeferred || (mStream->availableForWrite() < mOutput_txRoomMax))
+		mNode_txBusyTime = HCS_micros();
+	else if (HCS_micros() - mNode_txBusyTime >= mNode_turnaroundDelay)
+	{
+		digitalWrite(mNode_driverEnablePin, LOW);
+		mNode_isDriving = false;
+	}
+}
+#endif
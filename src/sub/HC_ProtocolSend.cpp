@@ -26,6 +26,9 @@
 // Include dependencies
 // *****************************************************************************
 
+// AVR
+#include <avr\pgmspace.h>
+
 // HITICommSupport
 #include <HCS_LowAccess_Bus.h>
 #include <HCS_LowAccess_IO.h>
@@ -37,6 +40,9 @@
 #include "HC_Data.h"
 #include "HC_Sram.h"
 #include "HC_ServoManager.h"
+#include "HC_Toolbox.h"
+#include "HC_Sampler.h"
+#include "sub\HC_MessageType.h"
 
 
 
@@ -53,152 +59,19 @@ enum StartChar
 };
 
 
-// Message Type --------------------------------------------------------
-
-
-enum MessageType
-{
-#ifdef PROTOBF_USE_READABLE_MESSAGETYPE
-	HC_MessageType_Bf = 0x4266,  // B query request (Board features)
-	HC_MessageType_Bq = 0x4271,  // B query replies (Board features 0-3)
-	HC_MessageType_BS = 0x4253,  // Board has started (or has reset)
-
-	HC_MessageType_M0 = 0x4D30,  // SRAM (Break value 0, Stack Pointer 0)
-	HC_MessageType_FR = 0x4652,  // Free RAM (measurement 0-2)
-
-	HC_MessageType_CT = 0x4354,  // Cycle Time (in us)
-	HC_MessageType_TM = 0x544D,  // Arduino Time (in ms)
-
-#ifdef HC_STRINGMESSAGE_COMPILE
-	HC_MessageType_S0 = 0x5330,  // HITI string
-#endif
-
-#ifdef HC_EEPROM_COMPILE
-	HC_MessageType_EE = 0x4545,  // EEPROM access
-	HC_MessageType_Es = 0x4573,  // EEPROM (notify start of a reply sequence)	
-	HC_MessageType_Ee = 0x4565,  // EEPROM (notify end of a reply sequence)	
-	HC_MessageType_Ec = 0x4563,  // EEPROM (IO Config access)
-	HC_MessageType_Ep = 0x4570,  // EEPROM (Config Param)
-#endif
-
-	HC_MessageType_PM = 0x504D,  // Pin mode / Input mode
-	HC_MessageType_DI = 0x4449,  // DI values
-	HC_MessageType_DO = 0x444F,  // DO values
-	HC_MessageType_AI = 0x4149,  // AI values
-	HC_MessageType_OT = 0x4F54,  // Output type
-	HC_MessageType_PA = 0x5041,  // PWM availability
-	HC_MessageType_PW = 0x5057,  // PWM values
-	HC_MessageType_SM = 0x534D,  // Servo mode
-	HC_MessageType_SV = 0x5356,  // Servo values
-	HC_MessageType_DD = 0x4444,  // DD values
-	HC_MessageType_AM = 0x414D,  // AD mask
-	HC_MessageType_AD = 0x4144,  // AD values
-#ifdef ARDUINO_ARCH_SAMD
-	HC_MessageType_DM = 0x444D,  // DAC mode (enable mask)
-	HC_MessageType_DA = 0x4441,  // DAC values
-#endif
-
-	HC_MessageType_Xs = 0x5873,  // Subscribe to X query
-	HC_MessageType_Xu = 0x5875,  // Unsubscribe from X query
-
-	HC_MessageType_X0 = 0x5830,  // XQuery period, Cycle Time
-	HC_MessageType_X1 = 0x5831,  // AI values (part 1 : 0 - 7)
-	HC_MessageType_X2 = 0x5832,  // AI values (part 2 : 8 - 15)
-	HC_MessageType_X3 = 0x5833,  // PWM values (part 1 : 0 - 7)
-	HC_MessageType_X4 = 0x5834,  // PWM values (part 1 : 8 - 15)
-	HC_MessageType_X5 = 0x5835,  // Servo values (part 1 :  0 - 5)
-	HC_MessageType_X6 = 0x5836,  // Servo values (part 2 :  6 - 11)
-	HC_MessageType_X7 = 0x5837,  // Servo values (part 3 : 12 - 17) 
-	HC_MessageType_X8 = 0x5838,  // Servo values (part 4 : 18 - 23) 
-	HC_MessageType_X9 = 0x5839,  // Servo values (part 5 : 24 - 29) 
-	HC_MessageType_XA = 0x5841,  // Servo values (part 6 : 30 - 35)
-	HC_MessageType_XB = 0x5842,  // Servo values (part 7 : 36 - 41) 
-	HC_MessageType_XC = 0x5843,  // Servo values (part 8 : 42 - 47) 
-	HC_MessageType_XD = 0x5844,  // AD values (part 1 :  0 - 3)
-	HC_MessageType_XE = 0x5845,  // AD values (part 2 :  4 - 7)
-	HC_MessageType_XF = 0x5846,  // AD values (part 3 :  8 - 11)
-	HC_MessageType_XG = 0x5847,  // AD values (part 4 : 12 - 15)
-	HC_MessageType_XH = 0x5848,  // AD values (part 5 : 16 - 19)
-
-	HC_MessageType_Aq = 0x4171,  // A query reply
-	HC_MessageType_As = 0x4173,  // Subscribe to A query
-	HC_MessageType_Au = 0x4175,  // Unsubscribe from A query
-#else
-	HC_MessageType_Bf = 0x31,  // B query request (Board features)
-	HC_MessageType_Bq = 0x30,  // B query replies (Board features 0-3)
-	HC_MessageType_BS = 0x32,  // Board has started (or has reset)
-
-	HC_MessageType_M0 = 0x3A,  // SRAM (Break value 0, Stack Pointer 0)
-	HC_MessageType_FR = 0x3D,  // Free RAM (measurement 0-2)
-
-	HC_MessageType_CT = 0x5A,  // Cycle Time (in us)
-#ifdef HC_ARDUINOTIME_COMPILE
-	HC_MessageType_TM = 0x5C,  // Arduino Time (in ms)
-#endif
-
-#ifdef HC_STRINGMESSAGE_COMPILE
-	HC_MessageType_S0 = 0x79,  // HITI string
-#endif
-	
-#ifdef HC_EEPROM_COMPILE
-	HC_MessageType_EE = 0x70,  // EEPROM access
-	HC_MessageType_Es = 0x71,  // EEPROM (notify start of a reply sequence)	
-	HC_MessageType_Ee = 0x72,  // EEPROM (notify end of a reply sequence)	
-	HC_MessageType_Ec = 0x73,  // EEPROM (IO Config access)
-	HC_MessageType_Ep = 0x74,  // EEPROM (Config Param)
-#endif
-
-	HC_MessageType_PM = 0x60,  // Pin mode / Input mode
-	HC_MessageType_DI = 0x61,  // DI values
-	HC_MessageType_DO = 0x62,  // DO values
-	HC_MessageType_AI = 0x63,  // AI values
-	HC_MessageType_OT = 0x64,  // Output type
-	HC_MessageType_PA = 0x65,  // PWM availability
-	HC_MessageType_PW = 0x66,  // PWM values
-	HC_MessageType_SM = 0x67,  // Servo mode
-	HC_MessageType_SV = 0x68,  // Servo values
-	HC_MessageType_DD = 0x69,  // DD values
-	HC_MessageType_AM = 0x6A,  // AD mask
-	HC_MessageType_AD = 0x6B,  // AD values
-#ifdef ARDUINO_ARCH_SAMD
-	HC_MessageType_DM = 0x6C,  // DAC mode (enable mask)
-	HC_MessageType_DA = 0x6D,  // DAC values
-#endif
-		
-	HC_MessageType_Xs = 0x5B,  // Subscribe to X query
-	HC_MessageType_Xu = 0x5D,  // Unsubscribe from X query
-
-	HC_MessageType_X0 = 0x40,  // XQuery period, Cycle Time
-	HC_MessageType_X1 = 0x41,  // AI values (part 1 : 0 - 7)
-	HC_MessageType_X2 = 0x42,  // AI values (part 2 : 8 - 15)
-	HC_MessageType_X3 = 0x43,  // PWM values (part 1 : 0 - 7)
-	HC_MessageType_X4 = 0x44,  // PWM values (part 1 : 8 - 15)
-	HC_MessageType_X5 = 0x45,  // Servo values (part 1 :  0 - 5)
-	HC_MessageType_X6 = 0x46,  // Servo values (part 2 :  6 - 11)
-	HC_MessageType_X7 = 0x47,  // Servo values (part 3 : 12 - 17) 
-	HC_MessageType_X8 = 0x48,  // Servo values (part 4 : 18 - 23) 
-	HC_MessageType_X9 = 0x49,  // Servo values (part 5 : 24 - 29) 
-	HC_MessageType_XA = 0x4A,  // Servo values (part 6 : 30 - 35)
-	HC_MessageType_XB = 0x4B,  // Servo values (part 7 : 36 - 41) 
-	HC_MessageType_XC = 0x4C,  // Servo values (part 8 : 42 - 47) 
-	HC_MessageType_XD = 0x4D,  // AD values (part 1 :  0 - 3)
-	HC_MessageType_XE = 0x4E,  // AD values (part 2 :  4 - 7)
-	HC_MessageType_XF = 0x4F,  // AD values (part 3 :  8 - 11)
-	HC_MessageType_XG = 0x50,  // AD values (part 4 : 12 - 15)
-	HC_MessageType_XH = 0x51,  // AD values (part 5 : 16 - 19)
-
-	HC_MessageType_Aq = 0x7A,  // A query reply
-	HC_MessageType_As = 0x7B,  // Subscribe to A query
-	HC_MessageType_Au = 0x7D,  // Unsubscribe from A query
-#endif
-};
-
-
 // length of hex number to send
 #define HEX_LENGTH_CYCLETIME		5  // max 1s
-#define HEX_LENGTH_AI				3
 #define HEX_LENGTH_SERVO			5
 
+// AI: 10 bits, or up to 14 bits if oversampled (HC_sampler)
+#ifdef HC_SAMPLER_COMPILE
+	#define HEX_LENGTH_AI			((HC_sampler.getMaxResolution() > 12) ? 4 : 3)
+	#define HEX_LENGTH_AI_MAX		4
+#else
+	#define HEX_LENGTH_AI			3
+	#define HEX_LENGTH_AI_MAX		3
+#endif
+
 #if defined ARDUINO_ARCH_SAMD
 	#define GET_HEXCOUNT_FROM_BITCOUNT(bitCount)	(bitCount/4 + ((bitCount%4) != 0 ? 1 : 0))
 	#define HEX_LENGTH_PWM							(GET_HEXCOUNT_FROM_BITCOUNT(HCS_getPwmResolution()))
@@ -214,12 +87,10 @@ enum MessageType
 // *****************************************************************************
 
 
-#ifdef PROTOBF_USE_READABLE_MESSAGETYPE
-void HC_Protocol::send(unsigned int messageType)
-#else
 void HC_Protocol::send(char messageType)
-#endif
 {
+	HC_PROFILE(HC_PROFILE_SEND);
+
 	// flag for checking if message has data
 	bool containsData = true;
 
@@ -264,6 +135,37 @@ void HC_Protocol::send(char messageType)
 			printNumber(HCS_getCycleTime(), HEX_LENGTH_CYCLETIME);
 			break;
 
+		// Baudrate: index of the current baudrate, supported baudrates (mask)
+		#ifdef HC_BAUDRATE_NEGOTIATION
+			case HC_MessageType_Br:
+				printNumber(getBaudrateIndex(mBaudrate));
+				printNumber(getSupportedBaudrates(), 4);
+				break;
+		#endif
+
+		// Flow control: unit, credits left, cycles paused (no credit)
+		#ifdef HC_FLOW_CONTROL
+			case HC_MessageType_Fc:
+				printNumber(mFlow_unit);
+				printNumber(mFlow_credit, 8);
+				printNumber(mFlow_pausedCycles, 8);
+				break;
+		#endif
+
+		// A query: quantity of subscriptions in the table (refused ones are not counted)
+		#ifndef HC_USE_FTDI
+			case HC_MessageType_As:
+				printNumber(mAquery_qty);
+				break;
+		#endif
+
+		// AI resolution: hex length of the AI values (X, A, C and AI replies)
+		#ifdef HC_SAMPLER_COMPILE
+			case HC_MessageType_Ar:
+				printNumber((uint8_t) HEX_LENGTH_AI);
+				break;
+		#endif
+
 		// Time (in ms)
 		#ifdef HC_ARDUINOTIME_COMPILE
 			case HC_MessageType_TM:
@@ -316,8 +218,13 @@ void HC_Protocol::send(char messageType)
 		// DI values
 		case HC_MessageType_DI:
 			#if HC_VARIANT == HC_VARIANT_MEGA
-				printHex(HC_readDI_H());
-				printHex(HC_readDI_L());
+			{
+				// all pins sampled at the same time
+				unsigned long reg_H, reg_L;
+				HC_readDI(reg_H, reg_L);
+				printHex(reg_H);
+				printHex(reg_L);
+			}
 			#else
 				printHex(HC_readDI());
 			#endif
@@ -326,8 +233,13 @@ void HC_Protocol::send(char messageType)
 		// DO values
 		case HC_MessageType_DO:
 			#if HC_VARIANT == HC_VARIANT_MEGA
-				printHex(HC_readDO_H());
-				printHex(HC_readDO_L());
+			{
+				// all pins sampled at the same time
+				unsigned long reg_H, reg_L;
+				HC_readDO(reg_H, reg_L);
+				printHex(reg_H);
+				printHex(reg_L);
+			}
 			#else
 				printHex(HC_readDO());
 			#endif
@@ -385,6 +297,10 @@ void HC_Protocol::send(char messageType)
 
 		// X query period (ms), Cycle Time (us)
 		case HC_MessageType_X0:
+			#ifdef HC_QUERY_TIMESTAMP
+				printTimestamp(HC_TIMESTAMP_X, HCS_micros());
+			#endif
+
 			// XQuery period (ms), 2 chars: max 255ms
 			#ifdef HC_DISPLAY_X_QUERY_PERIOD
 				now = millis();
@@ -398,205 +314,223 @@ void HC_Protocol::send(char messageType)
 			printNumber(HCS_getCycleTime(), HEX_LENGTH_CYCLETIME);
 			break;
 
+		// AI, PWM, Servo, AD values (X1 -> XH)
+		case HC_MessageType_X1:
+		case HC_MessageType_X2:
+		case HC_MessageType_X3:
+		case HC_MessageType_X4:
+		case HC_MessageType_X5:
+		case HC_MessageType_X6:
+		case HC_MessageType_X7:
+		case HC_MessageType_X8:
+		case HC_MessageType_X9:
+		case HC_MessageType_XA:
+		case HC_MessageType_XB:
+		case HC_MessageType_XC:
+		case HC_MessageType_XD:
+		case HC_MessageType_XE:
+		case HC_MessageType_XF:
+		case HC_MessageType_XG:
+		case HC_MessageType_XH:
+			containsData = sendX_Values(messageType);
+			break;
+
+#ifndef HC_USE_FTDI
+		// A query *******************************************************
+
+		case HC_MessageType_Aq:
+			sendA_Values();
+			break;
+#endif
+
+
+#ifdef HC_CAPTURE_COMPILE
+		// C query *******************************************************
+
+		// Capture state, channel qty, frame qty (0 if not done), trigger frame, period (us)
+		case HC_MessageType_Ca:
+			printNumber((uint8_t)HC_capture.getState());
+			printNumber(HC_capture.getChannelQty());
+			printNumber(HC_capture.getFrameQty(), 4);
+			printNumber(HC_capture.getPreTrigger(), 4);
+			printNumber(HC_capture.getPeriod(), 8);
+			break;
+
+		// Captured data (1 chunk)
+		case HC_MessageType_Cd:
+			sendC_Data();
+			break;
+#endif
+
+
+		// Other queries (E, Ec, ...) ********************************************
+
+		// For other Types, message is an acknowledge response
+		// => should not end with the Empty Data char (&)
+		// => containsData = true;
+	}
+	
+
+	// if message has Empty Data (finishes with &_)
+	if (!containsData)
+		printSpecialChar_EmptyData();
+	
+	// CRC
+	printCRC();
+	
+	// FOOTER: CR + LF
+    printFooter();
+}
+
+
+// X query: AI, PWM, Servo or AD values (X1 -> XH). Returns true if message contains data
+bool HC_Protocol::sendX_Values(char messageType)
+{
+	#ifdef HC_XQUERY_CHANGEMASK
+		// change mask (1 bit per value of the message), then changed values only
+		if (!mXvalue_isScanning)
+			printHex(mXvalue_changeMask);
+	#endif
+
+	switch(messageType)
+	{
 		// AI values (part 1 : 0 - 7)
 		case HC_MessageType_X1:
 			sendX_AIValues(0, 7);
-			break;	
+			return true;	
 
 		// AI values (part 2 : 8 - 15)
 		case HC_MessageType_X2:
 			sendX_AIValues(8, 15);
-			break;
+			return true;
 				
 		// PWM values (part 1 : 0 - 7)
 		case HC_MessageType_X3:
-			containsData = sendX_AOValues(0, 7);
-			break;
+			return sendX_AOValues(0, 7);
 				
 		// PWM values (part 1 : 8 - 15)
 		case HC_MessageType_X4:
-			containsData = sendX_AOValues(8, 15);
-			break;
+			return sendX_AOValues(8, 15);
 			
 		// Servo values (part 1 :  0 - 5)
 		case HC_MessageType_X5:
-			containsData = sendX_ServoValues(0, 5);
-			break;
+			return sendX_ServoValues(0, 5);
 			
 		// Servo values (part 2 :  6 - 11)
 		case HC_MessageType_X6:
-			containsData = sendX_ServoValues(6, 11);
-			break;
+			return sendX_ServoValues(6, 11);
 			
 		// Servo values (part 3 : 12 - 17) 
 		case HC_MessageType_X7:
-			containsData = sendX_ServoValues(12, 17);
-			break;
+			return sendX_ServoValues(12, 17);
 			
 		// Servo values (part 4 : 18 - 23) 
 		case HC_MessageType_X8:
-			containsData = sendX_ServoValues(18, 23);
-			break;
+			return sendX_ServoValues(18, 23);
 			
 		// Servo values (part 5 : 24 - 29)
 		case HC_MessageType_X9:
-			containsData = sendX_ServoValues(24, 29);
-			break;
+			return sendX_ServoValues(24, 29);
 			
 		// Servo values (part 6 : 30 - 35)  
 		case HC_MessageType_XA:
-			containsData = sendX_ServoValues(30, 35);
-			break;
+			return sendX_ServoValues(30, 35);
 			
 		// Servo values (part 7 : 36 - 41)  
 		case HC_MessageType_XB:
-			containsData = sendX_ServoValues(36, 41);
-			break;
+			return sendX_ServoValues(36, 41);
 			
 		// Servo values (part 8 : 42 - 47)  
 		case HC_MessageType_XC:
-			containsData = sendX_ServoValues(42, 47);
-			break;
+			return sendX_ServoValues(42, 47);
 			
 		// AD values (part 1 :  0 - 3)
 		case HC_MessageType_XD:
-			containsData = sendX_ADValues(0, 3);
-			break;
+			return sendX_ADValues(0, 3);
 
 		// AD values (part 2 :  4 - 7)
 		case HC_MessageType_XE:
-			containsData = sendX_ADValues(4, 7);
-			break;
+			return sendX_ADValues(4, 7);
 
 		// AD values (part 3 :  8 - 11)
 		case HC_MessageType_XF:
-			containsData = sendX_ADValues(8, 11);
-			break;
+			return sendX_ADValues(8, 11);
 		
 		// AD values (part 4 : 12 - 15)
 		case HC_MessageType_XG:
-			containsData = sendX_ADValues(12, 15);
-			break;
+			return sendX_ADValues(12, 15);
 								
 		// AD values (part 4 : 16 - 19)
 		case HC_MessageType_XH:
-			containsData = sendX_ADValues(16, 19);
-			break;
-			
+			return sendX_ADValues(16, 19);
+	}
 
-#ifndef HC_USE_FTDI
-		// A query *******************************************************
+	return false;
+}
 
-		case HC_MessageType_Aq:
-			for (int j = 0; j < mAquery_ARRAY_SIZE; ++j)
-			{
-				bool noDataQuerried = false;
 
-				#ifdef PROTOBF_USE_READABLE_MESSAGETYPE
-				switch (HCI_stringToConcByte(mAquery_type_array[j]))
-				#else
-				switch (mAquery_type_array[j])
-				#endif
-				{
-					// if no data querried ("")
-					case 0:
-						noDataQuerried = true;
-						break;
-
-					// Free RAM (probe 0-2)
-					case HC_MessageType_FR:
-						printNumber(HC_sram.getFreeRAM(mAquery_index_array[j]));
-						break;
-
-					// Cycle Time (in us)
-					case HC_MessageType_CT:
-						printNumber(HCS_getCycleTime(), HEX_LENGTH_CYCLETIME);
-						break;
-
-					// DI value
-					case HC_MessageType_DI:
-						printNumber(HC_readDI(mAquery_index_array[j]));
-						break;
-
-					// DO value
-					case HC_MessageType_DO:
-						printNumber(HC_readDO(mAquery_index_array[j]));
-						break;
-
-					// AI value
-					case HC_MessageType_AI:
-						printNumber(HC_readAI(mAquery_index_array[j]), HEX_LENGTH_AI);
-						break;
-
-					// PWM value
-					case HC_MessageType_PW:
-						#if defined ARDUINO_ARCH_SAMD
-							printNumber(HC_readPWM(mAquery_index_array[j]), HEX_LENGTH_PWM);
-						#else
-							printNumber(HC_readPWM(mAquery_index_array[j]));
-						#endif
-						break;
-
-					// Servo value
-					case HC_MessageType_SV:
-						printNumber(HC_servoRead(mAquery_index_array[j]), HEX_LENGTH_SERVO);
-						break;
-
-					// DD value
-					case HC_MessageType_DD:
-						printNumber(HC_readDD(mAquery_index_array[j]));
-						break;
-
-					// AD value
-					case HC_MessageType_AD:
-						printFloat(HC_readAD(mAquery_index_array[j]));
-						break;
-
-					// DAC value
-					#if defined ARDUINO_ARCH_SAMD
-					case HC_MessageType_DA:
-						printNumber(HC_readDAC(mAquery_index_array[j]), HEX_LENGTH_DAC);
-						break;
-					#endif
-				}
+#ifdef HC_XQUERY_CHANGEMASK
+// X query: compare the values of a message (X1 -> XH) to the last sent ones (nothing is printed)
+// return true if at least 1 value has changed (all values if first pass (keyframe))
+bool HC_Protocol::scanX_Values(char messageType)
+{
+	mXvalue_changeMask = 0;
 
-				if (noDataQuerried)
-					break;
-			}
-			break;
-#endif
+	mXvalue_isScanning = true;
+	sendX_Values(messageType);
+	mXvalue_isScanning = false;
 
+	return (mXvalue_changeMask != 0);
+}
 
-		// Other queries (E, Ec, ...) ********************************************
+// X query: the changed values of the message become the last sent ones (once the message is written)
+void HC_Protocol::commitX_Values()
+{
+	for (uint8_t bit = 0; bit < 8; ++bit)
+		if (HCS_readBit(mXvalue_changeMask, bit))
+			mXvalue_last[mXvalue_first + bit] = mXvalue_scanned[bit];
+}
 
-		// For other Types, message is an acknowledge response
-		// => should not end with the Empty Data char (&)
-		// => containsData = true;
-	}
-	
+// X query: value i of a message
+//    - scanning: value is kept (printed as is, not read again). If value has changed (or keyframe),
+//      its bit is set in the change mask
+//    - printing: return true if value has changed
+// index: index of the value in the list of last sent values (mXvalue_last)
+// value: value read when scanning (float: bits), ignored when printing (mXvalue_scanned[bit])
+bool HC_Protocol::sendX_valueHasChanged(uint8_t index, uint8_t bit, unsigned long value)
+{
+	if (mXvalue_isScanning)
+	{
+		mXvalue_scanned[bit] = value;
+		mXvalue_first = index - bit;
 
-	// if message has Empty Data (finishes with &_)
-	if (!containsData)
-		printSpecialChar_EmptyData();
-	
-	// CRC
-	printCRC();
-	
-	// FOOTER: CR + LF
-    printFooter();
+		if (HCS_readBit(mXquery_firstPass, mXquery_group) || (value != mXvalue_last[index]))
+			HCS_writeBit(mXvalue_changeMask, bit, 1);
+
+		return false;
+	}
+	else
+		return HCS_readBit(mXvalue_changeMask, bit);
 }
+#endif
 
 
 // X query: AI values (part i : min - max)  
 bool HC_Protocol::sendX_AIValues(uint8_t min, uint8_t max)
 {
 	bool containsData = false;
+	uint8_t hexLength = HEX_LENGTH_AI;
 
 	for (uint8_t j = HCS_getAI_startIndex(); j <= HCS_getAI_endIndex(); ++j)
 	{
 		if ((min <= j) && (j <= max))
 		{
-			printNumber(HC_readAI(j), HEX_LENGTH_AI);
+			#ifdef HC_XQUERY_CHANGEMASK
+				if (sendX_valueHasChanged(HC_XVALUE_AI + j, j - min, mXvalue_isScanning ? HC_readAI(j) : 0))
+					printNumber(mXvalue_scanned[j - min], hexLength);
+			#else
+				printNumber(HC_readAI(j), hexLength);
+			#endif
 			containsData = true;
 		}
 	}
@@ -617,10 +551,23 @@ bool HC_Protocol::sendX_AOValues(uint8_t min, uint8_t max)
 		{
 			if ((min <= counter) && (counter <= max))
 			{
-				#if defined ARDUINO_ARCH_SAMD
-					printNumber(HC_readPWM(j), HEX_LENGTH_PWM);
+				#ifdef HC_XQUERY_CHANGEMASK
+				if (sendX_valueHasChanged(HC_XVALUE_PWM + counter, counter - min, mXvalue_isScanning ? HC_readPWM(j) : 0))
+				{
+					#if defined ARDUINO_ARCH_SAMD
+						printNumber(mXvalue_scanned[counter - min], HEX_LENGTH_PWM);
+					#else
+						printNumber((uint8_t) mXvalue_scanned[counter - min]);
+					#endif
+				}
 				#else
-					printNumber(HC_readPWM(j));
+				{
+					#if defined ARDUINO_ARCH_SAMD
+						printNumber(HC_readPWM(j), HEX_LENGTH_PWM);
+					#else
+						printNumber(HC_readPWM(j));
+					#endif
+				}
 				#endif
 				containsData = true;
 			}
@@ -648,7 +595,12 @@ bool HC_Protocol::sendX_ServoValues(uint8_t min, uint8_t max)
 			if ((min <= counter) && (counter <= max))
 			{
 				// Servo value in millidegrees
-				printNumber(HC_servoRead(j), HEX_LENGTH_SERVO);
+				#ifdef HC_XQUERY_CHANGEMASK
+				if (sendX_valueHasChanged(HC_XVALUE_SERVO + counter, counter - min, mXvalue_isScanning ? HC_servoRead(j) : 0))
+					printNumber(mXvalue_scanned[counter - min], HEX_LENGTH_SERVO);
+				#else
+					printNumber(HC_servoRead(j), HEX_LENGTH_SERVO);
+				#endif
 				containsData = true;
 			}
 
@@ -674,7 +626,12 @@ bool HC_Protocol::sendX_ADValues(uint8_t min, uint8_t max)
 		{
 			if ((min <= counter) && (counter <= max))
 			{
-				printFloat(HC_readAD(j));
+				#ifdef HC_XQUERY_CHANGEMASK
+				if (sendX_valueHasChanged(HC_XVALUE_AD + counter, counter - min, mXvalue_isScanning ? HCI_convertFloatToHex(HC_readAD(j)) : 0))
+					printFloat(HCI_convertHexToFloat(mXvalue_scanned[counter - min]));
+				#else
+					printFloat(HC_readAD(j));
+				#endif
 				containsData = true;
 			}
 
@@ -687,6 +644,208 @@ bool HC_Protocol::sendX_ADValues(uint8_t min, uint8_t max)
 }
 
 
+#ifndef HC_USE_FTDI
+// A Query ---------------------------------------------------------------------
+
+// readers (value or float bits)
+static unsigned long HCI_readA_FR(uint8_t index)	{ return HC_sram.getFreeRAM(index); }
+static unsigned long HCI_readA_CT(uint8_t index)	{ return HCS_getCycleTime(); }
+static unsigned long HCI_readA_DI(uint8_t index)	{ return HC_readDI(index); }
+static unsigned long HCI_readA_DO(uint8_t index)	{ return HC_readDO(index); }
+static unsigned long HCI_readA_AI(uint8_t index)	{ return HC_readAI(index); }
+static unsigned long HCI_readA_PW(uint8_t index)	{ return HC_readPWM(index); }
+static unsigned long HCI_readA_SV(uint8_t index)	{ return HC_servoRead(index); }
+static unsigned long HCI_readA_DD(uint8_t index)	{ return HC_readDD(index); }
+static unsigned long HCI_readA_AD(uint8_t index)	{ return HCI_convertFloatToHex(HC_readAD(index)); }
+#if defined ARDUINO_ARCH_SAMD
+static unsigned long HCI_readA_DA(uint8_t index)	{ return HC_readDAC(index); }
+#endif
+
+// longest printed value (bytes) of a subscription (hex length 0: float, 1: bool)
+static uint8_t HCI_getAValueMaxLength(uint8_t hexLength)
+{
+	#if defined(PROTOBF_USE_BINARY)
+		return (hexLength == 0) ? 4 : (hexLength + 1) / 2;
+	#elif defined(PROTOBF_USE_INT)
+		// decimal digits of the largest value, + separator. Float: sign, 10 digits, point, decimals
+		static const uint8_t digits[9] = { 12 + HC_DECIMAL_QTY, 2, 3, 4, 5, 7, 8, 9, 10 };
+		return digits[hexLength] + 1;
+	#elif defined(PROTOBF_USE_SEPARATOR)
+		return ((hexLength == 0) ? 8 : hexLength) + 1;
+	#else
+		return (hexLength == 0) ? 8 : hexLength;
+	#endif
+}
+
+// add a value to the subscription table (reader and print format are set once)
+// return false if table is full, if the longest reply would not fit in the output frame,
+// or if message type is not supported
+bool HC_Protocol::subscribeA(char messageType, uint8_t index)
+{
+	if (mAquery_qty >= HC_AQUERY_MAX_QTY)
+		return false;
+
+	ASubscription* subscription = &mAquery_subscriptions[mAquery_qty];
+
+	switch (messageType)
+	{
+		// Free RAM (probe 0-2)
+		case HC_MessageType_FR:
+			subscription->read = HCI_readA_FR;
+			subscription->hexLength = 2 * sizeof(unsigned int);
+			break;
+
+		// Cycle Time (in us)
+		case HC_MessageType_CT:
+			subscription->read = HCI_readA_CT;
+			subscription->hexLength = HEX_LENGTH_CYCLETIME;
+			break;
+
+		// DI value
+		case HC_MessageType_DI:
+			subscription->read = HCI_readA_DI;
+			subscription->hexLength = 1;
+			break;
+
+		// DO value
+		case HC_MessageType_DO:
+			subscription->read = HCI_readA_DO;
+			subscription->hexLength = 1;
+			break;
+
+		// AI value
+		case HC_MessageType_AI:
+			subscription->read = HCI_readA_AI;
+			subscription->hexLength = HEX_LENGTH_AI_MAX;	// sampler: printed with the current length
+			break;
+
+		// PWM value
+		case HC_MessageType_PW:
+			subscription->read = HCI_readA_PW;
+			subscription->hexLength = HEX_LENGTH_PWM;
+			break;
+
+		// Servo value
+		case HC_MessageType_SV:
+			subscription->read = HCI_readA_SV;
+			subscription->hexLength = HEX_LENGTH_SERVO;
+			break;
+
+		// DD value
+		case HC_MessageType_DD:
+			subscription->read = HCI_readA_DD;
+			subscription->hexLength = 1;
+			break;
+
+		// AD value
+		case HC_MessageType_AD:
+			subscription->read = HCI_readA_AD;
+			subscription->hexLength = 0;
+			break;
+
+		// DAC value
+		#if defined ARDUINO_ARCH_SAMD
+		case HC_MessageType_DA:
+			subscription->read = HCI_readA_DA;
+			subscription->hexLength = HEX_LENGTH_DAC;
+			break;
+		#endif
+
+		default:
+			return false;
+	}
+
+	// longest reply with this value: must fit in the output frame
+	unsigned int length = HC_AQUERY_FRAME_OVERHEAD;
+	for (uint8_t j = 0; j <= mAquery_qty; ++j)
+		length += HCI_getAValueMaxLength(mAquery_subscriptions[j].hexLength);
+	if (length > HC_OUTPUTFRAME_MAX_ARRAY_LENGHT)
+		return false;
+
+	subscription->index = index;
+	++mAquery_qty;
+	return true;
+}
+
+// A reply: values in subscription order.
+// If binary: packed, bool values are sent as a bit field (1 bit per value) after the other values.
+void HC_Protocol::sendA_Values()
+{
+	#ifdef HC_QUERY_TIMESTAMP
+		// values are sampled now
+		printTimestamp(HC_TIMESTAMP_A, HCS_micros());
+	#endif
+
+	#ifdef PROTOBF_USE_BINARY
+		uint8_t bits = 0;
+		uint8_t bitQty = 0;
+	#endif
+
+	for (uint8_t j = 0; j < mAquery_qty; ++j)
+	{
+		ASubscription* subscription = &mAquery_subscriptions[j];
+		unsigned long value = (*subscription->read)(subscription->index);
+
+		switch (subscription->hexLength)
+		{
+			// float
+			case 0:
+				printFloat(HCI_convertHexToFloat(value));
+				break;
+
+			#ifdef PROTOBF_USE_BINARY
+			// bool
+			case 1:
+				bits |= (value != 0) << (bitQty & 0x07);
+				if ((++bitQty & 0x07) == 0)
+				{
+					printByte(bits);
+					bits = 0;
+				}
+				break;
+			#endif
+
+			default:
+				#ifdef HC_SAMPLER_COMPILE
+					// AI: the oversampling may have changed since the subscription
+					if (subscription->read == HCI_readA_AI)
+						printNumber(value, HEX_LENGTH_AI);
+					else
+				#endif
+				printNumber(value, subscription->hexLength);
+				break;
+		}
+	}
+
+	#ifdef PROTOBF_USE_BINARY
+		// last bits
+		if (bitQty & 0x07)
+			printByte(bits);
+	#endif
+}
+#endif
+
+
+// Timestamp (us): delta from previous timestamp of the same query, or escape + absolute time
+#ifdef HC_QUERY_TIMESTAMP
+void HC_Protocol::printTimestamp(uint8_t query, unsigned long timestamp)
+{
+	unsigned long delta = timestamp - mTimestamp_previous[query];
+	mTimestamp_previous[query] = timestamp;
+
+	if (HCS_readBit(mTimestamp_isAbsolute, query) || (delta >= HC_TIMESTAMP_ESCAPE))
+	{
+		HCS_writeBit(mTimestamp_isAbsolute, query, 0);
+
+		printNumber((unsigned int)HC_TIMESTAMP_ESCAPE, 4);
+		printNumber(timestamp, 8);
+	}
+	else
+		printNumber((unsigned int)delta, 4);
+}
+#endif
+
+
 // B Query replies
 void HC_Protocol::send_BQuery()
 {
@@ -701,8 +860,8 @@ void HC_Protocol::send_BQuery()
             mBquery_ID = 0;
             mBquery_run = false;
 
-			// set first time flag
-			mFirstTime = true;
+			// X query: all messages are sent once
+			mXquery_firstPass = 0xFF;
         }
         else
 			send_withIndex(mBquery_ID++, HC_MessageType_Bq);
@@ -727,16 +886,19 @@ void HC_Protocol::send_EQuery()
 			// reset flag and message ID
 			mEquery_ID = 0;
 			mEquery_run = false;
+			mEquery_isStarted = false;
 			
 			// notify end of a reply sequence
             send(HC_MessageType_Ee);
+		}
+		// notify start of a reply sequence (in its own cycle: a deferred reply is never followed by another one)
+		else if(!mEquery_isStarted)
+		{
+			mEquery_isStarted = true;
+            send(HC_MessageType_Es);
 		}
 		else
 		{
-			// notify start of a reply sequence
-			if(mEquery_ID == 0)	
-                send(HC_MessageType_Es);
-			
 			// send several sets of address/value per messages
 			send_withConsecutiveAddresses(mEquery_ID, setQtyPerMessage, HC_MessageType_EE);
 		
@@ -782,304 +944,331 @@ void HC_Protocol::send_EQuery()
 #endif
 
 
-// X Query replies
-// return true if a message was sent (some messages may be skipped (no data changed...)
-bool HC_Protocol::send_XQuery()
-{ 
-	switch(mXquery_ID)
+// C Query replies
+#ifdef HC_CAPTURE_COMPILE
+void HC_Protocol::send_CQuery()
+{
+	/*
+	* - Capture armed by computer is done: send capture state, then start sending captured data
+	*   (overrun: capture state only)
+	* - Send all captured frames in several messages at highest rate (1 message per cycle)
+	*/
+	if (mCquery_isArmed && (HC_capture.getState() >= HC_CAPTURE_DONE))
 	{
-		case 0: 
-			send(HC_MessageType_X0);		// X query period (ms), Cycle Time (us)
-			break;
+		mCquery_isArmed = false;
+		mCquery_run = (HC_capture.getState() == HC_CAPTURE_DONE);
+		mCquery_frame = 0;
 
-		case 1: 
-			if (mFirstTime || HC_sram.hasChanged())
-			{
-				send(HC_MessageType_M0);	// SRAM
-				break;
-			}
-			else
-				mXquery_ID++;
-				// continue to next case
+		send(HC_MessageType_Ca);
+	}
+	else if (mCquery_run)
+	{
+		if (mCquery_frame >= HC_capture.getFrameQty())
+			// reset flag
+			mCquery_run = false;
+		else
+			send(HC_MessageType_Cd);
+	}
+}
 
-		case 2: 
-			#if defined(ARDUINO_ARCH_SAMD)
-			if (mFirstTime || HCI_PinsMode_hasChanged() || HCI_InputsMode_hasChanged() || HCI_InputsModeOption_hasChanged())
-			#else
-			if (mFirstTime || HCI_PinsMode_hasChanged() || HCI_InputsMode_hasChanged())
-			#endif
-			{
-				send(HC_MessageType_PM);	// Pin Mode + Input Mode
-				break;
-			}
-			else
-				mXquery_ID++;
-				// continue to next case
+// Cd: first frame, frame qty, then samples (frames in time order, channels in subscription order)
+void HC_Protocol::sendC_Data()
+{
+	uint8_t channelQty = HC_capture.getChannelQty();
+	unsigned int frameQty = HC_CQUERY_SAMPLE_QTY / channelQty;
+	if (frameQty > HC_capture.getFrameQty() - mCquery_frame)
+		frameQty = HC_capture.getFrameQty() - mCquery_frame;
 
-		case 3: 
-			if (mFirstTime || HCI_ServosMode_hasChanged())
-			{
-				send(HC_MessageType_SM);	// Servo Mode
-				break;
-			}
-			else
-				mXquery_ID++;
-				// continue to next case
+	printNumber(mCquery_frame, 4);
+	printNumber((uint8_t)frameQty);
 
-		case 4: 
-			if (mFirstTime || HCI_OutputTypes_hasChanged())
-			{
-				send(HC_MessageType_OT);	// Output Type
-				break;
-			}
-			else
-				mXquery_ID++;
-				// continue to next case
+	uint8_t hexLength = HEX_LENGTH_AI;
 
-		case 5: 
-			if (mFirstTime || HCI_PWMavailability_hasChanged())
-			{
-				send(HC_MessageType_PA);	// PWM availability
-				break;
-			}
-			else
-				mXquery_ID++;
-				// continue to next case
+	for (unsigned int f = mCquery_frame; f < mCquery_frame + frameQty; ++f)
+		for (uint8_t c = 0; c < channelQty; ++c)
+			printNumber(HC_capture.readSample(f, c), hexLength);
 
-		case 6: 
-			if (mFirstTime || HCI_ADMask_hasChanged())
-			{
-				send(HC_MessageType_AM);	// AD mask
-				break;
-			}
-			else
-				mXquery_ID++;
-				// continue to next case
+	mCquery_frame += frameQty;
+}
+#endif
 
-		case 7:
-			#ifdef ARDUINO_ARCH_SAMD
-				if (mFirstTime || HCI_DacsMode_hasChanged())
-				{
-					send(HC_MessageType_DM);// DAC mode (enable mask)
-					break;
-				}
-				else
-			#endif
-			mXquery_ID++;
-			// continue to next case
-	
-		case 8: 
-			send(HC_MessageType_DI);		// DI values
-			break;
 
-		case 9: 
-			send(HC_MessageType_DO);		// DD values
-			break;
+// X Query replies ------------------------------------------------------------
 
-		case 10: 
-			send(HC_MessageType_DD);		// DD values
-			break;
+// A message of a group is sent if quantity() > threshold (or on first pass, if onFirstPass)
+struct XSlot
+{
+	char messageType;
+	uint8_t (*quantity)();	// 0: always sent
+	uint8_t threshold;
+	bool onFirstPass;
+	uint8_t change;			// quantity() reads a change (HC_XCHANGE_xxx), 0 if not
+};
 
-		case 11:
-			#ifdef HC_STRINGMESSAGE_COMPILE
-				if (mFirstTime || HCI_String_hasChanged())
-				{
-					send(HC_MessageType_S0);// String
-					break;
-				}
-				else
-			#endif
-			mXquery_ID++;
-			// continue to next case
+// A group of messages is sent every period (ms).
+// series: messages are consecutive parts of a same set of values (a part is sent only
+// if the previous one is sent) => sending stops at the first part which is not sent.
+struct XGroup
+{
+	const XSlot* slots;
+	uint8_t slotQty;
+	unsigned int period;
+	uint8_t priority;
+	bool series;
+};
 
-		case 12:
-            send(HC_MessageType_X1);		// AI values (part 1 : 0 - 7)
-			break;	
-			
-		case 13:
-			if (HCS_getAI_qty() > 8)
-			{
-				send(HC_MessageType_X2);	// AI values (part 2 : 8 - 15)	
-				break;
-			}
-			else
-				mXquery_ID++;
-				// continue to next case
+// quantities
+static uint8_t HCI_XQty_SRAMChange()		{ return HC_sram.hasChanged(); }
+#if defined(ARDUINO_ARCH_SAMD)
+static uint8_t HCI_XQty_PinsModeChange()	{ return HCI_PinsMode_hasChanged() || HCI_InputsMode_hasChanged() || HCI_InputsModeOption_hasChanged(); }
+static uint8_t HCI_XQty_DacsModeChange()	{ return HCI_DacsMode_hasChanged(); }
+static uint8_t HCI_XQty_DacsMode()			{ return HC_readDacsMode(); }
+#else
+static uint8_t HCI_XQty_PinsModeChange()	{ return HCI_PinsMode_hasChanged() || HCI_InputsMode_hasChanged(); }
+#endif
+static uint8_t HCI_XQty_ServosModeChange()	{ return HCI_ServosMode_hasChanged(); }
+static uint8_t HCI_XQty_OutputTypesChange()	{ return HCI_OutputTypes_hasChanged(); }
+static uint8_t HCI_XQty_PWMavailabilityChange() { return HCI_PWMavailability_hasChanged(); }
+static uint8_t HCI_XQty_ADMaskChange()		{ return HCI_ADMask_hasChanged(); }
+#ifdef HC_STRINGMESSAGE_COMPILE
+static uint8_t HCI_XQty_StringChange()		{ return HCI_String_hasChanged(); }
+#endif
+static uint8_t HCI_XQty_AI()				{ return HCS_getAI_qty(); }
 
-		case 14:
-			if (mFirstTime || (HCI_getPWM_qty() > 0))
-			{
-				send(HC_MessageType_X3);	// PWM values (part 1 : 0 - 7)
-				break;
-			}
-			else
-				mXquery_ID++;
-				// continue to next case
+// groups
+static const XSlot XSlots_Config[] PROGMEM =
+{
+	{ HC_MessageType_X0, 0,									0, false },	// X query period (ms), Cycle Time (us)
+	{ HC_MessageType_M0, HCI_XQty_SRAMChange,				0, true, HC_XCHANGE_SRAM },				// SRAM
+	{ HC_MessageType_PM, HCI_XQty_PinsModeChange,			0, true, HC_XCHANGE_PINSMODE },			// Pin Mode + Input Mode
+	{ HC_MessageType_SM, HCI_XQty_ServosModeChange,			0, true, HC_XCHANGE_SERVOSMODE },		// Servo Mode
+	{ HC_MessageType_OT, HCI_XQty_OutputTypesChange,		0, true, HC_XCHANGE_OUTPUTTYPES },		// Output Type
+	{ HC_MessageType_PA, HCI_XQty_PWMavailabilityChange,	0, true, HC_XCHANGE_PWMAVAILABILITY },	// PWM availability
+	{ HC_MessageType_AM, HCI_XQty_ADMaskChange,				0, true, HC_XCHANGE_ADMASK },			// AD mask
+	#ifdef ARDUINO_ARCH_SAMD
+	{ HC_MessageType_DM, HCI_XQty_DacsModeChange,			0, true, HC_XCHANGE_DACSMODE },			// DAC mode (enable mask)
+	#endif
+};
 
-		case 15:
-			if (HCI_getPWM_qty() > 8)
-			{
-				send(HC_MessageType_X4);	// PWM values (part 2 : 8 - 15)
-				break;
-			}
-			else
-				mXquery_ID++;
-				// continue to next case
+static const XSlot XSlots_Digital[] PROGMEM =
+{
+	{ HC_MessageType_DI, 0, 0, false },	// DI values
+	{ HC_MessageType_DO, 0, 0, false },	// DO values
+	{ HC_MessageType_DD, 0, 0, false },	// DD values
+};
 
-		case 16:
-			if (mFirstTime || (HCI_getAttachedServosQty() > 0))
-			{
-				send(HC_MessageType_X5);	// Servo values (part 1 :  0 - 5)
-				break;
-			}
-			else
-				mXquery_ID++;
-				// continue to next case
+#ifdef HC_STRINGMESSAGE_COMPILE
+static const XSlot XSlots_String[] PROGMEM =
+{
+	{ HC_MessageType_S0, HCI_XQty_StringChange, 0, true, HC_XCHANGE_STRING },	// String
+};
+#endif
 
-		case 17:
-			if(HCI_getAttachedServosQty() > 6)
-			{
-				send(HC_MessageType_X6);	// Servo values (part 2 :  6 - 11)
-				break;
-			}
-			else
-				mXquery_ID++;
-				// continue to next case
+static const XSlot XSlots_AI[] PROGMEM =
+{
+	{ HC_MessageType_X1, 0,				0, false },	// AI values (part 1 : 0 - 7)
+	{ HC_MessageType_X2, HCI_XQty_AI,	8, false },	// AI values (part 2 : 8 - 15)
+};
 
-		case 18:
-			if (HCI_getAttachedServosQty() > 12)
-			{
-				send(HC_MessageType_X7);	// Servo values (part 3 : 12 - 17)
-				break;
-			}
-			else
-				mXquery_ID++;
-				// continue to next case
+static const XSlot XSlots_PWM[] PROGMEM =
+{
+	{ HC_MessageType_X3, HCI_getPWM_qty, 0, true },	// PWM values (part 1 : 0 - 7)
+	{ HC_MessageType_X4, HCI_getPWM_qty, 8, false },	// PWM values (part 2 : 8 - 15)
+};
 
-		case 19:
-			if (HCI_getAttachedServosQty() > 18)
-			{
-				send(HC_MessageType_X8);	// Servo values (part 4 : 18 - 23) 
-				break;
-			}
-			else
-				mXquery_ID++;
-				// continue to next case
+static const XSlot XSlots_Servo[] PROGMEM =
+{
+	{ HC_MessageType_X5, HCI_getAttachedServosQty, 0,  true },	// Servo values (part 1 :  0 - 5)
+	{ HC_MessageType_X6, HCI_getAttachedServosQty, 6,  false },	// Servo values (part 2 :  6 - 11)
+	{ HC_MessageType_X7, HCI_getAttachedServosQty, 12, false },	// Servo values (part 3 : 12 - 17)
+	{ HC_MessageType_X8, HCI_getAttachedServosQty, 18, false },	// Servo values (part 4 : 18 - 23)
+	{ HC_MessageType_X9, HCI_getAttachedServosQty, 24, false },	// Servo values (part 5 : 24 - 29)
+	{ HC_MessageType_XA, HCI_getAttachedServosQty, 30, false },	// Servo values (part 6 : 30 - 35)
+	{ HC_MessageType_XB, HCI_getAttachedServosQty, 36, false },	// Servo values (part 7 : 36 - 41)
+	{ HC_MessageType_XC, HCI_getAttachedServosQty, 42, false },	// Servo values (part 8 : 42 - 47)
+};
 
-		case 20:
-			if (HCI_getAttachedServosQty() > 24)
-			{
-				send(HC_MessageType_X9);	// Servo values (part 5 : 24 - 29)
-				break;
-			}
-			else
-				mXquery_ID++;
-				// continue to next case
+static const XSlot XSlots_AD[] PROGMEM =
+{
+	{ HC_MessageType_XD, HCI_getAD_NonNullQty, 0,  true },	// AD values (part 1 :  0 - 3)
+	{ HC_MessageType_XE, HCI_getAD_NonNullQty, 4,  false },	// AD values (part 2 :  4 - 7)
+	{ HC_MessageType_XF, HCI_getAD_NonNullQty, 8,  false },	// AD values (part 3 :  8 - 11)
+	{ HC_MessageType_XG, HCI_getAD_NonNullQty, 12, false },	// AD values (part 4 : 12 - 15)
+	{ HC_MessageType_XH, HCI_getAD_NonNullQty, 16, false },	// AD values (part 5 : 16 - 19)
+};
 
-		case 21:
-			if (HCI_getAttachedServosQty() > 30)
-			{
-				send(HC_MessageType_XA);	// Servo values (part 6 : 30 - 35)
-				break;
-			}
-			else
-				mXquery_ID++;
-				// continue to next case
+#ifdef ARDUINO_ARCH_SAMD
+static const XSlot XSlots_DAC[] PROGMEM =
+{
+	{ HC_MessageType_DA, HCI_XQty_DacsMode, 0, false },	// DAC values (0 - 3)
+};
+#endif
 
-		case 22:
-			if (HCI_getAttachedServosQty() > 36)
-			{
-				send(HC_MessageType_XB);	// Servo values (part 7 : 36 - 41)
-				break;
-			}
-			else
-				mXquery_ID++;
-				// continue to next case
+#define HC_XSLOT_QTY(slots) (sizeof(slots) / sizeof(XSlot))
 
-		case 23:
-			if (HCI_getAttachedServosQty() > 42)
-			{
-				send(HC_MessageType_XC);	// Servo values (part 8 : 42 - 47)
-				break;
-			}
-			else
-				mXquery_ID++;
-				// continue to next case
+// groups are sent in this order when they have the same priority
+static const XGroup XGroups[] PROGMEM =
+{
+	{ XSlots_Config,	HC_XSLOT_QTY(XSlots_Config),	HC_XGROUP_PERIOD_CONFIG,	HC_XGROUP_PRIORITY_CONFIG,	false },
+	{ XSlots_Digital,	HC_XSLOT_QTY(XSlots_Digital),	HC_XGROUP_PERIOD_DIGITAL,	HC_XGROUP_PRIORITY_DIGITAL,	false },
+	#ifdef HC_STRINGMESSAGE_COMPILE
+	{ XSlots_String,	HC_XSLOT_QTY(XSlots_String),	HC_XGROUP_PERIOD_STRING,	HC_XGROUP_PRIORITY_STRING,	false },
+	#endif
+	{ XSlots_AI,		HC_XSLOT_QTY(XSlots_AI),		HC_XGROUP_PERIOD_AI,		HC_XGROUP_PRIORITY_AI,		true },
+	{ XSlots_PWM,		HC_XSLOT_QTY(XSlots_PWM),		HC_XGROUP_PERIOD_PWM,		HC_XGROUP_PRIORITY_PWM,		true },
+	{ XSlots_Servo,		HC_XSLOT_QTY(XSlots_Servo),		HC_XGROUP_PERIOD_SERVO,		HC_XGROUP_PRIORITY_SERVO,	true },
+	{ XSlots_AD,		HC_XSLOT_QTY(XSlots_AD),		HC_XGROUP_PERIOD_AD,		HC_XGROUP_PRIORITY_AD,		true },
+	#ifdef ARDUINO_ARCH_SAMD
+	{ XSlots_DAC,		HC_XSLOT_QTY(XSlots_DAC),		HC_XGROUP_PERIOD_DAC,		HC_XGROUP_PRIORITY_DAC,		false },
+	#endif
+};
 
-		case 24:
-			if (mFirstTime || (HCI_getAD_NonNullQty() > 0))
-			{
-				send(HC_MessageType_XD);	// AD values (part 1 :  0 - 3)
-				break;
-			}
-			else
-				mXquery_ID++;
-				// continue to next case
+#define HC_XGROUP_QTY (sizeof(XGroups) / sizeof(XGroup))	// <= HC_XGROUP_MAX_QTY
 
-		case 25:
-			if(HCI_getAD_NonNullQty() > 4)
-			{
-				send(HC_MessageType_XE);	// AD values (part 2 :  4 - 7)
-				break;
-			}
-			else
-				mXquery_ID++;
-				// continue to next case
 
-		case 26:
-			if (HCI_getAD_NonNullQty() > 8)
-			{
-				send(HC_MessageType_XF);	// AD values (part 3 :  8 - 11)
-				break;
-			}
-			else
-				mXquery_ID++;
-				// continue to next case
+// all groups are due
+void HC_Protocol::restartXQuery()
+{
+	unsigned int now = (unsigned int) HCS_millis();
 
-		case 27:
-			if (HCI_getAD_NonNullQty() > 12)
-			{
-				send(HC_MessageType_XG);	// AD values (part 4 : 12 - 15)
-				break;
-			}
-			else
-				mXquery_ID++;
-				// continue to next case
+	for (uint8_t g = 0; g < HC_XGROUP_QTY; ++g)
+		mXgroup_startTime[g] = now - pgm_read_word(&XGroups[g].period);
+
+	mXquery_group = 0xFF;
+	mXquery_lastGroup = HC_XGROUP_QTY - 1;
+
+	#ifdef HC_QUERY_TIMESTAMP
+		// first timestamp is absolute
+		HCS_writeBit(mTimestamp_isAbsolute, HC_TIMESTAMP_X, 1);
+	#endif
+}
 
-		case 28:
-			if (HCI_getAD_NonNullQty() > 16)
+// if no group is being sent, select the due group with the highest priority
+// return true if a group is being sent
+bool HC_Protocol::selectXGroup()
+{
+	if (mXquery_group < HC_XGROUP_QTY)
+		return true;
+
+	unsigned int now = (unsigned int) HCS_millis();
+	uint8_t priority = 0xFF;
+
+	// round robin, starting after last group sent
+	uint8_t g = mXquery_lastGroup;
+	for (uint8_t i = 0; i < HC_XGROUP_QTY; ++i)
+	{
+		if (++g >= HC_XGROUP_QTY)
+			g = 0;
+
+		uint8_t groupPriority = pgm_read_byte(&XGroups[g].priority);
+
+		if ((groupPriority < priority) &&
+			(HCS_readBit(mXquery_firstPass, g) || ((unsigned int)(now - mXgroup_startTime[g]) >= pgm_read_word(&XGroups[g].period))))
+		{
+			mXquery_group = g;
+			priority = groupPriority;
+		}
+	}
+
+	if (mXquery_group < HC_XGROUP_QTY)
+	{
+		#ifdef HC_XQUERY_CHANGEMASK
+			// keyframe: all messages and values are sent (1st pass of each group)
+			if ((unsigned int)(now - mXquery_keyframeTime) >= HC_XQUERY_KEYFRAME_PERIOD)
 			{
-				send(HC_MessageType_XH);	// AD values (part 5 : 16 - 19)
-				break;
+				mXquery_firstPass = 0xFF;
+				mXquery_keyframeTime = now;
 			}
-			else
-				mXquery_ID++;
-				// continue to next case
-
-		case 29:
-			#ifdef ARDUINO_ARCH_SAMD
-				if (HC_readDacsMode())
-					send(HC_MessageType_DA);// DAC values (0 - 3)
+		#endif
+
+		mXquery_ID = 0;
+		mXgroup_startTime[mXquery_group] = now;
+		return true;
+	}
+	else
+		return false;
+}
+
+// A change is read (and reset) once from the board by the first session which checks it.
+// It is then kept by each session until this session sends it
+uint8_t HC_Protocol::readXQuantity(uint8_t (*quantity)(), uint8_t change)
+{
+	uint8_t qty = (*quantity)();
+
+	if (change == 0)
+		return qty;
+
+	if (qty > 0)
+	{
+		mXchange |= change;
+		for (HC_Protocol* session = mSession_first; session != NULL_POINTER; session = session->mSession_next)
+			session->mXchange |= change;
+	}
+
+	return (mXchange & change) ? 1 : 0;
+}
+
+// send next message of the group being sent (messages with nothing to send are skipped)
+// return true if a message was sent
+bool HC_Protocol::send_XQuery()
+{
+	if (!selectXGroup())
+		return false;
+
+	XGroup group;
+	memcpy_P(&group, &XGroups[mXquery_group], sizeof(XGroup));
+
+	bool firstPass = HCS_readBit(mXquery_firstPass, mXquery_group);
+	bool isSent = false;
+
+	while (!isSent && (mXquery_ID < group.slotQty))
+	{
+		XSlot slot;
+		memcpy_P(&slot, &group.slots[mXquery_ID++], sizeof(XSlot));
+
+		if ((slot.quantity == 0) || (firstPass && slot.onFirstPass) || (readXQuantity(slot.quantity, slot.change) > slot.threshold))
+		{
+			#ifdef HC_XQUERY_CHANGEMASK
+				// values: no message if no value has changed (next parts are still checked)
+				if (group.series && !scanX_Values(slot.messageType))
+					continue;
 			#endif
-		
-			// reset first time flag
-			if (mFirstTime)
-				mFirstTime = false;
-			break;
+
+			#ifdef HC_XQUERY_CHANGEMASK
+				unsigned long droppedReplies = mOutput_droppedReplies;
+			#endif
+
+			send(slot.messageType);
+			isSent = true;
+
+			#ifdef HC_XQUERY_CHANGEMASK
+				// changed values are the last sent ones, unless the message was dropped
+				if (group.series && (mOutput_droppedReplies == droppedReplies))
+					commitX_Values();
+			#endif
+
+			// change is sent
+			mXchange &= ~slot.change;
+		}
+		// next parts are not sent either
+		else if (group.series)
+			mXquery_ID = group.slotQty;
+	}
+
+	// end of group
+	if (mXquery_ID >= group.slotQty)
+	{
+		HCS_writeBit(mXquery_firstPass, mXquery_group, 0);
+		mXquery_lastGroup = mXquery_group;
+		mXquery_group = 0xFF;
 	}
 
-	// 0 - 29: increment ID
-	if (mXquery_ID < mXquery_qty)
-		mXquery_ID++;
+	return isSent;
 }
 
 	
 // specify 1 index
-#ifdef PROTOBF_USE_READABLE_MESSAGETYPE
-void HC_Protocol::send_withIndex(uint8_t index, unsigned int messageType)
-#else
 void HC_Protocol::send_withIndex(uint8_t index, char messageType)
-#endif
 {
 	// reset CRC
 	mOutput_CRC = 0;
@@ -1184,6 +1373,21 @@ void HC_Protocol::send_withIndex(uint8_t index, char messageType)
 			}
 			break;
 
+		// Baudrate (read: supported baudrate, write: acknowledge of the change)
+		#ifdef HC_BAUDRATE_NEGOTIATION
+			case HC_MessageType_Br:
+				printNumber((unsigned long) getBaudrateValue(index));
+				break;
+		#endif
+
+		// AI resolution: oversampling (4^n samples per result), resolution (bits)
+		#ifdef HC_SAMPLER_COMPILE
+			case HC_MessageType_Ar:
+				printNumber(HC_sampler.getOversampling(index));
+				printNumber(HC_sampler.getResolution(index));
+				break;
+		#endif
+
 		// Free RAM
 		case HC_MessageType_FR:
 			printNumber(HC_sram.getFreeRAM(index));
@@ -1294,22 +1498,14 @@ void HC_Protocol::send_withIndex(uint8_t index, char messageType)
 #ifdef HC_EEPROM_COMPILE
 
 	// specify 1 address
-	#ifdef PROTOBF_USE_READABLE_MESSAGETYPE
-	void HC_Protocol::send_withAddress(int unsigned address, unsigned int messageType)
-	#else
 	void HC_Protocol::send_withAddress(int unsigned address, char messageType)
-	#endif
 	{
 		send_withConsecutiveAddresses(address, 1, messageType);
 	}
 
 
 	// specify several consecutive addresses
-	#ifdef PROTOBF_USE_READABLE_MESSAGETYPE
-	void HC_Protocol::send_withConsecutiveAddresses(int unsigned start_address, uint8_t qty, unsigned int messageType)
-	#else
 	void HC_Protocol::send_withConsecutiveAddresses(int unsigned start_address, uint8_t qty, char messageType)
-	#endif
 	{
 		// reset CRC
 		mOutput_CRC = 0;
@@ -1351,11 +1547,7 @@ void HC_Protocol::send_withIndex(uint8_t index, char messageType)
 
 
 	// specify 1 index and 1 address
-	#ifdef PROTOBF_USE_READABLE_MESSAGETYPE
-	void HC_Protocol::send_withIndex_withAddress(uint8_t index, int unsigned address, unsigned int messageType)
-	#else
 	void HC_Protocol::send_withIndex_withAddress(uint8_t index, int unsigned address, char messageType)
-	#endif
 	{
 		// reset CRC
 		mOutput_CRC = 0;
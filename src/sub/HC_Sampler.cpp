@@ -0,0 +1,565 @@
+/*
+ * HITIComm
+ * HC_Sampler.cpp
+ *
+ * Copyright © 2021 Christophe LANDRET
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "HC_Sampler.h"
+
+
+
+// *****************************************************************************
+// Compilation trigger
+// *****************************************************************************
+
+#ifdef HC_SAMPLER_COMPILE
+
+
+
+// *****************************************************************************
+// Include dependencies
+// *****************************************************************************
+
+// HITICommSupport
+#include "HITICommSupport.h"
+#include <HCS_LowAccess_IO.h>
+#include <HCS_Time.h>
+
+
+
+// *****************************************************************************
+// Instanciates an object so that it can be reused in other files (forward declared in .h)
+// *****************************************************************************
+
+HC_Sampler HC_sampler;
+
+
+
+// *****************************************************************************
+// Interrupt handlers
+// *****************************************************************************
+
+#ifdef HC_SAMPLER_INTERRUPT
+ISR(ADC_vect)
+{
+	HC_sampler.onConversion(ADC);
+}
+
+// ADC multiplexer: channel of an AI (as analogRead()). The reference (REFS bits) is kept:
+// set by analogReference() and the last analogRead() (begin())
+static void HCI_sampler_select(uint8_t index)
+{
+	#ifdef analogPinToChannel
+		uint8_t channel = analogPinToChannel(index);
+	#else
+		uint8_t channel = index;
+	#endif
+
+	#ifdef MUX5
+		ADCSRB = (ADCSRB & ~_BV(MUX5)) | (((channel >> 3) & 0x01) << MUX5);
+	#endif
+	ADMUX = (ADMUX & 0xC0) | (channel & 0x07);
+}
+#endif
+
+
+
+// *****************************************************************************
+// DMA (SAMD21)
+// *****************************************************************************
+
+#ifdef HC_SAMPLER_DMA
+// descriptors: channel 0 (base and write-back sections), 2nd buffer (linked)
+static DmacDescriptor g_sampler_descriptor __attribute__((aligned(16)));
+static DmacDescriptor g_sampler_writeback __attribute__((aligned(16)));
+static DmacDescriptor g_sampler_linked __attribute__((aligned(16)));
+
+// ADC settings of analogRead(), restored when stopped
+static uint16_t g_sampler_ADC_CTRLB;
+static uint8_t g_sampler_ADC_AVGCTRL;
+static uint32_t g_sampler_ADC_INPUTCTRL;
+
+static void HCI_sampler_syncADC()
+{
+	while (ADC->STATUS.bit.SYNCBUSY);
+}
+
+static void HCI_sampler_setDescriptor(DmacDescriptor* descriptor, volatile uint16_t* buffer, uint16_t length, DmacDescriptor* next)
+{
+	descriptor->BTCTRL.reg = DMAC_BTCTRL_VALID | DMAC_BTCTRL_BLOCKACT_INT | DMAC_BTCTRL_BEATSIZE_HWORD | DMAC_BTCTRL_DSTINC;
+	descriptor->BTCNT.reg = length;
+	descriptor->SRCADDR.reg = (uint32_t) &ADC->RESULT.reg;
+	descriptor->DSTADDR.reg = (uint32_t) (buffer + length);		// end address (incremented destination)
+	descriptor->DESCADDR.reg = (uint32_t) next;
+}
+
+// scan of inputs first -> first + qty - 1, results written in buffer 0, then 1, then 0...
+// false if the DMA controller is already used
+static bool HCI_sampler_startDMA(volatile uint16_t* buffer0, volatile uint16_t* buffer1, uint8_t first, uint8_t qty, uint8_t averaging)
+{
+	// DMA controller
+	if (DMAC->CTRL.bit.DMAENABLE && (DMAC->BASEADDR.reg != (uint32_t) &g_sampler_descriptor))
+		return false;
+
+	PM->AHBMASK.reg |= PM_AHBMASK_DMAC;
+	PM->APBBMASK.reg |= PM_APBBMASK_DMAC;
+
+	DMAC->CTRL.reg = 0;
+	DMAC->BASEADDR.reg = (uint32_t) &g_sampler_descriptor;
+	DMAC->WRBADDR.reg = (uint32_t) &g_sampler_writeback;
+	DMAC->CTRL.reg = DMAC_CTRL_DMAENABLE | DMAC_CTRL_LVLEN(0xf);
+
+	uint16_t length = qty * HC_SAMPLER_DMA_SWEEP_QTY;
+	HCI_sampler_setDescriptor(&g_sampler_descriptor, buffer0, length, &g_sampler_linked);
+	HCI_sampler_setDescriptor(&g_sampler_linked, buffer1, length, &g_sampler_descriptor);
+
+	// buffer 0 in progress until the first result
+	g_sampler_writeback.DSTADDR.reg = g_sampler_descriptor.DSTADDR.reg;
+
+	// channel 0: 1 beat (result) per ADC result ready. Block interrupt flag, without interrupt
+	DMAC->CHID.reg = DMAC_CHID_ID(0);
+	DMAC->CHCTRLA.reg = 0;
+	DMAC->CHCTRLA.reg = DMAC_CHCTRLA_SWRST;
+	DMAC->CHCTRLB.reg = DMAC_CHCTRLB_LVL(0) | DMAC_CHCTRLB_TRIGSRC(ADC_DMAC_ID_RESRDY) | DMAC_CHCTRLB_TRIGACT_BEAT;
+	DMAC->CHINTFLAG.reg = DMAC_CHINTFLAG_TCMPL;
+	DMAC->CHCTRLA.reg = DMAC_CHCTRLA_ENABLE;
+
+	// ADC (reference, gain, prescaler and sampling time of analogRead())
+	ADC->CTRLA.bit.ENABLE = 0;
+	HCI_sampler_syncADC();
+	g_sampler_ADC_CTRLB = ADC->CTRLB.reg;
+	g_sampler_ADC_AVGCTRL = ADC->AVGCTRL.reg;
+	g_sampler_ADC_INPUTCTRL = ADC->INPUTCTRL.reg;
+
+	ADC->INPUTCTRL.bit.MUXPOS = first;
+	HCI_sampler_syncADC();
+	ADC->INPUTCTRL.bit.INPUTSCAN = qty - 1;
+	HCI_sampler_syncADC();
+	ADC->INPUTCTRL.bit.INPUTOFFSET = 0;
+	HCI_sampler_syncADC();
+
+	// averaging: 2^n samples accumulated (16 bits), divided by 2^ADJRES (n up to 4), above 16 samples
+	// the accumulation is also shifted right automatically (n - 4): result is always a 12 bit average
+	ADC->AVGCTRL.reg = ADC_AVGCTRL_SAMPLENUM(averaging) | ADC_AVGCTRL_ADJRES((averaging < 4) ? averaging : 4);
+	ADC->CTRLB.bit.RESSEL = averaging ? ADC_CTRLB_RESSEL_16BIT_Val : ADC_CTRLB_RESSEL_12BIT_Val;
+	HCI_sampler_syncADC();
+	ADC->CTRLB.bit.FREERUN = 1;
+	HCI_sampler_syncADC();
+
+	ADC->CTRLA.bit.ENABLE = 1;
+	HCI_sampler_syncADC();
+	ADC->SWTRIG.bit.START = 1;
+	HCI_sampler_syncADC();
+
+	return true;
+}
+
+static void HCI_sampler_stopDMA()
+{
+	ADC->CTRLA.bit.ENABLE = 0;
+	HCI_sampler_syncADC();
+	ADC->CTRLB.reg = g_sampler_ADC_CTRLB;
+	HCI_sampler_syncADC();
+	ADC->AVGCTRL.reg = g_sampler_ADC_AVGCTRL;
+	ADC->INPUTCTRL.reg = g_sampler_ADC_INPUTCTRL;
+	HCI_sampler_syncADC();
+
+	DMAC->CHID.reg = DMAC_CHID_ID(0);
+	DMAC->CHCTRLA.reg = 0;
+}
+
+// a buffer has been completed (since the flag was consumed)
+static bool HCI_sampler_readCompletedFlag(bool consume)
+{
+	DMAC->CHID.reg = DMAC_CHID_ID(0);
+	if (!(DMAC->CHINTFLAG.reg & DMAC_CHINTFLAG_TCMPL))
+		return false;
+
+	if (consume)
+		DMAC->CHINTFLAG.reg = DMAC_CHINTFLAG_TCMPL;
+	return true;
+}
+
+// buffer being written (0 or 1): destination of the descriptor in progress (write-back section)
+static uint8_t HCI_sampler_getActiveBuffer()
+{
+	return (g_sampler_writeback.DSTADDR.reg == g_sampler_descriptor.DSTADDR.reg) ? 0 : 1;
+}
+#endif
+
+
+
+// *****************************************************************************
+// Class Methods
+// *****************************************************************************
+
+	// setters -----------------------------------------------------------------
+
+	void HC_Sampler::enableChannel(uint8_t index, unsigned long period)
+	{
+		stop();
+
+		if ((index >= HC_SAMPLER_MAX_CHANNEL_QTY) || (index > HCS_getAI_endIndex()))
+			return;
+
+		HCS_writeBit(mChannels, index, true);
+		mPeriod[index] = period;
+	}
+
+	void HC_Sampler::disableChannel(uint8_t index)
+	{
+		stop();
+
+		if (index < HC_SAMPLER_MAX_CHANNEL_QTY)
+			HCS_writeBit(mChannels, index, false);
+	}
+
+	void HC_Sampler::enableAllChannels(unsigned long period)
+	{
+		for (uint8_t index = 0; index <= HCS_getAI_endIndex(); ++index)
+			enableChannel(index, period);
+	}
+
+	void HC_Sampler::setOversampling(uint8_t index, uint8_t n)
+	{
+		stop();
+
+		if (index < HC_SAMPLER_MAX_CHANNEL_QTY)
+			mOversampling[index] = (n > HC_SAMPLER_MAX_OVERSAMPLING) ? HC_SAMPLER_MAX_OVERSAMPLING : n;
+	}
+
+#ifdef HC_SAMPLER_DMA
+	void HC_Sampler::setAveraging(uint8_t n)
+	{
+		stop();
+		mAveraging = (n > HC_SAMPLER_DMA_MAX_AVERAGING) ? HC_SAMPLER_DMA_MAX_AVERAGING : n;
+	}
+#endif
+
+
+	// control -----------------------------------------------------------------
+
+	void HC_Sampler::begin()
+	{
+		stop();
+
+		if (mChannels == 0)
+			return;
+
+		// latest conversions available as soon as started
+		for (uint8_t index = 0; index < HC_SAMPLER_MAX_CHANNEL_QTY; ++index)
+		{
+			mHistory_write[index] = 0;
+			mHistory_qty[index] = 0;
+			mSum[index] = 0;
+			mSum_qty[index] = 0;
+
+			if (isEnabled(index))
+				mLatest[index] = HCS_readAI_LA(index) << mOversampling[index];
+		}
+
+		if (!isEnabled(mChannel_current))
+			mChannel_current = getNextChannel();
+
+		#ifdef HC_SAMPLER_DMA
+			// scanned ADC inputs: lowest to highest enabled one
+			uint8_t last = 0;
+			mScan_first = 0xFF;
+			for (uint8_t index = 0; index < HC_SAMPLER_MAX_CHANNEL_QTY; ++index)
+			{
+				if (!isEnabled(index))
+					continue;
+
+				mInput[index] = g_APinDescription[PIN_A0 + index].ulADCChannelNumber;
+				if (mInput[index] < mScan_first)
+					mScan_first = mInput[index];
+				if (mInput[index] > last)
+					last = mInput[index];
+			}
+			mScan_qty = last - mScan_first + 1;
+		#endif
+
+		mIsStarted = true;
+		startConversion();
+	}
+
+	void HC_Sampler::stop()
+	{
+		if (!mIsStarted)
+			return;
+
+		waitConversion();
+		mIsStarted = false;
+	}
+
+	void HC_Sampler::run()
+	{
+		if (!mIsStarted)
+			return;
+
+		#if defined(HC_SAMPLER_DMA)
+			// history: once per completed buffer (oversampled channels: all sweeps of the buffer)
+			if (mDma_isStarted)
+			{
+				if (HCI_sampler_readCompletedFlag(true))
+				{
+					mDma_isFilled = true;
+					const volatile uint16_t* sweep = getCompletedSweep();
+
+					for (uint8_t index = 0; index < HC_SAMPLER_MAX_CHANNEL_QTY; ++index)
+					{
+						if (!isEnabled(index))
+							continue;
+
+						if (mOversampling[index] == 0)
+							record(index, readSweep(sweep, index));
+						else
+							for (uint8_t s = HC_SAMPLER_DMA_SWEEP_QTY; s > 0; --s)
+								record(index, readSweep(sweep - (s - 1) * mScan_qty, index));
+					}
+				}
+				return;
+			}
+		#endif
+
+		#ifndef HC_SAMPLER_INTERRUPT
+			onConversion(HCS_readAI_LA(mChannel_current));
+		#endif
+	}
+
+
+	// getters -----------------------------------------------------------------
+
+	bool HC_Sampler::isStarted() const
+	{
+		return mIsStarted;
+	}
+
+	bool HC_Sampler::isEnabled(uint8_t index) const
+	{
+		return (index < HC_SAMPLER_MAX_CHANNEL_QTY) && HCS_readBit(mChannels, index);
+	}
+
+	unsigned long HC_Sampler::getPeriod(uint8_t index) const
+	{
+		return (index < HC_SAMPLER_MAX_CHANNEL_QTY) ? mPeriod[index] : 0;
+	}
+
+	uint8_t HC_Sampler::getOversampling(uint8_t index) const
+	{
+		return (index < HC_SAMPLER_MAX_CHANNEL_QTY) ? mOversampling[index] : 0;
+	}
+
+	uint8_t HC_Sampler::getResolution(uint8_t index) const
+	{
+		return isEnabled(index) ? 10 + mOversampling[index] : 10;
+	}
+
+	uint8_t HC_Sampler::getMaxResolution() const
+	{
+		uint8_t resolution = 10;
+
+		for (uint8_t index = 0; index < HC_SAMPLER_MAX_CHANNEL_QTY; ++index)
+		{
+			if (getResolution(index) > resolution)
+				resolution = getResolution(index);
+		}
+
+		return resolution;
+	}
+
+#ifdef HC_SAMPLER_DMA
+	uint8_t HC_Sampler::getAveraging() const
+	{
+		return mAveraging;
+	}
+#endif
+
+	unsigned int HC_Sampler::read(uint8_t index)
+	{
+		if (index > HCS_getAI_endIndex())
+			return 0;
+
+		// blocking conversion (ADC not used by the sampler meanwhile)
+		if (!mIsStarted || !isEnabled(index))
+		{
+			if (mIsStarted)
+				waitConversion();
+
+			unsigned int value = HCS_readAI_LA(index);
+
+			if (mIsStarted)
+				startConversion();
+
+			return value;
+		}
+
+		#ifdef HC_SAMPLER_DMA
+			// oversampled: results decimated by run()
+			if (mDma_isStarted && (mOversampling[index] == 0))
+			{
+				const volatile uint16_t* sweep = getCompletedSweep();
+				if (sweep != NULL_POINTER)
+					return readSweep(sweep, index);
+			}
+		#endif
+
+		noInterrupts();
+		unsigned int value = mLatest[index];
+		interrupts();
+
+		return value;
+	}
+
+	uint8_t HC_Sampler::getHistoryQty(uint8_t index) const
+	{
+		return (index < HC_SAMPLER_MAX_CHANNEL_QTY) ? mHistory_qty[index] : 0;
+	}
+
+	unsigned int HC_Sampler::readHistory(uint8_t index, uint8_t age) const
+	{
+		unsigned int value = 0;
+
+		noInterrupts();
+		if ((index < HC_SAMPLER_MAX_CHANNEL_QTY) && (age < mHistory_qty[index]))
+			value = mHistory[index][(uint8_t)(mHistory_write[index] - 1 - age) & (HC_SAMPLER_HISTORY_SIZE - 1)];
+		interrupts();
+
+		return value;
+	}
+
+
+	// called from interrupts --------------------------------------------------
+
+	void HC_Sampler::onConversion(unsigned int value)
+	{
+		record(mChannel_current, value);
+
+		mChannel_current = getNextChannel();
+
+		#ifdef HC_SAMPLER_INTERRUPT
+			if (mIsStarted)
+				startConversion();
+		#endif
+	}
+
+
+	// conversions -------------------------------------------------------------
+
+	void HC_Sampler::startConversion()
+	{
+		#if defined(HC_SAMPLER_INTERRUPT)
+			HCI_sampler_select(mChannel_current);
+
+			// clear the interrupt flag, enable the interrupt, start
+			ADCSRA |= _BV(ADIF) | _BV(ADIE) | _BV(ADSC);
+
+		#elif defined(HC_SAMPLER_DMA)
+			mDma_isFilled = false;
+			mDma_isStarted = (mScan_qty <= HC_SAMPLER_DMA_MAX_INPUT_QTY) &&
+							 HCI_sampler_startDMA(mDma_buffer[0], mDma_buffer[1], mScan_first, mScan_qty, mAveraging);
+		#endif
+	}
+
+	void HC_Sampler::waitConversion()
+	{
+		#if defined(HC_SAMPLER_INTERRUPT)
+			// no interrupt: the conversion in progress is dropped
+			noInterrupts();
+			ADCSRA &= ~_BV(ADIE);
+			interrupts();
+
+			while (ADCSRA & _BV(ADSC));
+			ADCSRA |= _BV(ADIF);
+
+		#elif defined(HC_SAMPLER_DMA)
+			if (mDma_isStarted)
+				HCI_sampler_stopDMA();
+			mDma_isStarted = false;
+		#endif
+	}
+
+	void HC_Sampler::record(uint8_t channel, unsigned int value)
+	{
+		// oversampling: 1 result per 4^n conversions, 10 + n bits
+		uint8_t n = mOversampling[channel];
+		if (n > 0)
+		{
+			mSum[channel] += value;
+			if (++mSum_qty[channel] < (1U << (2 * n)))
+				return;
+
+			value = mSum[channel] >> n;
+			mSum[channel] = 0;
+			mSum_qty[channel] = 0;
+		}
+
+		mLatest[channel] = value;
+
+		// history: every period at most
+		unsigned long now = HCS_micros();
+		if ((mHistory_qty[channel] == 0) || (now - mHistory_time[channel] >= mPeriod[channel]))
+		{
+			mHistory[channel][mHistory_write[channel]] = value;
+			mHistory_write[channel] = (mHistory_write[channel] + 1) & (HC_SAMPLER_HISTORY_SIZE - 1);
+			if (mHistory_qty[channel] < HC_SAMPLER_HISTORY_SIZE)
+				++mHistory_qty[channel];
+			mHistory_time[channel] = now;
+		}
+	}
+
+	uint8_t HC_Sampler::getNextChannel() const
+	{
+		uint8_t channel = mChannel_current;
+
+		for (uint8_t i = 0; i < HC_SAMPLER_MAX_CHANNEL_QTY; ++i)
+		{
+			if (++channel >= HC_SAMPLER_MAX_CHANNEL_QTY)
+				channel = 0;
+
+			if (HCS_readBit(mChannels, channel))
+				return channel;
+		}
+
+		return mChannel_current;
+	}
+
+
+	// DMA ---------------------------------------------------------------------
+
+#ifdef HC_SAMPLER_DMA
+	const volatile uint16_t* HC_Sampler::getCompletedSweep()
+	{
+		// buffer 0 is completed first
+		uint8_t active = HCI_sampler_getActiveBuffer();
+		if ((active == 1) || HCI_sampler_readCompletedFlag(false))
+			mDma_isFilled = true;
+		if (!mDma_isFilled)
+			return NULL_POINTER;
+
+		return mDma_buffer[active ^ 1] + (HC_SAMPLER_DMA_SWEEP_QTY - 1) * mScan_qty;
+	}
+
+	unsigned int HC_Sampler::readSweep(const volatile uint16_t* sweep, uint8_t channel) const
+	{
+		// result: 12 bits (averaged or not). Scaled to 10 bits
+		return sweep[mInput[channel] - mScan_first] >> 2;
+	}
+#endif
+
+
+#endif // HC_SAMPLER_COMPILE
@@ -269,6 +269,9 @@ void attachPinToServo(
                     // update max achieved quantity
                     if (_attachedServos_qty_maxAchieved < _attachedServos_qty)
                         _attachedServos_qty_maxAchieved = _attachedServos_qty;
+
+                    // servo mode and PWM availability have changed
+                    HCI_invalidateWritableDO();
                 }
             }
         }
@@ -289,6 +292,9 @@ void detachPinFromServo(uint8_t pin)
 
         // decrement counter
         _attachedServos_qty --;
+
+        // servo mode and PWM availability have changed
+        HCI_invalidateWritableDO();
     }
 }
 /*
@@ -115,6 +115,17 @@ HC_Sram HC_sram;
     unsigned int HC_Sram::getAddress_HeapStart()        { return (unsigned int) &__end__; }
     unsigned int HC_Sram::getAddress_HeapEnd()          { return (unsigned int) &__HeapLimit; }
 
+    unsigned int HC_Sram::getAddress_MallocHeapStart()  { return 0; }
+    unsigned int HC_Sram::getAddress_MallocHeapEnd()    { return 0; }
+    unsigned int HC_Sram::getMallocMargin()             { return 0; }
+#else
+    // no memory map (host build)
+    unsigned int HC_Sram::getAddress_DataStart()        { return 0; }
+    unsigned int HC_Sram::getAddress_DataEnd()          { return 0; }
+    unsigned int HC_Sram::getAddress_BssStart()         { return 0; }
+    unsigned int HC_Sram::getAddress_BssEnd()           { return 0; }
+    unsigned int HC_Sram::getAddress_HeapStart()        { return 0; }
+    unsigned int HC_Sram::getAddress_HeapEnd()          { return 0; }
     unsigned int HC_Sram::getAddress_MallocHeapStart()  { return 0; }
     unsigned int HC_Sram::getAddress_MallocHeapEnd()    { return 0; }
     unsigned int HC_Sram::getMallocMargin()             { return 0; }
@@ -157,6 +168,10 @@ void HC_Sram::setProbe(unsigned char i)
 
     // measure Heap Break Value
     unsigned int heapBreakValue = (unsigned int)sbrk(0);
+#else
+    // no memory map (host build)
+    unsigned int stackPointer = 0;
+    unsigned int heapBreakValue = 0;
 #endif
 
     // check for changes
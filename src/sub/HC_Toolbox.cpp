@@ -115,7 +115,7 @@ uint8_t HC_countBit(uint8_t b)         { return HC_countBit(b, 8); }
 typedef union FloatU
 {
     float float_value;
-    unsigned long hex_value;
+    uint32_t hex_value;
     uint8_t byte_array[4];
 }FloatUnion;
 
@@ -170,6 +170,58 @@ unsigned long HCI_concByteToString(unsigned int inputValue, char* destinationStr
     return (unsigned long) destinationString[0] + (unsigned long) destinationString[1] + (unsigned long) destinationString[2];
 }
 
+// --------------------------------------------------------------------------------
+// Hex char -> value --------------------------------------------------------------
+// --------------------------------------------------------------------------------
+
+uint8_t HCI_hexCharToValue(char c)
+{
+    if ((c >= '0') && (c <= '9'))
+        return c - '0';
+    else if ((c >= 'A') && (c <= 'F'))
+        return c - 'A' + 10;
+    else if ((c >= 'a') && (c <= 'f'))
+        return c - 'a' + 10;
+    else
+        return 0xFF;
+}
+
+
+
+// --------------------------------------------------------------------------------
+// Binary framing (CRC-16, COBS) --------------------------------------------------
+// --------------------------------------------------------------------------------
+
+// CRC-16/XMODEM (poly 0x1021, init 0), bitwise (no table: saves 512 bytes of flash)
+uint16_t HCI_updateCRC16(uint16_t crc, uint8_t data)
+{
+    crc ^= (uint16_t)data << 8;
+
+    uint8_t i = 8;
+    while (i--)
+        crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+
+    return crc;
+}
+
+// in place: each 0x00 data byte is replaced by the distance to the next 0x00 (or to the frame end)
+uint8_t HCI_encodeCOBS(uint8_t* buffer, uint8_t length)
+{
+    uint8_t code_index = 0;
+
+    for (uint8_t i = 1; i <= length; ++i)
+    {
+        if (buffer[i] == 0)
+        {
+            buffer[code_index] = i - code_index;
+            code_index = i;
+        }
+    }
+    buffer[code_index] = length + 1 - code_index;
+
+    return length + 1;
+}
+
 
 
 // -----------------------------------------------------------------------------
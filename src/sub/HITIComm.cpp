@@ -26,6 +26,7 @@
 // Variables
 // *****************************************************************************
 
+// main session (Serial by default)
 static HC_Protocol protocol;
 
 
@@ -36,6 +37,10 @@ static HC_Protocol protocol;
 
 // HITICommSupport
 #include "HCS_Serial.h"
+#include "HCS_Time.h"
+
+// HITIComm
+#include "HC_Sram.h"
 
 
 
@@ -48,11 +53,26 @@ void HC_begin(long baudrate)
     // Set Serial baudrate
     HCS_Serial_setBaudrate(baudrate);
 
+    HC_begin(Serial);
+
+#ifdef HC_BAUDRATE_NEGOTIATION
+    // baudrate can be changed by the computer
+    protocol.setBaudrate(baudrate);
+#endif
+}
+
+
+void HC_begin(Stream& stream)
+{
+    protocol.setStream(stream);
+
 	// instantiates all Servos
 	HCI_initializeServos(true);
 
-    // inform computer that Arduino has started
-    protocol.sendMessage_BoardHasStarted();
+    // DI and DO registers read port by port
+    HCI_initializeDIOPorts();
+
+    HC_addSession(protocol);
 }
 
 
@@ -62,9 +82,98 @@ void HC_begin()
 }
 
 
+void HC_addSession(HC_Protocol& session)
+{
+    HC_Protocol::addSession(session);
+
+    // inform computer that Arduino has started
+    session.sendMessage_BoardHasStarted();
+}
+
+
+#ifdef HC_MIRROR_COMPILE
+void HC_addMirror(HC_Mirror& mirror)
+{
+    HC_Mirror::addMirror(mirror);
+}
+#endif
+
+
+#ifdef HC_MULTIDROP
+void HC_multidropNode(uint8_t node)
+{
+    protocol.setNode(node);
+}
+
+
+void HC_multidropDriverEnable(uint8_t pin, unsigned int turnaroundDelay)
+{
+    protocol.setDriverEnable(pin, turnaroundDelay);
+}
+#endif
+
+
+#ifdef HC_BAUDRATE_NEGOTIATION
+long HC_readBaudrate()
+{
+    return protocol.getBaudrate();
+}
+#endif
+
+
 void HC_communicate()
 {
-    protocol.communicate();
+    // calculate cycle time
+    HCS_calculateCycleTime();
+
+    // measure SRAM on probe 0 (measurement used in X query)
+    HC_sram.setProbe(0);
+
+    // record Digital Data (useful for rising/falling edge detection)
+    HCI_recordDD();
+
+#ifdef HC_SAMPLER_COMPILE
+    // background AI conversion (1 per cycle, unless chained by the ADC interrupt: HC_SAMPLER_INTERRUPT)
+    HC_sampler.run();
+#endif
+
+#ifdef HC_CAPTURE_COMPILE
+    // sample captured AI (if capture is armed)
+    HC_capture.run();
+#endif
+
+#ifdef HC_PERIPHERAL_COMPILE
+    // refresh the register-mapped snapshot (if a master MCU polls the board)
+    HC_peripheral.update();
+#endif
+
+#ifdef HC_MIRROR_COMPILE
+    // each mirror: apply received DD/AD, send changes
+    for (HC_Mirror* mirror = HC_Mirror::getFirstMirror(); mirror != NULL_POINTER; mirror = mirror->getNextMirror())
+        mirror->run();
+#endif
+
+    // each session: receive, process, send messages
+    for (HC_Protocol* session = HC_Protocol::getFirstSession(); session != NULL_POINTER; session = session->getNextSession())
+        session->communicate();
+}
+
+
+unsigned int HC_readQueuedBytes()
+{
+    return protocol.getQueuedBytes();
+}
+
+
+unsigned long HC_readDeferredReplies()
+{
+    return protocol.getDeferredReplies();
+}
+
+
+unsigned long HC_readDroppedReplies()
+{
+    return protocol.getDroppedReplies();
 }
 
 